@@ -0,0 +1,159 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef DATASKETCHES_BFLOAT16_HPP_
+#define DATASKETCHES_BFLOAT16_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "memory_operations.hpp"
+#include "serde.hpp"
+#include "sorting.hpp"
+
+namespace datasketches {
+
+/**
+ * Compact floating point item: the upper 16 bits of a float
+ * with the same exponent range and 8 bits of precision.
+ * A float is rounded to the nearest bfloat16 (ties to even), so the relative error of an item is at most 2^-8.
+ *
+ * This is meant as the item type of quantiles sketches, for instance kll_sketch<bfloat16>,
+ * to retain and serialize half the bytes of a sketch of floats.
+ * The rounding preserves the order of the items, so such a sketch is an ordinary sketch of the rounded stream.
+ * Compared to the original stream:
+ * - quantiles are within the relative error above from a quantile with the error of the sketch
+ * - the rank of a value can be off by the error of the sketch plus the fraction of the stream
+ *   within the relative error above from the value
+ * NaN does not have an order, so it must not be added into a sketch.
+ * Sketches check NaN only for floating point arguments, so update the sketch with floats, not with bfloat16.
+ */
+class bfloat16 {
+public:
+  bfloat16(): bits_(0) {}
+
+  // implicit to update a sketch of bfloat16 with floats
+  bfloat16(float value): bits_(round(value)) {}
+
+  // implicit to compare and to use as a float
+  operator float() const {
+    const uint32_t bits = static_cast<uint32_t>(bits_) << 16;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  uint16_t get_bits() const { return bits_; }
+
+  static bfloat16 from_bits(uint16_t bits) {
+    bfloat16 value;
+    value.bits_ = bits;
+    return value;
+  }
+
+private:
+  uint16_t bits_;
+
+  static uint16_t round(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffff) > 0x7f800000) return static_cast<uint16_t>((bits >> 16) | 0x40); // quiet NaN
+    // round to nearest even, overflows to infinity
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return static_cast<uint16_t>(bits >> 16);
+  }
+};
+
+// sorting by the same key as float
+template<>
+struct radix_sort_key<bfloat16> {
+  static const bool supported = true;
+  using type = uint16_t;
+  static type get(bfloat16 item) {
+    const type bits = item.get_bits();
+    // flip all bits of negative numbers and only the sign bit of positive ones
+    return bits ^ (static_cast<type>(0 - (bits >> 15)) | 0x8000);
+  }
+};
+
+// serde of the 16 bits of each item
+template<>
+struct serde<bfloat16> {
+  void serialize(std::ostream& os, const bfloat16* items, unsigned num) const {
+    bool failure = false;
+    try {
+      for (unsigned i = 0; i < num; ++i) {
+        const uint16_t bits = items[i].get_bits();
+        os.write(reinterpret_cast<const char*>(&bits), sizeof(bits));
+      }
+    } catch (std::ostream::failure&) {
+      failure = true;
+    }
+    if (failure || !os.good()) {
+      throw std::runtime_error("error writing to std::ostream with " + std::to_string(num) + " items");
+    }
+  }
+  void deserialize(std::istream& is, bfloat16* items, unsigned num) const {
+    bool failure = false;
+    unsigned i = 0;
+    try {
+      for (; i < num; ++i) {
+        uint16_t bits;
+        is.read(reinterpret_cast<char*>(&bits), sizeof(bits));
+        if (!is.good()) break;
+        new (&items[i]) bfloat16(bfloat16::from_bits(bits));
+      }
+    } catch (std::istream::failure&) {
+      failure = true;
+    }
+    if (failure || !is.good()) {
+      throw std::runtime_error("error reading from std::istream with " + std::to_string(num) + " items");
+    }
+  }
+
+  size_t size_of_item(const bfloat16&) const {
+    return sizeof(uint16_t);
+  }
+  size_t serialize(void* ptr, size_t capacity, const bfloat16* items, unsigned num) const {
+    const size_t bytes_written = sizeof(uint16_t) * num;
+    check_memory_size(bytes_written, capacity);
+    char* dst = static_cast<char*>(ptr);
+    for (unsigned i = 0; i < num; ++i) dst += copy_to_mem(items[i].get_bits(), dst);
+    return bytes_written;
+  }
+  size_t deserialize(const void* ptr, size_t capacity, bfloat16* items, unsigned num) const {
+    const size_t bytes_read = sizeof(uint16_t) * num;
+    check_memory_size(bytes_read, capacity);
+    const char* src = static_cast<const char*>(ptr);
+    for (unsigned i = 0; i < num; ++i) {
+      uint16_t bits;
+      src += copy_from_mem(src, bits);
+      new (&items[i]) bfloat16(bfloat16::from_bits(bits));
+    }
+    return bytes_read;
+  }
+};
+
+} /* namespace datasketches */
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef PARALLEL_MERGE_HPP_
+#define PARALLEL_MERGE_HPP_
+
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "common_defs.hpp"
+#include "run_parallel.hpp"
+
+namespace datasketches {
+
+/**
+ * Merges a range of sketches into the given one using several threads.
+ * The sketches are merged pairwise in a binary tree, and the nodes of each level of the tree
+ * are merged in parallel. This works for any sketch with copy and move constructors
+ * and merge(), such as kll_sketch, req_sketch and quantiles_sketch.
+ *
+ * <p>The shape of the tree depends only on the number of sketches, not on the number of threads.
+ * The result is random, as with merging one sketch at a time.
+ *
+ * <p>The sketches must not be modified while this function runs. If a merge throws,
+ * the exception is rethrown here once all threads have finished, and the state
+ * of the target sketch is unspecified.
+ *
+ * @param sketch target sketch to merge the range into
+ * @param first iterator to the first sketch
+ * @param last iterator past the last sketch, must be a forward iterator
+ * @param num_threads number of threads to use, including the calling thread
+ */
+template<typename Sketch, typename ForwardIt>
+void merge_parallel(Sketch& sketch, ForwardIt first, ForwardIt last, unsigned num_threads);
+
+/**
+ * Same as above, but the random generators of each thread are seeded for every merge
+ * from the given seed and the position of the merge in the tree, so that the result
+ * is reproducible regardless of the number of threads.
+ * The state of the random generators of the calling thread is restored at the end.
+ *
+ * @param sketch target sketch to merge the range into
+ * @param first iterator to the first sketch
+ * @param last iterator past the last sketch, must be a forward iterator
+ * @param num_threads number of threads to use, including the calling thread
+ * @param seed seed for the random generators
+ */
+template<typename Sketch, typename ForwardIt>
+void merge_parallel(Sketch& sketch, ForwardIt first, ForwardIt last, unsigned num_threads, uint64_t seed);
+
+namespace parallel_merge_helpers {
+
+// splitmix64 finalizer to derive independent seeds for the merges
+static inline uint64_t merge_seed(uint64_t seed, uint64_t round, uint64_t node) {
+  uint64_t z = seed + (round << 48) + node + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static inline void seed_random(uint64_t seed) {
+  random_bit.seed(static_cast<uint32_t>(seed));
+  random_utils::rand.seed(seed);
+}
+
+// restores the random generators of this thread on scope exit
+struct random_state_guard {
+  random_state_guard(): saved_random_bit(random_bit), saved_rand(random_utils::rand) {}
+  ~random_state_guard() {
+    random_bit = saved_random_bit;
+    random_utils::rand = saved_rand;
+  }
+  const decltype(random_bit) saved_random_bit;
+  const decltype(random_utils::rand) saved_rand;
+};
+
+template<typename Sketch, typename ForwardIt>
+void merge_parallel(Sketch& sketch, ForwardIt first, ForwardIt last, unsigned num_threads, bool is_seeded, uint64_t seed) {
+  if (num_threads == 0) throw std::invalid_argument("num_threads must be positive");
+  using Allocator = decltype(sketch.get_allocator());
+  using AllocPtr = typename std::allocator_traits<Allocator>::template rebind_alloc<const Sketch*>;
+  using AllocSketch = typename std::allocator_traits<Allocator>::template rebind_alloc<Sketch>;
+  const Allocator allocator = sketch.get_allocator();
+  std::vector<const Sketch*, AllocPtr> inputs(allocator);
+  for (ForwardIt it = first; it != last; ++it) inputs.push_back(std::addressof(*it));
+  if (inputs.empty()) return;
+
+  // leaves of the tree are pairs of inputs, the first one of each pair is copied
+  std::vector<Sketch, AllocSketch> partials(allocator);
+  partials.reserve((inputs.size() + 1) / 2);
+  for (size_t i = 0; i < inputs.size(); i += 2) partials.push_back(*inputs[i]);
+  run_parallel(partials.size(), num_threads, [&](size_t node) {
+    if (2 * node + 1 == inputs.size()) return;
+    if (is_seeded) seed_random(merge_seed(seed, 0, node));
+    partials[node].merge(*inputs[2 * node + 1]);
+  }, allocator);
+
+  // each next level merges pairs of partial results in place
+  uint64_t round = 1;
+  for (size_t stride = 1; stride < partials.size(); stride *= 2, ++round) {
+    const size_t num_nodes = (partials.size() + 2 * stride - 1) / (2 * stride);
+    run_parallel(num_nodes, num_threads, [&](size_t node) {
+      const size_t i = node * 2 * stride;
+      if (i + stride >= partials.size()) return;
+      if (is_seeded) seed_random(merge_seed(seed, round, node));
+      partials[i].merge(std::move(partials[i + stride]));
+    }, allocator);
+  }
+
+  if (is_seeded) seed_random(merge_seed(seed, round, 0));
+  sketch.merge(std::move(partials[0]));
+}
+
+} /* namespace parallel_merge_helpers */
+
+template<typename Sketch, typename ForwardIt>
+void merge_parallel(Sketch& sketch, ForwardIt first, ForwardIt last, unsigned num_threads) {
+  parallel_merge_helpers::merge_parallel(sketch, first, last, num_threads, false, 0);
+}
+
+template<typename Sketch, typename ForwardIt>
+void merge_parallel(Sketch& sketch, ForwardIt first, ForwardIt last, unsigned num_threads, uint64_t seed) {
+  const parallel_merge_helpers::random_state_guard guard;
+  parallel_merge_helpers::merge_parallel(sketch, first, last, num_threads, true, seed);
+}
+
+} /* namespace datasketches */
+
+#endif
@@ -22,8 +22,10 @@
 
 #include <functional>
 #include <cmath>
+#include <vector>
 
 #include "common_defs.hpp"
+#include "serde.hpp"
 
 namespace datasketches {
 
@@ -40,6 +42,8 @@ public:
 
   quantiles_sorted_view(uint32_t num, const Comparator& comparator, const Allocator& allocator);
 
+  // adds a sorted range of items with the given weight
+  // the ranges are merged all at once by convert_to_cummulative()
   template<typename Iterator>
   void add(Iterator begin, Iterator end, uint64_t weight);
 
@@ -60,14 +64,51 @@ public:
   vector_double get_CDF(const T* split_points, uint32_t size, bool inclusive = true) const;
   vector_double get_PMF(const T* split_points, uint32_t size, bool inclusive = true) const;
 
+  // batch versions of get_rank() and get_quantile(), which are faster for many items or ranks,
+  // especially if they are sorted
+  vector_double get_ranks(const T* items, uint32_t size, bool inclusive = true) const;
+  std::vector<T, Allocator> get_quantiles(const double* ranks, uint32_t size, bool inclusive = true) const;
+
+  // size needed to serialize the view
+  template<typename SerDe = serde<T>>
+  size_t get_serialized_size_bytes(const SerDe& sd = SerDe()) const;
+
+  // The type returned by the following serialize method
+  using vector_bytes = std::vector<uint8_t, typename std::allocator_traits<Allocator>::template rebind_alloc<uint8_t>>;
+
+  // serializes the cumulative weights followed by the items to be queried later by wrapped_quantiles_sorted_view
+  // without building the view again (a header size multiple of 8 keeps the weights aligned)
+  template<typename SerDe = serde<T>>
+  vector_bytes serialize(unsigned header_size_bytes = 0, const SerDe& sd = SerDe()) const;
+
 private:
+  template<typename TT, typename CC, typename AA> friend class wrapped_quantiles_sorted_view;
+
+  static const uint8_t SERIAL_VERSION = 1;
+  static const size_t DATA_START = 16;
+
+  using vector_u32 = std::vector<uint32_t, typename std::allocator_traits<Allocator>::template rebind_alloc<uint32_t>>;
+
   Comparator comparator_;
   uint64_t total_weight_;
   Container entries_;
+  vector_u32 level_ends_; // ends of the added ranges in entries_ until they are merged
+
+  void merge_levels();
+
+  template<typename Key, typename Pred, typename Output>
+  void find_all(const Key* keys, uint32_t size, bool sorted, Pred pred, Output output) const;
+
+  double get_rank_at(size_t index) const;
+  quantile_return_type get_quantile_at(size_t index) const;
+  uint64_t get_weight_for_rank(double rank, bool inclusive) const;
 
   static inline const T& deref_helper(const T* t) { return *t; }
   static inline T deref_helper(T t) { return t; }
 
+  static inline const T* ptr_helper(const T* t) { return t; }
+  static inline const T* ptr_helper(const T& t) { return std::addressof(t); }
+
   struct compare_pairs_by_first {
     explicit compare_pairs_by_first(const Comparator& comparator): comparator_(comparator) {}
     bool operator()(const Entry& a, const Entry& b) const {
@@ -94,6 +135,13 @@ private:
   template<typename TT = T, typename std::enable_if<!std::is_arithmetic<TT>::value, int>::type = 0>
   static inline Entry make_dummy_entry(uint64_t weight) { return Entry(nullptr, weight); }
 
+  // NaN is not ordered, so NaN keys are left out of the sweeps and searched one by one
+  template<typename Key, typename std::enable_if<std::is_floating_point<Key>::value, int>::type = 0>
+  static inline bool is_nan(const Key& key) { return std::isnan(key); }
+
+  template<typename Key, typename std::enable_if<!std::is_floating_point<Key>::value, int>::type = 0>
+  static inline bool is_nan(const Key&) { return false; }
+
   template<typename TT = T, typename std::enable_if<std::is_floating_point<TT>::value, int>::type = 0>
   static inline void check_split_points(const T* items, uint32_t size) {
     for (uint32_t i = 0; i < size ; i++) {
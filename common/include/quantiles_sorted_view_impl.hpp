@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <stdexcept>
 #include <cmath>
+#include <string>
 
 namespace datasketches {
 
@@ -30,7 +31,8 @@ template<typename T, typename C, typename A>
 quantiles_sorted_view<T, C, A>::quantiles_sorted_view(uint32_t num, const C& comparator, const A& allocator):
 comparator_(comparator),
 total_weight_(0),
-entries_(allocator)
+entries_(allocator),
+level_ends_(allocator)
 {
   entries_.reserve(num);
 }
@@ -40,20 +42,41 @@ template<typename Iterator>
 void quantiles_sorted_view<T, C, A>::add(Iterator first, Iterator last, uint64_t weight) {
   const size_t size_before = entries_.size();
   for (auto it = first; it != last; ++it) entries_.push_back(Entry(ref_helper(*it), weight));
-  if (size_before > 0) {
-    Container tmp(entries_.get_allocator());
-    tmp.reserve(entries_.capacity());
-    std::merge(
-        entries_.begin(), entries_.begin() + size_before,
-        entries_.begin() + size_before, entries_.end(),
-        std::back_inserter(tmp), compare_pairs_by_first(comparator_)
-    );
-    std::swap(tmp, entries_);
+  if (entries_.size() > size_before) level_ends_.push_back(static_cast<uint32_t>(entries_.size()));
+}
+
+// merges the added levels one by one into the previous ones, keeping equivalent items in the order of the levels
+template<typename T, typename C, typename A>
+void quantiles_sorted_view<T, C, A>::merge_levels() {
+  if (level_ends_.size() > 1) {
+    Container merged(entries_.size(), entries_[0], entries_.get_allocator());
+    Entry* src = entries_.data();
+    Entry* dst = merged.data();
+    const compare_pairs_by_first compare(comparator_);
+    for (size_t i = 1; i < level_ends_.size(); ++i) {
+      const Entry* first1 = src;
+      const Entry* last1 = src + level_ends_[i - 1];
+      // the level is still in its place in the entries, and when merging into the entries
+      // the output never gets ahead of reading the level
+      const Entry* first2 = entries_.data() + level_ends_[i - 1];
+      const Entry* last2 = entries_.data() + level_ends_[i];
+      Entry* out = dst;
+      while (first1 != last1 && first2 != last2) {
+        if (compare(*first2, *first1)) *out++ = *first2++;
+        else *out++ = *first1++;
+      }
+      out = std::copy(first1, last1, out);
+      if (out != first2) std::copy(first2, last2, out);
+      std::swap(src, dst);
+    }
+    if (src != entries_.data()) std::swap(entries_, merged);
   }
+  level_ends_.clear();
 }
 
 template<typename T, typename C, typename A>
 void quantiles_sorted_view<T, C, A>::convert_to_cummulative() {
+  merge_levels();
   for (auto& entry: entries_) {
     total_weight_ += entry.second;
     entry.second = total_weight_;
@@ -75,7 +98,7 @@ double quantiles_sorted_view<T, C, A>::get_rank(const T& item, bool inclusive) c
 template<typename T, typename C, typename A>
 auto quantiles_sorted_view<T, C, A>::get_quantile(double rank, bool inclusive) const -> quantile_return_type {
   if (entries_.empty()) throw std::runtime_error("operation is undefined for an empty sketch");
-  uint64_t weight = static_cast<uint64_t>(inclusive ? std::ceil(rank * total_weight_) : rank * total_weight_);
+  const uint64_t weight = get_weight_for_rank(rank, inclusive);
   auto it = inclusive ?
       std::lower_bound(entries_.begin(), entries_.end(), make_dummy_entry<T>(weight), compare_pairs_by_second())
     : std::upper_bound(entries_.begin(), entries_.end(), make_dummy_entry<T>(weight), compare_pairs_by_second());
@@ -89,9 +112,16 @@ auto quantiles_sorted_view<T, C, A>::get_CDF(const T* split_points, uint32_t siz
   vector_double buckets(entries_.get_allocator());
   if (entries_.size() == 0) return buckets;
   check_split_points(split_points, size);
-  buckets.reserve(size + 1);
-  for (uint32_t i = 0; i < size; ++i) buckets.push_back(get_rank(split_points[i], inclusive));
-  buckets.push_back(1);
+  buckets.resize(size + 1);
+  // split points are sorted, so this is one sweep if there are many of them
+  const C& compare = comparator_;
+  auto output = [this, &buckets](uint32_t i, size_t index) { buckets[i] = get_rank_at(index); };
+  if (inclusive) {
+    find_all(split_points, size, true, [&compare](const Entry& entry, const T& item) { return !compare(item, deref_helper(entry.first)); }, output);
+  } else {
+    find_all(split_points, size, true, [&compare](const Entry& entry, const T& item) { return compare(deref_helper(entry.first), item); }, output);
+  }
+  buckets[size] = 1;
   return buckets;
 }
 
@@ -105,6 +135,139 @@ auto quantiles_sorted_view<T, C, A>::get_PMF(const T* split_points, uint32_t siz
   return buckets;
 }
 
+template<typename T, typename C, typename A>
+auto quantiles_sorted_view<T, C, A>::get_ranks(const T* items, uint32_t size, bool inclusive) const -> vector_double {
+  if (entries_.empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  vector_double ranks(size, 0, entries_.get_allocator());
+  const C& compare = comparator_;
+  bool sorted = true;
+  const T* previous = nullptr;
+  for (uint32_t i = 0; i < size && sorted; ++i) {
+    if (is_nan(items[i])) continue;
+    if (previous != nullptr && comparator_(items[i], *previous)) sorted = false;
+    previous = &items[i];
+  }
+  auto output = [this, &ranks](uint32_t i, size_t index) { ranks[i] = get_rank_at(index); };
+  if (inclusive) {
+    find_all(items, size, sorted, [&compare](const Entry& entry, const T& item) { return !compare(item, deref_helper(entry.first)); }, output);
+  } else {
+    find_all(items, size, sorted, [&compare](const Entry& entry, const T& item) { return compare(deref_helper(entry.first), item); }, output);
+  }
+  return ranks;
+}
+
+template<typename T, typename C, typename A>
+auto quantiles_sorted_view<T, C, A>::get_quantiles(const double* ranks, uint32_t size, bool inclusive) const -> std::vector<T, A> {
+  if (entries_.empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  using AllocU64 = typename std::allocator_traits<A>::template rebind_alloc<uint64_t>;
+  std::vector<uint64_t, AllocU64> weights(entries_.get_allocator());
+  weights.reserve(size);
+  for (uint32_t i = 0; i < size; ++i) weights.push_back(get_weight_for_rank(ranks[i], inclusive));
+  const bool sorted = std::is_sorted(weights.begin(), weights.end());
+  std::vector<T, A> quantiles(entries_.get_allocator());
+  quantiles.reserve(size);
+  auto output = [this, &quantiles](uint32_t, size_t index) { quantiles.push_back(get_quantile_at(index)); };
+  if (inclusive) {
+    find_all(weights.data(), size, sorted, [](const Entry& entry, uint64_t weight) { return entry.second < weight; }, output);
+  } else {
+    find_all(weights.data(), size, sorted, [](const Entry& entry, uint64_t weight) { return entry.second <= weight; }, output);
+  }
+  return quantiles;
+}
+
+template<typename T, typename C, typename A>
+template<typename SerDe>
+size_t quantiles_sorted_view<T, C, A>::get_serialized_size_bytes(const SerDe& sd) const {
+  size_t size = DATA_START + entries_.size() * sizeof(uint64_t);
+  for (const Entry& entry: entries_) size += sd.size_of_item(deref_helper(entry.first));
+  return size;
+}
+
+template<typename T, typename C, typename A>
+template<typename SerDe>
+auto quantiles_sorted_view<T, C, A>::serialize(unsigned header_size_bytes, const SerDe& sd) const -> vector_bytes {
+  const size_t size = header_size_bytes + get_serialized_size_bytes(sd);
+  vector_bytes bytes(size, 0, entries_.get_allocator());
+  uint8_t* ptr = bytes.data() + header_size_bytes;
+  const uint8_t* end_ptr = bytes.data() + size;
+  const uint8_t serial_version(SERIAL_VERSION);
+  ptr += copy_to_mem(serial_version, ptr);
+  ptr += 3 * sizeof(uint8_t); // unused
+  const uint32_t num_entries = static_cast<uint32_t>(entries_.size());
+  ptr += copy_to_mem(num_entries, ptr);
+  ptr += copy_to_mem(total_weight_, ptr);
+  for (const Entry& entry: entries_) ptr += copy_to_mem(entry.second, ptr);
+  for (const Entry& entry: entries_) {
+    ptr += sd.serialize(ptr, end_ptr - ptr, ptr_helper(entry.first), 1);
+  }
+  const size_t delta = ptr - bytes.data();
+  if (delta != size) throw std::logic_error("serialized size mismatch: " + std::to_string(delta)
+      + " != " + std::to_string(size));
+  return bytes;
+}
+
+// Finds the index of the first entry for which pred(entry, key) is false for each key, in the order of the keys.
+// The predicate must be true for some number of entries at the beginning and false for the rest.
+// For many sorted keys one sweep over the entries is faster than searching for each key, NaN keys are searched instead.
+// Otherwise the binary search has no branches on the comparisons, and a group of keys
+// is searched at the same time, so that the memory accesses for different keys can overlap.
+template<typename T, typename C, typename A>
+template<typename Key, typename Pred, typename Output>
+void quantiles_sorted_view<T, C, A>::find_all(const Key* keys, uint32_t size, bool sorted, Pred pred, Output output) const {
+  const Entry* entries = entries_.data();
+  const size_t num_entries = entries_.size();
+  size_t num_steps = 1;
+  while ((static_cast<size_t>(1) << num_steps) < num_entries) ++num_steps;
+  if (sorted && static_cast<size_t>(size) * num_steps >= num_entries) {
+    size_t index = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      if (is_nan(keys[i])) {
+        const Key& key = keys[i];
+        output(i, std::partition_point(entries, entries + num_entries, [&pred, &key](const Entry& entry) { return pred(entry, key); }) - entries);
+        continue;
+      }
+      while (index < num_entries && pred(entries[index], keys[i])) ++index;
+      output(i, index);
+    }
+    return;
+  }
+  const uint32_t NUM_LANES = 8;
+  for (uint32_t i = 0; i < size; i += NUM_LANES) {
+    const uint32_t num_lanes = std::min(NUM_LANES, size - i);
+    const Entry* bases[NUM_LANES];
+    for (uint32_t j = 0; j < num_lanes; ++j) bases[j] = entries;
+    size_t length = num_entries;
+    while (length > 1) {
+      const size_t half = length / 2;
+      for (uint32_t j = 0; j < num_lanes; ++j) {
+        bases[j] += pred(bases[j][half - 1], keys[i + j]) * half;
+      }
+      length -= half;
+    }
+    for (uint32_t j = 0; j < num_lanes; ++j) {
+      output(i + j, (bases[j] - entries) + pred(*bases[j], keys[i + j]));
+    }
+  }
+}
+
+// rank of the entry before the given index
+template<typename T, typename C, typename A>
+double quantiles_sorted_view<T, C, A>::get_rank_at(size_t index) const {
+  if (index == 0) return 0;
+  return static_cast<double>(entries_[index - 1].second) / total_weight_;
+}
+
+template<typename T, typename C, typename A>
+auto quantiles_sorted_view<T, C, A>::get_quantile_at(size_t index) const -> quantile_return_type {
+  if (index == entries_.size()) return deref_helper(entries_[entries_.size() - 1].first);
+  return deref_helper(entries_[index].first);
+}
+
+template<typename T, typename C, typename A>
+uint64_t quantiles_sorted_view<T, C, A>::get_weight_for_rank(double rank, bool inclusive) const {
+  return static_cast<uint64_t>(inclusive ? std::ceil(rank * total_weight_) : rank * total_weight_);
+}
+
 template<typename T, typename C, typename A>
 auto quantiles_sorted_view<T, C, A>::begin() const -> const_iterator {
   return const_iterator(entries_.begin(), entries_.begin());
@@ -0,0 +1,77 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef RUN_PARALLEL_HPP_
+#define RUN_PARALLEL_HPP_
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace datasketches {
+
+/**
+ * Runs task(node) for every node in [0, num_nodes) on up to num_threads threads,
+ * including the calling thread, which takes nodes as well.
+ * Threads take the next node as soon as they finish the previous one.
+ *
+ * <p>If a task throws, the remaining nodes are still processed,
+ * and the exception is rethrown here once all threads have finished.
+ *
+ * @param num_nodes number of nodes
+ * @param num_threads number of threads to use, including the calling thread, must be positive
+ * @param task function to call with each node
+ * @param allocator allocator for the threads and the exceptions
+ */
+template<typename Task, typename Allocator>
+void run_parallel(size_t num_nodes, unsigned num_threads, const Task& task, const Allocator& allocator) {
+  if (num_threads > num_nodes) num_threads = static_cast<unsigned>(num_nodes);
+  if (num_threads == 0) return;
+  using AllocThread = typename std::allocator_traits<Allocator>::template rebind_alloc<std::thread>;
+  using AllocError = typename std::allocator_traits<Allocator>::template rebind_alloc<std::exception_ptr>;
+  std::vector<std::exception_ptr, AllocError> errors(num_threads, nullptr, allocator);
+  std::atomic<size_t> next_node(0);
+  auto worker = [&task, &errors, &next_node, num_nodes](unsigned i) {
+    try {
+      for (size_t node = next_node++; node < num_nodes; node = next_node++) task(node);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  std::vector<std::thread, AllocThread> threads(allocator);
+  threads.reserve(num_threads - 1);
+  try {
+    for (unsigned i = 1; i < num_threads; ++i) threads.emplace_back(worker, i);
+  } catch (...) {
+    next_node = num_nodes;
+    for (auto& thread: threads) thread.join();
+    throw;
+  }
+  worker(0);
+  for (auto& thread: threads) thread.join();
+  for (const auto& error: errors) {
+    if (error) std::rethrow_exception(error);
+  }
+}
+
+} /* namespace datasketches */
+
+#endif
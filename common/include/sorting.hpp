@@ -0,0 +1,234 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef SORTING_HPP_
+#define SORTING_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+namespace datasketches {
+
+// Sorting and merging of sketch levels.
+// Items of arithmetic types ordered by std::less are sorted by counting for very few items
+// and by radix sort for many items instead of comparison sort,
+// and items of arithmetic types are merged without branching on the comparison.
+// Both need scratch space, which callers provide, so that sorting and merging do not allocate.
+// Without scratch space the items are sorted and merged by the standard algorithms.
+
+// Unsigned key with the same order as the item
+template<typename T, typename Enable = void>
+struct radix_sort_key {
+  static const bool supported = false;
+};
+
+template<typename T>
+struct radix_sort_key<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+  static const bool supported = true;
+  using type = typename std::make_unsigned<T>::type;
+  static type get(T item) {
+    const type sign = std::is_signed<T>::value ? static_cast<type>(static_cast<type>(1) << (sizeof(T) * 8 - 1)) : 0;
+    return static_cast<type>(static_cast<type>(item) ^ sign);
+  }
+};
+
+// NaN is never sorted, and -0 goes before 0, which are equivalent
+template<typename T>
+struct radix_sort_key<T, typename std::enable_if<std::is_floating_point<T>::value && std::numeric_limits<T>::is_iec559
+    && (sizeof(T) == sizeof(uint32_t) || sizeof(T) == sizeof(uint64_t))>::type> {
+  static const bool supported = true;
+  using type = typename std::conditional<sizeof(T) == sizeof(uint32_t), uint32_t, uint64_t>::type;
+  static type get(T item) {
+    type bits;
+    std::memcpy(&bits, &item, sizeof(T));
+    const type sign = static_cast<type>(1) << (sizeof(T) * 8 - 1);
+    // flip all bits of negative numbers and only the sign bit of positive ones
+    return bits ^ (static_cast<type>(0 - (bits >> (sizeof(T) * 8 - 1))) | sign);
+  }
+};
+
+template<typename T, typename C>
+using use_radix_sort = std::integral_constant<bool, radix_sort_key<T>::supported && std::is_same<C, std::less<T>>::value>;
+
+// Number of items of scratch space that sort_items() and merge_items_in_place() need for ranges of up to num items
+template<typename T>
+size_t get_sort_space(size_t num) {
+  return radix_sort_key<T>::supported || std::is_arithmetic<T>::value ? num : 0;
+}
+
+// below this number of items a comparison sort is faster
+static const size_t RADIX_SORT_MIN_ITEMS = 128;
+
+// up to this number of items counting the smaller items is faster than any other sort
+static const size_t RANK_SORT_MAX_ITEMS = 16;
+
+// Each item goes to the position given by the number of items before it in sorted order.
+// This takes more comparisons than a comparison sort, but there are no branches on the comparisons.
+template<typename T, typename C>
+void rank_sort(T* first, T* last, const C& comparator) {
+  T sorted[RANK_SORT_MAX_ITEMS];
+  const size_t num = last - first;
+  for (size_t i = 0; i < num; ++i) {
+    const T item = first[i];
+    size_t rank = 0;
+    for (size_t j = 0; j < i; ++j) rank += !comparator(item, first[j]);
+    for (size_t j = i + 1; j < num; ++j) rank += comparator(first[j], item);
+    sorted[rank] = item;
+  }
+  std::copy(sorted, sorted + num, first);
+}
+
+// LSD radix sort, one byte at a time, skipping bytes that are the same in all items
+template<typename T>
+void radix_sort(T* first, T* last, T* tmp) {
+  using key = radix_sort_key<T>;
+  const unsigned num_bytes = sizeof(typename key::type);
+  const size_t num = last - first;
+  uint32_t counts[num_bytes][256];
+  std::memset(counts, 0, sizeof(counts));
+  for (const T* it = first; it != last; ++it) {
+    const auto k = key::get(*it);
+    for (unsigned i = 0; i < num_bytes; ++i) ++counts[i][(k >> (i * 8)) & 0xff];
+  }
+  T* src = first;
+  T* dst = tmp;
+  for (unsigned i = 0; i < num_bytes; ++i) {
+    uint32_t* offsets = counts[i];
+    if (offsets[(key::get(*src) >> (i * 8)) & 0xff] == num) continue;
+    uint32_t sum = 0;
+    for (unsigned j = 0; j < 256; ++j) {
+      const uint32_t count = offsets[j];
+      offsets[j] = sum;
+      sum += count;
+    }
+    for (const T* it = src; it != src + num; ++it) dst[offsets[(key::get(*it) >> (i * 8)) & 0xff]++] = *it;
+    std::swap(src, dst);
+  }
+  if (src != first) std::copy(src, src + num, first);
+}
+
+// tmp is the scratch space of get_sort_space() items
+template<typename T, typename C, typename std::enable_if<use_radix_sort<T, C>::value, int>::type = 0>
+void sort_items(T* first, T* last, const C& comparator, T* tmp) {
+  const size_t num = last - first;
+  if (num <= RANK_SORT_MAX_ITEMS) {
+    rank_sort(first, last, comparator);
+    return;
+  }
+  if (num < RADIX_SORT_MIN_ITEMS) {
+    std::sort(first, last, comparator);
+    return;
+  }
+  radix_sort(first, last, tmp);
+}
+
+template<typename T, typename C, typename std::enable_if<!use_radix_sort<T, C>::value, int>::type = 0>
+void sort_items(T* first, T* last, const C& comparator, T*) {
+  std::sort(first, last, comparator);
+}
+
+// without scratch space
+template<typename T, typename C, typename std::enable_if<use_radix_sort<T, C>::value, int>::type = 0>
+void sort_items(T* first, T* last, const C& comparator) {
+  if (static_cast<size_t>(last - first) <= RANK_SORT_MAX_ITEMS) {
+    rank_sort(first, last, comparator);
+    return;
+  }
+  std::sort(first, last, comparator);
+}
+
+template<typename T, typename C, typename std::enable_if<!use_radix_sort<T, C>::value, int>::type = 0>
+void sort_items(T* first, T* last, const C& comparator) {
+  std::sort(first, last, comparator);
+}
+
+/*
+ * Merges two sorted ranges into dst.
+ * Equivalent items are taken from the first range first.
+ * The items are moved, and dst must contain initialized items or be trivially constructible.
+ * The destination may overlap the second range as long as dst + (last1 - first1) <= first2.
+ * Returns the end of the merged range.
+ */
+template<typename T, typename C, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+T* merge_items(T* first1, T* last1, T* first2, T* last2, T* dst, const C& comparator) {
+  if (first1 != last1 && first2 != last2) {
+    // both items are loaded before storing, which makes the overlap safe
+    T item1 = *first1;
+    T item2 = *first2;
+    for (;;) {
+      const bool take2 = comparator(item2, item1);
+      *dst++ = take2 ? item2 : item1;
+      first1 += !take2;
+      first2 += take2;
+      if (first1 == last1 || first2 == last2) break;
+      item1 = *first1;
+      item2 = *first2;
+    }
+  }
+  dst = std::copy(first1, last1, dst);
+  if (dst == first2) return last2;
+  return std::copy(first2, last2, dst);
+}
+
+template<typename T, typename C, typename std::enable_if<!std::is_arithmetic<T>::value, int>::type = 0>
+T* merge_items(T* first1, T* last1, T* first2, T* last2, T* dst, const C& comparator) {
+  while (first1 != last1 && first2 != last2) {
+    if (comparator(*first2, *first1)) {
+      if (first2 != dst) *dst = std::move(*first2);
+      ++first2;
+    } else {
+      *dst = std::move(*first1++);
+    }
+    ++dst;
+  }
+  dst = std::move(first1, last1, dst);
+  if (dst == first2) return last2;
+  return std::move(first2, last2, dst);
+}
+
+/*
+ * Merges two consecutive sorted ranges in place.
+ * Equivalent items from the first range go first.
+ * tmp is the scratch space of get_sort_space() items for the first range.
+ */
+template<typename T, typename C, typename std::enable_if<std::is_arithmetic<T>::value, int>::type = 0>
+void merge_items_in_place(T* first, T* middle, T* last, const C& comparator, T* tmp) {
+  if (first == middle || middle == last) return;
+  T* tmp_last = std::copy(first, middle, tmp);
+  merge_items(tmp, tmp_last, middle, last, first, comparator);
+}
+
+template<typename T, typename C, typename std::enable_if<!std::is_arithmetic<T>::value, int>::type = 0>
+void merge_items_in_place(T* first, T* middle, T* last, const C& comparator, T*) {
+  std::inplace_merge(first, middle, last, comparator);
+}
+
+// without scratch space
+template<typename T, typename C>
+void merge_items_in_place(T* first, T* middle, T* last, const C& comparator) {
+  std::inplace_merge(first, middle, last, comparator);
+}
+
+} /* namespace datasketches */
+
+#endif
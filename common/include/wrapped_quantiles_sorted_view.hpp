@@ -0,0 +1,99 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef WRAPPED_QUANTILES_SORTED_VIEW_HPP_
+#define WRAPPED_QUANTILES_SORTED_VIEW_HPP_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "quantiles_sorted_view.hpp"
+
+namespace datasketches {
+
+/**
+ * Read-only sorted view over a buffer produced by quantiles_sorted_view::serialize(),
+ * for instance a memory-mapped file, to query it repeatedly without building the view again.
+ * The cumulative weights are used in place, so the buffer must be aligned to 8 bytes
+ * and must outlive the wrapper.
+ * Items of arithmetic types serialized with the default serde are used in place as well,
+ * other items are deserialized into the wrapper.
+ */
+template<
+  typename T,
+  typename Comparator = std::less<T>, // strict weak ordering function (see C++ named requirements: Compare)
+  typename Allocator = std::allocator<T>
+>
+class wrapped_quantiles_sorted_view {
+public:
+  using quantile_return_type = typename std::conditional<std::is_arithmetic<T>::value, T, const T&>::type;
+  using vector_double = std::vector<double, typename std::allocator_traits<Allocator>::template rebind_alloc<double>>;
+
+  /**
+   * This method wraps a serialized sorted view as an array of bytes.
+   * @param bytes pointer to the array of bytes aligned to 8 bytes
+   * @param size the size of the array
+   * @param sd instance of a SerDe
+   * @param comparator instance of a Comparator
+   * @param allocator instance of an Allocator
+   * @return an instance of the wrapped view
+   */
+  template<typename SerDe = serde<T>>
+  static wrapped_quantiles_sorted_view wrap(const void* bytes, size_t size, const SerDe& sd = SerDe(),
+      const Comparator& comparator = Comparator(), const Allocator& allocator = Allocator());
+
+  bool is_empty() const;
+  uint32_t size() const;
+  uint64_t get_total_weight() const;
+
+  double get_rank(const T& item, bool inclusive = true) const;
+  quantile_return_type get_quantile(double rank, bool inclusive = true) const;
+  vector_double get_CDF(const T* split_points, uint32_t size, bool inclusive = true) const;
+  vector_double get_PMF(const T* split_points, uint32_t size, bool inclusive = true) const;
+
+private:
+  using view = quantiles_sorted_view<T, Comparator, Allocator>;
+
+  Comparator comparator_;
+  uint64_t total_weight_;
+  uint32_t num_entries_;
+  const uint64_t* weights_;
+  const T* items_; // in the wrapped bytes, or null if the items are deserialized
+  std::vector<T, Allocator> deserialized_items_;
+
+  wrapped_quantiles_sorted_view(const Comparator& comparator, uint64_t total_weight, uint32_t num_entries,
+      const uint64_t* weights, const T* items, std::vector<T, Allocator>&& deserialized_items);
+
+  const T* get_items() const;
+  uint32_t find_item(const T& item, bool inclusive, uint32_t from) const;
+
+  template<typename SerDe>
+  static const T* wrap_items(const char* ptr, const char* end_ptr, uint32_t num, const SerDe& sd,
+      std::vector<T, Allocator>& items, std::true_type);
+  template<typename SerDe>
+  static const T* wrap_items(const char* ptr, const char* end_ptr, uint32_t num, const SerDe& sd,
+      std::vector<T, Allocator>& items, std::false_type);
+};
+
+} /* namespace datasketches */
+
+#include "wrapped_quantiles_sorted_view_impl.hpp"
+
+#endif
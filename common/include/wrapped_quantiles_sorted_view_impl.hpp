@@ -0,0 +1,181 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef WRAPPED_QUANTILES_SORTED_VIEW_IMPL_HPP_
+#define WRAPPED_QUANTILES_SORTED_VIEW_IMPL_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace datasketches {
+
+template<typename T, typename C, typename A>
+wrapped_quantiles_sorted_view<T, C, A>::wrapped_quantiles_sorted_view(const C& comparator, uint64_t total_weight,
+    uint32_t num_entries, const uint64_t* weights, const T* items, std::vector<T, A>&& deserialized_items):
+comparator_(comparator),
+total_weight_(total_weight),
+num_entries_(num_entries),
+weights_(weights),
+items_(items),
+deserialized_items_(std::move(deserialized_items))
+{}
+
+template<typename T, typename C, typename A>
+template<typename SerDe>
+wrapped_quantiles_sorted_view<T, C, A> wrapped_quantiles_sorted_view<T, C, A>::wrap(const void* bytes, size_t size,
+    const SerDe& sd, const C& comparator, const A& allocator) {
+  if (reinterpret_cast<uintptr_t>(bytes) % alignof(uint64_t) != 0) {
+    throw std::invalid_argument("serialized view must be aligned to " + std::to_string(alignof(uint64_t)) + " bytes");
+  }
+  ensure_minimum_memory(size, view::DATA_START);
+  const char* ptr = static_cast<const char*>(bytes);
+  const char* end_ptr = ptr + size;
+  uint8_t serial_version;
+  ptr += copy_from_mem(ptr, serial_version);
+  if (serial_version != view::SERIAL_VERSION) {
+    throw std::invalid_argument("serial version mismatch: expected " + std::to_string(view::SERIAL_VERSION)
+        + ", actual " + std::to_string(serial_version));
+  }
+  ptr += 3 * sizeof(uint8_t); // skip unused bytes
+  uint32_t num_entries;
+  ptr += copy_from_mem(ptr, num_entries);
+  uint64_t total_weight;
+  ptr += copy_from_mem(ptr, total_weight);
+  ensure_minimum_memory(size, view::DATA_START + num_entries * sizeof(uint64_t));
+  const uint64_t* weights = reinterpret_cast<const uint64_t*>(ptr);
+  ptr += num_entries * sizeof(uint64_t);
+  std::vector<T, A> deserialized_items(allocator);
+  using is_in_place = std::integral_constant<bool, std::is_arithmetic<T>::value && std::is_same<SerDe, serde<T>>::value>;
+  const T* items = wrap_items(ptr, end_ptr, num_entries, sd, deserialized_items, is_in_place());
+  return wrapped_quantiles_sorted_view(comparator, total_weight, num_entries, weights, items, std::move(deserialized_items));
+}
+
+// items used in place
+template<typename T, typename C, typename A>
+template<typename SerDe>
+const T* wrapped_quantiles_sorted_view<T, C, A>::wrap_items(const char* ptr, const char* end_ptr, uint32_t num,
+    const SerDe&, std::vector<T, A>&, std::true_type) {
+  const size_t size = num * sizeof(T);
+  check_memory_size(size, end_ptr - ptr);
+  if (static_cast<size_t>(end_ptr - ptr) != size) throw std::invalid_argument("wrapped size mismatch: "
+      + std::to_string(end_ptr - ptr) + " != " + std::to_string(size));
+  return reinterpret_cast<const T*>(ptr);
+}
+
+// items deserialized
+template<typename T, typename C, typename A>
+template<typename SerDe>
+const T* wrapped_quantiles_sorted_view<T, C, A>::wrap_items(const char* ptr, const char* end_ptr, uint32_t num,
+    const SerDe& sd, std::vector<T, A>& items, std::false_type) {
+  items.reserve(num);
+  A alloc(items.get_allocator());
+  auto item_buffer_deleter = [&alloc](T* ptr) { alloc.deallocate(ptr, 1); };
+  std::unique_ptr<T, decltype(item_buffer_deleter)> item_buffer(alloc.allocate(1), item_buffer_deleter);
+  for (uint32_t i = 0; i < num; ++i) {
+    ptr += sd.deserialize(ptr, end_ptr - ptr, item_buffer.get(), 1);
+    // no reallocation after reserve(), so this does not throw
+    items.push_back(std::move(*item_buffer));
+    item_buffer->~T();
+  }
+  if (ptr != end_ptr) throw std::invalid_argument("wrapped size mismatch: "
+      + std::to_string(end_ptr - ptr) + " bytes remaining");
+  return nullptr;
+}
+
+template<typename T, typename C, typename A>
+bool wrapped_quantiles_sorted_view<T, C, A>::is_empty() const {
+  return num_entries_ == 0;
+}
+
+template<typename T, typename C, typename A>
+uint32_t wrapped_quantiles_sorted_view<T, C, A>::size() const {
+  return num_entries_;
+}
+
+template<typename T, typename C, typename A>
+uint64_t wrapped_quantiles_sorted_view<T, C, A>::get_total_weight() const {
+  return total_weight_;
+}
+
+template<typename T, typename C, typename A>
+double wrapped_quantiles_sorted_view<T, C, A>::get_rank(const T& item, bool inclusive) const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  const uint32_t index = find_item(item, inclusive, 0);
+  // we need item just before
+  if (index == 0) return 0;
+  return static_cast<double>(weights_[index - 1]) / total_weight_;
+}
+
+template<typename T, typename C, typename A>
+auto wrapped_quantiles_sorted_view<T, C, A>::get_quantile(double rank, bool inclusive) const -> quantile_return_type {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  const uint64_t weight = static_cast<uint64_t>(inclusive ? std::ceil(rank * total_weight_) : rank * total_weight_);
+  const uint64_t* it = inclusive ?
+      std::lower_bound(weights_, weights_ + num_entries_, weight)
+    : std::upper_bound(weights_, weights_ + num_entries_, weight);
+  if (it == weights_ + num_entries_) return get_items()[num_entries_ - 1];
+  return get_items()[it - weights_];
+}
+
+template<typename T, typename C, typename A>
+auto wrapped_quantiles_sorted_view<T, C, A>::get_CDF(const T* split_points, uint32_t size, bool inclusive) const -> vector_double {
+  if (is_empty()) return vector_double(deserialized_items_.get_allocator());
+  view::check_split_points(split_points, size);
+  vector_double buckets(size + 1, 0, deserialized_items_.get_allocator());
+  // split points are sorted, so each search starts where the previous one ended
+  uint32_t index = 0;
+  for (uint32_t i = 0; i < size; ++i) {
+    index = find_item(split_points[i], inclusive, index);
+    buckets[i] = index == 0 ? 0 : static_cast<double>(weights_[index - 1]) / total_weight_;
+  }
+  buckets[size] = 1;
+  return buckets;
+}
+
+template<typename T, typename C, typename A>
+auto wrapped_quantiles_sorted_view<T, C, A>::get_PMF(const T* split_points, uint32_t size, bool inclusive) const -> vector_double {
+  auto buckets = get_CDF(split_points, size, inclusive);
+  if (buckets.size() == 0) return buckets;
+  for (uint32_t i = size; i > 0; --i) {
+    buckets[i] -= buckets[i - 1];
+  }
+  return buckets;
+}
+
+template<typename T, typename C, typename A>
+const T* wrapped_quantiles_sorted_view<T, C, A>::get_items() const {
+  return items_ != nullptr ? items_ : deserialized_items_.data();
+}
+
+// index of the first item greater than the given one (or not less if not inclusive)
+template<typename T, typename C, typename A>
+uint32_t wrapped_quantiles_sorted_view<T, C, A>::find_item(const T& item, bool inclusive, uint32_t from) const {
+  const T* items = get_items();
+  const T* it = inclusive ?
+      std::upper_bound(items + from, items + num_entries_, item, comparator_)
+    : std::lower_bound(items + from, items + num_entries_, item, comparator_);
+  return static_cast<uint32_t>(it - items);
+}
+
+} /* namespace datasketches */
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "bfloat16.hpp"
+
+namespace datasketches {
+
+TEST_CASE("bfloat16: rounding", "[bfloat16]") {
+  REQUIRE(static_cast<float>(bfloat16(0)) == 0);
+  REQUIRE(static_cast<float>(bfloat16(1)) == 1);
+  REQUIRE(static_cast<float>(bfloat16(-2.5f)) == -2.5f);
+  REQUIRE(static_cast<float>(bfloat16(256)) == 256);
+  REQUIRE(static_cast<float>(bfloat16(257)) == 256); // tie to even
+  REQUIRE(static_cast<float>(bfloat16(259)) == 260); // tie to even
+  REQUIRE(static_cast<float>(bfloat16(259.5f)) == 260); // nearest
+  REQUIRE(std::isinf(static_cast<float>(bfloat16(std::numeric_limits<float>::max()))));
+  REQUIRE(std::isinf(static_cast<float>(bfloat16(std::numeric_limits<float>::infinity()))));
+  REQUIRE(std::isnan(static_cast<float>(bfloat16(std::numeric_limits<float>::quiet_NaN()))));
+  REQUIRE(std::isnan(static_cast<float>(bfloat16(std::numeric_limits<float>::signaling_NaN()))));
+
+  std::mt19937 gen(1);
+  std::exponential_distribution<float> distribution(0.001f);
+  for (int i = 0; i < 10000; ++i) {
+    const float value = distribution(gen);
+    const float rounded = bfloat16(value);
+    REQUIRE(std::abs(rounded - value) <= std::ldexp(value, -8));
+  }
+}
+
+TEST_CASE("bfloat16: order", "[bfloat16]") {
+  std::vector<bfloat16> items;
+  for (const float value: {3.0f, -1.5f, 0.0f, -0.0f, 1e30f, -1e-30f, 7.0f, -std::numeric_limits<float>::infinity(), 2.0f}) {
+    items.push_back(value);
+  }
+  for (int i = 0; i < 300; ++i) items.push_back(static_cast<float>((i * 7919) % 1000 - 500));
+  std::vector<float> expected(items.begin(), items.end());
+  std::sort(expected.begin(), expected.end());
+  std::vector<bfloat16> tmp(get_sort_space<bfloat16>(items.size()));
+  sort_items(items.data(), items.data() + items.size(), std::less<bfloat16>(), tmp.data());
+  REQUIRE(std::vector<float>(items.begin(), items.end()) == expected);
+}
+
+TEST_CASE("bfloat16: serde", "[bfloat16]") {
+  const std::vector<bfloat16> items = {1.0f, -3.5f, 1e20f, 0.0f};
+  serde<bfloat16> sd;
+  std::vector<uint8_t> bytes(items.size() * sizeof(uint16_t));
+  REQUIRE(sd.serialize(bytes.data(), bytes.size(), items.data(), items.size()) == bytes.size());
+  std::vector<bfloat16> deserialized(items.size());
+  REQUIRE(sd.deserialize(bytes.data(), bytes.size(), deserialized.data(), items.size()) == bytes.size());
+  REQUIRE(std::vector<float>(deserialized.begin(), deserialized.end()) == std::vector<float>(items.begin(), items.end()));
+  REQUIRE_THROWS_AS(sd.serialize(bytes.data(), bytes.size() - 1, items.data(), items.size()), std::out_of_range);
+
+  std::stringstream s(std::ios::in | std::ios::out | std::ios::binary);
+  sd.serialize(s, items.data(), items.size());
+  std::vector<bfloat16> deserialized_from_stream(items.size());
+  sd.deserialize(s, deserialized_from_stream.data(), items.size());
+  REQUIRE(std::vector<float>(deserialized_from_stream.begin(), deserialized_from_stream.end())
+      == std::vector<float>(items.begin(), items.end()));
+  REQUIRE_THROWS_AS(sd.deserialize(s, deserialized_from_stream.data(), 1), std::runtime_error);
+}
+
+} /* namespace datasketches */
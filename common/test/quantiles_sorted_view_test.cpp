@@ -19,6 +19,9 @@
 
 #include <catch2/catch.hpp>
 
+#include <algorithm>
+#include <limits>
+#include <string>
 #include <vector>
 #include <utility>
 
@@ -35,6 +38,9 @@ TEST_CASE("empty", "sorted view") {
   const float split_points[1] {0};
   REQUIRE_THROWS_AS(view.get_CDF(split_points, 1), std::runtime_error);
   REQUIRE_THROWS_AS(view.get_PMF(split_points, 1), std::runtime_error);
+  const double ranks[1] {0};
+  REQUIRE_THROWS_AS(view.get_ranks(split_points, 1), std::runtime_error);
+  REQUIRE_THROWS_AS(view.get_quantiles(ranks, 1), std::runtime_error);
 }
 
 TEST_CASE("set 0", "sorted view") {
@@ -456,4 +462,117 @@ TEST_CASE("set 4", "sorted view") {
     REQUIRE(view.get_quantile(1, false) == 40);
 }
 
+TEST_CASE("many levels", "sorted view") {
+  // levels of different sizes, with items repeated across levels and an empty level
+  std::vector<std::vector<int>> levels;
+  for (int level = 0; level < 9; ++level) {
+    std::vector<int> items;
+    if (level != 4) {
+      for (int i = 0; i < (level + 1) * 3; ++i) items.push_back((i * 7 + level) % 20);
+    }
+    std::sort(items.begin(), items.end());
+    levels.push_back(items);
+  }
+  std::vector<std::pair<int, uint64_t>> expected;
+  uint32_t num = 0;
+  auto view = quantiles_sorted_view<int, std::less<int>, std::allocator<int>>(100, std::less<int>(), std::allocator<int>());
+  for (size_t level = 0; level < levels.size(); ++level) {
+    view.add(levels[level].begin(), levels[level].end(), 1ULL << level);
+    for (int item: levels[level]) expected.push_back(std::make_pair(item, 1ULL << level));
+    num += static_cast<uint32_t>(levels[level].size());
+  }
+  // equivalent items are expected in the order of levels
+  std::stable_sort(expected.begin(), expected.end(),
+      [](const std::pair<int, uint64_t>& a, const std::pair<int, uint64_t>& b) { return a.first < b.first; });
+  view.convert_to_cummulative();
+  REQUIRE(view.size() == num);
+  uint64_t cumulative_weight = 0;
+  auto it = view.begin();
+  for (const auto& entry: expected) {
+    cumulative_weight += entry.second;
+    REQUIRE(it->first == entry.first);
+    REQUIRE(it.get_weight() == entry.second);
+    REQUIRE(it.get_cumulative_weight() == cumulative_weight);
+    ++it;
+  }
+  REQUIRE(it == view.end());
+}
+
+
+TEST_CASE("batch queries same as one by one", "sorted view") {
+  auto view = quantiles_sorted_view<int, std::less<int>, std::allocator<int>>(100, std::less<int>(), std::allocator<int>());
+  // duplicates within and across levels
+  for (int level = 0; level < 6; ++level) {
+    std::vector<int> items;
+    for (int i = 0; i < 200 >> level; ++i) items.push_back(i * 3 % 500 + level);
+    std::sort(items.begin(), items.end());
+    view.add(items.begin(), items.end(), 1ULL << level);
+  }
+  view.convert_to_cummulative();
+
+  // many sorted queries use one sweep, few or unsorted queries use binary search
+  for (const size_t num_queries: {1, 3, 9, 100, 2000}) {
+    std::vector<int> items;
+    std::vector<double> ranks;
+    for (size_t i = 0; i < num_queries; ++i) {
+      items.push_back(static_cast<int>(i * 600 / num_queries) - 50);
+      ranks.push_back(static_cast<double>(i) / num_queries);
+    }
+    ranks.push_back(1);
+    for (const bool sorted: {true, false}) {
+      if (!sorted) {
+        std::reverse(items.begin(), items.end());
+        std::rotate(ranks.begin(), ranks.begin() + ranks.size() / 2, ranks.end());
+      }
+      for (const bool inclusive: {true, false}) {
+        const auto batch_ranks = view.get_ranks(items.data(), static_cast<uint32_t>(items.size()), inclusive);
+        REQUIRE(batch_ranks.size() == items.size());
+        for (size_t i = 0; i < items.size(); ++i) REQUIRE(batch_ranks[i] == view.get_rank(items[i], inclusive));
+        const auto quantiles = view.get_quantiles(ranks.data(), static_cast<uint32_t>(ranks.size()), inclusive);
+        REQUIRE(quantiles.size() == ranks.size());
+        for (size_t i = 0; i < ranks.size(); ++i) REQUIRE(quantiles[i] == view.get_quantile(ranks[i], inclusive));
+      }
+    }
+  }
+}
+
+TEST_CASE("batch ranks with NaN", "sorted view") {
+  auto view = quantiles_sorted_view<float, std::less<float>, std::allocator<float>>(1000, std::less<float>(), std::allocator<float>());
+  std::vector<float> items;
+  for (int i = 0; i < 1000; ++i) items.push_back(static_cast<float>(i));
+  view.add(items.begin(), items.end(), 1);
+  view.convert_to_cummulative();
+
+  // NaN is not ordered, so it must not affect the ranks of the other queries, sorted or not
+  std::vector<float> queries;
+  for (int i = 0; i < 100; ++i) queries.push_back(static_cast<float>(i));
+  queries.push_back(std::numeric_limits<float>::quiet_NaN());
+  for (int i = 50; i < 150; ++i) queries.push_back(static_cast<float>(i));
+  std::vector<float> sorted_queries;
+  for (int i = 0; i < 2000; ++i) sorted_queries.push_back(i % 100 == 50 ? std::numeric_limits<float>::quiet_NaN() : static_cast<float>(i / 2));
+  for (const auto& batch: {queries, sorted_queries}) {
+    for (const bool inclusive: {true, false}) {
+      const auto ranks = view.get_ranks(batch.data(), static_cast<uint32_t>(batch.size()), inclusive);
+      for (size_t i = 0; i < batch.size(); ++i) REQUIRE(ranks[i] == view.get_rank(batch[i], inclusive));
+    }
+  }
+}
+
+TEST_CASE("batch queries of strings", "sorted view") {
+  auto view = quantiles_sorted_view<std::string, std::less<std::string>, std::allocator<std::string>>(100, std::less<std::string>(), std::allocator<std::string>());
+  std::vector<std::string> level0 {"a", "c", "e", "g"};
+  std::vector<std::string> level1 {"b", "c", "f"};
+  view.add(level0.begin(), level0.end(), 1);
+  view.add(level1.begin(), level1.end(), 2);
+  view.convert_to_cummulative();
+  const std::vector<std::string> items {"d", "", "c", "z", "f"};
+  const std::vector<double> ranks {0.5, 0, 1, 0.1};
+  for (const bool inclusive: {true, false}) {
+    const auto batch_ranks = view.get_ranks(items.data(), static_cast<uint32_t>(items.size()), inclusive);
+    for (size_t i = 0; i < items.size(); ++i) REQUIRE(batch_ranks[i] == view.get_rank(items[i], inclusive));
+    const auto quantiles = view.get_quantiles(ranks.data(), static_cast<uint32_t>(ranks.size()), inclusive);
+    for (size_t i = 0; i < ranks.size(); ++i) REQUIRE(quantiles[i] == view.get_quantile(ranks[i], inclusive));
+  }
+}
+
 } /* namespace datasketches */
@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sorting.hpp"
+
+namespace datasketches {
+
+template<typename T>
+static void check_sort(std::vector<T> items) {
+  std::vector<T> expected(items);
+  std::sort(expected.begin(), expected.end());
+
+  // with scratch space provided
+  std::vector<T> items_tmp(items);
+  std::vector<T> tmp(get_sort_space<T>(items.size()));
+  sort_items(items_tmp.data(), items_tmp.data() + items_tmp.size(), std::less<T>(), tmp.data());
+  REQUIRE(items_tmp == expected);
+
+  // without scratch space
+  sort_items(items.data(), items.data() + items.size(), std::less<T>());
+  REQUIRE(items == expected);
+}
+
+TEST_CASE("sorting: radix sort same as std::sort", "[sorting]") {
+  std::mt19937_64 rng(1);
+  std::normal_distribution<double> dist(0, 1000);
+  for (size_t n: {0, 1, 10, 16, 17, 127, 128, 1000}) {
+    std::vector<float> floats;
+    std::vector<double> doubles;
+    std::vector<int64_t> longs;
+    std::vector<uint32_t> uints;
+    std::vector<int8_t> bytes;
+    for (size_t i = 0; i < n; ++i) {
+      const double value = dist(rng);
+      floats.push_back(static_cast<float>(value));
+      doubles.push_back(value);
+      longs.push_back(static_cast<int64_t>(value * 1e12));
+      uints.push_back(static_cast<uint32_t>(rng()));
+      bytes.push_back(static_cast<int8_t>(value));
+    }
+    check_sort(floats);
+    check_sort(doubles);
+    check_sort(longs);
+    check_sort(uints);
+    check_sort(bytes);
+  }
+}
+
+TEST_CASE("sorting: radix sort of special values", "[sorting]") {
+  std::vector<double> items;
+  for (int i = 0; i < 200; ++i) {
+    items.push_back(std::numeric_limits<double>::infinity());
+    items.push_back(-std::numeric_limits<double>::infinity());
+    items.push_back(std::numeric_limits<double>::max());
+    items.push_back(std::numeric_limits<double>::lowest());
+    items.push_back(std::numeric_limits<double>::denorm_min());
+    items.push_back(-std::numeric_limits<double>::denorm_min());
+    items.push_back(i);
+  }
+  check_sort(items);
+
+  // all items the same apart from the lowest byte
+  std::vector<int32_t> ints;
+  for (int32_t i = 0; i < 200; ++i) ints.push_back(-1000 + i % 7);
+  check_sort(ints);
+
+  // -0 and 0 are equivalent, so only the sign tells them apart
+  std::vector<float> zeros;
+  for (int i = 0; i < 200; ++i) zeros.push_back(i % 2 == 0 ? 0.0f : -0.0f);
+  std::vector<float> tmp(get_sort_space<float>(zeros.size()));
+  sort_items(zeros.data(), zeros.data() + zeros.size(), std::less<float>(), tmp.data());
+  REQUIRE(std::is_sorted(zeros.begin(), zeros.end()));
+  REQUIRE(std::signbit(zeros.front()));
+  REQUIRE_FALSE(std::signbit(zeros.back()));
+}
+
+TEST_CASE("sorting: other comparators and types", "[sorting]") {
+  std::vector<float> floats;
+  for (int i = 0; i < 1000; ++i) floats.push_back(static_cast<float>((i * 7919) % 1009));
+  std::vector<float> expected(floats);
+  std::sort(expected.begin(), expected.end(), std::greater<float>());
+  sort_items(floats.data(), floats.data() + floats.size(), std::greater<float>());
+  REQUIRE(floats == expected);
+
+  std::vector<std::string> strings;
+  for (int i = 0; i < 1000; ++i) strings.push_back(std::to_string((i * 7919) % 1009));
+  check_sort(strings);
+}
+
+template<typename T>
+static void check_merge(const std::vector<T>& items1, const std::vector<T>& items2) {
+  std::vector<T> expected;
+  std::merge(items1.begin(), items1.end(), items2.begin(), items2.end(), std::back_inserter(expected));
+
+  // separate output
+  std::vector<T> a(items1), b(items2), c(a.size() + b.size());
+  T* end = merge_items(a.data(), a.data() + a.size(), b.data(), b.data() + b.size(), c.data(), std::less<T>());
+  REQUIRE(end == c.data() + c.size());
+  REQUIRE(c == expected);
+
+  // output overlaps the second range, the first range is just below the output
+  std::vector<T> buf(items1);
+  buf.insert(buf.end(), items1.size(), T());
+  buf.insert(buf.end(), items2.begin(), items2.end());
+  T* first1 = buf.data();
+  T* first2 = buf.data() + 2 * items1.size();
+  end = merge_items(first1, first1 + items1.size(), first2, first2 + items2.size(), first1 + items1.size(), std::less<T>());
+  REQUIRE(end == buf.data() + buf.size());
+  REQUIRE(std::equal(expected.begin(), expected.end(), first1 + items1.size()));
+
+  // in place
+  std::vector<T> in_place(items1);
+  in_place.insert(in_place.end(), items2.begin(), items2.end());
+  merge_items_in_place(in_place.data(), in_place.data() + items1.size(), in_place.data() + in_place.size(),
+      std::less<T>());
+  REQUIRE(in_place == expected);
+
+  // in place with scratch space provided
+  std::vector<T> in_place_tmp(items1);
+  in_place_tmp.insert(in_place_tmp.end(), items2.begin(), items2.end());
+  std::vector<T> tmp(get_sort_space<T>(items1.size()));
+  merge_items_in_place(in_place_tmp.data(), in_place_tmp.data() + items1.size(), in_place_tmp.data() + in_place_tmp.size(),
+      std::less<T>(), tmp.data());
+  REQUIRE(in_place_tmp == expected);
+}
+
+TEST_CASE("sorting: merge", "[sorting]") {
+  std::vector<int> evens;
+  std::vector<int> odds;
+  std::vector<std::string> strings1;
+  std::vector<std::string> strings2;
+  for (int i = 0; i < 100; ++i) {
+    evens.push_back(i * 2);
+    odds.push_back(i * 2 + 1);
+  }
+  for (char c = 'a'; c <= 'z'; ++c) {
+    strings1.push_back(std::string(1, c));
+    strings2.push_back(std::string(2, c));
+  }
+  check_merge(evens, odds);
+  check_merge(odds, evens);
+  check_merge(evens, evens);
+  check_merge(evens, std::vector<int>());
+  check_merge(std::vector<int>(), odds);
+  check_merge(std::vector<int>(evens.begin(), evens.begin() + 10), odds);
+  check_merge(evens, std::vector<int>(odds.begin() + 50, odds.end()));
+  check_merge(strings1, strings2);
+  check_merge(strings2, strings1);
+  check_merge(std::vector<std::string>(), strings1);
+}
+
+} /* namespace datasketches */
@@ -28,4 +28,10 @@ long long test_allocator_total_bytes = 0;
 // (number of allocations minus number of deallocations)
 long long test_allocator_net_allocations = 0;
 
+// global variable to keep track of the number of allocations
+long long test_allocator_total_allocations = 0;
+
+// global variable to keep track of the largest allocated size
+long long test_allocator_peak_bytes = 0;
+
 } /* namespace datasketches */
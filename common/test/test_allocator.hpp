@@ -30,6 +30,8 @@ namespace datasketches {
 
 extern long long test_allocator_total_bytes;
 extern long long test_allocator_net_allocations;
+extern long long test_allocator_total_allocations;
+extern long long test_allocator_peak_bytes;
 
 template <class T> class test_allocator {
 public:
@@ -70,6 +72,8 @@ public:
     if (!p) throw std::bad_alloc();
     test_allocator_total_bytes += n * sizeof(value_type);
     ++test_allocator_net_allocations;
+    ++test_allocator_total_allocations;
+    if (test_allocator_total_bytes > test_allocator_peak_bytes) test_allocator_peak_bytes = test_allocator_total_bytes;
     return static_cast<pointer>(p);
   }
 
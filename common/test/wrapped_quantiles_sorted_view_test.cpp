@@ -0,0 +1,124 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "wrapped_quantiles_sorted_view.hpp"
+
+namespace datasketches {
+
+using view_float = quantiles_sorted_view<float, std::less<float>, std::allocator<float>>;
+using view_string = quantiles_sorted_view<std::string, std::less<std::string>, std::allocator<std::string>>;
+
+TEST_CASE("wrapped sorted view: empty", "[wrapped sorted view]") {
+  view_float view(1, std::less<float>(), std::allocator<float>());
+  view.convert_to_cummulative();
+  auto bytes = view.serialize();
+  REQUIRE(bytes.size() == view.get_serialized_size_bytes());
+  auto wrapped = wrapped_quantiles_sorted_view<float>::wrap(bytes.data(), bytes.size());
+  REQUIRE(wrapped.is_empty());
+  REQUIRE(wrapped.size() == 0);
+  REQUIRE_THROWS_AS(wrapped.get_rank(0), std::runtime_error);
+  REQUIRE_THROWS_AS(wrapped.get_quantile(0), std::runtime_error);
+  const float split_points[1] {0};
+  REQUIRE(wrapped.get_CDF(split_points, 1).empty());
+  REQUIRE(wrapped.get_PMF(split_points, 1).empty());
+}
+
+TEST_CASE("wrapped sorted view: same as view", "[wrapped sorted view]") {
+  view_float view(100, std::less<float>(), std::allocator<float>());
+  uint64_t total_weight = 0;
+  for (int level = 0; level < 5; ++level) {
+    std::vector<float> items;
+    for (int i = 0; i < 40 >> level; ++i) items.push_back(static_cast<float>(i * 3 % 50 + level));
+    std::sort(items.begin(), items.end());
+    view.add(items.begin(), items.end(), 1ULL << level);
+    total_weight += items.size() << level;
+  }
+  view.convert_to_cummulative();
+  // the weights stay aligned with a header of 8 bytes
+  auto bytes = view.serialize(8);
+  REQUIRE(bytes.size() == view.get_serialized_size_bytes() + 8);
+  auto wrapped = wrapped_quantiles_sorted_view<float>::wrap(bytes.data() + 8, bytes.size() - 8);
+  REQUIRE(wrapped.size() == view.size());
+  REQUIRE(wrapped.get_total_weight() == total_weight);
+  const std::vector<float> split_points {-1, 5, 10.5, 20, 60};
+  for (const bool inclusive: {true, false}) {
+    for (int i = -2; i < 60; ++i) {
+      const float item = static_cast<float>(i);
+      REQUIRE(wrapped.get_rank(item, inclusive) == view.get_rank(item, inclusive));
+    }
+    for (int i = 0; i <= 100; ++i) {
+      const double rank = i / 100.0;
+      REQUIRE(wrapped.get_quantile(rank, inclusive) == view.get_quantile(rank, inclusive));
+    }
+    const auto cdf = wrapped.get_CDF(split_points.data(), static_cast<uint32_t>(split_points.size()), inclusive);
+    const auto expected_cdf = view.get_CDF(split_points.data(), static_cast<uint32_t>(split_points.size()), inclusive);
+    REQUIRE(std::vector<double>(cdf.begin(), cdf.end()) == std::vector<double>(expected_cdf.begin(), expected_cdf.end()));
+    const auto pmf = wrapped.get_PMF(split_points.data(), static_cast<uint32_t>(split_points.size()), inclusive);
+    const auto expected_pmf = view.get_PMF(split_points.data(), static_cast<uint32_t>(split_points.size()), inclusive);
+    REQUIRE(std::vector<double>(pmf.begin(), pmf.end()) == std::vector<double>(expected_pmf.begin(), expected_pmf.end()));
+  }
+  const float unsorted[2] {5, 1};
+  REQUIRE_THROWS_AS(wrapped.get_CDF(unsorted, 2), std::invalid_argument);
+}
+
+TEST_CASE("wrapped sorted view: strings", "[wrapped sorted view]") {
+  view_string view(10, std::less<std::string>(), std::allocator<std::string>());
+  std::vector<std::string> level0 {"a", "c", "e", "g"};
+  std::vector<std::string> level1 {"b", "c", "f"};
+  view.add(level0.begin(), level0.end(), 1);
+  view.add(level1.begin(), level1.end(), 2);
+  view.convert_to_cummulative();
+  auto bytes = view.serialize();
+  auto wrapped = wrapped_quantiles_sorted_view<std::string>::wrap(bytes.data(), bytes.size());
+  // the items are deserialized into the wrapper and must survive copying
+  auto copy = wrapped;
+  REQUIRE(copy.size() == 7);
+  for (const bool inclusive: {true, false}) {
+    for (const std::string item: {"", "a", "b", "c", "d", "g", "z"}) {
+      REQUIRE(copy.get_rank(item, inclusive) == view.get_rank(item, inclusive));
+    }
+    for (int i = 0; i <= 20; ++i) {
+      REQUIRE(copy.get_quantile(i / 20.0, inclusive) == view.get_quantile(i / 20.0, inclusive));
+    }
+  }
+}
+
+TEST_CASE("wrapped sorted view: invalid bytes", "[wrapped sorted view]") {
+  view_float view(10, std::less<float>(), std::allocator<float>());
+  std::vector<float> items {1, 2, 3};
+  view.add(items.begin(), items.end(), 1);
+  view.convert_to_cummulative();
+  auto bytes = view.serialize(8);
+  // misaligned
+  REQUIRE_THROWS_AS(wrapped_quantiles_sorted_view<float>::wrap(bytes.data() + 4, bytes.size() - 4), std::invalid_argument);
+  // truncated
+  REQUIRE_THROWS_AS(wrapped_quantiles_sorted_view<float>::wrap(bytes.data() + 8, 12), std::out_of_range);
+  REQUIRE_THROWS_AS(wrapped_quantiles_sorted_view<float>::wrap(bytes.data() + 8, bytes.size() - 9), std::out_of_range);
+  // serial version
+  bytes[8] = 0;
+  REQUIRE_THROWS_AS(wrapped_quantiles_sorted_view<float>::wrap(bytes.data() + 8, bytes.size() - 8), std::invalid_argument);
+}
+
+} /* namespace datasketches */
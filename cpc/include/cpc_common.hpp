@@ -49,14 +49,26 @@ template<typename A> using vector_u64 = std::vector<uint64_t, AllocU64<A>>;
 // forward declaration
 template<typename A> class u32_table;
 
-template<typename A>
-struct compressed_state {
-  explicit compressed_state(const A& allocator): table_data(allocator), table_data_words(0), table_num_entries(0),
-      window_data(allocator), window_data_words(0) {}
-  vector_u32<A> table_data;
+// sizes of the compressed data of a sketch written into a buffer provided by the caller
+// the window data comes first, followed by the table data, as in a serialized sketch
+struct compressed_sizes {
+  uint32_t window_data_words;
+  uint32_t table_data_words;
+  uint32_t table_num_entries; // can be different from the number of entries in the sketch in hybrid mode
+};
+
+// header fields of a serialized sketch with its compressed data left in place
+struct compressed_image {
+  uint8_t lg_k;
+  uint8_t first_interesting_column;
+  bool has_hip;
+  uint32_t num_coupons;
+  double kxp;
+  double hip_est_accum;
+  const char* table_data; // not necessarily aligned
   uint32_t table_data_words;
   uint32_t table_num_entries; // can be different from the number of entries in the sketch in hybrid mode
-  vector_u32<A> window_data;
+  const char* window_data; // not necessarily aligned
   uint32_t window_data_words;
 };
 
@@ -47,24 +47,39 @@ inline cpc_compressor<A>& get_compressor();
 template<typename A>
 class cpc_compressor {
 public:
-  void compress(const cpc_sketch_alloc<A>& source, compressed_state<A>& target) const;
-  void uncompress(const compressed_state<A>& source, uncompressed_state<A>& target, uint8_t lg_k, uint32_t num_coupons) const;
+  // This writes the compressed window followed by the compressed table into the given words,
+  // as they appear in a serialized sketch. Nothing is written past max_words.
+  // Returns the number of words needed, which is greater than max_words if the data did not fit.
+  uint32_t compress(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words, compressed_sizes& sizes) const;
+  // an upper bound on the number of words that compress() needs for the given sketch
+  uint32_t get_max_compressed_words(const cpc_sketch_alloc<A>& source) const;
+  // This decodes the compressed data of a serialized sketch in place unless it is misaligned.
+  void uncompress(const compressed_image& source, uncompressed_state<A>& target) const;
+
+  // These decode the compressed parts of a serialized sketch into buffers provided by the caller
+  // without building a sketch. The window must have room for k bytes.
+  // The pairs are restored to the columns of the sketch and come out sorted by row.
+  void uncompress_window(const uint32_t* data, uint32_t data_words, uint8_t* window, uint8_t lg_k, uint32_t num_coupons) const;
+  void uncompress_pairs(const uint32_t* data, uint32_t data_words, uint32_t num_pairs, uint32_t* pairs,
+      uint8_t lg_k, uint32_t num_coupons) const;
 
   // methods below are public for testing
 
-  // This returns the number of compressed words that were actually used. It is the caller's
-  // responsibility to ensure that the compressed_words array is long enough to prevent over-run.
+  // This returns the number of compressed words that were actually used.
+  // Nothing is written past max_words, but the words that did not fit are still counted.
   uint32_t low_level_compress_bytes(
       const uint8_t* byte_array, // input
       uint32_t num_bytes_to_encode,
       const uint16_t* encoding_table,
-      uint32_t* compressed_words  // output
+      uint32_t* compressed_words,  // output
+      uint32_t max_words = UINT32_MAX
   ) const;
 
+  // decoding_table must be made by make_multi_symbol_decoding_table()
   void low_level_uncompress_bytes(
       uint8_t* byte_array, // output
       uint32_t num_bytes_to_decode,
-      const uint16_t* decoding_table,
+      const uint32_t* decoding_table,
       const uint32_t* compressed_words,
       uint32_t num_compressed_words // input
   ) const;
@@ -72,12 +87,13 @@ public:
   // Here "pairs" refers to row-column pairs that specify
   // the positions of surprising values in the bit matrix.
 
-  // returns the number of compressedWords actually used
+  // returns the number of compressedWords actually used, including the ones past max_words that were not written
   uint32_t low_level_compress_pairs(
       const uint32_t* pair_array, // input
       uint32_t num_pairs_to_encode,
       uint8_t num_base_bits,
-      uint32_t* compressed_words // output
+      uint32_t* compressed_words, // output
+      uint32_t max_words = UINT32_MAX
   ) const;
 
   void low_level_uncompress_pairs(
@@ -90,7 +106,8 @@ public:
 
 private:
   // These decoding tables are created at library startup time by inverting the encoding tables
-  uint16_t* decoding_tables_for_high_entropy_byte[22] = {
+  // The byte tables decode up to two codewords per lookup
+  uint32_t* decoding_tables_for_high_entropy_byte[22] = {
     // sixteen tables for the steady state (chosen based on the "phase" of C/K)
     NULL, NULL, NULL, NULL,
     NULL, NULL, NULL, NULL,
@@ -112,24 +129,31 @@ private:
   void make_decoding_tables(); // call this at startup
   void free_decoding_tables(); // call this at the end
 
-  void compress_sparse_flavor(const cpc_sketch_alloc<A>& source, compressed_state<A>& target) const;
-  void compress_hybrid_flavor(const cpc_sketch_alloc<A>& source, compressed_state<A>& target) const;
-  void compress_pinned_flavor(const cpc_sketch_alloc<A>& source, compressed_state<A>& target) const;
-  void compress_sliding_flavor(const cpc_sketch_alloc<A>& source, compressed_state<A>& target) const;
+  void compress_sparse_flavor(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words, compressed_sizes& sizes) const;
+  void compress_hybrid_flavor(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words, compressed_sizes& sizes) const;
+  void compress_pinned_flavor(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words, compressed_sizes& sizes) const;
+  void compress_sliding_flavor(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words, compressed_sizes& sizes) const;
 
-  void uncompress_sparse_flavor(const compressed_state<A>& source, uncompressed_state<A>& target, uint8_t lg_k) const;
-  void uncompress_hybrid_flavor(const compressed_state<A>& source, uncompressed_state<A>& target, uint8_t lg_k) const;
-  void uncompress_pinned_flavor(const compressed_state<A>& source, uncompressed_state<A>& target, uint8_t lg_k, uint32_t num_coupons) const;
-  void uncompress_sliding_flavor(const compressed_state<A>& source, uncompressed_state<A>& target, uint8_t lg_k, uint32_t num_coupons) const;
+  // the pointers are to the aligned window and table data of the source
+  void uncompress_sparse_flavor(const compressed_image& source, const uint32_t* table_data, uncompressed_state<A>& target) const;
+  void uncompress_hybrid_flavor(const compressed_image& source, const uint32_t* table_data, uncompressed_state<A>& target) const;
+  void uncompress_windowed_flavor(const compressed_image& source, const uint32_t* window_data, const uint32_t* table_data,
+      uncompressed_state<A>& target) const;
 
   uint8_t* make_inverse_permutation(const uint8_t* permu, unsigned length);
   uint16_t* make_decoding_table(const uint16_t* encoding_table, unsigned num_byte_values);
+  uint32_t* make_multi_symbol_decoding_table(const uint16_t* decoding_table);
   void validate_decoding_table(const uint16_t* decoding_table, const uint16_t* encoding_table) const;
 
-  void compress_surprising_values(const vector_u32<A>& pairs, uint8_t lg_k, compressed_state<A>& result) const;
-  void compress_sliding_window(const uint8_t* window, uint8_t lg_k, uint32_t num_coupons, compressed_state<A>& target) const;
+  // the table data goes after the window data, which must have been compressed already
+  void compress_surprising_values(const vector_u32<A>& pairs, uint8_t lg_k, uint32_t* words, uint32_t max_words,
+      compressed_sizes& sizes) const;
+  void compress_sliding_window(const uint8_t* window, uint8_t lg_k, uint32_t num_coupons, uint32_t* words, uint32_t max_words,
+      compressed_sizes& sizes) const;
 
   vector_u32<A> uncompress_surprising_values(const uint32_t* data, uint32_t data_words, uint32_t num_pairs, uint8_t lg_k, const A& allocator) const;
+  void uncompress_surprising_values(const uint32_t* data, uint32_t data_words, uint32_t num_pairs, uint8_t lg_k, uint32_t* pairs) const;
+  void restore_columns(uint32_t* pairs, uint32_t num_pairs, uint8_t lg_k, uint32_t num_coupons) const;
   void uncompress_sliding_window(const uint32_t* data, uint32_t data_words, vector_u8<A>& window, uint8_t lg_k, uint32_t num_coupons) const;
 
   static size_t safe_length_for_compressed_pair_buf(uint32_t k, uint32_t num_pairs, uint8_t num_base_bits);
@@ -22,6 +22,8 @@
 #ifndef CPC_COMPRESSOR_IMPL_HPP_
 #define CPC_COMPRESSOR_IMPL_HPP_
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 
@@ -98,6 +100,31 @@ void cpc_compressor<A>::validate_decoding_table(const uint16_t* decoding_table,
   }
 }
 
+/* Given a size-4096 decoding table, this builds one that also decodes the codeword
+   following the first one whenever both fit in the 12-bit peek.
+   Each entry holds the first byte in bits 0-7, the second byte in bits 8-15,
+   the length of the first codeword in bits 16-19, the total length in bits 20-23,
+   and bit 24 is set if the entry holds two bytes. */
+template<typename A>
+uint32_t* cpc_compressor<A>::make_multi_symbol_decoding_table(const uint16_t* decoding_table) {
+  uint32_t* multi_symbol_table = new uint32_t[4096]; // use new for global initialization
+  for (uint32_t peek12 = 0; peek12 < 4096; peek12++) {
+    const uint16_t first = decoding_table[peek12];
+    const uint8_t first_length = first >> 8;
+    // the top first_length bits of the shifted peek are zeros rather than stream bits,
+    // so the second codeword is valid only if it does not reach into them
+    const uint16_t second = decoding_table[peek12 >> first_length];
+    const uint8_t second_length = second >> 8;
+    if (first_length + second_length <= 12) {
+      multi_symbol_table[peek12] = (first & 0xff) | ((second & 0xff) << 8) | (first_length << 16)
+          | ((first_length + second_length) << 20) | (1 << 24);
+    } else {
+      multi_symbol_table[peek12] = (first & 0xff) | (first_length << 16) | (first_length << 20);
+    }
+  }
+  return multi_symbol_table;
+}
+
 template<typename A>
 void cpc_compressor<A>::make_decoding_tables() {
   length_limited_unary_decoding_table65 = make_decoding_table(length_limited_unary_encoding_table65, 65);
@@ -107,11 +134,12 @@ void cpc_compressor<A>::make_decoding_tables() {
   );
 
   for (int i = 0; i < (16 + 6); i++) {
-    decoding_tables_for_high_entropy_byte[i] = make_decoding_table(encoding_tables_for_high_entropy_byte[i], 256);
+    const std::unique_ptr<uint16_t[]> decoding_table(make_decoding_table(encoding_tables_for_high_entropy_byte[i], 256));
     validate_decoding_table(
-        decoding_tables_for_high_entropy_byte[i],
+        decoding_table.get(),
         encoding_tables_for_high_entropy_byte[i]
     );
+    decoding_tables_for_high_entropy_byte[i] = make_multi_symbol_decoding_table(decoding_table.get());
   }
 
   for (int i = 0; i < 16; i++) {
@@ -131,76 +159,116 @@ void cpc_compressor<A>::free_decoding_tables() {
 }
 
 template<typename A>
-void cpc_compressor<A>::compress(const cpc_sketch_alloc<A>& source, compressed_state<A>& result) const {
+uint32_t cpc_compressor<A>::compress(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words,
+    compressed_sizes& sizes) const {
+  sizes.window_data_words = 0;
+  sizes.table_data_words = 0;
+  sizes.table_num_entries = 0;
   switch (source.determine_flavor()) {
     case cpc_sketch_alloc<A>::flavor::EMPTY:
       break;
     case cpc_sketch_alloc<A>::flavor::SPARSE:
-      compress_sparse_flavor(source, result);
-      if (result.window_data.size() > 0) throw std::logic_error("window is not expected");
-      if (result.table_data.size() == 0) throw std::logic_error("table is expected");
+      compress_sparse_flavor(source, words, max_words, sizes);
+      if (sizes.window_data_words > 0) throw std::logic_error("window is not expected");
+      if (sizes.table_data_words == 0) throw std::logic_error("table is expected");
       break;
     case cpc_sketch_alloc<A>::flavor::HYBRID:
-      compress_hybrid_flavor(source, result);
-      if (result.window_data.size() > 0) throw std::logic_error("window is not expected");
-      if (result.table_data.size() == 0) throw std::logic_error("table is expected");
+      compress_hybrid_flavor(source, words, max_words, sizes);
+      if (sizes.window_data_words > 0) throw std::logic_error("window is not expected");
+      if (sizes.table_data_words == 0) throw std::logic_error("table is expected");
       break;
     case cpc_sketch_alloc<A>::flavor::PINNED:
-      compress_pinned_flavor(source, result);
-      if (result.window_data.size() == 0) throw std::logic_error("window is not expected");
+      compress_pinned_flavor(source, words, max_words, sizes);
+      if (sizes.window_data_words == 0) throw std::logic_error("window is expected");
       break;
     case cpc_sketch_alloc<A>::flavor::SLIDING:
-      compress_sliding_flavor(source, result);
-      if (result.window_data.size() == 0) throw std::logic_error("window is expected");
+      compress_sliding_flavor(source, words, max_words, sizes);
+      if (sizes.window_data_words == 0) throw std::logic_error("window is expected");
       break;
     default: throw std::logic_error("Unknown sketch flavor");
   }
+  return sizes.window_data_words + sizes.table_data_words;
 }
 
 template<typename A>
-void cpc_compressor<A>::uncompress(const compressed_state<A>& source, uncompressed_state<A>& target, uint8_t lg_k, uint32_t num_coupons) const {
-  switch (cpc_sketch_alloc<A>::determine_flavor(lg_k, num_coupons)) {
+uint32_t cpc_compressor<A>::get_max_compressed_words(const cpc_sketch_alloc<A>& source) const {
+  const uint32_t k = 1 << source.get_lg_k();
+  switch (source.determine_flavor()) {
     case cpc_sketch_alloc<A>::flavor::EMPTY:
-      target.table = u32_table<A>(2, 6 + lg_k, source.table_data.get_allocator());
+      return 0;
+    case cpc_sketch_alloc<A>::flavor::SPARSE:
+    case cpc_sketch_alloc<A>::flavor::HYBRID: {
+      const uint32_t num_pairs = source.get_num_coupons();
+      return static_cast<uint32_t>(safe_length_for_compressed_pair_buf(k, num_pairs, golomb_choose_number_of_base_bits(k + num_pairs, num_pairs)));
+    }
+    default: {
+      const uint32_t num_pairs = source.surprising_value_table.get_num_items();
+      const size_t table_words = num_pairs == 0 ? 0
+          : safe_length_for_compressed_pair_buf(k, num_pairs, golomb_choose_number_of_base_bits(k + num_pairs, num_pairs));
+      return static_cast<uint32_t>(safe_length_for_compressed_window_buf(k) + table_words);
+    }
+  }
+}
+
+template<typename A>
+void cpc_compressor<A>::uncompress(const compressed_image& source, uncompressed_state<A>& target) const {
+  // the compressed words are decoded in place unless they are misaligned
+  vector_u32<A> window_words(target.window.get_allocator());
+  const uint32_t* window_data = reinterpret_cast<const uint32_t*>(source.window_data);
+  if (reinterpret_cast<uintptr_t>(source.window_data) % alignof(uint32_t) != 0) {
+    window_words.resize(source.window_data_words);
+    std::memcpy(window_words.data(), source.window_data, source.window_data_words * sizeof(uint32_t));
+    window_data = window_words.data();
+  }
+  vector_u32<A> table_words(target.window.get_allocator());
+  const uint32_t* table_data = reinterpret_cast<const uint32_t*>(source.table_data);
+  if (reinterpret_cast<uintptr_t>(source.table_data) % alignof(uint32_t) != 0) {
+    table_words.resize(source.table_data_words);
+    std::memcpy(table_words.data(), source.table_data, source.table_data_words * sizeof(uint32_t));
+    table_data = table_words.data();
+  }
+  switch (cpc_sketch_alloc<A>::determine_flavor(source.lg_k, source.num_coupons)) {
+    case cpc_sketch_alloc<A>::flavor::EMPTY:
+      target.table = u32_table<A>(2, 6 + source.lg_k, target.window.get_allocator());
       break;
     case cpc_sketch_alloc<A>::flavor::SPARSE:
-      uncompress_sparse_flavor(source, target, lg_k);
+      uncompress_sparse_flavor(source, table_data, target);
       break;
     case cpc_sketch_alloc<A>::flavor::HYBRID:
-      uncompress_hybrid_flavor(source, target, lg_k);
+      uncompress_hybrid_flavor(source, table_data, target);
       break;
     case cpc_sketch_alloc<A>::flavor::PINNED:
-      if (source.window_data.size() == 0) throw std::logic_error("window is expected");
-      uncompress_pinned_flavor(source, target, lg_k, num_coupons);
-      break;
     case cpc_sketch_alloc<A>::flavor::SLIDING:
-      uncompress_sliding_flavor(source, target, lg_k, num_coupons);
+      uncompress_windowed_flavor(source, window_data, table_data, target);
       break;
     default: std::logic_error("Unknown sketch flavor");
   }
 }
 
 template<typename A>
-void cpc_compressor<A>::compress_sparse_flavor(const cpc_sketch_alloc<A>& source, compressed_state<A>& result) const {
+void cpc_compressor<A>::compress_sparse_flavor(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words,
+    compressed_sizes& sizes) const {
   if (source.sliding_window.size() > 0) throw std::logic_error("unexpected sliding window");
   vector_u32<A> pairs = source.surprising_value_table.unwrapping_get_items();
   u32_table<A>::introspective_insertion_sort(pairs.data(), 0, pairs.size());
-  compress_surprising_values(pairs, source.get_lg_k(), result);
+  compress_surprising_values(pairs, source.get_lg_k(), words, max_words, sizes);
 }
 
 template<typename A>
-void cpc_compressor<A>::uncompress_sparse_flavor(const compressed_state<A>& source, uncompressed_state<A>& target, uint8_t lg_k) const {
-  if (source.window_data.size() > 0) throw std::logic_error("unexpected sliding window");
-  if (source.table_data.size() == 0) throw std::logic_error("table is expected");
-  vector_u32<A> pairs = uncompress_surprising_values(source.table_data.data(), source.table_data_words, source.table_num_entries,
-      lg_k, source.table_data.get_allocator());
-  target.table = u32_table<A>::make_from_pairs(pairs.data(), source.table_num_entries, lg_k, pairs.get_allocator());
+void cpc_compressor<A>::uncompress_sparse_flavor(const compressed_image& source, const uint32_t* table_data,
+    uncompressed_state<A>& target) const {
+  if (source.window_data != nullptr) throw std::logic_error("unexpected sliding window");
+  if (table_data == nullptr) throw std::logic_error("table is expected");
+  vector_u32<A> pairs = uncompress_surprising_values(table_data, source.table_data_words, source.table_num_entries,
+      source.lg_k, target.window.get_allocator());
+  target.table = u32_table<A>::make_from_pairs(pairs.data(), source.table_num_entries, source.lg_k, pairs.get_allocator());
 }
 
 // This is complicated because it effectively builds a Sparse version
 // of a Pinned sketch before compressing it. Hence the name Hybrid.
 template<typename A>
-void cpc_compressor<A>::compress_hybrid_flavor(const cpc_sketch_alloc<A>& source, compressed_state<A>& result) const {
+void cpc_compressor<A>::compress_hybrid_flavor(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words,
+    compressed_sizes& sizes) const {
   if (source.sliding_window.size() == 0) throw std::logic_error("no sliding window");
   if (source.window_offset != 0) throw std::logic_error("window_offset != 0");
   const uint32_t k = 1 << source.get_lg_k();
@@ -217,20 +285,21 @@ void cpc_compressor<A>::compress_hybrid_flavor(const cpc_sketch_alloc<A>& source
       all_pairs.data(), 0
   );  // note the overlapping subarray trick
 
-  compress_surprising_values(all_pairs, source.get_lg_k(), result);
+  compress_surprising_values(all_pairs, source.get_lg_k(), words, max_words, sizes);
 }
 
 template<typename A>
-void cpc_compressor<A>::uncompress_hybrid_flavor(const compressed_state<A>& source, uncompressed_state<A>& target, uint8_t lg_k) const {
-  if (source.window_data.size() > 0) throw std::logic_error("window is not expected");
-  if (source.table_data.size() == 0) throw std::logic_error("table is expected");
-  vector_u32<A> pairs = uncompress_surprising_values(source.table_data.data(), source.table_data_words, source.table_num_entries,
-      lg_k, source.table_data.get_allocator());
+void cpc_compressor<A>::uncompress_hybrid_flavor(const compressed_image& source, const uint32_t* table_data,
+    uncompressed_state<A>& target) const {
+  if (source.window_data != nullptr) throw std::logic_error("window is not expected");
+  if (table_data == nullptr) throw std::logic_error("table is expected");
+  vector_u32<A> pairs = uncompress_surprising_values(table_data, source.table_data_words, source.table_num_entries,
+      source.lg_k, target.window.get_allocator());
 
   // In the hybrid flavor, some of these pairs actually
   // belong in the window, so we will separate them out,
   // moving the "true" pairs to the bottom of the array.
-  const uint32_t k = 1 << lg_k;
+  const uint32_t k = 1 << source.lg_k;
   target.window.resize(k, 0); // important: zero the memory
   uint32_t next_true_pair = 0;
   for (uint32_t i = 0; i < source.table_num_entries; i++) {
@@ -244,12 +313,13 @@ void cpc_compressor<A>::uncompress_hybrid_flavor(const compressed_state<A>& sour
       pairs[next_true_pair++] = row_col; // move true pair down
     }
   }
-  target.table = u32_table<A>::make_from_pairs(pairs.data(), next_true_pair, lg_k, pairs.get_allocator());
+  target.table = u32_table<A>::make_from_pairs(pairs.data(), next_true_pair, source.lg_k, pairs.get_allocator());
 }
 
 template<typename A>
-void cpc_compressor<A>::compress_pinned_flavor(const cpc_sketch_alloc<A>& source, compressed_state<A>& result) const {
-  compress_sliding_window(source.sliding_window.data(), source.get_lg_k(), source.get_num_coupons(), result);
+void cpc_compressor<A>::compress_pinned_flavor(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words,
+    compressed_sizes& sizes) const {
+  compress_sliding_window(source.sliding_window.data(), source.get_lg_k(), source.get_num_coupons(), words, max_words, sizes);
   vector_u32<A> pairs = source.surprising_value_table.unwrapping_get_items();
   if (pairs.size() > 0) {
     // Here we subtract 8 from the column indices. Because they are stored in the low 6 bits
@@ -263,34 +333,14 @@ void cpc_compressor<A>::compress_pinned_flavor(const cpc_sketch_alloc<A>& source
     }
 
     if (pairs.size() > 0) u32_table<A>::introspective_insertion_sort(pairs.data(), 0, pairs.size());
-    compress_surprising_values(pairs, source.get_lg_k(), result);
+    compress_surprising_values(pairs, source.get_lg_k(), words, max_words, sizes);
   }
 }
 
 template<typename A>
-void cpc_compressor<A>::uncompress_pinned_flavor(const compressed_state<A>& source, uncompressed_state<A>& target,
-    uint8_t lg_k, uint32_t num_coupons) const {
-  if (source.window_data.size() == 0) throw std::logic_error("window is expected");
-  uncompress_sliding_window(source.window_data.data(), source.window_data_words, target.window, lg_k, num_coupons);
-  const uint32_t num_pairs = source.table_num_entries;
-  if (num_pairs == 0) {
-    target.table = u32_table<A>(2, 6 + lg_k, source.table_data.get_allocator());
-  } else {
-    if (source.table_data.size() == 0) throw std::logic_error("table is expected");
-    vector_u32<A> pairs = uncompress_surprising_values(source.table_data.data(), source.table_data_words, num_pairs,
-        lg_k, source.table_data.get_allocator());
-    // undo the compressor's 8-column shift
-    for (uint32_t i = 0; i < num_pairs; i++) {
-      if ((pairs[i] & 63) >= 56) throw std::logic_error("(pairs[i] & 63) >= 56");
-      pairs[i] += 8;
-    }
-    target.table = u32_table<A>::make_from_pairs(pairs.data(), num_pairs, lg_k, pairs.get_allocator());
-  }
-}
-
-template<typename A>
-void cpc_compressor<A>::compress_sliding_flavor(const cpc_sketch_alloc<A>& source, compressed_state<A>& result) const {
-  compress_sliding_window(source.sliding_window.data(), source.get_lg_k(), source.get_num_coupons(), result);
+void cpc_compressor<A>::compress_sliding_flavor(const cpc_sketch_alloc<A>& source, uint32_t* words, uint32_t max_words,
+    compressed_sizes& sizes) const {
+  compress_sliding_window(source.sliding_window.data(), source.get_lg_k(), source.get_num_coupons(), words, max_words, sizes);
   vector_u32<A> pairs = source.surprising_value_table.unwrapping_get_items();
   if (pairs.size() > 0) {
     // Here we apply a complicated transformation to the column indices, which
@@ -316,23 +366,39 @@ void cpc_compressor<A>::compress_sliding_flavor(const cpc_sketch_alloc<A>& sourc
     }
 
     if (pairs.size() > 0) u32_table<A>::introspective_insertion_sort(pairs.data(), 0, pairs.size());
-    compress_surprising_values(pairs, source.get_lg_k(), result);
+    compress_surprising_values(pairs, source.get_lg_k(), words, max_words, sizes);
   }
 }
 
+// the Pinned and Sliding flavors differ only in the column transformations undone by restore_columns()
 template<typename A>
-void cpc_compressor<A>::uncompress_sliding_flavor(const compressed_state<A>& source, uncompressed_state<A>& target,
-    uint8_t lg_k, uint32_t num_coupons) const {
-  if (source.window_data.size() == 0) throw std::logic_error("window is expected");
-  uncompress_sliding_window(source.window_data.data(), source.window_data_words, target.window, lg_k, num_coupons);
+void cpc_compressor<A>::uncompress_windowed_flavor(const compressed_image& source, const uint32_t* window_data,
+    const uint32_t* table_data, uncompressed_state<A>& target) const {
+  if (window_data == nullptr) throw std::logic_error("window is expected");
+  uncompress_sliding_window(window_data, source.window_data_words, target.window, source.lg_k, source.num_coupons);
   const uint32_t num_pairs = source.table_num_entries;
   if (num_pairs == 0) {
-    target.table = u32_table<A>(2, 6 + lg_k, source.table_data.get_allocator());
+    target.table = u32_table<A>(2, 6 + source.lg_k, target.window.get_allocator());
   } else {
-    if (source.table_data.size() == 0) throw std::logic_error("table is expected");
-    vector_u32<A> pairs = uncompress_surprising_values(source.table_data.data(), source.table_data_words, num_pairs,
-        lg_k, source.table_data.get_allocator());
+    if (table_data == nullptr) throw std::logic_error("table is expected");
+    vector_u32<A> pairs = uncompress_surprising_values(table_data, source.table_data_words, num_pairs,
+        source.lg_k, target.window.get_allocator());
+    restore_columns(pairs.data(), num_pairs, source.lg_k, source.num_coupons);
+    target.table = u32_table<A>::make_from_pairs(pairs.data(), num_pairs, source.lg_k, pairs.get_allocator());
+  }
+}
 
+// undoes the column transformations that the compressor applies to the pairs of the windowed flavors
+template<typename A>
+void cpc_compressor<A>::restore_columns(uint32_t* pairs, uint32_t num_pairs, uint8_t lg_k, uint32_t num_coupons) const {
+  const auto flavor = cpc_sketch_alloc<A>::determine_flavor(lg_k, num_coupons);
+  if (flavor == cpc_sketch_alloc<A>::flavor::PINNED) {
+    // undo the compressor's 8-column shift
+    for (uint32_t i = 0; i < num_pairs; i++) {
+      if ((pairs[i] & 63) >= 56) throw std::logic_error("(pairs[i] & 63) >= 56");
+      pairs[i] += 8;
+    }
+  } else if (flavor == cpc_sketch_alloc<A>::flavor::SLIDING) {
     const uint8_t pseudo_phase = determine_pseudo_phase(lg_k, num_coupons);
     if (pseudo_phase >= 16) throw std::logic_error("unexpected pseudo phase for sliding flavor");
     const uint8_t* permutation = column_permutations_for_decoding[pseudo_phase];
@@ -350,52 +416,58 @@ void cpc_compressor<A>::uncompress_sliding_flavor(const compressed_state<A>& sou
       col = (col + (offset + 8)) & 63;
       pairs[i] = (row << 6) | col;
     }
-
-    target.table = u32_table<A>::make_from_pairs(pairs.data(), num_pairs, lg_k, pairs.get_allocator());
   }
 }
 
 template<typename A>
-void cpc_compressor<A>::compress_surprising_values(const vector_u32<A>& pairs, uint8_t lg_k, compressed_state<A>& result) const {
+void cpc_compressor<A>::uncompress_window(const uint32_t* data, uint32_t data_words, uint8_t* window,
+    uint8_t lg_k, uint32_t num_coupons) const {
   const uint32_t k = 1 << lg_k;
-  const uint32_t num_pairs = static_cast<uint32_t>(pairs.size());
-  const uint8_t num_base_bits = golomb_choose_number_of_base_bits(k + num_pairs, num_pairs);
-  const uint64_t table_len = safe_length_for_compressed_pair_buf(k, num_pairs, num_base_bits);
-  result.table_data.resize(table_len);
-
-  uint32_t csv_length = low_level_compress_pairs(pairs.data(), static_cast<uint32_t>(pairs.size()), num_base_bits, result.table_data.data());
+  const uint8_t pseudo_phase = determine_pseudo_phase(lg_k, num_coupons);
+  low_level_uncompress_bytes(window, k, decoding_tables_for_high_entropy_byte[pseudo_phase], data, data_words);
+}
 
-  // At this point we could free the unused portion of the compression output buffer,
-  // but it is not necessary if it is temporary
-  // Note: realloc caused strange timing spikes for lgK = 11 and 12.
+template<typename A>
+void cpc_compressor<A>::uncompress_pairs(const uint32_t* data, uint32_t data_words, uint32_t num_pairs, uint32_t* pairs,
+    uint8_t lg_k, uint32_t num_coupons) const {
+  uncompress_surprising_values(data, data_words, num_pairs, lg_k, pairs);
+  restore_columns(pairs, num_pairs, lg_k, num_coupons);
+}
 
-  result.table_data_words = csv_length;
-  result.table_num_entries = num_pairs;
+template<typename A>
+void cpc_compressor<A>::compress_surprising_values(const vector_u32<A>& pairs, uint8_t lg_k, uint32_t* words, uint32_t max_words,
+    compressed_sizes& sizes) const {
+  const uint32_t k = 1 << lg_k;
+  const uint32_t num_pairs = static_cast<uint32_t>(pairs.size());
+  const uint8_t num_base_bits = golomb_choose_number_of_base_bits(k + num_pairs, num_pairs);
+  // the window data may not have fit either, in which case nothing is written
+  const uint32_t offset = std::min(sizes.window_data_words, max_words);
+  sizes.table_data_words = low_level_compress_pairs(pairs.data(), num_pairs, num_base_bits, words + offset, max_words - offset);
+  sizes.table_num_entries = num_pairs;
 }
 
 template<typename A>
 vector_u32<A> cpc_compressor<A>::uncompress_surprising_values(const uint32_t* data, uint32_t data_words, uint32_t num_pairs,
     uint8_t lg_k, const A& allocator) const {
-  const uint32_t k = 1 << lg_k;
   vector_u32<A> pairs(num_pairs, 0, allocator);
-  const uint8_t num_base_bits = golomb_choose_number_of_base_bits(k + num_pairs, num_pairs);
-  low_level_uncompress_pairs(pairs.data(), num_pairs, num_base_bits, data, data_words);
+  uncompress_surprising_values(data, data_words, num_pairs, lg_k, pairs.data());
   return pairs;
 }
 
 template<typename A>
-void cpc_compressor<A>::compress_sliding_window(const uint8_t* window, uint8_t lg_k, uint32_t num_coupons, compressed_state<A>& target) const {
+void cpc_compressor<A>::uncompress_surprising_values(const uint32_t* data, uint32_t data_words, uint32_t num_pairs,
+    uint8_t lg_k, uint32_t* pairs) const {
   const uint32_t k = 1 << lg_k;
-  const size_t window_buf_len = safe_length_for_compressed_window_buf(k);
-  target.window_data.resize(window_buf_len);
-  const uint8_t pseudo_phase = determine_pseudo_phase(lg_k, num_coupons);
-  size_t data_words = low_level_compress_bytes(window, k, encoding_tables_for_high_entropy_byte[pseudo_phase], target.window_data.data());
-
-  // At this point we could free the unused portion of the compression output buffer,
-  // but it is not necessary if it is temporary
-  // Note: realloc caused strange timing spikes for lgK = 11 and 12.
+  const uint8_t num_base_bits = golomb_choose_number_of_base_bits(k + num_pairs, num_pairs);
+  low_level_uncompress_pairs(pairs, num_pairs, num_base_bits, data, data_words);
+}
 
-  target.window_data_words = static_cast<uint32_t>(data_words);
+template<typename A>
+void cpc_compressor<A>::compress_sliding_window(const uint8_t* window, uint8_t lg_k, uint32_t num_coupons, uint32_t* words,
+    uint32_t max_words, compressed_sizes& sizes) const {
+  const uint32_t k = 1 << lg_k;
+  const uint8_t pseudo_phase = determine_pseudo_phase(lg_k, num_coupons);
+  sizes.window_data_words = low_level_compress_bytes(window, k, encoding_tables_for_high_entropy_byte[pseudo_phase], words, max_words);
 }
 
 template<typename A>
@@ -403,8 +475,7 @@ void cpc_compressor<A>::uncompress_sliding_window(const uint32_t* data, uint32_t
     uint8_t lg_k, uint32_t num_coupons) const {
   const uint32_t k = 1 << lg_k;
   window.resize(k); // zeroing not needed here (unlike the Hybrid Flavor)
-  const uint8_t pseudo_phase = determine_pseudo_phase(lg_k, num_coupons);
-  low_level_uncompress_bytes(window.data(), k, decoding_tables_for_high_entropy_byte[pseudo_phase], data, data_words);
+  uncompress_window(data, data_words, window.data(), lg_k, num_coupons);
 }
 
 template<typename A>
@@ -454,29 +525,51 @@ uint8_t cpc_compressor<A>::determine_pseudo_phase(uint8_t lg_k, uint32_t c) {
   }
 }
 
-static inline void maybe_flush_bitbuf(uint64_t& bitbuf, uint8_t& bufbits, uint32_t* wordarr, uint32_t& wordindex) {
+// words past max_words are counted, but not written
+static inline void maybe_flush_bitbuf(uint64_t& bitbuf, uint8_t& bufbits, uint32_t* wordarr, uint32_t max_words, uint32_t& wordindex) {
   if (bufbits >= 32) {
-    wordarr[wordindex++] = bitbuf & 0xffffffff;
+    if (wordindex < max_words) wordarr[wordindex] = bitbuf & 0xffffffff;
+    ++wordindex;
     bitbuf = bitbuf >> 32;
     bufbits -= 32;
   }
 }
 
-static inline void maybe_fill_bitbuf(uint64_t& bitbuf, uint8_t& bufbits, const uint32_t* wordarr, uint32_t& wordindex, uint8_t minbits) {
-  if (bufbits < minbits) {
-    bitbuf |= static_cast<uint64_t>(wordarr[wordindex++]) << bufbits;
+// number of bits of the input consumed so far
+static inline uint64_t bits_used(uint32_t wordindex, uint8_t bufbits) {
+  return (static_cast<uint64_t>(wordindex) << 5) - bufbits;
+}
+
+// Makes sure that there are at least 32 bits in the bit buffer, without branching on it.
+// The next word is always read, words past the end of the input read as zeros,
+// and it is only appended if the buffer holds fewer than 32 bits.
+static inline void refill_bitbuf(uint64_t& bitbuf, uint8_t& bufbits, const uint32_t* wordarr, uint32_t num_words, uint32_t& wordindex) {
+  const uint64_t word = wordindex < num_words ? wordarr[wordindex] : 0;
+  const uint8_t needed = bufbits < 32;
+  bitbuf |= (word << (bufbits & 31)) * needed;
+  wordindex += needed;
+  bufbits += needed << 5;
+}
+
+// Same as above, but branching. The pairs decoder is faster with this one since
+// the branch lets the next lookup start before the refill is resolved.
+static inline void maybe_refill_bitbuf(uint64_t& bitbuf, uint8_t& bufbits, const uint32_t* wordarr, uint32_t num_words, uint32_t& wordindex) {
+  if (bufbits < 32) {
+    if (wordindex < num_words) bitbuf |= static_cast<uint64_t>(wordarr[wordindex]) << bufbits;
+    ++wordindex;
     bufbits += 32;
   }
 }
 
 // This returns the number of compressed words that were actually used.
-// It is the caller's responsibility to ensure that the compressed_words array is long enough.
+// Nothing is written past max_words, but the words that did not fit are still counted.
 template<typename A>
 uint32_t cpc_compressor<A>::low_level_compress_bytes(
     const uint8_t* byte_array, // input
     uint32_t num_bytes_to_encode,
     const uint16_t* encoding_table,
-    uint32_t* compressed_words // output
+    uint32_t* compressed_words, // output
+    uint32_t max_words
 ) const {
   uint64_t bitbuf = 0; // bits are packed into this first, then are flushed to compressed_words
   uint8_t bufbits = 0; // number of bits currently in bitbuf; must be between 0 and 31
@@ -488,16 +581,17 @@ uint32_t cpc_compressor<A>::low_level_compress_bytes(
     const uint8_t code_len = code_info >> 12;
     bitbuf |= (code_val << bufbits);
     bufbits += code_len;
-    maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, next_word_index);
+    maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, max_words, next_word_index);
   }
 
   // Pad the bitstream with 11 zero-bits so that the decompressor's 12-bit peek can't overrun its input.
   bufbits += 11;
-  maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, next_word_index);
+  maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, max_words, next_word_index);
 
   if (bufbits > 0) { // We are done encoding now, so we flush the bit buffer.
     if (bufbits >= 32) throw std::logic_error("bufbits >= 32");
-    compressed_words[next_word_index++] = bitbuf & 0xffffffff;
+    if (next_word_index < max_words) compressed_words[next_word_index] = bitbuf & 0xffffffff;
+    ++next_word_index;
     bitbuf = 0; bufbits = 0; // not really necessary
   }
   return next_word_index;
@@ -507,36 +601,49 @@ template<typename A>
 void cpc_compressor<A>::low_level_uncompress_bytes(
     uint8_t* byte_array, // output
     uint32_t num_bytes_to_decode,
-    const uint16_t* decoding_table,
+    const uint32_t* decoding_table,
     const uint32_t* compressed_words, // input
     uint32_t num_compressed_words
 ) const {
-  uint32_t word_index = 0;
-  uint64_t bitbuf = 0;
-  uint8_t bufbits = 0;
-
   if (byte_array == nullptr) throw std::logic_error("byte_array == NULL");
   if (decoding_table == nullptr) throw std::logic_error("decoding_table == NULL");
   if (compressed_words == nullptr) throw std::logic_error("compressed_words == NULL");
 
-  for (uint32_t byte_index = 0; byte_index < num_bytes_to_decode; byte_index++) {
-    maybe_fill_bitbuf(bitbuf, bufbits, compressed_words, word_index, 12); // ensure 12 bits in bit buffer
-
-    const size_t peek12 = bitbuf & 0xfff; // These 12 bits will include an entire Huffman codeword.
-    const uint16_t lookup = decoding_table[peek12];
-    const uint8_t code_word_length = lookup >> 8;
-    const uint8_t decoded_byte = lookup & 0xff;
-    byte_array[byte_index] = decoded_byte;
-    bitbuf >>= code_word_length;
-    bufbits -= code_word_length;
+  uint32_t word_index = 0;
+  uint64_t bitbuf = 0;
+  uint8_t bufbits = 0;
+  uint32_t byte_index = 0;
+  // Each lookup yields one or two bytes and consumes at most 12 bits, so one refill
+  // is good for two lookups. The second byte is written either way and is
+  // overwritten by the next lookup if it was not decoded.
+  while (byte_index + 4 <= num_bytes_to_decode) {
+    refill_bitbuf(bitbuf, bufbits, compressed_words, num_compressed_words, word_index);
+    for (int i = 0; i < 2; i++) {
+      const uint32_t lookup = decoding_table[bitbuf & 0xfff];
+      byte_array[byte_index] = lookup & 0xff;
+      byte_array[byte_index + 1] = (lookup >> 8) & 0xff;
+      byte_index += 1 + ((lookup >> 24) & 1);
+      const uint8_t code_length = (lookup >> 20) & 0xf;
+      bitbuf >>= code_length;
+      bufbits -= code_length;
+    }
+  }
+  while (byte_index < num_bytes_to_decode) { // the remaining bytes one at a time
+    refill_bitbuf(bitbuf, bufbits, compressed_words, num_compressed_words, word_index);
+    const uint32_t lookup = decoding_table[bitbuf & 0xfff];
+    byte_array[byte_index++] = lookup & 0xff;
+    const uint8_t code_length = (lookup >> 16) & 0xf;
+    bitbuf >>= code_length;
+    bufbits -= code_length;
   }
   // Buffer over-run should be impossible unless there is a bug.
-  // However, we might as well check here.
-  if (word_index > num_compressed_words) throw std::logic_error("word_index > num_compressed_words");
+  // However, we might as well check here. Words past the end may have been read as zeros, but not used.
+  if (bits_used(word_index, bufbits) > bits_used(num_compressed_words, 0)) throw std::logic_error("word_index > num_compressed_words");
 }
 
 static inline uint64_t read_unary(
     const uint32_t* compressed_words,
+    uint32_t num_compressed_words,
     uint32_t& next_word_index,
     uint64_t& bitbuf,
     uint8_t& bufbits
@@ -544,6 +651,7 @@ static inline uint64_t read_unary(
 
 static inline void write_unary(
     uint32_t* compressed_words,
+    uint32_t max_words,
     uint32_t& next_word_index_ptr,
     uint64_t& bit_buf_ptr,
     uint8_t& buf_bits_ptr,
@@ -553,13 +661,14 @@ static inline void write_unary(
 // Here "pairs" refers to row/column pairs that specify
 // the positions of surprising values in the bit matrix.
 
-// returns the number of compressed_words actually used
+// returns the number of compressed_words actually used, including the ones past max_words that were not written
 template<typename A>
 uint32_t cpc_compressor<A>::low_level_compress_pairs(
     const uint32_t* pair_array,  // input
     uint32_t num_pairs_to_encode,
     uint8_t num_base_bits,
-    uint32_t* compressed_words // output
+    uint32_t* compressed_words, // output
+    uint32_t max_words
 ) const {
   uint64_t bitbuf = 0;
   uint8_t bufbits = 0;
@@ -589,26 +698,27 @@ uint32_t cpc_compressor<A>::low_level_compress_pairs(
     const uint8_t code_len = static_cast<uint8_t>(code_info >> 12);
     bitbuf |= code_val << bufbits;
     bufbits += code_len;
-    maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, next_word_index);
+    maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, max_words, next_word_index);
 
     const uint64_t golomb_lo = y_delta & golomb_lo_mask;
     const uint64_t golomb_hi = y_delta >> num_base_bits;
 
-    write_unary(compressed_words, next_word_index, bitbuf, bufbits, golomb_hi);
+    write_unary(compressed_words, max_words, next_word_index, bitbuf, bufbits, golomb_hi);
 
     bitbuf |= golomb_lo << bufbits;
     bufbits += num_base_bits;
-    maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, next_word_index);
+    maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, max_words, next_word_index);
   }
 
   // Pad the bitstream so that the decompressor's 12-bit peek can't overrun its input.
   const uint8_t padding = (num_base_bits > 10) ? 0 : 10 - num_base_bits;
   bufbits += padding;
-  maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, next_word_index);
+  maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, max_words, next_word_index);
 
   if (bufbits > 0) { // We are done encoding now, so we flush the bit buffer
     if (bufbits >= 32) throw std::logic_error("bufbits >= 32");
-    compressed_words[next_word_index++] = bitbuf & 0xffffffff;
+    if (next_word_index < max_words) compressed_words[next_word_index] = bitbuf & 0xffffffff;
+    ++next_word_index;
     bitbuf = 0; bufbits = 0; // not really necessary
   }
 
@@ -623,6 +733,7 @@ void cpc_compressor<A>::low_level_uncompress_pairs(
     const uint32_t* compressed_words, // input
     uint32_t num_compressed_words
 ) const {
+  if (compressed_words == nullptr) throw std::logic_error("compressed_words == NULL");
   uint32_t word_index = 0;
   uint64_t bitbuf = 0;
   uint8_t bufbits = 0;
@@ -636,17 +747,26 @@ void cpc_compressor<A>::low_level_uncompress_pairs(
   // y_delta_lo (basebits)
 
   for (uint32_t pair_index = 0; pair_index < num_pairs_to_decode; pair_index++) {
-    maybe_fill_bitbuf(bitbuf, bufbits, compressed_words, word_index, 12); // ensure 12 bits in bit buffer
-    const size_t peek12 = bitbuf & 0xfff;
-    const uint16_t lookup = length_limited_unary_decoding_table65[peek12];
+    maybe_refill_bitbuf(bitbuf, bufbits, compressed_words, num_compressed_words, word_index); // at least 32 bits
+    const uint16_t lookup = length_limited_unary_decoding_table65[bitbuf & 0xfff];
     const uint8_t code_word_length = lookup >> 8;
     const int8_t x_delta = lookup & 0xff;
     bitbuf >>= code_word_length;
     bufbits -= code_word_length;
 
-    const uint64_t golomb_hi = read_unary(compressed_words, word_index, bitbuf, bufbits);
+    // at least 20 bits are left, and the next 8 usually hold the whole unary code,
+    // which leaves enough for the low bits without another refill
+    uint64_t golomb_hi;
+    const uint8_t trailing_zeros = byte_trailing_zeros_table[bitbuf & 0xff];
+    if (trailing_zeros < 8 && num_base_bits <= 12) {
+      golomb_hi = trailing_zeros;
+      bitbuf >>= trailing_zeros + 1;
+      bufbits -= trailing_zeros + 1;
+    } else {
+      golomb_hi = read_unary(compressed_words, num_compressed_words, word_index, bitbuf, bufbits);
+      maybe_refill_bitbuf(bitbuf, bufbits, compressed_words, num_compressed_words, word_index);
+    }
 
-    maybe_fill_bitbuf(bitbuf, bufbits, compressed_words, word_index, num_base_bits); // ensure num_base_bits in bit buffer
     const uint64_t golomb_lo = bitbuf & golomb_lo_mask;
     bitbuf >>= num_base_bits;
     bufbits -= num_base_bits;
@@ -661,38 +781,37 @@ void cpc_compressor<A>::low_level_uncompress_pairs(
     predicted_row_index = row_index;
     predicted_col_index = col_index + 1;
   }
-  if (word_index > num_compressed_words) throw std::logic_error("word_index > num_compressed_words"); // check for buffer over-run
+  // check for buffer over-run
+  if (bits_used(word_index, bufbits) > bits_used(num_compressed_words, 0)) throw std::logic_error("word_index > num_compressed_words");
 }
 
 uint64_t read_unary(
     const uint32_t* compressed_words,
+    uint32_t num_compressed_words,
     uint32_t& next_word_index,
     uint64_t& bitbuf,
     uint8_t& bufbits
 ) {
-  if (compressed_words == nullptr) throw std::logic_error("compressed_words == NULL");
   size_t subtotal = 0;
   while (true) {
-    maybe_fill_bitbuf(bitbuf, bufbits, compressed_words, next_word_index, 8); // ensure 8 bits in bit buffer
-
-    const uint8_t peek8 = bitbuf & 0xff; // These 8 bits include either all or part of the Unary codeword
-    const uint8_t trailing_zeros = byte_trailing_zeros_table[peek8];
-
-    if (trailing_zeros > 8) throw std::out_of_range("trailing_zeros out of range");
-    if (trailing_zeros < 8) {
+    refill_bitbuf(bitbuf, bufbits, compressed_words, num_compressed_words, next_word_index);
+    if (bitbuf & 0xffffffff) {
+      const uint8_t trailing_zeros = count_trailing_zeros_in_u32(bitbuf & 0xffffffff);
       bufbits -= 1 + trailing_zeros;
       bitbuf >>= 1 + trailing_zeros;
       return subtotal + trailing_zeros;
     }
     // The codeword was partial, so read some more
-    subtotal += 8;
-    bufbits -= 8;
-    bitbuf >>= 8;
+    if (bits_used(next_word_index, bufbits) > bits_used(num_compressed_words, 0)) throw std::logic_error("word_index > num_compressed_words");
+    subtotal += 32;
+    bufbits -= 32;
+    bitbuf >>= 32;
   }
 }
 
 void write_unary(
     uint32_t* compressed_words,
+    uint32_t max_words,
     uint32_t& next_word_index,
     uint64_t& bitbuf,
     uint8_t& bufbits,
@@ -708,7 +827,7 @@ void write_unary(
     // Here we output 16 zeros, but we don't need to physically write them into bitbuf
     // because it already contains zeros in that region.
     bufbits += 16; // Record the fact that 16 bits of output have occurred.
-    maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, next_word_index);
+    maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, max_words, next_word_index);
   }
 
   if (remaining > 15) throw std::out_of_range("remaining out of range");
@@ -716,7 +835,7 @@ void write_unary(
   const uint64_t the_unary_code = 1ULL << remaining;
   bitbuf |= the_unary_code << bufbits;
   bufbits += static_cast<uint8_t>(remaining + 1);
-  maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, next_word_index);
+  maybe_flush_bitbuf(bitbuf, bufbits, compressed_words, max_words, next_word_index);
 }
 
 // The empty space that this leaves at the beginning of the output array
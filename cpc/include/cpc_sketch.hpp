@@ -194,6 +194,28 @@ public:
    */
   void update(const void* value, size_t size);
 
+  /**
+   * Update this sketch with a range of values.
+   * Each value is hashed exactly as the update() method for its type above would hash it,
+   * and the resulting sketch, including the HIP estimate, is the same as after updating
+   * with each value in turn. The values are hashed in blocks ahead of updating the sketch,
+   * which is faster than calling update() in a loop.
+   * @param first iterator to the first value
+   * @param last iterator past the last value
+   */
+  template<typename InputIt>
+  void update(InputIt first, InputIt last);
+
+  /**
+   * Update this sketch with a value that was already hashed.
+   * The two halves of the hash must come from MurmurHash3_x64_128 with the seed of this sketch
+   * applied to the same bytes that update() would hash, otherwise this sketch will not be
+   * compatible with sketches updated in the usual way.
+   * @param hash1 the first 64 bits of the 128-bit hash
+   * @param hash2 the second 64 bits of the 128-bit hash
+   */
+  void update_hash(uint64_t hash1, uint64_t hash2);
+
   /**
    * Returns a human-readable summary of this sketch
    */
@@ -218,6 +240,18 @@ public:
    */
   vector_bytes serialize(unsigned header_size_bytes = 0) const;
 
+  /**
+   * This method serializes the sketch into a given buffer.
+   * The compressed data is written directly into the buffer without intermediate copies
+   * unless the buffer is not aligned to 4 bytes.
+   * A buffer of get_max_serialized_size_bytes(lg_k) is large enough for almost all sketches.
+   * @param buffer pointer to the memory to serialize the sketch into
+   * @param capacity the size of the buffer in bytes
+   * @return the number of bytes written
+   * @throw std::out_of_range if the serialized sketch does not fit into the buffer
+   */
+  size_t serialize(void* buffer, size_t capacity) const;
+
   /**
    * This method deserializes a sketch from a given stream.
    * @param is input stream
@@ -246,6 +280,26 @@ public:
    */
   static size_t get_max_serialized_size_bytes(uint8_t lg_k);
 
+  /**
+   * Reserves the storage that this sketch needs as it goes through all the flavors,
+   * so that subsequent updates do not allocate memory.
+   * This takes about 4K bytes in total: K bytes for the sliding window, 2K bytes for the table
+   * of surprising values sized for K/4 slots and for rebuilding it, and 3K/4 bytes for sorting
+   * the surprising values when the window moves. In practice the table stays well below
+   * this size. Should it grow beyond it anyway, it allocates as usual.
+   * A copy of this sketch does not keep the reserved storage.
+   */
+  void reserve();
+
+  /**
+   * Returns the largest amount of heap storage in bytes held by this sketch so far.
+   * This counts the storage held between updates, but not the short-lived buffers within an update,
+   * such as the old slots while the table of surprising values is resized.
+   * With reserved storage there are no such buffers.
+   * @return peak storage in bytes
+   */
+  size_t get_peak_storage_bytes() const;
+
   // for internal use
   uint32_t get_num_coupons() const;
 
@@ -283,17 +337,43 @@ private:
   double kxp;
   double hip_est_accum;
 
+  vector_u32<A> surprises_buffer; // reused by move_window()
+  size_t peak_storage_bytes;
+
   // for deserialization and cpc_union::get_result()
   cpc_sketch_alloc(uint8_t lg_k, uint32_t num_coupons, uint8_t first_interesting_column, u32_table<A>&& table,
       vector_u8<A>&& window, bool has_hip, double kxp, double hip_est_accum, uint64_t seed);
 
+  // number of values hashed ahead of updating the sketch in update(first, last)
+  static const unsigned UPDATE_BATCH_SIZE = 64;
+
+  // these hash values the same way as the corresponding update() methods,
+  // returning false if the value must be ignored
+  bool hash_value(const std::string& value, HashState& hashes) const;
+  bool hash_value(uint64_t value, HashState& hashes) const;
+  bool hash_value(int64_t value, HashState& hashes) const;
+  bool hash_value(uint32_t value, HashState& hashes) const;
+  bool hash_value(int32_t value, HashState& hashes) const;
+  bool hash_value(uint16_t value, HashState& hashes) const;
+  bool hash_value(int16_t value, HashState& hashes) const;
+  bool hash_value(uint8_t value, HashState& hashes) const;
+  bool hash_value(int8_t value, HashState& hashes) const;
+  bool hash_value(double value, HashState& hashes) const;
+  bool hash_value(float value, HashState& hashes) const;
+
   inline void row_col_update(uint32_t row_col);
   inline void update_sparse(uint32_t row_col);
   inline void update_windowed(uint32_t row_col);
   inline void update_hip(uint32_t row_col);
   void promote_sparse_to_windowed();
   void move_window();
-  void refresh_kxp(const uint64_t* bit_matrix);
+  void update_peak_storage();
+
+  // KXP is computed from the number of zeros in each column of the bit matrix,
+  // which are counted at most MAX_ROWS_PER_ZERO_COUNT rows at a time
+  static const uint32_t MAX_ROWS_PER_ZERO_COUNT = 255;
+  static void count_zeros_in_columns(const uint64_t* rows, uint32_t num_rows, uint64_t* column_zeros);
+  static double kxp_from_zeros_in_columns(const uint64_t* column_zeros);
 
   friend double get_hip_confidence_lb<A>(const cpc_sketch_alloc<A>& sketch, int kappa);
   friend double get_hip_confidence_ub<A>(const cpc_sketch_alloc<A>& sketch, int kappa);
@@ -311,7 +391,10 @@ private:
   vector_u64<A> build_bit_matrix() const;
 
   static uint8_t get_preamble_ints(uint32_t num_coupons, bool has_hip, bool has_table, bool has_window);
-  inline void write_hip(std::ostream& os) const;
+  // returns the serialized size, which is greater than the capacity if nothing was written
+  size_t serialize_to_mem(uint8_t* ptr, size_t capacity) const;
+  // checks a serialized sketch and finds its compressed data without copying it
+  static compressed_image parse(const void* bytes, size_t size, uint64_t seed);
   inline size_t copy_hip_to_mem(void* dst) const;
 
   static void check_lg_k(uint8_t lg_k);
@@ -20,13 +20,13 @@
 #ifndef CPC_SKETCH_IMPL_HPP_
 #define CPC_SKETCH_IMPL_HPP_
 
+#include <algorithm>
 #include <stdexcept>
 #include <cmath>
 #include <cstring>
 #include <sstream>
 
 #include "cpc_confidence.hpp"
-#include "kxp_byte_lookup.hpp"
 #include "inv_pow2_table.hpp"
 #include "cpc_util.hpp"
 #include "icon_estimator.hpp"
@@ -35,6 +35,10 @@
 
 namespace datasketches {
 
+// std::min() takes it by reference, so it needs a definition without optimization
+template<typename A>
+const uint32_t cpc_sketch_alloc<A>::MAX_ROWS_PER_ZERO_COUNT;
+
 template<typename A>
 void cpc_init() {
   get_compressor<A>(); // this initializes a global static instance of the compressor on the first use
@@ -51,9 +55,12 @@ sliding_window(allocator),
 window_offset(0),
 first_interesting_column(0),
 kxp(1 << lg_k),
-hip_est_accum(0)
+hip_est_accum(0),
+surprises_buffer(allocator),
+peak_storage_bytes(0)
 {
   check_lg_k(lg_k);
+  update_peak_storage();
 }
 
 template<typename A>
@@ -153,18 +160,9 @@ void cpc_sketch_alloc<A>::update(int8_t value) {
 
 template<typename A>
 void cpc_sketch_alloc<A>::update(double value) {
-  union {
-    int64_t long_value;
-    double double_value;
-  } ldu;
-  if (value == 0.0) {
-    ldu.double_value = 0.0; // canonicalize -0.0 to 0.0
-  } else if (std::isnan(value)) {
-    ldu.long_value = 0x7ff8000000000000L; // canonicalize NaN using value from Java's Double.doubleToLongBits()
-  } else {
-    ldu.double_value = value;
-  }
-  update(&ldu, sizeof(ldu));
+  HashState hashes;
+  hash_value(value, hashes);
+  update_hash(hashes.h1, hashes.h2);
 }
 
 template<typename A>
@@ -192,6 +190,101 @@ void cpc_sketch_alloc<A>::update(const void* value, size_t size) {
   row_col_update(row_col_from_two_hashes(hashes.h1, hashes.h2, lg_k));
 }
 
+template<typename A>
+void cpc_sketch_alloc<A>::update_hash(uint64_t hash1, uint64_t hash2) {
+  row_col_update(row_col_from_two_hashes(hash1, hash2, lg_k));
+}
+
+template<typename A>
+template<typename InputIt>
+void cpc_sketch_alloc<A>::update(InputIt first, InputIt last) {
+  // Hashing is independent for each value, so a block of values is hashed before
+  // any of them is applied. The coupons are applied in the original order
+  // because the HIP estimate depends on the order in which they arrive.
+  uint32_t row_cols[UPDATE_BATCH_SIZE];
+  while (first != last) {
+    unsigned num_row_cols = 0;
+    for (; first != last && num_row_cols < UPDATE_BATCH_SIZE; ++first) {
+      HashState hashes;
+      if (hash_value(*first, hashes)) {
+        row_cols[num_row_cols++] = row_col_from_two_hashes(hashes.h1, hashes.h2, lg_k);
+      }
+    }
+    for (unsigned i = 0; i < num_row_cols; i++) row_col_update(row_cols[i]);
+  }
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(const std::string& value, HashState& hashes) const {
+  if (value.empty()) return false;
+  MurmurHash3_x64_128(value.c_str(), value.length(), seed, hashes);
+  return true;
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(uint64_t value, HashState& hashes) const {
+  MurmurHash3_x64_128(&value, sizeof(value), seed, hashes);
+  return true;
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(int64_t value, HashState& hashes) const {
+  MurmurHash3_x64_128(&value, sizeof(value), seed, hashes);
+  return true;
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(uint32_t value, HashState& hashes) const {
+  return hash_value(static_cast<int32_t>(value), hashes);
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(int32_t value, HashState& hashes) const {
+  return hash_value(static_cast<int64_t>(value), hashes);
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(uint16_t value, HashState& hashes) const {
+  return hash_value(static_cast<int16_t>(value), hashes);
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(int16_t value, HashState& hashes) const {
+  return hash_value(static_cast<int64_t>(value), hashes);
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(uint8_t value, HashState& hashes) const {
+  return hash_value(static_cast<int8_t>(value), hashes);
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(int8_t value, HashState& hashes) const {
+  return hash_value(static_cast<int64_t>(value), hashes);
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(double value, HashState& hashes) const {
+  union {
+    int64_t long_value;
+    double double_value;
+  } ldu;
+  if (value == 0.0) {
+    ldu.double_value = 0.0; // canonicalize -0.0 to 0.0
+  } else if (std::isnan(value)) {
+    ldu.long_value = 0x7ff8000000000000L; // canonicalize NaN using value from Java's Double.doubleToLongBits()
+  } else {
+    ldu.double_value = value;
+  }
+  MurmurHash3_x64_128(&ldu, sizeof(ldu), seed, hashes);
+  return true;
+}
+
+template<typename A>
+bool cpc_sketch_alloc<A>::hash_value(float value, HashState& hashes) const {
+  return hash_value(static_cast<double>(value), hashes);
+}
+
 template<typename A>
 void cpc_sketch_alloc<A>::row_col_update(uint32_t row_col) {
   const uint8_t col = row_col & 63;
@@ -209,8 +302,10 @@ void cpc_sketch_alloc<A>::update_sparse(uint32_t row_col) {
   const uint32_t k = 1 << lg_k;
   const uint64_t c32pre = static_cast<uint64_t>(num_coupons) << 5;
   if (c32pre >= 3 * k) throw std::logic_error("c32pre >= 3 * k"); // C < 3K/32, in other words flavor == SPARSE
+  const uint8_t table_lg_size = surprising_value_table.get_lg_size();
   bool is_novel = surprising_value_table.maybe_insert(row_col);
   if (is_novel) {
+    if (surprising_value_table.get_lg_size() != table_lg_size) update_peak_storage();
     num_coupons++;
     update_hip(row_col);
     const uint64_t c32post = static_cast<uint64_t>(num_coupons) << 5;
@@ -231,6 +326,7 @@ void cpc_sketch_alloc<A>::update_windowed(uint32_t row_col) {
 
   bool is_novel = false;
   const uint8_t col = row_col & 63;
+  const uint8_t table_lg_size = surprising_value_table.get_lg_size();
 
   if (col < window_offset) { // track the surprising 0's "before" the window
     is_novel = surprising_value_table.maybe_delete(row_col); // inverted logic
@@ -249,6 +345,7 @@ void cpc_sketch_alloc<A>::update_windowed(uint32_t row_col) {
   }
 
   if (is_novel) {
+    if (surprising_value_table.get_lg_size() != table_lg_size) update_peak_storage();
     num_coupons++;
     update_hip(row_col);
     const uint64_t c8post = static_cast<uint64_t>(num_coupons) << 3;
@@ -280,8 +377,6 @@ void cpc_sketch_alloc<A>::promote_sparse_to_windowed() {
 
   sliding_window.resize(k, 0); // zero the memory (because we will be OR'ing into it)
 
-  u32_table<A> new_table(2, 6 + lg_k, sliding_window.get_allocator());
-
   const uint32_t* old_slots = surprising_value_table.get_slots();
   const uint32_t old_num_slots = 1 << surprising_value_table.get_lg_size();
 
@@ -294,15 +389,13 @@ void cpc_sketch_alloc<A>::promote_sparse_to_windowed() {
       if (col < 8) {
         const uint32_t row = row_col >> 6;
         sliding_window[row] |= 1 << col;
-      } else {
-        // cannot use u32_table::must_insert(), because it doesn't provide for growth
-        const bool is_novel = new_table.maybe_insert(row_col);
-        if (!is_novel) throw std::logic_error("is_novel != true");
       }
     }
   }
 
-  surprising_value_table = std::move(new_table);
+  // the table keeps the values after the window, and is resized for them in its own storage
+  surprising_value_table.erase_if([](uint32_t row_col) { return (row_col & 63) < 8; });
+  update_peak_storage();
 }
 
 template<typename A>
@@ -314,60 +407,100 @@ void cpc_sketch_alloc<A>::move_window() {
   if (sliding_window.size() == 0) throw std::logic_error("no sliding window");
   const uint32_t k = 1 << lg_k;
 
-  // Construct the full-sized bit matrix that corresponds to the sketch
-  vector_u64<A> bit_matrix = build_bit_matrix();
-
-  // refresh the KXP register on every 8th window shift.
-  if ((new_offset & 0x7) == 0) refresh_kxp(bit_matrix.data());
+  // The rows of the bit matrix that corresponds to the sketch are built a block at a time,
+  // as in build_bit_matrix(), from the window and the surprising values sorted by row.
+  surprises_buffer.clear();
+  surprises_buffer.reserve(surprising_value_table.get_num_items());
+  const uint32_t* slots = surprising_value_table.get_slots();
+  const uint32_t num_slots = 1 << surprising_value_table.get_lg_size();
+  for (uint32_t i = 0; i < num_slots; i++) {
+    if (slots[i] != UINT32_MAX) surprises_buffer.push_back(slots[i]);
+  }
+  std::sort(surprises_buffer.begin(), surprises_buffer.end());
 
   surprising_value_table.clear(); // the new number of surprises will be about the same
 
+  // refresh the KXP register on every 8th window shift.
+  const bool must_refresh_kxp = (new_offset & 0x7) == 0;
+  uint64_t column_zeros[64]; // allocating on the stack
+  std::fill(column_zeros, column_zeros + 64, 0);
+
+  const uint64_t default_row = (static_cast<uint64_t>(1) << window_offset) - 1;
   const uint64_t mask_for_clearing_window = (static_cast<uint64_t>(0xff) << new_offset) ^ UINT64_MAX;
   const uint64_t mask_for_flipping_early_zone = (static_cast<uint64_t>(1) << new_offset) - 1;
   uint64_t all_surprises_ored = 0;
 
-  for (uint32_t i = 0; i < k; i++) {
-    uint64_t pattern = bit_matrix[i];
-    sliding_window[i] = (pattern >> new_offset) & 0xff;
-    pattern &= mask_for_clearing_window;
-    // The following line converts surprising 0's to 1's in the "early zone",
-    // (and vice versa, which is essential for this procedure's O(k) time cost).
-    pattern ^= mask_for_flipping_early_zone;
-    all_surprises_ored |= pattern; // a cheap way to recalculate first_interesting_column
-    while (pattern != 0) {
-      const uint8_t col = count_trailing_zeros_in_u64(pattern);
-      pattern = pattern ^ (static_cast<uint64_t>(1) << col); // erase the 1
-      const uint32_t row_col = (i << 6) | col;
-      const bool is_novel = surprising_value_table.maybe_insert(row_col);
-      if (!is_novel) throw std::logic_error("is_novel != true");
+  uint64_t rows[MAX_ROWS_PER_ZERO_COUNT]; // allocating on the stack
+  auto surprise = surprises_buffer.begin();
+  for (uint32_t start = 0; start < k; start += MAX_ROWS_PER_ZERO_COUNT) {
+    const uint32_t num_rows = std::min(MAX_ROWS_PER_ZERO_COUNT, k - start);
+    for (uint32_t i = 0; i < num_rows; i++) {
+      rows[i] = default_row | (static_cast<uint64_t>(sliding_window[start + i]) << window_offset);
+    }
+    for (; surprise != surprises_buffer.end() && (*surprise >> 6) < start + num_rows; ++surprise) {
+      // Flip the specified matrix bit from its default value.
+      rows[(*surprise >> 6) - start] ^= static_cast<uint64_t>(1) << (*surprise & 63);
+    }
+    if (must_refresh_kxp) count_zeros_in_columns(rows, num_rows, column_zeros);
+
+    for (uint32_t i = 0; i < num_rows; i++) {
+      uint64_t pattern = rows[i];
+      sliding_window[start + i] = (pattern >> new_offset) & 0xff;
+      pattern &= mask_for_clearing_window;
+      // The following line converts surprising 0's to 1's in the "early zone",
+      // (and vice versa, which is essential for this procedure's O(k) time cost).
+      pattern ^= mask_for_flipping_early_zone;
+      all_surprises_ored |= pattern; // a cheap way to recalculate first_interesting_column
+      while (pattern != 0) {
+        const uint8_t col = count_trailing_zeros_in_u64(pattern);
+        pattern = pattern ^ (static_cast<uint64_t>(1) << col); // erase the 1
+        const uint32_t row_col = ((start + i) << 6) | col;
+        const bool is_novel = surprising_value_table.maybe_insert(row_col);
+        if (!is_novel) throw std::logic_error("is_novel != true");
+      }
     }
   }
 
+  if (must_refresh_kxp) kxp = kxp_from_zeros_in_columns(column_zeros);
+
   window_offset = new_offset;
 
   first_interesting_column = count_trailing_zeros_in_u64(all_surprises_ored);
   if (first_interesting_column > new_offset) first_interesting_column = new_offset; // corner case
+  update_peak_storage();
 }
 
 // The KXP register is a double with roughly 50 bits of precision, but
 // it might need roughly 90 bits to track the value with perfect accuracy.
 // Therefore we recalculate KXP occasionally from the sketch's full bitmatrix
 // so that it will reflect changes that were previously outside the mantissa.
-template<typename A>
-void cpc_sketch_alloc<A>::refresh_kxp(const uint64_t* bit_matrix) {
-  const uint32_t k = 1 << lg_k;
+// KXP is the sum of 2^-(col+1) over the zero bits of the matrix. Summed separately for each byte
+// of the rows, these are exact integers in units of 1/256, so they are computed from the number
+// of zeros in each column without any rounding.
+
+// The zeros are counted in eight interleaved byte-wide counters per row,
+// which are flushed before any of them can overflow (at most 255 rows at a time).
+template<typename A>
+void cpc_sketch_alloc<A>::count_zeros_in_columns(const uint64_t* rows, uint32_t num_rows, uint64_t* column_zeros) {
+  if (num_rows > MAX_ROWS_PER_ZERO_COUNT) throw std::logic_error("too many rows");
+  uint64_t counters[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  for (uint32_t i = 0; i < num_rows; i++) {
+    const uint64_t zeros = ~rows[i];
+    for (unsigned b = 0; b < 8; b++) counters[b] += (zeros >> b) & 0x0101010101010101ULL;
+  }
+  for (unsigned b = 0; b < 8; b++) {
+    for (unsigned j = 0; j < 8; j++) column_zeros[8 * j + b] += (counters[b] >> (8 * j)) & 0xff;
+  }
+}
 
+template<typename A>
+double cpc_sketch_alloc<A>::kxp_from_zeros_in_columns(const uint64_t* column_zeros) {
   // for improved numerical accuracy, we separately sum the bytes of the U64's
   double byte_sums[8]; // allocating on the stack
-  std::fill(byte_sums, byte_sums + 8, 0);
-
-  for (size_t i = 0; i < k; i++) {
-    uint64_t word = bit_matrix[i];
-    for (unsigned j = 0; j < 8; j++) {
-      const uint8_t byte = word & 0xff;
-      byte_sums[j] += KXP_BYTE_TABLE[byte];
-      word >>= 8;
-    }
+  for (unsigned j = 0; j < 8; j++) {
+    uint64_t sum = 0; // in units of 1/256
+    for (unsigned b = 0; b < 8; b++) sum += column_zeros[8 * j + b] << (7 - b);
+    byte_sums[j] = static_cast<double>(sum) / 256;
   }
 
   double total = 0.0;
@@ -375,8 +508,31 @@ void cpc_sketch_alloc<A>::refresh_kxp(const uint64_t* bit_matrix) {
     const double factor = INVERSE_POWERS_OF_2[8 * j]; // pow (256.0, (-1.0 * ((double) j)));
     total += factor * byte_sums[j];
   }
+  return total;
+}
 
-  kxp = total;
+template<typename A>
+void cpc_sketch_alloc<A>::reserve() {
+  const uint32_t k = 1 << lg_k;
+  sliding_window.reserve(k);
+  // the table of surprising values stays below K/8 slots in the sparse flavor
+  // and, except for the smallest K, well below K/16 slots in the windowed flavors
+  const uint8_t table_lg_size = lg_k < 6 ? lg_k - 1 : lg_k - 2;
+  surprising_value_table.reserve(table_lg_size);
+  surprises_buffer.reserve(U32_TABLE_UPSIZE_NUMER * (1 << table_lg_size) / U32_TABLE_UPSIZE_DENOM);
+  update_peak_storage();
+}
+
+template<typename A>
+size_t cpc_sketch_alloc<A>::get_peak_storage_bytes() const {
+  return peak_storage_bytes;
+}
+
+template<typename A>
+void cpc_sketch_alloc<A>::update_peak_storage() {
+  const size_t storage_bytes = surprising_value_table.get_storage_bytes() + sliding_window.capacity()
+      + surprises_buffer.capacity() * sizeof(uint32_t);
+  peak_storage_bytes = std::max(peak_storage_bytes, storage_bytes);
 }
 
 template<typename A>
@@ -404,73 +560,104 @@ string<A> cpc_sketch_alloc<A>::to_string() const {
   return string<A>(os.str().c_str(), sliding_window.get_allocator());
 }
 
+/*
+ * These empirical values for the 99.9th percentile of size in bytes were measured using 100,000
+ * trials. The value for each trial is the maximum of 5*16=80 measurements that were equally
+ * spaced over values of the quantity C/K between 3.0 and 8.0. This table does not include the
+ * worst-case space for the preamble, which is added by the function.
+ */
+static const uint8_t CPC_EMPIRICAL_SIZE_MAX_LGK = 19;
+static const size_t CPC_EMPIRICAL_MAX_SIZE_BYTES[]  = {
+    24,     // lg_k = 4
+    36,     // lg_k = 5
+    56,     // lg_k = 6
+    100,    // lg_k = 7
+    180,    // lg_k = 8
+    344,    // lg_k = 9
+    660,    // lg_k = 10
+    1292,   // lg_k = 11
+    2540,   // lg_k = 12
+    5020,   // lg_k = 13
+    9968,   // lg_k = 14
+    19836,  // lg_k = 15
+    39532,  // lg_k = 16
+    78880,  // lg_k = 17
+    157516, // lg_k = 18
+    314656  // lg_k = 19
+};
+static const double CPC_EMPIRICAL_MAX_SIZE_FACTOR = 0.6; // 0.6 = 4.8 / 8.0
+static const size_t CPC_MAX_PREAMBLE_SIZE_BYTES = 40;
+
 template<typename A>
 void cpc_sketch_alloc<A>::serialize(std::ostream& os) const {
-  compressed_state<A> compressed(A(sliding_window.get_allocator()));
-  compressed.table_data_words = 0;
-  compressed.table_num_entries = 0;
-  compressed.window_data_words = 0;
-  get_compressor<A>().compress(*this, compressed);
-  const bool has_hip = !was_merged;
-  const bool has_table = compressed.table_data.size() > 0;
-  const bool has_window = compressed.window_data.size() > 0;
-  const uint8_t preamble_ints = get_preamble_ints(num_coupons, has_hip, has_table, has_window);
-  write(os, preamble_ints);
-  const uint8_t serial_version = SERIAL_VERSION;
-  write(os, serial_version);
-  const uint8_t family = FAMILY;
-  write(os, family);
-  write(os, lg_k);
-  write(os, first_interesting_column);
-  const uint8_t flags_byte(
-    (1 << flags::IS_COMPRESSED)
-    | (has_hip ? 1 << flags::HAS_HIP : 0)
-    | (has_table ? 1 << flags::HAS_TABLE : 0)
-    | (has_window ? 1 << flags::HAS_WINDOW : 0)
+  // the word counts come before the compressed data, so it has to be compressed in memory first
+  const auto bytes = serialize();
+  write(os, bytes.data(), bytes.size());
+}
+
+template<typename A>
+vector_u8<A> cpc_sketch_alloc<A>::serialize(unsigned header_size_bytes) const {
+  // the empirical maximum is much tighter than the safe bound for the windowed flavors,
+  // but a sketch that does not fit is simply serialized again into a larger buffer
+  const size_t max_size = std::min(
+      CPC_MAX_PREAMBLE_SIZE_BYTES + get_compressor<A>().get_max_compressed_words(*this) * sizeof(uint32_t),
+      get_max_serialized_size_bytes(lg_k)
   );
-  write(os, flags_byte);
-  const uint16_t seed_hash(compute_seed_hash(seed));
-  write(os, seed_hash);
-  if (!is_empty()) {
-    write(os, num_coupons);
-    if (has_table && has_window) {
-      // if there is no window it is the same as number of coupons
-      write(os, compressed.table_num_entries);
-      // HIP values can be in two different places in the sequence of fields
-      // this is the first HIP decision point
-      if (has_hip) write_hip(os);
-    }
-    if (has_table) {
-      write(os, compressed.table_data_words);
-    }
-    if (has_window) {
-      write(os, compressed.window_data_words);
-    }
-    // this is the second HIP decision point
-    if (has_hip && !(has_table && has_window)) write_hip(os);
-    if (has_window) {
-      write(os, compressed.window_data.data(), compressed.window_data_words * sizeof(uint32_t));
-    }
-    if (has_table) {
-      write(os, compressed.table_data.data(), compressed.table_data_words * sizeof(uint32_t));
-    }
+  vector_u8<A> bytes(header_size_bytes + max_size, 0, sliding_window.get_allocator());
+  const size_t size = serialize_to_mem(bytes.data() + header_size_bytes, max_size);
+  if (size > max_size) {
+    bytes.resize(header_size_bytes + size);
+    if (serialize_to_mem(bytes.data() + header_size_bytes, size) != size) throw std::logic_error("serialized size mismatch");
   }
+  bytes.resize(header_size_bytes + size);
+  return bytes;
 }
 
 template<typename A>
-vector_u8<A> cpc_sketch_alloc<A>::serialize(unsigned header_size_bytes) const {
-  compressed_state<A> compressed(sliding_window.get_allocator());
-  compressed.table_data_words = 0;
-  compressed.table_num_entries = 0;
-  compressed.window_data_words = 0;
-  get_compressor<A>().compress(*this, compressed);
+size_t cpc_sketch_alloc<A>::serialize(void* buffer, size_t capacity) const {
+  const size_t size = serialize_to_mem(static_cast<uint8_t*>(buffer), capacity);
+  if (size > capacity) {
+    throw std::out_of_range("insufficient buffer size: " + std::to_string(capacity) + ", need " + std::to_string(size));
+  }
+  return size;
+}
+
+template<typename A>
+size_t cpc_sketch_alloc<A>::serialize_to_mem(uint8_t* ptr, size_t capacity) const {
+  // the layout of the preamble depends only on the flavor and the number of surprising values,
+  // so the compressed data can be written in place before the preamble
+  const flavor f = determine_flavor();
   const bool has_hip = !was_merged;
-  const bool has_table = compressed.table_data.size() > 0;
-  const bool has_window = compressed.window_data.size() > 0;
+  const bool has_table = f == flavor::SPARSE || f == flavor::HYBRID
+      || (f != flavor::EMPTY && surprising_value_table.get_num_items() > 0);
+  const bool has_window = f == flavor::PINNED || f == flavor::SLIDING;
   const uint8_t preamble_ints = get_preamble_ints(num_coupons, has_hip, has_table, has_window);
-  const size_t size = header_size_bytes + (preamble_ints + compressed.table_data_words + compressed.window_data_words) * sizeof(uint32_t);
-  vector_u8<A> bytes(size, 0, sliding_window.get_allocator());
-  uint8_t* ptr = bytes.data() + header_size_bytes;
+  const size_t preamble_bytes = preamble_ints * sizeof(uint32_t);
+  uint32_t max_words = capacity < preamble_bytes ? 0
+      : static_cast<uint32_t>(std::min<size_t>((capacity - preamble_bytes) / sizeof(uint32_t), UINT32_MAX));
+
+  // the compressed words are written in place unless they would be misaligned,
+  // in which case the temporary buffer is no larger than the compressed words can be
+  compressed_sizes compressed;
+  vector_u32<A> words(sliding_window.get_allocator());
+  uint32_t no_words;
+  uint32_t* data = &no_words;
+  if (max_words > 0) {
+    data = reinterpret_cast<uint32_t*>(ptr + preamble_bytes);
+    if (reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) {
+      max_words = std::min(max_words, get_compressor<A>().get_max_compressed_words(*this));
+      words.resize(max_words);
+      data = max_words > 0 ? words.data() : &no_words;
+    }
+  }
+  const uint32_t data_words = get_compressor<A>().compress(*this, data, max_words, compressed);
+  const size_t size = preamble_bytes + data_words * sizeof(uint32_t);
+  if (size > capacity) return size;
+  if (has_table != (compressed.table_data_words > 0)) throw std::logic_error("table is not expected");
+  if (has_window != (compressed.window_data_words > 0)) throw std::logic_error("window is not expected");
+  if (!words.empty()) std::memcpy(ptr + preamble_bytes, data, data_words * sizeof(uint32_t));
+
+  const uint8_t* preamble_end = ptr + preamble_bytes;
   ptr += copy_to_mem(preamble_ints, ptr);
   const uint8_t serial_version = SERIAL_VERSION;
   ptr += copy_to_mem(serial_version, ptr);
@@ -504,15 +691,9 @@ vector_u8<A> cpc_sketch_alloc<A>::serialize(unsigned header_size_bytes) const {
     }
     // this is the second HIP decision point
     if (has_hip && !(has_table && has_window)) ptr += copy_hip_to_mem(ptr);
-    if (has_window) {
-      ptr += copy_to_mem(compressed.window_data.data(), ptr, compressed.window_data_words * sizeof(uint32_t));
-    }
-    if (has_table) {
-      ptr += copy_to_mem(compressed.table_data.data(), ptr, compressed.table_data_words * sizeof(uint32_t));
-    }
   }
-  if (ptr != bytes.data() + size) throw std::logic_error("serialized size mismatch");
-  return bytes;
+  if (ptr != preamble_end) throw std::logic_error("serialized size mismatch");
+  return size;
 }
 
 template<typename A>
@@ -527,42 +708,46 @@ cpc_sketch_alloc<A> cpc_sketch_alloc<A>::deserialize(std::istream& is, uint64_t
   const bool has_hip = flags_byte & (1 << flags::HAS_HIP);
   const bool has_table = flags_byte & (1 << flags::HAS_TABLE);
   const bool has_window = flags_byte & (1 << flags::HAS_WINDOW);
-  compressed_state<A> compressed(allocator);
-  compressed.table_data_words = 0;
-  compressed.table_num_entries = 0;
-  compressed.window_data_words = 0;
-  uint32_t num_coupons = 0;
-  double kxp = 0;
-  double hip_est_accum = 0;
+  compressed_image image;
+  image.lg_k = lg_k;
+  image.first_interesting_column = first_interesting_column;
+  image.has_hip = has_hip;
+  image.num_coupons = 0;
+  image.kxp = 0;
+  image.hip_est_accum = 0;
+  image.table_data = nullptr;
+  image.table_data_words = 0;
+  image.table_num_entries = 0;
+  image.window_data = nullptr;
+  image.window_data_words = 0;
+  // the window and table data are read into one buffer and decoded from there
+  vector_u32<A> words(allocator);
   if (has_table || has_window) {
-    num_coupons = read<uint32_t>(is);
+    image.num_coupons = read<uint32_t>(is);
     if (has_table && has_window) {
-      compressed.table_num_entries = read<uint32_t>(is);
+      image.table_num_entries = read<uint32_t>(is);
       if (has_hip) {
-        kxp = read<double>(is);
-        hip_est_accum = read<double>(is);
+        image.kxp = read<double>(is);
+        image.hip_est_accum = read<double>(is);
       }
     }
     if (has_table) {
-      compressed.table_data_words = read<uint32_t>(is);
+      image.table_data_words = read<uint32_t>(is);
     }
     if (has_window) {
-      compressed.window_data_words = read<uint32_t>(is);
+      image.window_data_words = read<uint32_t>(is);
     }
     if (has_hip && !(has_table && has_window)) {
-      kxp = read<double>(is);
-      hip_est_accum = read<double>(is);
-    }
-    if (has_window) {
-      compressed.window_data.resize(compressed.window_data_words);
-      read(is, compressed.window_data.data(), compressed.window_data_words * sizeof(uint32_t));
-    }
-    if (has_table) {
-      compressed.table_data.resize(compressed.table_data_words);
-      read(is, compressed.table_data.data(), compressed.table_data_words * sizeof(uint32_t));
-    }
-    if (!has_window) compressed.table_num_entries = num_coupons;
+      image.kxp = read<double>(is);
+      image.hip_est_accum = read<double>(is);
+    }
+    words.resize(image.window_data_words + image.table_data_words);
+    read(is, words.data(), words.size() * sizeof(uint32_t));
+    if (has_window) image.window_data = reinterpret_cast<const char*>(words.data());
+    if (has_table) image.table_data = reinterpret_cast<const char*>(words.data() + image.window_data_words);
+    if (!has_window) image.table_num_entries = image.num_coupons;
   }
+  const uint32_t num_coupons = image.num_coupons;
 
   uint8_t expected_preamble_ints = get_preamble_ints(num_coupons, has_hip, has_table, has_window);
   if (preamble_ints != expected_preamble_ints) {
@@ -581,16 +766,25 @@ cpc_sketch_alloc<A> cpc_sketch_alloc<A>::deserialize(std::istream& is, uint64_t
     throw std::invalid_argument("Incompatible seed hashes: " + std::to_string(seed_hash) + ", "
         + std::to_string(compute_seed_hash(seed)));
   }
-  uncompressed_state<A> uncompressed(allocator);
-  get_compressor<A>().uncompress(compressed, uncompressed, lg_k, num_coupons);
   if (!is.good())
     throw std::runtime_error("error reading from std::istream"); 
+  uncompressed_state<A> uncompressed(allocator);
+  get_compressor<A>().uncompress(image, uncompressed);
   return cpc_sketch_alloc(lg_k, num_coupons, first_interesting_column, std::move(uncompressed.table),
-      std::move(uncompressed.window), has_hip, kxp, hip_est_accum, seed);
+      std::move(uncompressed.window), has_hip, image.kxp, image.hip_est_accum, seed);
 }
 
 template<typename A>
 cpc_sketch_alloc<A> cpc_sketch_alloc<A>::deserialize(const void* bytes, size_t size, uint64_t seed, const A& allocator) {
+  const compressed_image image = parse(bytes, size, seed);
+  uncompressed_state<A> uncompressed(allocator);
+  get_compressor<A>().uncompress(image, uncompressed);
+  return cpc_sketch_alloc(image.lg_k, image.num_coupons, image.first_interesting_column, std::move(uncompressed.table),
+      std::move(uncompressed.window), image.has_hip, image.kxp, image.hip_est_accum, seed);
+}
+
+template<typename A>
+compressed_image cpc_sketch_alloc<A>::parse(const void* bytes, size_t size, uint64_t seed) {
   ensure_minimum_memory(size, 8);
   const char* ptr = static_cast<const char*>(bytes);
   const char* base = static_cast<const char*>(bytes);
@@ -600,65 +794,65 @@ cpc_sketch_alloc<A> cpc_sketch_alloc<A>::deserialize(const void* bytes, size_t s
   ptr += copy_from_mem(ptr, serial_version);
   uint8_t family_id;
   ptr += copy_from_mem(ptr, family_id);
-  uint8_t lg_k;
-  ptr += copy_from_mem(ptr, lg_k);
-  uint8_t first_interesting_column;
-  ptr += copy_from_mem(ptr, first_interesting_column);
+  compressed_image image;
+  ptr += copy_from_mem(ptr, image.lg_k);
+  ptr += copy_from_mem(ptr, image.first_interesting_column);
   uint8_t flags_byte;
   ptr += copy_from_mem(ptr, flags_byte);
   uint16_t seed_hash;
   ptr += copy_from_mem(ptr, seed_hash);
-  const bool has_hip = flags_byte & (1 << flags::HAS_HIP);
+  image.has_hip = flags_byte & (1 << flags::HAS_HIP);
   const bool has_table = flags_byte & (1 << flags::HAS_TABLE);
   const bool has_window = flags_byte & (1 << flags::HAS_WINDOW);
   ensure_minimum_memory(size, preamble_ints << 2);
-  compressed_state<A> compressed(allocator);
-  compressed.table_data_words = 0;
-  compressed.table_num_entries = 0;
-  compressed.window_data_words = 0;
-  uint32_t num_coupons = 0;
-  double kxp = 0;
-  double hip_est_accum = 0;
+  image.num_coupons = 0;
+  image.kxp = 0;
+  image.hip_est_accum = 0;
+  image.table_data = nullptr;
+  image.table_data_words = 0;
+  image.table_num_entries = 0;
+  image.window_data = nullptr;
+  image.window_data_words = 0;
   if (has_table || has_window) {
-    check_memory_size(ptr - base + sizeof(num_coupons), size);
-    ptr += copy_from_mem(ptr, num_coupons);
+    check_memory_size(ptr - base + sizeof(image.num_coupons), size);
+    ptr += copy_from_mem(ptr, image.num_coupons);
     if (has_table && has_window) {
-      check_memory_size(ptr - base + sizeof(compressed.table_num_entries), size);
-      ptr += copy_from_mem(ptr, compressed.table_num_entries);
-      if (has_hip) {
-        check_memory_size(ptr - base + sizeof(kxp) + sizeof(hip_est_accum), size);
-        ptr += copy_from_mem(ptr, kxp);
-        ptr += copy_from_mem(ptr, hip_est_accum);
+      check_memory_size(ptr - base + sizeof(image.table_num_entries), size);
+      ptr += copy_from_mem(ptr, image.table_num_entries);
+      if (image.has_hip) {
+        check_memory_size(ptr - base + sizeof(image.kxp) + sizeof(image.hip_est_accum), size);
+        ptr += copy_from_mem(ptr, image.kxp);
+        ptr += copy_from_mem(ptr, image.hip_est_accum);
       }
     }
     if (has_table) {
-      check_memory_size(ptr - base + sizeof(compressed.table_data_words), size);
-      ptr += copy_from_mem(ptr, compressed.table_data_words);
+      check_memory_size(ptr - base + sizeof(image.table_data_words), size);
+      ptr += copy_from_mem(ptr, image.table_data_words);
     }
     if (has_window) {
-      check_memory_size(ptr - base + sizeof(compressed.window_data_words), size);
-      ptr += copy_from_mem(ptr, compressed.window_data_words);
+      check_memory_size(ptr - base + sizeof(image.window_data_words), size);
+      ptr += copy_from_mem(ptr, image.window_data_words);
     }
-    if (has_hip && !(has_table && has_window)) {
-      check_memory_size(ptr - base + sizeof(kxp) + sizeof(hip_est_accum), size);
-      ptr += copy_from_mem(ptr, kxp);
-      ptr += copy_from_mem(ptr, hip_est_accum);
+    if (image.has_hip && !(has_table && has_window)) {
+      check_memory_size(ptr - base + sizeof(image.kxp) + sizeof(image.hip_est_accum), size);
+      ptr += copy_from_mem(ptr, image.kxp);
+      ptr += copy_from_mem(ptr, image.hip_est_accum);
     }
     if (has_window) {
-      compressed.window_data.resize(compressed.window_data_words);
-      check_memory_size(ptr - base + (compressed.window_data_words * sizeof(uint32_t)), size);
-      ptr += copy_from_mem(ptr, compressed.window_data.data(), compressed.window_data_words * sizeof(uint32_t));
+      check_memory_size(ptr - base + (image.window_data_words * sizeof(uint32_t)), size);
+      image.window_data = ptr;
+      ptr += image.window_data_words * sizeof(uint32_t);
     }
     if (has_table) {
-      compressed.table_data.resize(compressed.table_data_words);
-      check_memory_size(ptr - base + (compressed.table_data_words * sizeof(uint32_t)), size);
-      ptr += copy_from_mem(ptr, compressed.table_data.data(), compressed.table_data_words * sizeof(uint32_t));
+      check_memory_size(ptr - base + (image.table_data_words * sizeof(uint32_t)), size);
+      image.table_data = ptr;
+      ptr += image.table_data_words * sizeof(uint32_t);
     }
-    if (!has_window) compressed.table_num_entries = num_coupons;
+    if (!has_window) image.table_num_entries = image.num_coupons;
   }
   if (ptr != static_cast<const char*>(bytes) + size) throw std::logic_error("deserialized size mismatch");
 
-  uint8_t expected_preamble_ints = get_preamble_ints(num_coupons, has_hip, has_table, has_window);
+  uint8_t expected_preamble_ints = get_preamble_ints(image.num_coupons, image.has_hip, has_table, has_window);
   if (preamble_ints != expected_preamble_ints) {
     throw std::invalid_argument("Possible corruption: preamble ints: expected "
         + std::to_string(expected_preamble_ints) + ", got " + std::to_string(preamble_ints));
@@ -675,40 +869,9 @@ cpc_sketch_alloc<A> cpc_sketch_alloc<A>::deserialize(const void* bytes, size_t s
     throw std::invalid_argument("Incompatible seed hashes: " + std::to_string(seed_hash) + ", "
         + std::to_string(compute_seed_hash(seed)));
   }
-  uncompressed_state<A> uncompressed(allocator);
-  get_compressor<A>().uncompress(compressed, uncompressed, lg_k, num_coupons);
-  return cpc_sketch_alloc(lg_k, num_coupons, first_interesting_column, std::move(uncompressed.table),
-      std::move(uncompressed.window), has_hip, kxp, hip_est_accum, seed);
+  return image;
 }
 
-/*
- * These empirical values for the 99.9th percentile of size in bytes were measured using 100,000
- * trials. The value for each trial is the maximum of 5*16=80 measurements that were equally
- * spaced over values of the quantity C/K between 3.0 and 8.0. This table does not include the
- * worst-case space for the preamble, which is added by the function.
- */
-static const uint8_t CPC_EMPIRICAL_SIZE_MAX_LGK = 19;
-static const size_t CPC_EMPIRICAL_MAX_SIZE_BYTES[]  = {
-    24,     // lg_k = 4
-    36,     // lg_k = 5
-    56,     // lg_k = 6
-    100,    // lg_k = 7
-    180,    // lg_k = 8
-    344,    // lg_k = 9
-    660,    // lg_k = 10
-    1292,   // lg_k = 11
-    2540,   // lg_k = 12
-    5020,   // lg_k = 13
-    9968,   // lg_k = 14
-    19836,  // lg_k = 15
-    39532,  // lg_k = 16
-    78880,  // lg_k = 17
-    157516, // lg_k = 18
-    314656  // lg_k = 19
-};
-static const double CPC_EMPIRICAL_MAX_SIZE_FACTOR = 0.6; // 0.6 = 4.8 / 8.0
-static const size_t CPC_MAX_PREAMBLE_SIZE_BYTES = 40;
-
 template<typename A>
 size_t cpc_sketch_alloc<A>::get_max_serialized_size_bytes(uint8_t lg_k) {
   check_lg_k(lg_k);
@@ -748,8 +911,12 @@ sliding_window(std::move(window)),
 window_offset(determine_correct_offset(lg_k, num_coupons)),
 first_interesting_column(first_interesting_column),
 kxp(kxp),
-hip_est_accum(hip_est_accum)
-{}
+hip_est_accum(hip_est_accum),
+surprises_buffer(sliding_window.get_allocator()),
+peak_storage_bytes(0)
+{
+  update_peak_storage();
+}
 
 template<typename A>
 uint8_t cpc_sketch_alloc<A>::get_preamble_ints(uint32_t num_coupons, bool has_hip, bool has_table, bool has_window) {
@@ -833,12 +1000,6 @@ vector_u64<A> cpc_sketch_alloc<A>::build_bit_matrix() const {
   return matrix;
 }
 
-template<typename A>
-void cpc_sketch_alloc<A>::write_hip(std::ostream& os) const {
-  write(os, kxp);
-  write(os, hip_est_accum);
-}
-
 template<typename A>
 size_t cpc_sketch_alloc<A>::copy_hip_to_mem(void* dst) const {
   memcpy(dst, &kxp, sizeof(kxp));
@@ -66,6 +66,36 @@ public:
    */
   void update(cpc_sketch_alloc<A>&& sketch);
 
+  /**
+   * This method is to update the union with a serialized sketch.
+   * The compressed data is merged directly into the union without deserializing the sketch,
+   * which is considerably faster than deserializing it first.
+   * @param bytes pointer to the serialized sketch
+   * @param size the size of the serialized sketch
+   */
+  void update(const void* bytes, size_t size);
+
+  /**
+   * This method is to update the union with a range of sketches, spreading the work over
+   * the given number of threads.
+   *
+   * <p>The smallest lg_k among the non-empty sketches is found up front, so that the union is
+   * reduced at most once instead of in the middle of the stream. The range is then split into
+   * contiguous chunks, each of which goes into a separate union on its own thread, and the partial
+   * results are merged into this union at the end. Since the union of coupons does not depend
+   * on the order of the sketches, the result is the same as after updating with each sketch in turn.
+   *
+   * <p>The sketches must not be modified while this method runs. If a worker throws,
+   * the exception is rethrown here once all threads have finished, and the state
+   * of this union is unspecified.
+   *
+   * @param first iterator to the first sketch
+   * @param last iterator past the last sketch, must be a forward iterator
+   * @param num_threads number of threads to use, including the calling thread
+   */
+  template<typename ForwardIt>
+  void update_parallel(ForwardIt first, ForwardIt last, unsigned num_threads);
+
   /**
    * This method produces a copy of the current state of the union as a sketch.
    * @return the result of the union
@@ -81,8 +111,12 @@ private:
   uint64_t seed;
   cpc_sketch_alloc<A>* accumulator;
   vector_u64<A> bit_matrix;
+  // reused to decode serialized sketches
+  vector_u32<A> pairs_buffer;
+  vector_u8<A> window_buffer;
 
   template<typename S> void internal_update(S&& sketch); // to support both rvalue and lvalue
+  void merge_partial(const cpc_union_alloc<A>& partial);
 
   cpc_sketch_alloc<A> get_result_from_accumulator() const;
   cpc_sketch_alloc<A> get_result_from_bit_matrix() const;
@@ -90,8 +124,14 @@ private:
   void switch_to_bit_matrix();
   void walk_table_updating_sketch(const u32_table<A>& table);
   void or_table_into_matrix(const u32_table<A>& table);
-  void or_window_into_matrix(const vector_u8<A>& sliding_window, uint8_t offset, uint8_t src_lg_k);
+  void or_window_into_matrix(const uint8_t* sliding_window, uint8_t offset, uint8_t src_lg_k);
+  void or_window_rows(const uint8_t* sliding_window, uint8_t offset, uint64_t default_row, uint32_t src_start, uint32_t src_end);
   void or_matrix_into_matrix(const vector_u64<A>& src_matrix, uint8_t src_lg_k);
+  void walk_pairs_updating_sketch(const uint32_t* pairs, uint32_t num_pairs);
+  void or_pairs_into_matrix(const uint32_t* pairs, uint32_t num_pairs);
+  void or_sliding_into_matrix(const uint8_t* sliding_window, uint8_t offset, const uint32_t* pairs, uint32_t num_pairs, uint8_t src_lg_k);
+  uint32_t uncompress_pairs(const compressed_image& image);
+  void uncompress_window(const compressed_image& image);
   void reduce_k(uint8_t new_lg_k);
 };
 
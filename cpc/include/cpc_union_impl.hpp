@@ -21,7 +21,11 @@
 #define CPC_UNION_IMPL_HPP_
 
 #include "count_zeros.hpp"
+#include "run_parallel.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <stdexcept>
 
 namespace datasketches {
@@ -31,7 +35,9 @@ cpc_union_alloc<A>::cpc_union_alloc(uint8_t lg_k, uint64_t seed, const A& alloca
 lg_k(lg_k),
 seed(seed),
 accumulator(nullptr),
-bit_matrix(allocator)
+bit_matrix(allocator),
+pairs_buffer(allocator),
+window_buffer(allocator)
 {
   if (lg_k < CPC_MIN_LG_K || lg_k > CPC_MAX_LG_K) {
     throw std::invalid_argument("lg_k must be >= " + std::to_string(CPC_MIN_LG_K) + " and <= " + std::to_string(CPC_MAX_LG_K) + ": " + std::to_string(lg_k));
@@ -44,7 +50,9 @@ cpc_union_alloc<A>::cpc_union_alloc(const cpc_union_alloc<A>& other):
 lg_k(other.lg_k),
 seed(other.seed),
 accumulator(other.accumulator),
-bit_matrix(other.bit_matrix)
+bit_matrix(other.bit_matrix),
+pairs_buffer(other.pairs_buffer.get_allocator()),
+window_buffer(other.window_buffer.get_allocator())
 {
   if (accumulator != nullptr) {
     accumulator = new (AllocCpc(accumulator->get_allocator()).allocate(1)) cpc_sketch_alloc<A>(*other.accumulator);
@@ -56,7 +64,9 @@ cpc_union_alloc<A>::cpc_union_alloc(cpc_union_alloc<A>&& other) noexcept:
 lg_k(other.lg_k),
 seed(other.seed),
 accumulator(other.accumulator),
-bit_matrix(std::move(other.bit_matrix))
+bit_matrix(std::move(other.bit_matrix)),
+pairs_buffer(std::move(other.pairs_buffer)),
+window_buffer(std::move(other.window_buffer))
 {
   other.accumulator = nullptr;
 }
@@ -158,7 +168,7 @@ void cpc_union_alloc<A>::internal_update(S&& sketch) {
   if (bit_matrix.size() == 0) throw std::logic_error("union bit_matrix is expected");
 
   if (cpc_sketch_alloc<A>::flavor::HYBRID == src_flavor || cpc_sketch_alloc<A>::flavor::PINNED == src_flavor) { // Case C
-    or_window_into_matrix(sketch.sliding_window, sketch.window_offset, sketch.get_lg_k());
+    or_window_into_matrix(sketch.sliding_window.data(), sketch.window_offset, sketch.get_lg_k());
     or_table_into_matrix(sketch.surprising_value_table);
     return;
   }
@@ -170,6 +180,131 @@ void cpc_union_alloc<A>::internal_update(S&& sketch) {
   or_matrix_into_matrix(src_matrix, sketch.get_lg_k());
 }
 
+// This follows the cases of internal_update(), but the compressed data of the sketch
+// is decoded straight into the union instead of into a table and a window of a new sketch.
+template<typename A>
+void cpc_union_alloc<A>::update(const void* bytes, size_t size) {
+  const compressed_image image = cpc_sketch_alloc<A>::parse(bytes, size, seed);
+  const auto src_flavor = cpc_sketch_alloc<A>::determine_flavor(image.lg_k, image.num_coupons);
+  if (cpc_sketch_alloc<A>::flavor::EMPTY == src_flavor) return;
+  cpc_sketch_alloc<A>::check_lg_k(image.lg_k);
+
+  if (image.lg_k < lg_k) reduce_k(image.lg_k);
+  if (image.lg_k < lg_k) throw std::logic_error("sketch lg_k < union lg_k");
+
+  if (accumulator == nullptr && bit_matrix.size() == 0) throw std::logic_error("both accumulator and bit matrix are absent");
+
+  if (cpc_sketch_alloc<A>::flavor::SPARSE == src_flavor && accumulator != nullptr)  { // Case A
+    if (bit_matrix.size() > 0) throw std::logic_error("union bit_matrix is not expected");
+    const auto initial_dest_flavor = accumulator->determine_flavor();
+    if (cpc_sketch_alloc<A>::flavor::EMPTY != initial_dest_flavor &&
+        cpc_sketch_alloc<A>::flavor::SPARSE != initial_dest_flavor) throw std::logic_error("wrong flavor");
+
+    // The accumulator needs a table anyway, so this is the same as in internal_update()
+    if (cpc_sketch_alloc<A>::flavor::EMPTY == initial_dest_flavor && lg_k == image.lg_k) {
+      *accumulator = cpc_sketch_alloc<A>::deserialize(bytes, size, seed, accumulator->get_allocator());
+      return;
+    }
+
+    walk_pairs_updating_sketch(pairs_buffer.data(), uncompress_pairs(image));
+    const auto final_dst_flavor = accumulator->determine_flavor();
+    // if the accumulator has graduated beyond sparse, switch to a bit matrix representation
+    if (final_dst_flavor != cpc_sketch_alloc<A>::flavor::EMPTY && final_dst_flavor != cpc_sketch_alloc<A>::flavor::SPARSE) {
+      switch_to_bit_matrix();
+    }
+    return;
+  }
+
+  if (cpc_sketch_alloc<A>::flavor::SPARSE == src_flavor && bit_matrix.size() > 0)  { // Case B
+    if (accumulator != nullptr) throw std::logic_error("union accumulator != null");
+    or_pairs_into_matrix(pairs_buffer.data(), uncompress_pairs(image));
+    return;
+  }
+
+  if (cpc_sketch_alloc<A>::flavor::HYBRID != src_flavor && cpc_sketch_alloc<A>::flavor::PINNED != src_flavor
+      && cpc_sketch_alloc<A>::flavor::SLIDING != src_flavor) throw std::logic_error("wrong flavor");
+
+  // source is past SPARSE mode, so make sure that dest is a bit matrix
+  if (accumulator != nullptr) {
+    if (bit_matrix.size() > 0) throw std::logic_error("union bit matrix is not expected");
+    const auto dst_flavor = accumulator->determine_flavor();
+    if (cpc_sketch_alloc<A>::flavor::EMPTY != dst_flavor && cpc_sketch_alloc<A>::flavor::SPARSE != dst_flavor) {
+      throw std::logic_error("wrong flavor");
+    }
+    switch_to_bit_matrix();
+  }
+  if (bit_matrix.size() == 0) throw std::logic_error("union bit_matrix is expected");
+
+  if (cpc_sketch_alloc<A>::flavor::HYBRID == src_flavor) { // Case C, the window bits are stored as pairs
+    or_pairs_into_matrix(pairs_buffer.data(), uncompress_pairs(image));
+    return;
+  }
+
+  uncompress_window(image);
+  const uint32_t num_pairs = uncompress_pairs(image);
+  const uint8_t offset = cpc_sketch_alloc<A>::determine_correct_offset(image.lg_k, image.num_coupons);
+  if (cpc_sketch_alloc<A>::flavor::PINNED == src_flavor) { // Case C
+    or_window_into_matrix(window_buffer.data(), offset, image.lg_k);
+    or_pairs_into_matrix(pairs_buffer.data(), num_pairs);
+    return;
+  }
+
+  // Case D, the rows of the source bit matrix are built one at a time
+  or_sliding_into_matrix(window_buffer.data(), offset, pairs_buffer.data(), num_pairs, image.lg_k);
+}
+
+template<typename A>
+template<typename ForwardIt>
+void cpc_union_alloc<A>::update_parallel(ForwardIt first, ForwardIt last, unsigned num_threads) {
+  if (num_threads == 0) throw std::invalid_argument("num_threads must be positive");
+
+  // empty sketches are skipped by update(), so they do not reduce the union either
+  size_t num_sketches = 0;
+  uint8_t min_lg_k = lg_k;
+  for (ForwardIt it = first; it != last; ++it) {
+    ++num_sketches;
+    if (!it->is_empty()) min_lg_k = std::min(min_lg_k, it->get_lg_k());
+  }
+  if (num_sketches == 0) return;
+  if (min_lg_k < lg_k) reduce_k(min_lg_k);
+  if (num_threads > num_sketches) num_threads = static_cast<unsigned>(num_sketches);
+
+  using AllocUnion = typename std::allocator_traits<A>::template rebind_alloc<cpc_union_alloc>;
+  using AllocIt = typename std::allocator_traits<A>::template rebind_alloc<ForwardIt>;
+  const A allocator = bit_matrix.get_allocator();
+  // the range is split into one contiguous chunk per thread
+  std::vector<ForwardIt, AllocIt> chunk_bounds(allocator);
+  chunk_bounds.reserve(num_threads + 1);
+  chunk_bounds.push_back(first);
+  size_t remaining = num_sketches;
+  for (unsigned i = 0; i < num_threads; ++i) {
+    const size_t chunk_size = remaining / (num_threads - i);
+    chunk_bounds.push_back(std::next(chunk_bounds.back(), chunk_size));
+    remaining -= chunk_size;
+  }
+  std::vector<cpc_union_alloc, AllocUnion> partials(allocator);
+  partials.reserve(num_threads);
+  for (unsigned i = 0; i < num_threads; ++i) partials.emplace_back(lg_k, seed, allocator);
+  run_parallel(num_threads, num_threads, [&partials, &chunk_bounds](size_t i) {
+    for (ForwardIt it = chunk_bounds[i]; it != chunk_bounds[i + 1]; ++it) partials[i].update(*it);
+  }, allocator);
+
+  for (const auto& partial: partials) merge_partial(partial);
+}
+
+// The partial union has the same lg_k as this one. A sparse accumulator is merged like a sparse sketch,
+// and a bit matrix forces this union into the bit matrix mode, as any sketch past the sparse flavor would.
+template<typename A>
+void cpc_union_alloc<A>::merge_partial(const cpc_union_alloc<A>& partial) {
+  if (partial.lg_k != lg_k) throw std::logic_error("partial lg_k != union lg_k");
+  if (partial.accumulator != nullptr) {
+    internal_update(*partial.accumulator);
+    return;
+  }
+  if (accumulator != nullptr) switch_to_bit_matrix();
+  or_matrix_into_matrix(partial.bit_matrix, lg_k);
+}
+
 template<typename A>
 cpc_sketch_alloc<A> cpc_union_alloc<A>::get_result() const {
   if (accumulator != nullptr) {
@@ -289,22 +424,130 @@ void cpc_union_alloc<A>::or_table_into_matrix(const u32_table<A>& table) {
 }
 
 template<typename A>
-void cpc_union_alloc<A>::or_window_into_matrix(const vector_u8<A>& sliding_window, uint8_t offset, uint8_t src_lg_k) {
+void cpc_union_alloc<A>::walk_pairs_updating_sketch(const uint32_t* pairs, uint32_t num_pairs) {
+  const uint64_t dst_mask = (((1 << accumulator->get_lg_k()) - 1) << 6) | 63; // downsamples when dst lgK < src LgK
+
+  // The pairs are sorted, so they are walked with a golden ratio stride as in walk_table_updating_sketch().
+  // The stride goes over a power of 2 range, and the indices beyond the pairs are skipped.
+  uint32_t num_slots = 8;
+  while (num_slots < num_pairs) num_slots <<= 1;
+  const double golden = 0.6180339887498949025;
+  const uint32_t stride = static_cast<uint32_t>(golden * static_cast<double>(num_slots)) | 1; // force the stride to be odd
+
+  for (uint32_t i = 0, j = 0; i < num_slots; i++, j += stride) {
+    j &= num_slots - 1;
+    if (j < num_pairs) {
+      accumulator->row_col_update(pairs[j] & dst_mask);
+    }
+  }
+}
+
+template<typename A>
+void cpc_union_alloc<A>::or_pairs_into_matrix(const uint32_t* pairs, uint32_t num_pairs) {
+  const uint64_t dest_mask = (1 << lg_k) - 1;  // downsamples when dst lgK < sr LgK
+  for (uint32_t i = 0; i < num_pairs; i++) {
+    const uint32_t row_col = pairs[i];
+    const uint8_t col = row_col & 63;
+    const uint32_t row = row_col >> 6;
+    bit_matrix[row & dest_mask] |= static_cast<uint64_t>(1) << col; // set the bit
+  }
+}
+
+template<typename A>
+void cpc_union_alloc<A>::or_sliding_into_matrix(const uint8_t* sliding_window, uint8_t offset, const uint32_t* pairs,
+    uint32_t num_pairs, uint8_t src_lg_k) {
   if (lg_k > src_lg_k) throw std::logic_error("dst LgK > src LgK");
-  const uint64_t dst_mask = (1 << lg_k) - 1; // downsamples when dst lgK < src LgK
+  if (offset > 56) throw std::logic_error("offset > 56");
+  const uint32_t dst_mask = (1 << lg_k) - 1; // downsamples when dst lgK < src LgK
   const uint32_t src_k = 1 << src_lg_k;
-  for (uint32_t src_row = 0; src_row < src_k; src_row++) {
-    bit_matrix[src_row & dst_mask] |= static_cast<uint64_t>(sliding_window[src_row]) << offset;
+  // the same rows as in cpc_sketch::build_bit_matrix(), which relies on the pairs being sorted by row here
+  const uint64_t default_row = (static_cast<uint64_t>(1) << offset) - 1;
+  uint32_t src_row = 0;
+  for (uint32_t i = 0; i < num_pairs; ) {
+    const uint32_t pair_row = pairs[i] >> 6;
+    if (pair_row >= src_k || pair_row < src_row) throw std::logic_error("pairs are not sorted by row");
+    or_window_rows(sliding_window, offset, default_row, src_row, pair_row); // rows without surprises
+    uint64_t pattern = default_row | (static_cast<uint64_t>(sliding_window[pair_row]) << offset);
+    for (; i < num_pairs && (pairs[i] >> 6) == pair_row; i++) {
+      pattern ^= static_cast<uint64_t>(1) << (pairs[i] & 63); // flip the bit from its default value
+    }
+    bit_matrix[pair_row & dst_mask] |= pattern;
+    src_row = pair_row + 1;
+  }
+  or_window_rows(sliding_window, offset, default_row, src_row, src_k);
+}
+
+// returns the number of pairs in pairs_buffer
+template<typename A>
+uint32_t cpc_union_alloc<A>::uncompress_pairs(const compressed_image& image) {
+  const uint32_t num_pairs = image.table_num_entries;
+  if (num_pairs == 0) return 0;
+  if (image.table_data == nullptr) throw std::logic_error("table is expected");
+  if (pairs_buffer.size() < num_pairs) pairs_buffer.resize(num_pairs);
+  // the compressed words are decoded in place unless they are misaligned
+  vector_u32<A> words(pairs_buffer.get_allocator());
+  const uint32_t* data = reinterpret_cast<const uint32_t*>(image.table_data);
+  if (reinterpret_cast<uintptr_t>(image.table_data) % alignof(uint32_t) != 0) {
+    words.resize(image.table_data_words);
+    std::memcpy(words.data(), image.table_data, image.table_data_words * sizeof(uint32_t));
+    data = words.data();
+  }
+  get_compressor<A>().uncompress_pairs(data, image.table_data_words, num_pairs, pairs_buffer.data(), image.lg_k, image.num_coupons);
+  return num_pairs;
+}
+
+// decodes the window into window_buffer
+template<typename A>
+void cpc_union_alloc<A>::uncompress_window(const compressed_image& image) {
+  if (image.window_data == nullptr) throw std::logic_error("window is expected");
+  window_buffer.resize(1 << image.lg_k);
+  vector_u32<A> words(window_buffer.get_allocator());
+  const uint32_t* data = reinterpret_cast<const uint32_t*>(image.window_data);
+  if (reinterpret_cast<uintptr_t>(image.window_data) % alignof(uint32_t) != 0) {
+    words.resize(image.window_data_words);
+    std::memcpy(words.data(), image.window_data, image.window_data_words * sizeof(uint32_t));
+    data = words.data();
+  }
+  get_compressor<A>().uncompress_window(data, image.window_data_words, window_buffer.data(), image.lg_k, image.num_coupons);
+}
+
+template<typename A>
+void cpc_union_alloc<A>::or_window_into_matrix(const uint8_t* sliding_window, uint8_t offset, uint8_t src_lg_k) {
+  if (lg_k > src_lg_k) throw std::logic_error("dst LgK > src LgK");
+  or_window_rows(sliding_window, offset, 0, 0, 1 << src_lg_k);
+}
+
+// ORs the given rows of a window shifted by offset and combined with default_row into the matrix
+template<typename A>
+void cpc_union_alloc<A>::or_window_rows(const uint8_t* sliding_window, uint8_t offset, uint64_t default_row,
+    uint32_t src_start, uint32_t src_end) {
+  const uint32_t dst_mask = (1 << lg_k) - 1;
+  uint64_t* dst = bit_matrix.data();
+  // downsamples when dst lgK < src LgK, one block of contiguous dst rows at a time, so that the inner loop vectorizes
+  while (src_start < src_end) {
+    const uint32_t block_end = std::min(src_end, (src_start | dst_mask) + 1);
+    uint64_t* block = dst + (src_start & dst_mask);
+    const uint8_t* src = sliding_window + src_start;
+    const uint32_t num_rows = block_end - src_start;
+    for (uint32_t row = 0; row < num_rows; row++) {
+      block[row] |= default_row | (static_cast<uint64_t>(src[row]) << offset);
+    }
+    src_start = block_end;
   }
 }
 
 template<typename A>
 void cpc_union_alloc<A>::or_matrix_into_matrix(const vector_u64<A>& src_matrix, uint8_t src_lg_k) {
   if (lg_k > src_lg_k) throw std::logic_error("dst LgK > src LgK");
-  const uint64_t dst_mask = (1 << lg_k) - 1; // downsamples when dst lgK < src LgK
+  const uint32_t dst_k = 1 << lg_k;
   const uint32_t src_k = 1 << src_lg_k;
-  for (uint32_t src_row = 0; src_row < src_k; src_row++) {
-    bit_matrix[src_row & dst_mask] |= src_matrix[src_row];
+  uint64_t* dst = bit_matrix.data();
+  // downsamples when dst lgK < src LgK, one block of dst_k rows at a time, so that the inner loop vectorizes
+  for (uint32_t src_start = 0; src_start < src_k; src_start += dst_k) {
+    const uint64_t* src = src_matrix.data() + src_start;
+    for (uint32_t row = 0; row < dst_k; row++) {
+      dst[row] |= src[row];
+    }
   }
 }
 
@@ -47,6 +47,16 @@ public:
   inline uint8_t get_lg_size() const;
   inline void clear();
 
+  // Keeps storage for up to 2^lg_size slots, including the storage needed to rebuild the table,
+  // so that the table does not allocate memory while it stays within this size.
+  void reserve(uint8_t lg_size);
+  // bytes of storage held by the table
+  size_t get_storage_bytes() const;
+
+  // removes the items for which the predicate is true and resizes the table for the remaining items
+  template<typename Predicate>
+  void erase_if(Predicate pred);
+
   // returns true iff the item was new and was therefore added to the table
   inline bool maybe_insert(uint32_t item);
   // returns true iff the item was present and was therefore removed from the table
@@ -70,10 +80,13 @@ private:
   uint8_t lg_size; // log2 of number of slots
   uint8_t num_valid_bits;
   uint32_t num_items;
+  uint8_t reserved_lg_size; // 0 if no storage is reserved
   vector_u32<A> slots;
+  vector_u32<A> spare; // reused by rebuilds up to the reserved size
 
   inline uint32_t lookup(uint32_t item) const;
   inline void must_insert(uint32_t item);
+  void must_insert_all(const uint32_t* items, size_t num);
   inline void rebuild(uint8_t new_lg_size);
 };
 
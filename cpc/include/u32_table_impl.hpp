@@ -33,7 +33,9 @@ u32_table<A>::u32_table(const A& allocator):
 lg_size(0),
 num_valid_bits(0),
 num_items(0),
-slots(allocator)
+reserved_lg_size(0),
+slots(allocator),
+spare(allocator)
 {}
 
 template<typename A>
@@ -41,7 +43,9 @@ u32_table<A>::u32_table(uint8_t lg_size, uint8_t num_valid_bits, const A& alloca
 lg_size(lg_size),
 num_valid_bits(num_valid_bits),
 num_items(0),
-slots(1ULL << lg_size, UINT32_MAX, allocator)
+reserved_lg_size(0),
+slots(1ULL << lg_size, UINT32_MAX, allocator),
+spare(allocator)
 {
   if (lg_size < 2) throw std::invalid_argument("lg_size must be >= 2");
   if (num_valid_bits < 1 || num_valid_bits > 32) throw std::invalid_argument("num_valid_bits must be between 1 and 32");
@@ -68,6 +72,46 @@ void u32_table<A>::clear() {
   num_items = 0;
 }
 
+template<typename A>
+void u32_table<A>::reserve(uint8_t lg_size) {
+  if (lg_size < 2) throw std::invalid_argument("lg_size must be >= 2");
+  reserved_lg_size = std::max(reserved_lg_size, lg_size);
+  slots.reserve(1ULL << reserved_lg_size);
+  spare.reserve(1ULL << reserved_lg_size);
+}
+
+template<typename A>
+size_t u32_table<A>::get_storage_bytes() const {
+  return (slots.capacity() + spare.capacity()) * sizeof(uint32_t);
+}
+
+template<typename A>
+template<typename Predicate>
+void u32_table<A>::erase_if(Predicate pred) {
+  // the remaining items are collected in the spare storage, or in a temporary vector if nothing is reserved
+  vector_u32<A> remaining(spare.get_allocator());
+  if (reserved_lg_size > 0) std::swap(remaining, spare);
+  remaining.clear();
+  remaining.reserve(num_items);
+  const uint32_t size = 1 << lg_size;
+  for (uint32_t i = 0; i < size; i++) {
+    if (slots[i] != UINT32_MAX && !pred(slots[i])) remaining.push_back(slots[i]);
+  }
+
+  // the same size as the table would grow to by inserting the remaining items one by one
+  uint8_t new_lg_size = 2;
+  while (U32_TABLE_UPSIZE_DENOM * remaining.size() > U32_TABLE_UPSIZE_NUMER * (1ULL << new_lg_size)) new_lg_size++;
+  if (new_lg_size <= reserved_lg_size) {
+    slots.assign(1ULL << new_lg_size, UINT32_MAX);
+  } else {
+    slots = vector_u32<A>(1ULL << new_lg_size, UINT32_MAX, slots.get_allocator());
+  }
+  lg_size = new_lg_size;
+  for (uint32_t item: remaining) must_insert(item);
+  num_items = static_cast<uint32_t>(remaining.size());
+  if (reserved_lg_size > 0) std::swap(remaining, spare);
+}
+
 template<typename A>
 bool u32_table<A>::maybe_insert(uint32_t item) {
   const uint32_t index = lookup(item);
@@ -114,11 +158,9 @@ u32_table<A> u32_table<A>::make_from_pairs(const uint32_t* pairs, uint32_t num_p
   uint8_t lg_num_slots = 2;
   while (U32_TABLE_UPSIZE_DENOM * num_pairs > U32_TABLE_UPSIZE_NUMER * (1 << lg_num_slots)) lg_num_slots++;
   u32_table<A> table(lg_num_slots, 6 + lg_k, allocator);
-  // Note: there is a possible "snowplow effect" here because the caller is passing in a sorted pairs array
-  // However, we are starting out with the correct final table size, so the problem might not occur
-  for (size_t i = 0; i < num_pairs; i++) {
-    table.must_insert(pairs[i]);
-  }
+  // The caller is passing in a sorted pairs array, which would cause a "snowplow effect" with probing,
+  // but in that order almost all of them are placed without it
+  table.must_insert_all(pairs, num_pairs);
   table.num_items = num_pairs;
   return table;
 }
@@ -145,12 +187,51 @@ void u32_table<A>::must_insert(uint32_t item) {
   slots[index] = item;
 }
 
+// Places the items exactly where inserting them one by one would, and counts must be handled by the caller.
+// The items are expected to come in the order of their home slots, as they do in a sorted array
+// since the home slot is a prefix of the item. Such an item goes either to its home slot
+// or right after the previous one because all slots in between are taken, so no probing is needed.
+// The rest of the items, including the ones that wrap around the end of the table, are probed for as usual.
+template<typename A>
+void u32_table<A>::must_insert_all(const uint32_t* items, size_t num) {
+  const uint32_t size = 1 << lg_size;
+  const uint8_t shift = num_valid_bits - lg_size;
+  uint32_t prev_home = 0;
+  uint32_t next_index = 0; // right after the previous item placed in order
+  for (size_t i = 0; i < num; i++) {
+    const uint32_t item = items[i];
+    if (i > 0 && item == items[i - 1]) throw std::logic_error("item exists");
+    const uint32_t home = item >> shift;
+    const uint32_t index = std::max(home, next_index);
+    if (home >= prev_home && index < size && slots[index] == UINT32_MAX) {
+      slots[index] = item;
+      prev_home = home;
+      next_index = index + 1;
+    } else {
+      must_insert(item);
+    }
+  }
+}
+
 template<typename A>
 void u32_table<A>::rebuild(uint8_t new_lg_size) {
   if (new_lg_size < 2) throw std::logic_error("lg_size must be >= 2");
   const uint32_t old_size = 1 << lg_size;
   const uint32_t new_size = 1 << new_lg_size;
   if (new_size <= num_items) throw std::logic_error("new_size <= num_items");
+  if (new_lg_size <= reserved_lg_size) {
+    // the old slots go to the spare storage, and the new ones are made in the storage that was there
+    spare.assign(new_size, UINT32_MAX);
+    std::swap(slots, spare);
+    lg_size = new_lg_size;
+    for (uint32_t i = 0; i < old_size; i++) {
+      if (spare[i] != UINT32_MAX) {
+        must_insert(spare[i]);
+      }
+    }
+    spare.clear();
+    return;
+  }
   vector_u32<A> old_slots = std::move(slots);
   slots = vector_u32<A>(new_size, UINT32_MAX, old_slots.get_allocator());
   lg_size = new_lg_size;
@@ -19,8 +19,12 @@
 
 #include <catch2/catch.hpp>
 #include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
 
 #include "cpc_compressor.hpp"
+#include "cpc_sketch.hpp"
 
 namespace datasketches {
 
@@ -64,4 +68,70 @@ TEST_CASE("cpc sketch: compress and decompress pairs", "[cpc_sketch]") {
   }
 }
 
+TEST_CASE("cpc sketch: compress and decompress pairs with long unary codes", "[cpc_sketch]") {
+  // rows far apart give unary codes longer than a byte and longer than a word
+  std::vector<uint32_t> pairs;
+  uint32_t row = 0;
+  for (uint32_t i = 0; i < 100; i++) {
+    row += (i % 10 == 0) ? 5000 : i * 3;
+    pairs.push_back((row << 6) | (i * 7 % 64));
+  }
+  const uint32_t num_pairs = static_cast<uint32_t>(pairs.size());
+  std::vector<uint32_t> compressed_words(num_pairs * 80);
+  std::vector<uint32_t> pairs2(num_pairs);
+  for (uint8_t num_base_bits = 0; num_base_bits <= 14; num_base_bits++) {
+    const uint32_t num_words = get_compressor<std::allocator<void>>().low_level_compress_pairs(pairs.data(), num_pairs, num_base_bits, compressed_words.data());
+    get_compressor<std::allocator<void>>().low_level_uncompress_pairs(pairs2.data(), num_pairs, num_base_bits, compressed_words.data(), num_words);
+    REQUIRE(pairs2 == pairs);
+  }
+}
+
+TEST_CASE("cpc sketch: table from pairs same as inserting one by one", "[cpc_sketch]") {
+  const uint8_t lg_k = 10;
+  // clusters at the end of the table wrap around to the beginning
+  for (uint32_t cluster_start: {0u, 900u, 1000u}) {
+    std::vector<uint32_t> pairs;
+    for (uint32_t row = 0; row < (1u << lg_k); row += 7) pairs.push_back((row << 6) | (row % 64));
+    for (uint32_t row = cluster_start; row < (1u << lg_k); row++) {
+      for (uint32_t col: {3u, 17u, 40u}) pairs.push_back((row << 6) | col);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    // only the order of the home slots matters, which are determined by the rows
+    for (bool reverse_columns: {false, true}) {
+      if (reverse_columns) {
+        std::sort(pairs.begin(), pairs.end(), [](uint32_t a, uint32_t b) { return (a >> 6) != (b >> 6) ? a < b : a > b; });
+      }
+      const uint32_t num_pairs = static_cast<uint32_t>(pairs.size());
+      auto t1 = table::make_from_pairs(pairs.data(), num_pairs, lg_k, std::allocator<void>());
+      table t2(t1.get_lg_size(), 6 + lg_k, std::allocator<void>());
+      for (uint32_t pair: pairs) REQUIRE(t2.maybe_insert(pair));
+      REQUIRE(t1.get_lg_size() == t2.get_lg_size());
+      REQUIRE(t1.get_num_items() == num_pairs);
+      REQUIRE(std::equal(t1.get_slots(), t1.get_slots() + (1 << t1.get_lg_size()), t2.get_slots()));
+    }
+  }
+}
+
+// not run by default, use the [benchmark] tag to run it
+TEST_CASE("cpc sketch: decompression throughput", "[.][benchmark]") {
+  const uint8_t lg_k = 16;
+  // sparse, hybrid, pinned and sliding flavors
+  for (uint64_t n: {10000ULL, 100000ULL, 300000ULL, 3000000ULL}) {
+    cpc_sketch sketch(lg_k);
+    for (uint64_t i = 0; i < n; ++i) sketch.update(i);
+    const auto bytes = sketch.serialize();
+    const int num_trials = 200;
+    double estimate = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_trials; ++i) {
+      estimate += cpc_sketch::deserialize(bytes.data(), bytes.size()).get_estimate();
+    }
+    const double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / num_trials;
+    std::cout << "lg_k=" << static_cast<int>(lg_k) << " n=" << n << ": " << bytes.size() << " bytes, "
+              << us << " us per deserialize" << std::endl;
+    REQUIRE(estimate / num_trials == Approx(n).epsilon(0.02));
+  }
+}
+
 } /* namespace datasketches */
@@ -21,6 +21,8 @@
 #include <cstring>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <vector>
 
 #include <catch2/catch.hpp>
 
@@ -235,6 +237,82 @@ TEST_CASE("cpc sketch allocation: serialize deserialize sliding, bytes", "[cpc_s
   REQUIRE(test_allocator_net_allocations == 0);
 }
 
+TEST_CASE("cpc sketch allocation: reserved storage", "[cpc_sketch]") {
+  for (uint8_t lg_k: {4, 5, 6, 8, 11, 14}) {
+    test_allocator_total_bytes = 0;
+    test_allocator_net_allocations = 0;
+    {
+      cpc_sketch_test_alloc sketch(lg_k, DEFAULT_SEED, 0);
+      sketch.reserve();
+      const long long reserved_bytes = test_allocator_total_bytes;
+      const long long reserved_allocations = test_allocator_net_allocations;
+      REQUIRE(sketch.get_peak_storage_bytes() == static_cast<size_t>(reserved_bytes));
+      // through all flavors up to sliding with many window moves
+      const int n = 100 << lg_k;
+      for (int i = 0; i < n; i++) {
+        sketch.update(i);
+        REQUIRE(test_allocator_total_bytes == reserved_bytes);
+        REQUIRE(test_allocator_net_allocations == reserved_allocations);
+      }
+      REQUIRE(sketch.get_peak_storage_bytes() == static_cast<size_t>(reserved_bytes));
+      REQUIRE(sketch.validate());
+
+      // the same sketch without reserved storage
+      cpc_sketch_test_alloc unreserved(lg_k, DEFAULT_SEED, 0);
+      for (int i = 0; i < n; i++) unreserved.update(i);
+      REQUIRE(unreserved.serialize() == sketch.serialize());
+      REQUIRE(unreserved.get_estimate() == sketch.get_estimate());
+    }
+    REQUIRE(test_allocator_total_bytes == 0);
+    REQUIRE(test_allocator_net_allocations == 0);
+  }
+}
+
+TEST_CASE("cpc sketch allocation: peak storage", "[cpc_sketch]") {
+  test_allocator_total_bytes = 0;
+  test_allocator_net_allocations = 0;
+  {
+    cpc_sketch_test_alloc sketch(11, DEFAULT_SEED, 0);
+    long long peak_bytes = test_allocator_total_bytes;
+    REQUIRE(sketch.get_peak_storage_bytes() == static_cast<size_t>(peak_bytes));
+    for (int i = 0; i < 100000; i++) {
+      sketch.update(i);
+      peak_bytes = std::max(peak_bytes, test_allocator_total_bytes);
+      REQUIRE(sketch.get_peak_storage_bytes() == static_cast<size_t>(peak_bytes));
+    }
+    REQUIRE(sketch.get_peak_storage_bytes() >= static_cast<size_t>(test_allocator_total_bytes));
+  }
+  REQUIRE(test_allocator_total_bytes == 0);
+  REQUIRE(test_allocator_net_allocations == 0);
+}
+
+TEST_CASE("cpc sketch allocation: serialize into large misaligned buffer", "[cpc_sketch]") {
+  test_allocator_total_bytes = 0;
+  test_allocator_net_allocations = 0;
+  {
+    // sparse, hybrid, pinned and sliding flavors
+    for (int n: {100, 1000, 5000, 50000}) {
+      cpc_sketch_test_alloc sketch(11, DEFAULT_SEED, 0);
+      for (int i = 0; i < n; i++) sketch.update(i);
+      const auto bytes = sketch.serialize();
+      // the temporary buffer for the misaligned words is sized by the sketch, not by the capacity
+      long long peak_bytes[2];
+      const size_t capacities[2] = {1 << 16, 1 << 20};
+      for (int i = 0; i < 2; i++) {
+        std::vector<uint8_t> buffer(capacities[i] + 1);
+        test_allocator_peak_bytes = test_allocator_total_bytes;
+        REQUIRE(sketch.serialize(buffer.data() + 1, capacities[i]) == bytes.size());
+        peak_bytes[i] = test_allocator_peak_bytes - test_allocator_total_bytes;
+        REQUIRE(std::equal(bytes.begin(), bytes.end(), buffer.begin() + 1));
+      }
+      REQUIRE(peak_bytes[1] == peak_bytes[0]);
+      REQUIRE(peak_bytes[0] < static_cast<long long>(capacities[0]));
+    }
+  }
+  REQUIRE(test_allocator_total_bytes == 0);
+  REQUIRE(test_allocator_net_allocations == 0);
+}
+
 using cpc_union_test_alloc = cpc_union_alloc<test_allocator<uint8_t>>;
 
 TEST_CASE("cpc sketch allocation: union") {
@@ -22,6 +22,9 @@
 #include <sstream>
 #include <fstream>
 #include <stdexcept>
+#include <vector>
+#include <chrono>
+#include <iostream>
 
 #include <catch2/catch.hpp>
 
@@ -68,6 +71,23 @@ TEST_CASE("cpc sketch: many values", "[cpc_sketch]") {
   REQUIRE(sketch.validate());
 }
 
+TEST_CASE("cpc sketch: hip estimate with sliding window", "[cpc_sketch]") {
+  // the HIP estimate depends on KXP, which is recomputed from the bit matrix every time the window moves
+  // these values were obtained by summing KXP_BYTE_TABLE lookups and must be reproduced exactly
+  const int n = 100000;
+  cpc_sketch sketch4(4);
+  cpc_sketch sketch10(10);
+  cpc_sketch sketch16(16);
+  for (int i = 0; i < n; i++) {
+    sketch4.update(i);
+    sketch10.update(i);
+    sketch16.update(i);
+  }
+  REQUIRE(sketch4.get_estimate() == 93133.576595020451);
+  REQUIRE(sketch10.get_estimate() == 103120.40318137013);
+  REQUIRE(sketch16.get_estimate() == 100073.69933777781);
+}
+
 TEST_CASE("cpc sketch: overflow bug", "[cpc_sketch]") {
   cpc_sketch sketch(12);
   const int n = 100000000;
@@ -404,4 +424,96 @@ TEST_CASE("cpc sketch: max serialized size", "[cpc_sketch]") {
   REQUIRE(cpc_sketch::get_max_serialized_size_bytes(26) == static_cast<size_t>((0.6 * (1 << 26)) + 40));
 }
 
+TEST_CASE("cpc sketch: serialize into buffer", "[cpc_sketch]") {
+  const uint8_t lg_k = 10;
+  const size_t max_size = cpc_sketch::get_max_serialized_size_bytes(lg_k);
+  // sizes cover all flavors
+  for (int n: {0, 1, 100, 1000, 5000, 50000}) {
+    cpc_sketch sketch(lg_k);
+    for (int i = 0; i < n; i++) sketch.update(i);
+    auto bytes = sketch.serialize();
+    std::vector<uint8_t> buffer(max_size + 1);
+    // the data is written in place at offset 0 and through a temporary buffer at offset 1
+    for (size_t offset: {0, 1}) {
+      REQUIRE(sketch.serialize(buffer.data() + offset, max_size) == bytes.size());
+      REQUIRE(std::memcmp(buffer.data() + offset, bytes.data(), bytes.size()) == 0);
+      auto deserialized = cpc_sketch::deserialize(buffer.data() + offset, bytes.size());
+      REQUIRE(deserialized.get_estimate() == sketch.get_estimate());
+      REQUIRE(deserialized.validate());
+      REQUIRE_THROWS_AS(sketch.serialize(buffer.data() + offset, bytes.size() - 1), std::out_of_range);
+    }
+  }
+}
+
+TEST_CASE("cpc sketch: batch update same as one by one", "[cpc_sketch]") {
+  // sizes cover all flavors up to sliding, and a partial last batch
+  for (int n: {0, 1, 63, 65, 1000, 10000, 100000}) {
+    std::vector<uint64_t> values(n);
+    for (int i = 0; i < n; i++) values[i] = i;
+    cpc_sketch sketch1(10);
+    for (uint64_t value: values) sketch1.update(value);
+    cpc_sketch sketch2(10);
+    sketch2.update(values.begin(), values.end());
+    REQUIRE(sketch2.get_num_coupons() == sketch1.get_num_coupons());
+    REQUIRE(sketch2.get_estimate() == sketch1.get_estimate());
+    REQUIRE(sketch2.serialize() == sketch1.serialize());
+    REQUIRE(sketch2.validate());
+  }
+}
+
+TEST_CASE("cpc sketch: batch update types", "[cpc_sketch]") {
+  cpc_sketch sketch1(11);
+  sketch1.update((int32_t) -1);
+  sketch1.update((float) 1);
+  sketch1.update(std::string("a"));
+
+  const std::vector<int32_t> ints = {-1};
+  const std::vector<uint8_t> bytes = {255};
+  const std::vector<float> floats = {1};
+  const std::vector<double> doubles = {1, -0.0};
+  const std::vector<std::string> strings = {"a", ""};
+  cpc_sketch sketch2(11);
+  sketch2.update(ints.begin(), ints.end());
+  sketch2.update(bytes.begin(), bytes.end());
+  sketch2.update(floats.begin(), floats.end());
+  sketch2.update(doubles.begin(), doubles.end());
+  sketch2.update(strings.begin(), strings.end());
+  // -0.0 is the same as 0.0, which is a new value, and the empty string is ignored
+  sketch1.update(0.0);
+  REQUIRE(sketch2.get_num_coupons() == 4);
+  REQUIRE(sketch2.serialize() == sketch1.serialize());
+}
+
+TEST_CASE("cpc sketch: update hash", "[cpc_sketch]") {
+  cpc_sketch sketch1(11);
+  cpc_sketch sketch2(11);
+  for (int64_t i = 0; i < 10000; i++) {
+    sketch1.update(i);
+    HashState hashes;
+    MurmurHash3_x64_128(&i, sizeof(i), DEFAULT_SEED, hashes);
+    sketch2.update_hash(hashes.h1, hashes.h2);
+  }
+  REQUIRE(sketch2.get_estimate() == sketch1.get_estimate());
+  REQUIRE(sketch2.serialize() == sketch1.serialize());
+}
+
+// not run by default, use the [benchmark] tag to run it
+TEST_CASE("cpc sketch: batch update speed", "[.][benchmark]") {
+  const uint64_t n = 1 << 24;
+  std::vector<uint64_t> values(n);
+  for (uint64_t i = 0; i < n; i++) values[i] = i;
+  for (uint8_t lg_k: {10, 16, 20}) {
+    cpc_sketch sketch1(lg_k);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t value: values) sketch1.update(value);
+    const double one_by_one = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+    cpc_sketch sketch2(lg_k);
+    start = std::chrono::steady_clock::now();
+    sketch2.update(values.begin(), values.end());
+    const double batch = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+    std::cout << "lg_k " << static_cast<int>(lg_k) << ": one by one " << one_by_one << " ns/value, batch " << batch << " ns/value\n";
+    REQUIRE(sketch2.get_estimate() == sketch1.get_estimate());
+  }
+}
+
 } /* namespace datasketches */
@@ -21,7 +21,11 @@
 
 #include "cpc_union.hpp"
 
+#include <chrono>
+#include <cstring>
+#include <iostream>
 #include <stdexcept>
+#include <vector>
 
 namespace datasketches {
 
@@ -146,6 +150,171 @@ TEST_CASE("cpc union: moving update", "[cpc_union]") {
   REQUIRE(r.get_estimate() == Approx(100).margin(100 * RELATIVE_ERROR_FOR_LG_K_11));
 }
 
+TEST_CASE("cpc union: serialized sketches same as deserialized", "[cpc_union]") {
+  // sketches of every flavor with lg_k that makes the union downsample along the way
+  const std::vector<uint8_t> lg_ks = {12, 12, 11, 12, 11, 10, 11, 12, 10, 10, 11};
+  const std::vector<int> ns = {0, 10, 100, 400, 1000, 3000, 20000, 100000, 50, 5000, 200000};
+  int key = 0;
+  cpc_union u1(12);
+  cpc_union u2(12);
+  for (size_t i = 0; i < lg_ks.size(); i++) {
+    cpc_sketch s(lg_ks[i]);
+    for (int j = 0; j < ns[i]; j++) s.update(key++);
+    key -= ns[i] / 2; // overlap with the next sketch
+    const auto bytes = s.serialize();
+    u1.update(cpc_sketch::deserialize(bytes.data(), bytes.size()));
+    u2.update(bytes.data(), bytes.size());
+    const cpc_sketch r1 = u1.get_result();
+    const cpc_sketch r2 = u2.get_result();
+    REQUIRE(r2.get_lg_k() == r1.get_lg_k());
+    REQUIRE(r2.get_num_coupons() == r1.get_num_coupons());
+    REQUIRE(r2.get_estimate() == r1.get_estimate());
+    REQUIRE(r2.serialize() == r1.serialize());
+  }
+  REQUIRE(u2.get_result().get_lg_k() == 10);
+}
+
+TEST_CASE("cpc union: serialized sketches of one flavor", "[cpc_union]") {
+  // each n keeps the union in one of the cases for a while
+  for (int n: {10, 100, 300, 1000, 10000}) {
+    cpc_union u1(11);
+    cpc_union u2(11);
+    for (int i = 0; i < 20; i++) {
+      cpc_sketch s(11);
+      for (int j = 0; j < n; j++) s.update(i * n / 2 + j);
+      const auto bytes = s.serialize();
+      u1.update(s);
+      u2.update(bytes.data(), bytes.size());
+    }
+    REQUIRE(u2.get_result().serialize() == u1.get_result().serialize());
+  }
+}
+
+TEST_CASE("cpc union: serialized sketch not aligned", "[cpc_union]") {
+  for (int n: {100, 1000, 10000}) {
+    cpc_sketch s(11);
+    for (int i = 0; i < n; i++) s.update(i);
+    const auto bytes = s.serialize();
+    std::vector<uint8_t> buffer(bytes.size() + 1);
+    std::memcpy(buffer.data() + 1, bytes.data(), bytes.size());
+    cpc_union u1(11);
+    u1.update(bytes.data(), bytes.size());
+    cpc_union u2(11);
+    u2.update(buffer.data() + 1, bytes.size());
+    REQUIRE(u2.get_result().serialize() == u1.get_result().serialize());
+  }
+}
+
+TEST_CASE("cpc union: serialized sketch errors", "[cpc_union]") {
+  cpc_sketch s(11, 123);
+  for (int i = 0; i < 1000; i++) s.update(i);
+  const auto bytes = s.serialize();
+  cpc_union u(11);
+  REQUIRE_THROWS_AS(u.update(bytes.data(), bytes.size()), std::invalid_argument);
+  REQUIRE_THROWS_AS(u.update(bytes.data(), 4), std::out_of_range);
+  REQUIRE_THROWS_AS(u.update(bytes.data(), bytes.size() - 4), std::out_of_range);
+  cpc_union u2(11, 123);
+  u2.update(bytes.data(), bytes.size());
+  REQUIRE(u2.get_result().get_estimate() == Approx(1000).margin(1000 * RELATIVE_ERROR_FOR_LG_K_11));
+}
+
+static std::vector<cpc_sketch> make_sketches(const std::vector<uint8_t>& lg_ks, const std::vector<int>& ns) {
+  std::vector<cpc_sketch> sketches;
+  int key = 0;
+  for (size_t i = 0; i < ns.size(); i++) {
+    sketches.emplace_back(lg_ks[i % lg_ks.size()]);
+    for (int j = 0; j < ns[i]; j++) sketches.back().update(key++);
+    key -= ns[i] / 2; // overlap with the next sketch
+  }
+  return sketches;
+}
 
+static void check_parallel_union(uint8_t lg_k, const std::vector<cpc_sketch>& sketches) {
+  cpc_union sequential(lg_k);
+  for (const auto& s: sketches) sequential.update(s);
+  const cpc_sketch expected = sequential.get_result();
+  for (unsigned num_threads: {1, 2, 3, 8}) {
+    cpc_union parallel(lg_k);
+    parallel.update_parallel(sketches.begin(), sketches.end(), num_threads);
+    const cpc_sketch result = parallel.get_result();
+    REQUIRE(result.get_lg_k() == expected.get_lg_k());
+    REQUIRE(result.get_num_coupons() == expected.get_num_coupons());
+    REQUIRE(result.get_estimate() == expected.get_estimate());
+    REQUIRE(result.serialize() == expected.serialize());
+    REQUIRE(result.validate());
+  }
+}
+
+TEST_CASE("cpc union: update parallel, mixed flavors", "[cpc_union]") {
+  check_parallel_union(12, make_sketches({12, 12, 11, 12, 10}, {0, 10, 100, 400, 1000, 3000, 20000, 100000, 50, 5000, 200000}));
+  check_parallel_union(11, make_sketches({11}, std::vector<int>(20, 1000)));
+  check_parallel_union(11, make_sketches({11}, std::vector<int>(20, 30000)));
+}
+
+TEST_CASE("cpc union: update parallel, sparse inputs", "[cpc_union]") {
+  // the union stays sparse
+  check_parallel_union(11, make_sketches({11}, std::vector<int>(10, 10)));
+  // the union goes past sparse only when the partial results are combined
+  check_parallel_union(11, make_sketches({11}, std::vector<int>(16, 40)));
+  // downsampled sketches
+  check_parallel_union(12, make_sketches({12, 11, 10}, std::vector<int>(16, 20)));
+  check_parallel_union(12, {});
+}
+
+TEST_CASE("cpc union: update parallel, empty sketch does not reduce k", "[cpc_union]") {
+  auto sketches = make_sketches({12}, {100, 1000, 10000});
+  sketches.emplace_back(4);
+  check_parallel_union(12, sketches);
+  cpc_union u(12);
+  u.update_parallel(sketches.begin(), sketches.end(), 2);
+  REQUIRE(u.get_result().get_lg_k() == 12);
+}
+
+TEST_CASE("cpc union: update parallel after update", "[cpc_union]") {
+  const auto sketches = make_sketches({12, 11}, {10, 5000, 20, 100000, 300});
+  for (int n: {0, 30, 3000}) {
+    cpc_sketch s(12);
+    for (int i = 0; i < n; i++) s.update(-i - 1);
+    cpc_union sequential(12);
+    sequential.update(s);
+    for (const auto& sketch: sketches) sequential.update(sketch);
+    cpc_union parallel(12);
+    parallel.update(s);
+    parallel.update_parallel(sketches.begin(), sketches.end(), 3);
+    REQUIRE(parallel.get_result().serialize() == sequential.get_result().serialize());
+  }
+}
+
+TEST_CASE("cpc union: update parallel errors", "[cpc_union]") {
+  const auto sketches = make_sketches({11}, {100, 10000});
+  cpc_union u(11);
+  REQUIRE_THROWS_AS(u.update_parallel(sketches.begin(), sketches.end(), 0), std::invalid_argument);
+  REQUIRE(u.get_result().is_empty());
+  std::vector<cpc_sketch> other_seed(sketches);
+  other_seed.emplace_back(11, 123);
+  other_seed.back().update(1);
+  REQUIRE_THROWS_AS(u.update_parallel(other_seed.begin(), other_seed.end(), 2), std::invalid_argument);
+}
+
+// not run by default, use the [benchmark] tag to run it
+TEST_CASE("cpc union: update parallel speed", "[.][benchmark]") {
+  const uint8_t lg_k = 16;
+  const auto sketches = make_sketches({lg_k}, std::vector<int>(400, 200000));
+  auto start = std::chrono::steady_clock::now();
+  cpc_union u1(lg_k);
+  for (const auto& s: sketches) u1.update(s);
+  const cpc_sketch r1 = u1.get_result();
+  const double sequential_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  for (unsigned num_threads: {2, 4, 8}) {
+    start = std::chrono::steady_clock::now();
+    cpc_union u2(lg_k);
+    u2.update_parallel(sketches.begin(), sketches.end(), num_threads);
+    const cpc_sketch r2 = u2.get_result();
+    const double parallel_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "lg_k=" << static_cast<int>(lg_k) << " sketches=" << sketches.size() << ": sequential "
+              << sequential_ms << " ms, " << num_threads << " threads " << parallel_ms << " ms" << std::endl;
+    REQUIRE(r2.serialize() == r1.serialize());
+  }
+}
 
 } /* namespace datasketches */
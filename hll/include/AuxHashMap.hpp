@@ -60,14 +60,14 @@ class AuxHashMap final {
     uint8_t mustFindValueFor(uint32_t slotNo) const;
     void mustReplace(uint32_t slotNo, uint8_t value);
 
+    // static so it can be used when resizing or on arrays not owned by a map
+    static int32_t find(const uint32_t* auxArr, uint8_t lgAuxArrInts, uint8_t lgConfigK, uint32_t slotNo);
+
   private:
     typedef typename std::allocator_traits<A>::template rebind_alloc<AuxHashMap<A>> ahmAlloc;
 
     using vector_int = std::vector<uint32_t, typename std::allocator_traits<A>::template rebind_alloc<uint32_t>>;
 
-    // static so it can be used when resizing
-    static int32_t find(const uint32_t* auxArr, uint8_t lgAuxArrInts, uint8_t lgConfigK, uint32_t slotNo);
-
     void checkGrow();
     void growAuxSpace();
 
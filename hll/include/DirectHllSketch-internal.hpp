@@ -0,0 +1,808 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DIRECTHLLSKETCH_INTERNAL_HPP_
+#define _DIRECTHLLSKETCH_INTERNAL_HPP_
+
+#include "direct_hll_sketch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+namespace datasketches {
+
+// The region holds exactly what HllSketchImpl<A>::serialize(false, 0) would write for the
+// equivalent heap sketch, and every method below keeps it that way. The mode transitions,
+// the hash set and aux map probing, and the HLL_4 cur_min shifting mirror CouponList,
+// CouponHashSet, Hll{4,6,8}Array and AuxHashMap step for step so that the images stay
+// byte-for-byte identical to those of a heap sketch fed the same input.
+
+template<typename A>
+direct_hll_sketch_alloc<A>::direct_hll_sketch_alloc(uint8_t* bytes, size_t capacity, const A& allocator):
+bytes_(bytes),
+capacity_(capacity),
+allocator_(allocator)
+{}
+
+template<typename A>
+direct_hll_sketch_alloc<A> direct_hll_sketch_alloc<A>::initialize(void* bytes, size_t capacity, uint8_t lg_config_k,
+    target_hll_type tgt_type, bool start_full_size, const A& allocator) {
+  HllUtil<A>::checkLgK(lg_config_k);
+  check_region(bytes, capacity, lg_config_k, tgt_type);
+  direct_hll_sketch_alloc sketch(static_cast<uint8_t*>(bytes), capacity, allocator);
+  sketch.write_list_preamble(lg_config_k, tgt_type);
+  if (start_full_size) sketch.write_hll_preamble(true);
+  return sketch;
+}
+
+template<typename A>
+direct_hll_sketch_alloc<A> direct_hll_sketch_alloc<A>::writable_wrap(void* bytes, size_t capacity, const A& allocator) {
+  if (bytes == nullptr) {
+    throw std::invalid_argument("Memory region must not be null");
+  }
+  if (capacity < hll_constants::EMPTY_SKETCH_SIZE_BYTES) {
+    throw std::out_of_range("Input data length insufficient to hold HLL sketch");
+  }
+  const uint8_t* data = static_cast<const uint8_t*>(bytes);
+  if (data[hll_constants::SER_VER_BYTE] != hll_constants::SER_VER) {
+    throw std::invalid_argument("Wrong ser ver in input stream");
+  }
+  if (data[hll_constants::FAMILY_BYTE] != hll_constants::FAMILY_ID) {
+    throw std::invalid_argument("Input array is not an HLL sketch");
+  }
+  if (data[hll_constants::FLAGS_BYTE] & hll_constants::COMPACT_FLAG_MASK) {
+    throw std::invalid_argument("Compact sketch image cannot be wrapped for updates");
+  }
+  const uint8_t mode_byte = data[hll_constants::MODE_BYTE];
+  if ((mode_byte & 0x3) == 0x3) {
+    throw std::invalid_argument("Invalid current sketch mode");
+  }
+  if (((mode_byte >> 2) & 0x3) == 0x3) {
+    throw std::invalid_argument("Invalid target HLL type");
+  }
+  const hll_mode mode = static_cast<hll_mode>(mode_byte & 0x3);
+  const target_hll_type tgt_type = static_cast<target_hll_type>((mode_byte >> 2) & 0x3);
+  const uint8_t expected_pre_ints = mode == LIST ? hll_constants::LIST_PREINTS
+      : (mode == SET ? hll_constants::HASH_SET_PREINTS : hll_constants::HLL_PREINTS);
+  if (data[hll_constants::PREAMBLE_INTS_BYTE] != expected_pre_ints) {
+    throw std::invalid_argument("Incorrect number of preInts in input stream");
+  }
+  const uint8_t lg_config_k = HllUtil<A>::checkLgK(data[hll_constants::LG_K_BYTE]);
+  check_region(bytes, capacity, lg_config_k, tgt_type);
+  if (mode == SET) {
+    if (lg_config_k <= 7) {
+      throw std::invalid_argument("Attempt to wrap invalid CouponHashSet with lgConfigK <= 7. Found: "
+                                  + std::to_string(lg_config_k));
+    }
+    const uint8_t lg_arr_ints = data[hll_constants::LG_ARR_BYTE];
+    if (lg_arr_ints < hll_constants::LG_INIT_SET_SIZE || lg_arr_ints > lg_config_k - 3) {
+      throw std::invalid_argument("Invalid hash set size: " + std::to_string(lg_arr_ints));
+    }
+  }
+  direct_hll_sketch_alloc sketch(static_cast<uint8_t*>(bytes), capacity, allocator);
+  if (sketch.get_updatable_serialization_bytes() > capacity) {
+    throw std::out_of_range("Memory region too small to hold sketch image");
+  }
+  return sketch;
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::check_region(const void* bytes, size_t capacity, uint8_t lg_config_k, target_hll_type tgt_type) {
+  if (bytes == nullptr) {
+    throw std::invalid_argument("Memory region must not be null");
+  }
+  if (reinterpret_cast<uintptr_t>(bytes) % alignof(uint32_t) != 0) {
+    throw std::invalid_argument("Memory region must be aligned for uint32_t access");
+  }
+  HllUtil<A>::checkMemSize(get_max_updatable_serialization_bytes(lg_config_k, tgt_type), capacity);
+}
+
+template<typename A>
+uint32_t direct_hll_sketch_alloc<A>::get_max_updatable_serialization_bytes(uint8_t lg_config_k, target_hll_type tgt_type) {
+  return hll_sketch_alloc<A>::get_max_updatable_serialization_bytes(lg_config_k, tgt_type);
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::reset() {
+  const bool start_full_size = get_current_mode() == HLL
+      && (bytes_[hll_constants::FLAGS_BYTE] & hll_constants::FULL_SIZE_FLAG_MASK);
+  write_list_preamble(get_lg_config_k(), get_target_type());
+  if (start_full_size) write_hll_preamble(true);
+}
+
+template<typename A>
+hll_sketch_alloc<A> direct_hll_sketch_alloc<A>::heapify() const {
+  return hll_sketch_alloc<A>::deserialize(bytes_, get_updatable_serialization_bytes(), allocator_);
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(const std::string& datum) {
+  if (datum.empty()) { return; }
+  HashState hashResult;
+  HllUtil<A>::hash(datum.c_str(), datum.length(), DEFAULT_SEED, hashResult);
+  coupon_update(HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(uint64_t datum) {
+  // no sign extension with 64 bits so no need to cast to signed value
+  HashState hashResult;
+  HllUtil<A>::hash(&datum, sizeof(uint64_t), DEFAULT_SEED, hashResult);
+  coupon_update(HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(uint32_t datum) {
+  update(static_cast<int32_t>(datum));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(uint16_t datum) {
+  update(static_cast<int16_t>(datum));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(uint8_t datum) {
+  update(static_cast<int8_t>(datum));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(int64_t datum) {
+  HashState hashResult;
+  HllUtil<A>::hash(&datum, sizeof(int64_t), DEFAULT_SEED, hashResult);
+  coupon_update(HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(int32_t datum) {
+  update(static_cast<int64_t>(datum));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(int16_t datum) {
+  update(static_cast<int64_t>(datum));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(int8_t datum) {
+  update(static_cast<int64_t>(datum));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(double datum) {
+  longDoubleUnion d;
+  d.doubleBytes = static_cast<double>(datum);
+  if (datum == 0.0) {
+    d.doubleBytes = 0.0; // canonicalize -0.0 to 0.0
+  } else if (std::isnan(d.doubleBytes)) {
+    d.longBytes = 0x7ff8000000000000L; // canonicalize NaN using value from Java's Double.doubleToLongBits()
+  }
+  HashState hashResult;
+  HllUtil<A>::hash(&d, sizeof(double), DEFAULT_SEED, hashResult);
+  coupon_update(HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(float datum) {
+  update(static_cast<double>(datum));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::update(const void* data, size_t lengthBytes) {
+  if (data == nullptr) { return; }
+  HashState hashResult;
+  HllUtil<A>::hash(data, lengthBytes, DEFAULT_SEED, hashResult);
+  coupon_update(HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::coupon_update(uint32_t coupon) {
+  if (coupon == hll_constants::EMPTY) { return; }
+  switch (get_current_mode()) {
+    case LIST:
+      list_update(coupon);
+      break;
+    case SET:
+      set_update(coupon);
+      break;
+    case HLL:
+      hll_update(coupon);
+      break;
+  }
+}
+
+// mirrors CouponList<A>::couponUpdate()
+template<typename A>
+void direct_hll_sketch_alloc<A>::list_update(uint32_t coupon) {
+  uint32_t* arr = coupons();
+  const uint32_t len = 1 << hll_constants::LG_INIT_LIST_SIZE;
+  for (uint32_t i = 0; i < len; ++i) { // search for empty slot
+    const uint32_t couponAtIdx = arr[i];
+    if (couponAtIdx == hll_constants::EMPTY) {
+      arr[i] = coupon; // the actual update
+      const uint8_t count = bytes_[hll_constants::LIST_COUNT_BYTE] + 1;
+      bytes_[hll_constants::LIST_COUNT_BYTE] = count;
+      clear_empty_flag();
+      if (count == len) { // array full
+        if (get_lg_config_k() < 8) {
+          promote_to_hll();
+        } else {
+          promote_list_to_set();
+        }
+      }
+      return;
+    }
+    // cell not empty
+    if (couponAtIdx == coupon) {
+      return; // duplicate
+    }
+  }
+  throw std::runtime_error("Array invalid: no empties and no duplicates");
+}
+
+// mirrors CouponHashSet<A>::couponUpdate() and checkGrowOrPromote()
+template<typename A>
+void direct_hll_sketch_alloc<A>::set_update(uint32_t coupon) {
+  const uint8_t lg_arr_ints = get_lg_arr_ints();
+  uint32_t* arr = coupons();
+  const int32_t index = find<A>(arr, lg_arr_ints, coupon);
+  if (index >= 0) {
+    return; // found duplicate, ignore
+  }
+  arr[~index] = coupon; // found empty
+  const uint32_t count = get_u32(hll_constants::HASH_SET_COUNT_INT) + 1;
+  put_u32(hll_constants::HASH_SET_COUNT_INT, count);
+  if (static_cast<size_t>(hll_constants::RESIZE_DENOM * count) > (hll_constants::RESIZE_NUMER * (1ULL << lg_arr_ints))) {
+    if (lg_arr_ints == (get_lg_config_k() - 3)) { // at max size
+      promote_to_hll();
+    } else {
+      grow_set(lg_arr_ints + 1);
+    }
+  }
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::hll_update(uint32_t coupon) {
+  const uint8_t lg_config_k = get_lg_config_k();
+  const uint32_t slot = HllUtil<A>::getLow26(coupon) & ((1 << lg_config_k) - 1);
+  const uint8_t new_value = HllUtil<A>::getValue(coupon);
+  uint8_t cur_value;
+  switch (get_target_type()) {
+    case HLL_8:
+      cur_value = bytes_[hll_constants::HLL_BYTE_ARR_START + slot];
+      if (new_value <= cur_value) return;
+      bytes_[hll_constants::HLL_BYTE_ARR_START + slot] = new_value;
+      break;
+    case HLL_6:
+      cur_value = get_hll6_slot(slot);
+      if (new_value <= cur_value) return;
+      put_hll6_slot(slot, new_value);
+      break;
+    default: // HLL_4
+      if (new_value <= bytes_[hll_constants::HLL_CUR_MIN_BYTE]) return; // quick rejection
+      hll4_update(slot, new_value);
+      return;
+  }
+  hip_and_kxq_incremental_update(cur_value, new_value);
+  if (cur_value == 0) {
+    // interpret numAtCurMin as num zeros
+    put_u32(hll_constants::CUR_MIN_COUNT_INT, get_u32(hll_constants::CUR_MIN_COUNT_INT) - 1);
+  }
+  clear_empty_flag();
+}
+
+// mirrors Hll4Array<A>::internalHll4Update()
+template<typename A>
+void direct_hll_sketch_alloc<A>::hll4_update(uint32_t slot, uint8_t new_value) {
+  const uint8_t cur_min = bytes_[hll_constants::HLL_CUR_MIN_BYTE];
+  const uint8_t raw_stored_old_value = get_hll4_slot(slot);
+  const uint8_t lb_on_old_value = raw_stored_old_value + cur_min;
+  if (new_value <= lb_on_old_value) return;
+
+  const uint8_t actual_old_value = (raw_stored_old_value < hll_constants::AUX_TOKEN)
+      ? lb_on_old_value : aux_find_value(slot);
+  if (new_value <= actual_old_value) return;
+
+  const uint8_t shifted_new_value = new_value - cur_min;
+  const bool becomes_exception = raw_stored_old_value != hll_constants::AUX_TOKEN
+      && shifted_new_value >= hll_constants::AUX_TOKEN;
+
+  // fail before touching the region if the aux map would outgrow it
+  const uint8_t lg_aux_arr_ints = get_lg_arr_ints();
+  if (becomes_exception && lg_aux_arr_ints > 0) {
+    const uint32_t aux_count = get_u32(hll_constants::AUX_COUNT_INT) + 1;
+    if ((hll_constants::RESIZE_DENOM * aux_count) > (hll_constants::RESIZE_NUMER * (1 << lg_aux_arr_ints))) {
+      const size_t required = hll_constants::HLL_BYTE_ARR_START + get_hll_arr_bytes() + (8 << lg_aux_arr_ints);
+      if (required > capacity_) {
+        throw std::out_of_range("Memory region too small to grow the aux map to " + std::to_string(required) + " bytes");
+      }
+    }
+  }
+
+  hip_and_kxq_incremental_update(actual_old_value, new_value);
+  if (raw_stored_old_value == hll_constants::AUX_TOKEN) {
+    // old value is an exception, and so must be the new value since cur_min has not changed
+    aux_replace(slot, new_value);
+  } else if (becomes_exception) {
+    put_hll4_slot(slot, hll_constants::AUX_TOKEN);
+    aux_add(slot, new_value);
+  } else {
+    put_hll4_slot(slot, shifted_new_value);
+  }
+  clear_empty_flag();
+
+  if (actual_old_value == cur_min) {
+    uint32_t num_at_cur_min = get_u32(hll_constants::CUR_MIN_COUNT_INT) - 1;
+    put_u32(hll_constants::CUR_MIN_COUNT_INT, num_at_cur_min);
+    while (num_at_cur_min == 0) {
+      shift_to_bigger_cur_min();
+      num_at_cur_min = get_u32(hll_constants::CUR_MIN_COUNT_INT);
+    }
+  }
+}
+
+// mirrors Hll4Array<A>::shiftToBiggerCurMin()
+template<typename A>
+void direct_hll_sketch_alloc<A>::shift_to_bigger_cur_min() {
+  const uint8_t new_cur_min = bytes_[hll_constants::HLL_CUR_MIN_BYTE] + 1;
+  const uint8_t lg_config_k = get_lg_config_k();
+  const uint32_t config_k_mask = (1 << lg_config_k) - 1;
+
+  uint32_t num_aux_tokens = 0;
+  const uint32_t num_at_new_cur_min = Hll4Array<A>::decrementRegisters(bytes_ + hll_constants::HLL_BYTE_ARR_START,
+      get_hll_arr_bytes(), num_aux_tokens);
+
+  const uint8_t lg_aux_arr_ints = get_lg_arr_ints();
+  if (lg_aux_arr_ints > 0) {
+    uint32_t* aux = aux_arr();
+    const uint32_t old_len = 1 << lg_aux_arr_ints;
+    uint32_t num_demoted = 0;
+    for (uint32_t i = 0; i < old_len; ++i) {
+      if (aux[i] == hll_constants::EMPTY) continue;
+      const uint32_t slot = HllUtil<A>::getLow26(aux[i]) & config_k_mask;
+      const uint8_t old_actual_value = HllUtil<A>::getValue(aux[i]);
+      if (old_actual_value < new_cur_min) {
+        throw std::logic_error("oldActualVal < newCurMin when incrementing curMin");
+      }
+      if (get_hll4_slot(slot) != hll_constants::AUX_TOKEN) {
+        throw std::logic_error("getSlot(slotNum) != AUX_TOKEN for item in auxiliary hash map");
+      }
+      const uint8_t new_shifted_value = old_actual_value - new_cur_min;
+      if (new_shifted_value < hll_constants::AUX_TOKEN) {
+        if (new_shifted_value != 14) {
+          throw std::logic_error("newShiftedVal != 14 for item in old auxHashMap despite curMin increment");
+        }
+        put_hll4_slot(slot, new_shifted_value);
+        ++num_demoted;
+      }
+    }
+    const uint32_t aux_count = get_u32(hll_constants::AUX_COUNT_INT);
+    if (aux_count != num_aux_tokens) {
+      throw std::runtime_error("Inconsistent counts: auxCount: " + std::to_string(aux_count)
+                               + ", HLL tokens: " + std::to_string(num_aux_tokens));
+    }
+
+    if (num_demoted > 0) {
+      // the remaining exceptions go into a fresh map sized to hold them without growing
+      const vector_u32 old_entries(aux, aux + old_len, allocator_);
+      std::fill_n(aux, old_len, 0);
+      const uint32_t new_aux_count = num_aux_tokens - num_demoted;
+      bytes_[hll_constants::LG_ARR_BYTE] = new_aux_count > 0
+          ? HllUtil<A>::computeLgArrInts(HLL, new_aux_count, lg_config_k) : 0;
+      put_u32(hll_constants::AUX_COUNT_INT, 0);
+      for (const uint32_t coupon: old_entries) {
+        if (coupon == hll_constants::EMPTY) continue;
+        const uint32_t slot = HllUtil<A>::getLow26(coupon) & config_k_mask;
+        if (get_hll4_slot(slot) == hll_constants::AUX_TOKEN) {
+          aux_add(slot, HllUtil<A>::getValue(coupon));
+        }
+      }
+    }
+  } else if (num_aux_tokens != 0) {
+    throw std::logic_error("No auxiliary hash map, but numAuxTokens != 0");
+  }
+
+  bytes_[hll_constants::HLL_CUR_MIN_BYTE] = new_cur_min;
+  put_u32(hll_constants::CUR_MIN_COUNT_INT, num_at_new_cur_min);
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::write_list_preamble(uint8_t lg_config_k, target_hll_type tgt_type) {
+  std::fill_n(bytes_, hll_constants::LIST_INT_ARR_START + (sizeof(uint32_t) << hll_constants::LG_INIT_LIST_SIZE), 0);
+  bytes_[hll_constants::PREAMBLE_INTS_BYTE] = hll_constants::LIST_PREINTS;
+  bytes_[hll_constants::SER_VER_BYTE] = hll_constants::SER_VER;
+  bytes_[hll_constants::FAMILY_BYTE] = hll_constants::FAMILY_ID;
+  bytes_[hll_constants::LG_K_BYTE] = lg_config_k;
+  bytes_[hll_constants::LG_ARR_BYTE] = hll_constants::LG_INIT_LIST_SIZE;
+  bytes_[hll_constants::FLAGS_BYTE] = hll_constants::EMPTY_FLAG_MASK;
+  bytes_[hll_constants::LIST_COUNT_BYTE] = 0;
+  // lo2bits = curMode, next 2 bits = tgtHllType
+  bytes_[hll_constants::MODE_BYTE] = static_cast<uint8_t>((tgt_type << 2) | LIST);
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::write_set_preamble(uint8_t lg_arr_ints) {
+  std::fill_n(bytes_ + hll_constants::HASH_SET_INT_ARR_START, sizeof(uint32_t) << lg_arr_ints, 0);
+  bytes_[hll_constants::PREAMBLE_INTS_BYTE] = hll_constants::HASH_SET_PREINTS;
+  bytes_[hll_constants::LG_ARR_BYTE] = lg_arr_ints;
+  bytes_[hll_constants::FLAGS_BYTE] = 0;
+  bytes_[hll_constants::LIST_COUNT_BYTE] = 0;
+  bytes_[hll_constants::MODE_BYTE] = static_cast<uint8_t>((get_target_type() << 2) | SET);
+  put_u32(hll_constants::HASH_SET_COUNT_INT, 0);
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::write_hll_preamble(bool start_full_size) {
+  const uint8_t lg_config_k = get_lg_config_k();
+  const target_hll_type tgt_type = get_target_type();
+  const uint32_t aux_bytes = tgt_type == HLL_4 ? 4 << hll_constants::LG_AUX_ARR_INTS[lg_config_k] : 0;
+  std::fill_n(bytes_, hll_constants::HLL_BYTE_ARR_START + HllArray<A>::hllArrBytes(tgt_type, lg_config_k) + aux_bytes, 0);
+  bytes_[hll_constants::PREAMBLE_INTS_BYTE] = hll_constants::HLL_PREINTS;
+  bytes_[hll_constants::SER_VER_BYTE] = hll_constants::SER_VER;
+  bytes_[hll_constants::FAMILY_BYTE] = hll_constants::FAMILY_ID;
+  bytes_[hll_constants::LG_K_BYTE] = lg_config_k;
+  bytes_[hll_constants::LG_ARR_BYTE] = 0;
+  bytes_[hll_constants::FLAGS_BYTE] = hll_constants::EMPTY_FLAG_MASK
+      | (start_full_size ? hll_constants::FULL_SIZE_FLAG_MASK : 0);
+  bytes_[hll_constants::HLL_CUR_MIN_BYTE] = 0;
+  bytes_[hll_constants::MODE_BYTE] = static_cast<uint8_t>((tgt_type << 2) | HLL);
+  put_double(hll_constants::HIP_ACCUM_DOUBLE, 0);
+  put_double(hll_constants::KXQ0_DOUBLE, 1 << lg_config_k);
+  put_double(hll_constants::KXQ1_DOUBLE, 0);
+  put_u32(hll_constants::CUR_MIN_COUNT_INT, 1 << lg_config_k);
+  put_u32(hll_constants::AUX_COUNT_INT, 0);
+}
+
+// mirrors HllSketchImplFactory<A>::promoteListToSet()
+template<typename A>
+void direct_hll_sketch_alloc<A>::promote_list_to_set() {
+  const vector_u32 list = collect_coupons();
+  write_set_preamble(hll_constants::LG_INIT_SET_SIZE);
+  for (const uint32_t coupon: list) {
+    set_update(coupon);
+  }
+}
+
+// mirrors CouponHashSet<A>::growHashSet()
+template<typename A>
+void direct_hll_sketch_alloc<A>::grow_set(uint8_t tgt_lg_arr_ints) {
+  uint32_t* arr = coupons();
+  const vector_u32 old_coupons(arr, arr + (1 << get_lg_arr_ints()), allocator_);
+  std::fill_n(arr, 1 << tgt_lg_arr_ints, 0);
+  bytes_[hll_constants::LG_ARR_BYTE] = tgt_lg_arr_ints;
+  for (const uint32_t fetched: old_coupons) {
+    if (fetched != hll_constants::EMPTY) {
+      const int32_t idx = find<A>(arr, tgt_lg_arr_ints, fetched);
+      if (idx < 0) { // found EMPTY
+        arr[~idx] = fetched;
+        continue;
+      }
+      throw std::runtime_error("Error: Found duplicate coupon");
+    }
+  }
+}
+
+// mirrors HllSketchImplFactory<A>::promoteListOrSetToHll()
+template<typename A>
+void direct_hll_sketch_alloc<A>::promote_to_hll() {
+  const vector_u32 src = collect_coupons();
+  promote_to_hll(src.data(), static_cast<uint32_t>(src.size()));
+}
+
+// the result does not depend on the order of the coupons
+template<typename A>
+void direct_hll_sketch_alloc<A>::promote_to_hll(const uint32_t* coupons, uint32_t num_coupons) {
+  const double estimate = fmax(CubicInterpolation<A>::usingXAndYTables(num_coupons), num_coupons);
+  write_hll_preamble(false);
+  for (uint32_t i = 0; i < num_coupons; ++i) {
+    hll_update(coupons[i]);
+  }
+  put_double(hll_constants::HIP_ACCUM_DOUBLE, estimate);
+}
+
+template<typename A>
+auto direct_hll_sketch_alloc<A>::collect_coupons() const -> vector_u32 {
+  const uint32_t* arr = coupons();
+  const uint32_t len = get_current_mode() == LIST ? 1 << hll_constants::LG_INIT_LIST_SIZE : 1 << get_lg_arr_ints();
+  vector_u32 result(allocator_);
+  result.reserve(get_coupon_count());
+  std::copy_if(arr, arr + len, std::back_inserter(result), [](uint32_t coupon) { return coupon != hll_constants::EMPTY; });
+  return result;
+}
+
+template<typename A>
+uint8_t direct_hll_sketch_alloc<A>::get_hll4_slot(uint32_t slot) const {
+  const uint8_t byte = bytes_[hll_constants::HLL_BYTE_ARR_START + (slot >> 1)];
+  if ((slot & 1) > 0) { // odd?
+    return byte >> 4;
+  }
+  return byte & hll_constants::loNibbleMask;
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::put_hll4_slot(uint32_t slot, uint8_t value) {
+  uint8_t& byte = bytes_[hll_constants::HLL_BYTE_ARR_START + (slot >> 1)];
+  if ((slot & 1) == 0) { // set low nibble
+    byte = (byte & hll_constants::hiNibbleMask) | (value & hll_constants::loNibbleMask);
+  } else { // set high nibble
+    byte = (byte & hll_constants::loNibbleMask) | ((value << 4) & hll_constants::hiNibbleMask);
+  }
+}
+
+template<typename A>
+uint8_t direct_hll_sketch_alloc<A>::get_hll6_slot(uint32_t slot) const {
+  const uint32_t start_bit = slot * 6;
+  const uint32_t shift = start_bit & 0x7;
+  const uint8_t* ptr = bytes_ + hll_constants::HLL_BYTE_ARR_START + (start_bit >> 3);
+  const uint16_t two_byte_val = (ptr[1] << 8) | ptr[0];
+  return (two_byte_val >> shift) & hll_constants::VAL_MASK_6;
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::put_hll6_slot(uint32_t slot, uint8_t value) {
+  const uint32_t start_bit = slot * 6;
+  const uint32_t shift = start_bit & 0x7;
+  uint8_t* ptr = bytes_ + hll_constants::HLL_BYTE_ARR_START + (start_bit >> 3);
+  const uint16_t val_shifted = (value & 0x3F) << shift;
+  uint16_t cur_masked = (ptr[1] << 8) | ptr[0];
+  cur_masked &= (~(hll_constants::VAL_MASK_6 << shift));
+  const uint16_t insert = cur_masked | val_shifted;
+  ptr[0] = insert & 0xFF;
+  ptr[1] = (insert & 0xFF00) >> 8;
+}
+
+// mirrors HllArray<A>::hipAndKxQIncrementalUpdate()
+template<typename A>
+void direct_hll_sketch_alloc<A>::hip_and_kxq_incremental_update(uint8_t old_value, uint8_t new_value) {
+  const uint32_t config_k = 1 << get_lg_config_k();
+  double kxq0 = get_double(hll_constants::KXQ0_DOUBLE);
+  double kxq1 = get_double(hll_constants::KXQ1_DOUBLE);
+  // update hip BEFORE updating kxq
+  if (!is_out_of_order_flag()) {
+    put_double(hll_constants::HIP_ACCUM_DOUBLE, get_double(hll_constants::HIP_ACCUM_DOUBLE) + config_k / (kxq0 + kxq1));
+  }
+  // update kxq0 and kxq1; subtract first, then add
+  if (old_value < 32) { kxq0 -= INVERSE_POWERS_OF_2[old_value]; }
+  else                { kxq1 -= INVERSE_POWERS_OF_2[old_value]; }
+  if (new_value < 32) { kxq0 += INVERSE_POWERS_OF_2[new_value]; }
+  else                { kxq1 += INVERSE_POWERS_OF_2[new_value]; }
+  put_double(hll_constants::KXQ0_DOUBLE, kxq0);
+  put_double(hll_constants::KXQ1_DOUBLE, kxq1);
+}
+
+template<typename A>
+uint32_t* direct_hll_sketch_alloc<A>::aux_arr() const {
+  return reinterpret_cast<uint32_t*>(bytes_ + hll_constants::HLL_BYTE_ARR_START + get_hll_arr_bytes());
+}
+
+// mirrors AuxHashMap<A>::mustAdd(), creating the map on first use
+template<typename A>
+void direct_hll_sketch_alloc<A>::aux_add(uint32_t slot, uint8_t value) {
+  const uint8_t lg_config_k = get_lg_config_k();
+  uint8_t lg_aux_arr_ints = get_lg_arr_ints();
+  if (lg_aux_arr_ints == 0) {
+    lg_aux_arr_ints = hll_constants::LG_AUX_ARR_INTS[lg_config_k];
+    bytes_[hll_constants::LG_ARR_BYTE] = lg_aux_arr_ints;
+  }
+  uint32_t* aux = aux_arr();
+  const int32_t index = AuxHashMap<A>::find(aux, lg_aux_arr_ints, lg_config_k, slot);
+  if (index >= 0) {
+    throw std::invalid_argument("Found a slotNo that should not be there: SlotNo: "
+                                + std::to_string(slot) + ", Value: " + std::to_string(value));
+  }
+  aux[~index] = HllUtil<A>::pair(slot, value);
+  const uint32_t aux_count = get_u32(hll_constants::AUX_COUNT_INT) + 1;
+  put_u32(hll_constants::AUX_COUNT_INT, aux_count);
+  if ((hll_constants::RESIZE_DENOM * aux_count) > (hll_constants::RESIZE_NUMER * (1 << lg_aux_arr_ints))) {
+    aux_grow();
+  }
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::aux_replace(uint32_t slot, uint8_t value) {
+  uint32_t* aux = aux_arr();
+  const int32_t index = AuxHashMap<A>::find(aux, get_lg_arr_ints(), get_lg_config_k(), slot);
+  if (index < 0) {
+    throw std::invalid_argument("Pair not found: SlotNo: " + std::to_string(slot)
+                                + ", Value: " + std::to_string(value));
+  }
+  aux[index] = HllUtil<A>::pair(slot, value);
+}
+
+template<typename A>
+uint8_t direct_hll_sketch_alloc<A>::aux_find_value(uint32_t slot) const {
+  const uint32_t* aux = aux_arr();
+  const int32_t index = AuxHashMap<A>::find(aux, get_lg_arr_ints(), get_lg_config_k(), slot);
+  if (index < 0) {
+    throw std::invalid_argument("slotNo not found: " + std::to_string(slot));
+  }
+  return HllUtil<A>::getValue(aux[index]);
+}
+
+// mirrors AuxHashMap<A>::growAuxSpace()
+template<typename A>
+void direct_hll_sketch_alloc<A>::aux_grow() {
+  const uint8_t lg_config_k = get_lg_config_k();
+  const uint32_t config_k_mask = (1 << lg_config_k) - 1;
+  const uint8_t lg_aux_arr_ints = get_lg_arr_ints() + 1;
+  const size_t required = hll_constants::HLL_BYTE_ARR_START + get_hll_arr_bytes() + (4 << lg_aux_arr_ints);
+  if (required > capacity_) {
+    throw std::out_of_range("Memory region too small to grow the aux map to " + std::to_string(required) + " bytes");
+  }
+  uint32_t* aux = aux_arr();
+  const vector_u32 old_entries(aux, aux + (1 << (lg_aux_arr_ints - 1)), allocator_);
+  std::fill_n(aux, 1 << lg_aux_arr_ints, 0);
+  bytes_[hll_constants::LG_ARR_BYTE] = lg_aux_arr_ints;
+  for (const uint32_t fetched: old_entries) {
+    if (fetched != hll_constants::EMPTY) {
+      const int32_t idx = AuxHashMap<A>::find(aux, lg_aux_arr_ints, lg_config_k, fetched & config_k_mask);
+      aux[~idx] = fetched;
+    }
+  }
+}
+
+template<typename A>
+double direct_hll_sketch_alloc<A>::get_estimate() const {
+  if (get_current_mode() != HLL) {
+    const uint32_t count = get_coupon_count();
+    return fmax(CubicInterpolation<A>::usingXAndYTables(count), count);
+  }
+  if (is_out_of_order_flag()) return get_composite_estimate();
+  return get_double(hll_constants::HIP_ACCUM_DOUBLE);
+}
+
+template<typename A>
+double direct_hll_sketch_alloc<A>::get_composite_estimate() const {
+  if (get_current_mode() != HLL) return get_estimate();
+  return HllArray<A>::compositeEstimate(get_lg_config_k(),
+      get_double(hll_constants::KXQ0_DOUBLE), get_double(hll_constants::KXQ1_DOUBLE),
+      bytes_[hll_constants::HLL_CUR_MIN_BYTE], get_u32(hll_constants::CUR_MIN_COUNT_INT));
+}
+
+template<typename A>
+double direct_hll_sketch_alloc<A>::get_lower_bound(uint8_t num_std_dev) const {
+  HllUtil<A>::checkNumStdDev(num_std_dev);
+  if (get_current_mode() != HLL) {
+    const uint32_t count = get_coupon_count();
+    const double est = CubicInterpolation<A>::usingXAndYTables(count);
+    return fmax(est / (1.0 + (num_std_dev * hll_constants::COUPON_RSE)), count);
+  }
+  const uint8_t lg_config_k = get_lg_config_k();
+  const uint32_t config_k = 1 << lg_config_k;
+  const double num_non_zeros = bytes_[hll_constants::HLL_CUR_MIN_BYTE] == 0
+      ? config_k - get_u32(hll_constants::CUR_MIN_COUNT_INT) : config_k;
+  const double rel_err = HllUtil<A>::getRelErr(false, is_out_of_order_flag(), lg_config_k, num_std_dev);
+  return fmax(get_estimate() / (1.0 + rel_err), num_non_zeros);
+}
+
+template<typename A>
+double direct_hll_sketch_alloc<A>::get_upper_bound(uint8_t num_std_dev) const {
+  HllUtil<A>::checkNumStdDev(num_std_dev);
+  if (get_current_mode() != HLL) {
+    const uint32_t count = get_coupon_count();
+    const double est = CubicInterpolation<A>::usingXAndYTables(count);
+    return fmax(est / (1.0 - (num_std_dev * hll_constants::COUPON_RSE)), count);
+  }
+  const double rel_err = HllUtil<A>::getRelErr(true, is_out_of_order_flag(), get_lg_config_k(), num_std_dev);
+  return get_estimate() / (1.0 + rel_err);
+}
+
+template<typename A>
+uint8_t direct_hll_sketch_alloc<A>::get_lg_config_k() const {
+  return bytes_[hll_constants::LG_K_BYTE];
+}
+
+template<typename A>
+target_hll_type direct_hll_sketch_alloc<A>::get_target_type() const {
+  return static_cast<target_hll_type>((bytes_[hll_constants::MODE_BYTE] >> 2) & 0x3);
+}
+
+template<typename A>
+bool direct_hll_sketch_alloc<A>::is_empty() const {
+  if (get_current_mode() != HLL) return get_coupon_count() == 0;
+  return bytes_[hll_constants::HLL_CUR_MIN_BYTE] == 0
+      && get_u32(hll_constants::CUR_MIN_COUNT_INT) == (1U << get_lg_config_k());
+}
+
+template<typename A>
+uint32_t direct_hll_sketch_alloc<A>::get_updatable_serialization_bytes() const {
+  switch (get_current_mode()) {
+    case LIST:
+      return hll_constants::LIST_INT_ARR_START + (sizeof(uint32_t) << hll_constants::LG_INIT_LIST_SIZE);
+    case SET:
+      return hll_constants::HASH_SET_INT_ARR_START + (sizeof(uint32_t) << get_lg_arr_ints());
+    default: {
+      uint32_t aux_bytes = 0;
+      if (get_target_type() == HLL_4) {
+        const uint8_t lg_aux_arr_ints = get_lg_arr_ints();
+        aux_bytes = 4 << (lg_aux_arr_ints > 0 ? lg_aux_arr_ints : hll_constants::LG_AUX_ARR_INTS[get_lg_config_k()]);
+      }
+      return hll_constants::HLL_BYTE_ARR_START + get_hll_arr_bytes() + aux_bytes;
+    }
+  }
+}
+
+template<typename A>
+hll_mode direct_hll_sketch_alloc<A>::get_current_mode() const {
+  return static_cast<hll_mode>(bytes_[hll_constants::MODE_BYTE] & 0x3);
+}
+
+template<typename A>
+uint32_t direct_hll_sketch_alloc<A>::get_coupon_count() const {
+  if (get_current_mode() == LIST) return bytes_[hll_constants::LIST_COUNT_BYTE];
+  return get_u32(hll_constants::HASH_SET_COUNT_INT);
+}
+
+template<typename A>
+uint32_t* direct_hll_sketch_alloc<A>::coupons() const {
+  const uint32_t offset = get_current_mode() == LIST ? hll_constants::LIST_INT_ARR_START : hll_constants::HASH_SET_INT_ARR_START;
+  return reinterpret_cast<uint32_t*>(bytes_ + offset);
+}
+
+template<typename A>
+uint8_t direct_hll_sketch_alloc<A>::get_lg_arr_ints() const {
+  return bytes_[hll_constants::LG_ARR_BYTE];
+}
+
+template<typename A>
+uint32_t direct_hll_sketch_alloc<A>::get_hll_arr_bytes() const {
+  return HllArray<A>::hllArrBytes(get_target_type(), get_lg_config_k());
+}
+
+template<typename A>
+bool direct_hll_sketch_alloc<A>::is_out_of_order_flag() const {
+  return bytes_[hll_constants::FLAGS_BYTE] & hll_constants::OUT_OF_ORDER_FLAG_MASK;
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::clear_empty_flag() {
+  bytes_[hll_constants::FLAGS_BYTE] &= ~hll_constants::EMPTY_FLAG_MASK;
+}
+
+template<typename A>
+uint32_t direct_hll_sketch_alloc<A>::get_u32(uint32_t offset) const {
+  uint32_t value;
+  std::memcpy(&value, bytes_ + offset, sizeof(value));
+  return value;
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::put_u32(uint32_t offset, uint32_t value) {
+  std::memcpy(bytes_ + offset, &value, sizeof(value));
+}
+
+template<typename A>
+double direct_hll_sketch_alloc<A>::get_double(uint32_t offset) const {
+  double value;
+  std::memcpy(&value, bytes_ + offset, sizeof(value));
+  return value;
+}
+
+template<typename A>
+void direct_hll_sketch_alloc<A>::put_double(uint32_t offset, double value) {
+  std::memcpy(bytes_ + offset, &value, sizeof(value));
+}
+
+}
+
+#endif // _DIRECTHLLSKETCH_INTERNAL_HPP_
@@ -241,96 +241,116 @@ void Hll4Array<A>::internalHll4Update(uint32_t slotNo, uint8_t newVal) {
 // Entering this routine assumes that all slots have valid values > 0 and <= 15.
 // An AuxHashMap must exist if any values in the current hllByteArray are already 15.
 // In C: again-two-registers.c Lines 710 "hhb_shift_to_bigger_curmin"
+// Unlike the C version the AuxHashMap is only rebuilt if some exception stops being one,
+// since it holds actual values, which do not depend on curMin.
 template<typename A>
 void Hll4Array<A>::shiftToBiggerCurMin() {
   const uint8_t newCurMin = this->curMin_ + 1;
-  const uint32_t configK = 1 << this->lgConfigK_;
-  const uint32_t configKmask = configK - 1;
+  const uint32_t configKmask = (1 << this->lgConfigK_) - 1;
 
-  uint32_t numAtNewCurMin = 0;
   uint32_t numAuxTokens = 0;
+  const uint32_t numAtNewCurMin = decrementRegisters(this->hllByteArr_.data(),
+      static_cast<uint32_t>(this->hllByteArr_.size()), numAuxTokens);
 
-  // Walk through the slots of 4-bit array decrementing stored values by one unless it
-  // equals AUX_TOKEN, where it is left alone but counted to be checked later.
-  // If oldStoredValue is 0 it is an error.
-  // If the decremented value is 0, we increment numAtNewCurMin.
-  // Because getNibble is masked to 4 bits oldStoredValue can never be > 15 or negative
-  for (uint32_t i = 0; i < configK; i++) { //724
-    uint8_t oldStoredValue = getSlot(i);
-    if (oldStoredValue == 0) {
-      throw std::runtime_error("Array slots cannot be 0 at this point.");
-    }
-    if (oldStoredValue < hll_constants::AUX_TOKEN) {
-      putSlot(i, --oldStoredValue);
-      if (oldStoredValue == 0) { numAtNewCurMin++; }
-    } else { //oldStoredValue == AUX_TOKEN
-      numAuxTokens++;
-      if (auxHashMap_ == nullptr) {
-        throw std::logic_error("auxHashMap cannot be null at this point");
-      }
-    }
-  }
-
-  // If old AuxHashMap exists, walk through it updating some slots and build a new AuxHashMap
-  // if needed.
-  AuxHashMap<A>* newAuxMap = nullptr;
   if (auxHashMap_ != nullptr) {
-    uint32_t slotNum;
-    uint8_t oldActualVal;
-    uint8_t newShiftedVal;
-
+    // exceptions equal to newCurMin + 14 go back into the 4-bit array
+    uint32_t numDemoted = 0;
     for (const auto coupon: *auxHashMap_) {
-      slotNum = HllUtil<A>::getLow26(coupon) & configKmask;
-      oldActualVal = HllUtil<A>::getValue(coupon);
+      const uint32_t slotNum = HllUtil<A>::getLow26(coupon) & configKmask;
+      const uint8_t oldActualVal = HllUtil<A>::getValue(coupon);
       if (oldActualVal < newCurMin) {
         throw std::logic_error("oldActualVal < newCurMin when incrementing curMin");
       }
-      newShiftedVal = oldActualVal - newCurMin;
-
       if (getSlot(slotNum) != hll_constants::AUX_TOKEN) {
         throw std::logic_error("getSlot(slotNum) != AUX_TOKEN for item in auxiliary hash map");
       }
-      // Array slot != AUX_TOKEN at getSlot(slotNum);
-      if (newShiftedVal < hll_constants::AUX_TOKEN) { // 756
+      const uint8_t newShiftedVal = oldActualVal - newCurMin;
+      if (newShiftedVal < hll_constants::AUX_TOKEN) {
         if (newShiftedVal != 14) {
           throw std::logic_error("newShiftedVal != 14 for item in old auxHashMap despite curMin increment");
         }
-        // The former exception value isn't one anymore, so it stays out of new AuxHashMap.
-        // Correct the AUX_TOKEN value in the HLL array to the newShiftedVal (14).
         putSlot(slotNum, newShiftedVal);
-        numAuxTokens--;
-      } else { //newShiftedVal >= AUX_TOKEN
-        // the former exception remains an exception, so must be added to the newAuxMap
-        if (newAuxMap == nullptr) {
-          newAuxMap = AuxHashMap<A>::newAuxHashMap(hll_constants::LG_AUX_ARR_INTS[this->lgConfigK_],
-              this->lgConfigK_, this->getAllocator());
-        }
-        newAuxMap->mustAdd(slotNum, oldActualVal);
+        ++numDemoted;
       }
-    } //end scan of oldAuxMap
-  } //end if (auxHashMap != null)
-  else { // oldAuxMap == null
-    if (numAuxTokens != 0) {
-      throw std::logic_error("No auxiliary hash map, but numAuxTokens != 0");
     }
-  }
-
-  if (newAuxMap != nullptr) {
-    if (newAuxMap->getAuxCount() != numAuxTokens) {
-      throw std::runtime_error("Inconsistent counts: auxCount: " + std::to_string(newAuxMap->getAuxCount())
-                               + ", HLL tokesn: " + std::to_string(numAuxTokens));
+    if (auxHashMap_->getAuxCount() != numAuxTokens) {
+      throw std::runtime_error("Inconsistent counts: auxCount: " + std::to_string(auxHashMap_->getAuxCount())
+                               + ", HLL tokens: " + std::to_string(numAuxTokens));
     }
-  }
 
-  if (auxHashMap_ != nullptr) {
-    AuxHashMap<A>::make_deleter()(auxHashMap_);
+    if (numDemoted > 0) {
+      // the remaining exceptions go into a new map sized to hold them without growing
+      const uint32_t newAuxCount = numAuxTokens - numDemoted;
+      AuxHashMap<A>* newAuxMap = nullptr;
+      if (newAuxCount > 0) {
+        newAuxMap = AuxHashMap<A>::newAuxHashMap(HllUtil<A>::computeLgArrInts(HLL, newAuxCount, this->lgConfigK_),
+            this->lgConfigK_, this->getAllocator());
+        for (const auto coupon: *auxHashMap_) {
+          const uint32_t slotNum = HllUtil<A>::getLow26(coupon) & configKmask;
+          if (getSlot(slotNum) == hll_constants::AUX_TOKEN) {
+            newAuxMap->mustAdd(slotNum, HllUtil<A>::getValue(coupon));
+          }
+        }
+      }
+      AuxHashMap<A>::make_deleter()(auxHashMap_);
+      auxHashMap_ = newAuxMap;
+    }
+  } else if (numAuxTokens != 0) {
+    throw std::logic_error("No auxiliary hash map, but numAuxTokens != 0");
   }
-  auxHashMap_ = newAuxMap;
 
   this->curMin_ = newCurMin;
   this->numAtCurMin_ = numAtNewCurMin;
 }
 
+// Each 64-bit word holds 16 registers. A register is AUX_TOKEN if all of its 4 bits are set
+// and 0 if none is, which is found for all of them at once by folding the bits of each
+// register into its lowest bit. Every other register is at least 1, so subtracting 1 from
+// each of them in one go never borrows from the neighbor.
+template<typename A>
+uint32_t Hll4Array<A>::decrementRegisters(uint8_t* arr, uint32_t numBytes, uint32_t& numAuxTokens) {
+  static const uint64_t LOW_BITS = 0x1111111111111111ULL;
+  static const uint64_t BYTE_MASK = 0x0f0f0f0f0f0f0f0fULL;
+  static const uint64_t BYTE_SUM = 0x0101010101010101ULL;
+  // number of registers flagged in the lowest bit of each nibble
+  auto count = [](uint64_t flags) {
+    flags = (flags + (flags >> 4)) & BYTE_MASK;
+    return static_cast<uint32_t>((flags * BYTE_SUM) >> 56);
+  };
+
+  uint32_t numZeros = 0;
+  uint32_t i = 0;
+  for (; i + sizeof(uint64_t) <= numBytes; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, arr + i, sizeof(word));
+    const uint64_t nonZero = (word | (word >> 1) | (word >> 2) | (word >> 3)) & LOW_BITS;
+    if (nonZero != LOW_BITS) {
+      throw std::runtime_error("Array slots cannot be 0 at this point.");
+    }
+    const uint64_t aux = word & (word >> 1) & (word >> 2) & (word >> 3) & LOW_BITS;
+    word -= LOW_BITS & ~aux;
+    const uint64_t stillNonZero = (word | (word >> 1) | (word >> 2) | (word >> 3)) & LOW_BITS;
+    numZeros += count(LOW_BITS & ~stillNonZero);
+    numAuxTokens += count(aux);
+    std::memcpy(arr + i, &word, sizeof(word));
+  }
+  for (; i < numBytes; ++i) {
+    for (uint8_t shift: {0, 4}) {
+      const uint8_t value = (arr[i] >> shift) & hll_constants::loNibbleMask;
+      if (value == 0) {
+        throw std::runtime_error("Array slots cannot be 0 at this point.");
+      }
+      if (value == hll_constants::AUX_TOKEN) {
+        ++numAuxTokens;
+      } else {
+        arr[i] -= 1 << shift;
+        if (value == 1) ++numZeros;
+      }
+    }
+  }
+  return numZeros;
+}
+
 template<typename A>
 typename HllArray<A>::const_iterator Hll4Array<A>::begin(bool all) const {
   return typename HllArray<A>::const_iterator(this->hllByteArr_.data(), 1 << this->lgConfigK_, 0, this->tgtHllType_,
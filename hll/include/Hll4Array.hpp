@@ -53,6 +53,11 @@ class Hll4Array final : public HllArray<A> {
     virtual typename HllArray<A>::const_iterator begin(bool all = false) const;
     virtual typename HllArray<A>::const_iterator end() const;
 
+    // Decrements every 4-bit register in the array except AUX_TOKEN ones, 16 registers at a time.
+    // Returns the number of registers that become 0 and counts the AUX_TOKEN ones.
+    // static so it can be used on arrays not owned by an Hll4Array
+    static uint32_t decrementRegisters(uint8_t* arr, uint32_t numBytes, uint32_t& numAuxTokens);
+
   private:
     void internalCouponUpdate(uint32_t coupon);
     void internalHll4Update(uint32_t slotNo, uint8_t newVal);
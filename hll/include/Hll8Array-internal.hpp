@@ -22,6 +22,8 @@
 
 #include "Hll8Array.hpp"
 
+#include <cstring>
+
 namespace datasketches {
 
 template<typename A>
@@ -191,6 +193,57 @@ void Hll8Array<A>::mergeHll(const HllArray<A>& src) {
   this->setRebuildKxqCurminFlag(true);
 }
 
+template<typename A>
+void Hll8Array<A>::mergeHllImage(const uint8_t* data) {
+  const uint8_t src_lg_k = data[hll_constants::LG_K_BYTE];
+  const uint32_t src_k = 1 << src_lg_k;
+  const uint32_t dst_mask = (1 << this->getLgConfigK()) - 1;
+  const target_hll_type src_type = static_cast<target_hll_type>((data[hll_constants::MODE_BYTE] >> 2) & 0x3);
+  const uint8_t* ptr = data + hll_constants::HLL_BYTE_ARR_START;
+  if (src_type == target_hll_type::HLL_8) {
+    for (uint32_t i = 0; i < src_k; ++i) {
+      processValue(i, dst_mask, ptr[i]);
+    }
+  } else if (src_type == target_hll_type::HLL_6) {
+    uint32_t i = 0;
+    while (i < src_k) {
+      uint8_t value = *ptr & 0x3f;
+      processValue(i++, dst_mask, value);
+      value = *ptr++ >> 6;
+      value |= (*ptr & 0x0f) << 2;
+      processValue(i++, dst_mask, value);
+      value = *ptr++ >> 4;
+      value |= (*ptr & 3) << 4;
+      processValue(i++, dst_mask, value);
+      value = *ptr++ >> 2;
+      processValue(i++, dst_mask, value);
+    }
+  } else { // HLL_4
+    // exceptions are skipped here and taken from the aux region below
+    const uint8_t cur_min = data[hll_constants::HLL_CUR_MIN_BYTE];
+    for (uint32_t i = 0; i < src_k; i += 2, ++ptr) {
+      const uint8_t lo = *ptr & hll_constants::loNibbleMask;
+      const uint8_t hi = *ptr >> 4;
+      if (lo != hll_constants::AUX_TOKEN) processValue(i, dst_mask, lo + cur_min);
+      if (hi != hll_constants::AUX_TOKEN) processValue(i + 1, dst_mask, hi + cur_min);
+    }
+    uint32_t aux_count;
+    std::memcpy(&aux_count, data + hll_constants::AUX_COUNT_INT, sizeof(aux_count));
+    if (aux_count > 0) {
+      const bool compact = data[hll_constants::FLAGS_BYTE] & hll_constants::COMPACT_FLAG_MASK;
+      const uint32_t aux_items = compact ? aux_count : 1 << data[hll_constants::LG_ARR_BYTE];
+      const size_t offset = hll_constants::HLL_BYTE_ARR_START + this->hll4ArrBytes(src_lg_k);
+      const uint32_t src_mask = src_k - 1;
+      for (uint32_t i = 0; i < aux_items; ++i) {
+        uint32_t pair;
+        std::memcpy(&pair, data + offset + i * sizeof(uint32_t), sizeof(pair));
+        if (pair == hll_constants::EMPTY) continue;
+        processValue(HllUtil<A>::getLow26(pair) & src_mask, dst_mask, HllUtil<A>::getValue(pair));
+      }
+    }
+  }
+  this->setRebuildKxqCurminFlag(true);
+}
 
 template<typename A>
 void Hll8Array<A>::processValue(uint32_t slot, uint32_t mask, uint8_t new_val) {
@@ -44,6 +44,8 @@ class Hll8Array final : public HllArray<A> {
     virtual HllSketchImpl<A>* couponUpdate(uint32_t coupon) final;
     void mergeList(const CouponList<A>& src);
     void mergeHll(const HllArray<A>& src);
+    // merges a validated serialized HLL image with lg_k >= this lg_k without deserializing it
+    void mergeHllImage(const uint8_t* data);
 
     virtual uint32_t getHllByteArrBytes() const;
 
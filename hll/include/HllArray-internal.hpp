@@ -365,11 +365,16 @@ double HllArray<A>::getUpperBound(uint8_t numStdDev) const {
 // Original C: again-two-registers.c hhb_get_composite_estimate L1489
 template<typename A>
 double HllArray<A>::getCompositeEstimate() const {
-  const double rawEst = getHllRawEstimate();
+  return compositeEstimate(this->lgConfigK_, kxq0_, kxq1_, curMin_, numAtCurMin_);
+}
+
+template<typename A>
+double HllArray<A>::compositeEstimate(uint8_t lgConfigK, double kxq0, double kxq1, uint8_t curMin, uint32_t numAtCurMin) {
+  const double rawEst = hllRawEstimate(lgConfigK, kxq0, kxq1);
 
-  const double* xArr = CompositeInterpolationXTable<A>::get_x_arr(this->lgConfigK_);
+  const double* xArr = CompositeInterpolationXTable<A>::get_x_arr(lgConfigK);
   const uint32_t xArrLen = CompositeInterpolationXTable<A>::get_x_arr_length();
-  const double yStride = CompositeInterpolationXTable<A>::get_y_stride(this->lgConfigK_);
+  const double yStride = CompositeInterpolationXTable<A>::get_y_stride(lgConfigK);
 
   if (rawEst < xArr[0]) {
     return 0;
@@ -388,9 +393,9 @@ double HllArray<A>::getCompositeEstimate() const {
   // We need to completely avoid the linear_counting estimator if it might have a crazy value.
   // Empirical evidence suggests that the threshold 3*k will keep us safe if 2^4 <= k <= 2^21.
 
-  if (adjEst > (3 << this->lgConfigK_)) { return adjEst; }
+  if (adjEst > (3 << lgConfigK)) { return adjEst; }
 
-  const double linEst = getHllBitMapEstimate();
+  const double linEst = hllBitMapEstimate(lgConfigK, curMin, numAtCurMin);
 
   // Bias is created when the value of an estimator is compared with a threshold to decide whether
   // to use that estimator or a different one.
@@ -402,10 +407,10 @@ double HllArray<A>::getCompositeEstimate() const {
   // The following constants comes from empirical measurements of the crossover point
   // between the average error of the linear estimator and the adjusted hll estimator
   double crossOver = 0.64;
-  if (this->lgConfigK_ == 4)      { crossOver = 0.718; }
-  else if (this->lgConfigK_ == 5) { crossOver = 0.672; }
+  if (lgConfigK == 4)      { crossOver = 0.718; }
+  else if (lgConfigK == 5) { crossOver = 0.672; }
 
-  return (avgEst > (crossOver * (1 << this->lgConfigK_))) ? adjEst : linEst;
+  return (avgEst > (crossOver * (1 << lgConfigK))) ? adjEst : linEst;
 }
 
 template<typename A>
@@ -561,8 +566,13 @@ void HllArray<A>::hipAndKxQIncrementalUpdate(uint8_t oldValue, uint8_t newValue)
 //In C: again-two-registers.c hhb_get_improved_linear_counting_estimate L1274
 template<typename A>
 double HllArray<A>::getHllBitMapEstimate() const {
-  const uint32_t configK = 1 << this->lgConfigK_;
-  const uint32_t numUnhitBuckets = curMin_ == 0 ? numAtCurMin_ : 0;
+  return hllBitMapEstimate(this->lgConfigK_, curMin_, numAtCurMin_);
+}
+
+template<typename A>
+double HllArray<A>::hllBitMapEstimate(uint8_t lgConfigK, uint8_t curMin, uint32_t numAtCurMin) {
+  const uint32_t configK = 1 << lgConfigK;
+  const uint32_t numUnhitBuckets = curMin == 0 ? numAtCurMin : 0;
 
   //This will eventually go away.
   if (numUnhitBuckets == 0) {
@@ -576,13 +586,18 @@ double HllArray<A>::getHllBitMapEstimate() const {
 //In C: again-two-registers.c hhb_get_raw_estimate L1167
 template<typename A>
 double HllArray<A>::getHllRawEstimate() const {
-  const uint32_t configK = 1 << this->lgConfigK_;
+  return hllRawEstimate(this->lgConfigK_, kxq0_, kxq1_);
+}
+
+template<typename A>
+double HllArray<A>::hllRawEstimate(uint8_t lgConfigK, double kxq0, double kxq1) {
+  const uint32_t configK = 1 << lgConfigK;
   double correctionFactor;
-  if (this->lgConfigK_ == 4) { correctionFactor = 0.673; }
-  else if (this->lgConfigK_ == 5) { correctionFactor = 0.697; }
-  else if (this->lgConfigK_ == 6) { correctionFactor = 0.709; }
+  if (lgConfigK == 4) { correctionFactor = 0.673; }
+  else if (lgConfigK == 5) { correctionFactor = 0.697; }
+  else if (lgConfigK == 6) { correctionFactor = 0.709; }
   else { correctionFactor = 0.7213 / (1.0 + (1.079 / configK)); }
-  const double hyperEst = (correctionFactor * configK * configK) / (kxq0_ + kxq1_);
+  const double hyperEst = (correctionFactor * configK * configK) / (kxq0 + kxq1);
   return hyperEst;
 }
 
@@ -85,6 +85,12 @@ class HllArray : public HllSketchImpl<A> {
     static uint32_t hll6ArrBytes(uint8_t lgConfigK);
     static uint32_t hll8ArrBytes(uint8_t lgConfigK);
 
+    // estimators expressed over the raw register statistics so that they
+    // can be shared with sketches that do not own an HllArray
+    static double compositeEstimate(uint8_t lgConfigK, double kxq0, double kxq1, uint8_t curMin, uint32_t numAtCurMin);
+    static double hllBitMapEstimate(uint8_t lgConfigK, uint8_t curMin, uint32_t numAtCurMin);
+    static double hllRawEstimate(uint8_t lgConfigK, double kxq0, double kxq1);
+
     virtual AuxHashMap<A>* getAuxHashMap() const;
 
     void setRebuildKxqCurminFlag(bool rebuild);
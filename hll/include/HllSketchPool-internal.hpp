@@ -0,0 +1,548 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _HLLSKETCHPOOL_INTERNAL_HPP_
+#define _HLLSKETCHPOOL_INTERNAL_HPP_
+
+#include "hll_sketch_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace datasketches {
+
+// Coupon states are tracked differently from the heap sketch: up to INLINE_COUPONS coupons
+// are kept in the entry itself, after that in a hash set block that starts at
+// LG_MIN_SET_SIZE and grows with the same load factor as CouponHashSet. Only the number of
+// coupons matters for the estimates in these states, and the promotion to HLL happens at the
+// same count as in the heap sketch. Promotion does not depend on the order of the coupons,
+// so from then on the HLL block holds the same image as the heap sketch would.
+
+template<typename A>
+hll_sketch_pool_alloc<A>::hll_sketch_pool_alloc(uint8_t lg_config_k, target_hll_type tgt_type, const A& allocator):
+lg_config_k_(HllUtil<A>::checkLgK(lg_config_k)),
+tgt_type_(tgt_type),
+lg_base_aux_ints_(hll_constants::LG_AUX_ARR_INTS[lg_config_k]),
+hll_threshold_(lg_config_k < 8 ? 1 << hll_constants::LG_INIT_LIST_SIZE
+    : ((hll_constants::RESIZE_NUMER << (lg_config_k - 3)) / hll_constants::RESIZE_DENOM) + 1),
+num_sketches_(0),
+allocator_(allocator),
+entries_(1, allocator),
+set_slabs_(AllocSlab(allocator)),
+hll_slabs_(AllocSlab(allocator))
+{}
+
+template<typename A>
+auto hll_sketch_pool_alloc<A>::create() -> handle {
+  const handle h = entries_.allocate();
+  entry& e = *entries_.get(h);
+  e.state = LIST_STATE;
+  e.lg_arr = 0;
+  e.reserved = 0;
+  e.count = 0;
+  ++num_sketches_;
+  return h;
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::destroy(handle h) {
+  entry& e = get_entry(h);
+  release_block(e);
+  e.state = FREE;
+  entries_.deallocate(h);
+  --num_sketches_;
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::reset(handle h) {
+  entry& e = get_entry(h);
+  release_block(e);
+  e.state = LIST_STATE;
+  e.lg_arr = 0;
+  e.count = 0;
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, const std::string& datum) {
+  if (datum.empty()) { return; }
+  HashState hashResult;
+  HllUtil<A>::hash(datum.c_str(), datum.length(), DEFAULT_SEED, hashResult);
+  coupon_update(h, HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, uint64_t datum) {
+  // no sign extension with 64 bits so no need to cast to signed value
+  HashState hashResult;
+  HllUtil<A>::hash(&datum, sizeof(uint64_t), DEFAULT_SEED, hashResult);
+  coupon_update(h, HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, uint32_t datum) {
+  update(h, static_cast<int32_t>(datum));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, uint16_t datum) {
+  update(h, static_cast<int16_t>(datum));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, uint8_t datum) {
+  update(h, static_cast<int8_t>(datum));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, int64_t datum) {
+  HashState hashResult;
+  HllUtil<A>::hash(&datum, sizeof(int64_t), DEFAULT_SEED, hashResult);
+  coupon_update(h, HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, int32_t datum) {
+  update(h, static_cast<int64_t>(datum));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, int16_t datum) {
+  update(h, static_cast<int64_t>(datum));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, int8_t datum) {
+  update(h, static_cast<int64_t>(datum));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, double datum) {
+  longDoubleUnion d;
+  d.doubleBytes = static_cast<double>(datum);
+  if (datum == 0.0) {
+    d.doubleBytes = 0.0; // canonicalize -0.0 to 0.0
+  } else if (std::isnan(d.doubleBytes)) {
+    d.longBytes = 0x7ff8000000000000L; // canonicalize NaN using value from Java's Double.doubleToLongBits()
+  }
+  HashState hashResult;
+  HllUtil<A>::hash(&d, sizeof(double), DEFAULT_SEED, hashResult);
+  coupon_update(h, HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, float datum) {
+  update(h, static_cast<double>(datum));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::update(handle h, const void* data, size_t lengthBytes) {
+  if (data == nullptr) { return; }
+  HashState hashResult;
+  HllUtil<A>::hash(data, lengthBytes, DEFAULT_SEED, hashResult);
+  coupon_update(h, HllUtil<A>::coupon(hashResult));
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::coupon_update(handle h, uint32_t coupon) {
+  if (coupon == hll_constants::EMPTY) { return; }
+  entry& e = get_entry(h);
+  switch (e.state) {
+    case LIST_STATE:
+      list_update(e, coupon);
+      break;
+    case SET_STATE:
+      set_update(e, coupon);
+      break;
+    default:
+      hll_update(e, coupon);
+      break;
+  }
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::list_update(entry& e, uint32_t coupon) {
+  for (uint32_t i = 0; i < e.count; ++i) {
+    if (e.coupons[i] == coupon) return; // duplicate
+  }
+  if (e.count < INLINE_COUPONS) {
+    // the heap sketch never promotes to HLL with this few coupons
+    e.coupons[e.count++] = coupon;
+    return;
+  }
+  move_to_set(e, LG_MIN_SET_SIZE);
+  set_update(e, coupon);
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::set_update(entry& e, uint32_t coupon) {
+  uint32_t* arr = get_set_slab(e.lg_arr).get(e.block);
+  const int32_t index = find<A>(arr, e.lg_arr, coupon);
+  if (index >= 0) {
+    return; // found duplicate, ignore
+  }
+  arr[~index] = coupon; // found empty
+  ++e.count;
+  if (e.count == hll_threshold_) {
+    promote_to_hll(e);
+  } else if (static_cast<size_t>(hll_constants::RESIZE_DENOM * e.count) > (hll_constants::RESIZE_NUMER * (1ULL << e.lg_arr))) {
+    move_to_set(e, e.lg_arr + 1);
+  }
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::hll_update(entry& e, uint32_t coupon) {
+  while (true) {
+    try {
+      get_direct_sketch(e).hll_update(coupon);
+      return;
+    } catch (const std::out_of_range&) {
+      // the HLL_4 aux map has outgrown the block, which the failed update left untouched,
+      // so move the image to a block with room for a larger aux map and try again
+      const uint32_t block = get_hll_slab(e.lg_arr + 1).allocate();
+      slab<uint32_t>& src = get_hll_slab(e.lg_arr);
+      slab<uint32_t>& dst = get_hll_slab(e.lg_arr + 1);
+      std::copy_n(src.get(e.block), src.get_block_size(), dst.get(block));
+      src.deallocate(e.block);
+      e.block = block;
+      ++e.lg_arr;
+    }
+  }
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::move_to_set(entry& e, uint8_t lg_arr) {
+  // the destination slab must exist before taking a reference to the source slab
+  slab<uint32_t>& dst_slab = get_set_slab(lg_arr);
+  const uint32_t block = dst_slab.allocate();
+  uint32_t* arr = dst_slab.get(block);
+  std::fill_n(arr, 1 << lg_arr, 0);
+  auto insert = [arr, lg_arr](uint32_t coupon) {
+    const int32_t index = find<A>(arr, lg_arr, coupon);
+    if (index >= 0) {
+      throw std::runtime_error("Error: Found duplicate coupon");
+    }
+    arr[~index] = coupon;
+  };
+  if (e.state == LIST_STATE) {
+    for (uint32_t i = 0; i < e.count; ++i) insert(e.coupons[i]);
+  } else {
+    slab<uint32_t>& src_slab = get_set_slab(e.lg_arr);
+    const uint32_t* src = src_slab.get(e.block);
+    for (uint32_t i = 0; i < (1U << e.lg_arr); ++i) {
+      if (src[i] != hll_constants::EMPTY) insert(src[i]);
+    }
+    src_slab.deallocate(e.block);
+  }
+  e.state = SET_STATE;
+  e.lg_arr = lg_arr;
+  e.block = block;
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::promote_to_hll(entry& e) {
+  using vector_u32 = std::vector<uint32_t, typename std::allocator_traits<A>::template rebind_alloc<uint32_t>>;
+  vector_u32 coupons(allocator_);
+  coupons.reserve(e.count);
+  const uint32_t* src = get_set_slab(e.lg_arr).get(e.block);
+  std::copy_if(src, src + (1 << e.lg_arr), std::back_inserter(coupons),
+      [](uint32_t coupon) { return coupon != hll_constants::EMPTY; });
+
+  uint8_t lg_aux_arr_ints = lg_base_aux_ints_;
+  uint32_t block;
+  while (true) {
+    slab<uint32_t>& hll_slab = get_hll_slab(lg_aux_arr_ints);
+    block = hll_slab.allocate();
+    direct_hll_sketch_alloc<A> sketch(reinterpret_cast<uint8_t*>(hll_slab.get(block)),
+        hll_slab.get_block_size() * sizeof(uint32_t), allocator_);
+    sketch.write_list_preamble(lg_config_k_, tgt_type_);
+    try {
+      sketch.promote_to_hll(coupons.data(), static_cast<uint32_t>(coupons.size()));
+      break;
+    } catch (const std::out_of_range&) {
+      hll_slab.deallocate(block);
+      ++lg_aux_arr_ints;
+    }
+  }
+  release_block(e);
+  e.state = HLL_STATE;
+  e.lg_arr = lg_aux_arr_ints;
+  e.block = block;
+}
+
+template<typename A>
+void hll_sketch_pool_alloc<A>::release_block(entry& e) {
+  if (e.state == SET_STATE) {
+    get_set_slab(e.lg_arr).deallocate(e.block);
+  } else if (e.state == HLL_STATE) {
+    get_hll_slab(e.lg_arr).deallocate(e.block);
+  }
+}
+
+template<typename A>
+auto hll_sketch_pool_alloc<A>::get_set_slab(uint8_t lg_arr) -> slab<uint32_t>& {
+  const size_t index = lg_arr - LG_MIN_SET_SIZE;
+  while (set_slabs_.size() <= index) {
+    set_slabs_.emplace_back(1 << (LG_MIN_SET_SIZE + set_slabs_.size()), allocator_);
+  }
+  return set_slabs_[index];
+}
+
+template<typename A>
+auto hll_sketch_pool_alloc<A>::get_hll_slab(uint8_t lg_aux_arr_ints) -> slab<uint32_t>& {
+  const size_t index = lg_aux_arr_ints - lg_base_aux_ints_;
+  while (hll_slabs_.size() <= index) {
+    const uint8_t lg_aux = static_cast<uint8_t>(lg_base_aux_ints_ + hll_slabs_.size());
+    const uint32_t aux_bytes = tgt_type_ == HLL_4 ? 4 << lg_aux : 0;
+    const uint32_t bytes = hll_constants::HLL_BYTE_ARR_START + HllArray<A>::hllArrBytes(tgt_type_, lg_config_k_) + aux_bytes;
+    hll_slabs_.emplace_back((bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t), allocator_);
+  }
+  return hll_slabs_[index];
+}
+
+template<typename A>
+direct_hll_sketch_alloc<A> hll_sketch_pool_alloc<A>::get_direct_sketch(const entry& e) const {
+  const slab<uint32_t>& hll_slab = hll_slabs_[e.lg_arr - lg_base_aux_ints_];
+  return direct_hll_sketch_alloc<A>(reinterpret_cast<uint8_t*>(hll_slab.get(e.block)),
+      hll_slab.get_block_size() * sizeof(uint32_t), allocator_);
+}
+
+template<typename A>
+auto hll_sketch_pool_alloc<A>::get_entry(handle h) const -> entry& {
+  if (h >= entries_.get_num_blocks()) {
+    throw std::invalid_argument("Invalid sketch handle: " + std::to_string(h));
+  }
+  entry& e = *entries_.get(h);
+  if (e.state == FREE) {
+    throw std::invalid_argument("Sketch has been destroyed: " + std::to_string(h));
+  }
+  return e;
+}
+
+template<typename A>
+double hll_sketch_pool_alloc<A>::get_estimate(handle h) const {
+  const entry& e = get_entry(h);
+  if (e.state == HLL_STATE) return get_direct_sketch(e).get_estimate();
+  const double est = CubicInterpolation<A>::usingXAndYTables(e.count);
+  return fmax(est, e.count);
+}
+
+template<typename A>
+double hll_sketch_pool_alloc<A>::get_composite_estimate(handle h) const {
+  const entry& e = get_entry(h);
+  if (e.state == HLL_STATE) return get_direct_sketch(e).get_composite_estimate();
+  return get_estimate(h);
+}
+
+template<typename A>
+double hll_sketch_pool_alloc<A>::get_lower_bound(handle h, uint8_t num_std_dev) const {
+  const entry& e = get_entry(h);
+  if (e.state == HLL_STATE) return get_direct_sketch(e).get_lower_bound(num_std_dev);
+  HllUtil<A>::checkNumStdDev(num_std_dev);
+  const double est = CubicInterpolation<A>::usingXAndYTables(e.count);
+  const double tmp = est / (1.0 + (num_std_dev * hll_constants::COUPON_RSE));
+  return fmax(tmp, e.count);
+}
+
+template<typename A>
+double hll_sketch_pool_alloc<A>::get_upper_bound(handle h, uint8_t num_std_dev) const {
+  const entry& e = get_entry(h);
+  if (e.state == HLL_STATE) return get_direct_sketch(e).get_upper_bound(num_std_dev);
+  HllUtil<A>::checkNumStdDev(num_std_dev);
+  const double est = CubicInterpolation<A>::usingXAndYTables(e.count);
+  const double tmp = est / (1.0 - (num_std_dev * hll_constants::COUPON_RSE));
+  return fmax(tmp, e.count);
+}
+
+template<typename A>
+bool hll_sketch_pool_alloc<A>::is_empty(handle h) const {
+  const entry& e = get_entry(h);
+  if (e.state == HLL_STATE) return get_direct_sketch(e).is_empty();
+  return e.count == 0;
+}
+
+template<typename A>
+hll_mode hll_sketch_pool_alloc<A>::get_current_mode(handle h) const {
+  const entry& e = get_entry(h);
+  if (e.state == HLL_STATE) return HLL;
+  // the mode the heap sketch would be in with this many coupons
+  return e.count < (1U << hll_constants::LG_INIT_LIST_SIZE) ? LIST : SET;
+}
+
+template<typename A>
+hll_sketch_alloc<A> hll_sketch_pool_alloc<A>::get_sketch(handle h) const {
+  const entry& e = get_entry(h);
+  if (e.state == HLL_STATE) return get_direct_sketch(e).heapify();
+
+  // replay the coupons into a direct image, which follows the heap sketch transitions;
+  // the heap sketch never has a smaller hash set than the pool, nor one smaller than
+  // LG_INIT_SET_SIZE, and a list image is smaller than either
+  using vector_u32 = std::vector<uint32_t, typename std::allocator_traits<A>::template rebind_alloc<uint32_t>>;
+  const uint8_t lg_arr = std::max<uint8_t>(hll_constants::LG_INIT_SET_SIZE, e.state == SET_STATE ? e.lg_arr : 0);
+  vector_u32 image((hll_constants::HASH_SET_INT_ARR_START / sizeof(uint32_t)) + (1 << lg_arr), 0, allocator_);
+  direct_hll_sketch_alloc<A> sketch(reinterpret_cast<uint8_t*>(image.data()), image.size() * sizeof(uint32_t), allocator_);
+  sketch.write_list_preamble(lg_config_k_, tgt_type_);
+  if (e.state == LIST_STATE) {
+    for (uint32_t i = 0; i < e.count; ++i) sketch.coupon_update(e.coupons[i]);
+  } else {
+    const slab<uint32_t>& set_slab = set_slabs_[e.lg_arr - LG_MIN_SET_SIZE];
+    const uint32_t* arr = set_slab.get(e.block);
+    for (uint32_t i = 0; i < (1U << e.lg_arr); ++i) {
+      if (arr[i] != hll_constants::EMPTY) sketch.coupon_update(arr[i]);
+    }
+  }
+  return sketch.heapify();
+}
+
+template<typename A>
+uint8_t hll_sketch_pool_alloc<A>::get_lg_config_k() const {
+  return lg_config_k_;
+}
+
+template<typename A>
+target_hll_type hll_sketch_pool_alloc<A>::get_target_type() const {
+  return tgt_type_;
+}
+
+template<typename A>
+uint32_t hll_sketch_pool_alloc<A>::get_num_sketches() const {
+  return num_sketches_;
+}
+
+template<typename A>
+size_t hll_sketch_pool_alloc<A>::get_memory_usage() const {
+  size_t total = sizeof(*this) + entries_.get_memory_usage();
+  total += (set_slabs_.capacity() + hll_slabs_.capacity()) * sizeof(slab<uint32_t>);
+  for (const auto& s: set_slabs_) total += s.get_memory_usage();
+  for (const auto& s: hll_slabs_) total += s.get_memory_usage();
+  return total;
+}
+
+// slab
+
+template<typename A>
+template<typename T>
+hll_sketch_pool_alloc<A>::slab<T>::slab(uint32_t block_size, const A& allocator):
+allocator_(allocator),
+block_size_(block_size),
+lg_blocks_per_chunk_(0),
+num_blocks_(0),
+chunks_(AllocPtr(allocator)),
+free_(AllocU32(allocator))
+{
+  // chunks of about 64KB, or a single block if that is larger
+  while ((static_cast<size_t>(block_size_) * sizeof(T) << (lg_blocks_per_chunk_ + 1)) <= (1 << 16)) {
+    ++lg_blocks_per_chunk_;
+  }
+}
+
+template<typename A>
+template<typename T>
+hll_sketch_pool_alloc<A>::slab<T>::slab(slab&& other) noexcept:
+allocator_(std::move(other.allocator_)),
+block_size_(other.block_size_),
+lg_blocks_per_chunk_(other.lg_blocks_per_chunk_),
+num_blocks_(other.num_blocks_),
+chunks_(std::move(other.chunks_)),
+free_(std::move(other.free_))
+{
+  other.chunks_.clear();
+  other.num_blocks_ = 0;
+}
+
+template<typename A>
+template<typename T>
+auto hll_sketch_pool_alloc<A>::slab<T>::operator=(slab&& other) noexcept -> slab& {
+  release();
+  allocator_ = std::move(other.allocator_);
+  block_size_ = other.block_size_;
+  lg_blocks_per_chunk_ = other.lg_blocks_per_chunk_;
+  num_blocks_ = other.num_blocks_;
+  chunks_ = std::move(other.chunks_);
+  free_ = std::move(other.free_);
+  other.chunks_.clear();
+  other.num_blocks_ = 0;
+  return *this;
+}
+
+template<typename A>
+template<typename T>
+hll_sketch_pool_alloc<A>::slab<T>::~slab() {
+  release();
+}
+
+template<typename A>
+template<typename T>
+void hll_sketch_pool_alloc<A>::slab<T>::release() {
+  for (T* chunk: chunks_) {
+    allocator_.deallocate(chunk, static_cast<size_t>(block_size_) << lg_blocks_per_chunk_);
+  }
+  chunks_.clear();
+}
+
+template<typename A>
+template<typename T>
+uint32_t hll_sketch_pool_alloc<A>::slab<T>::allocate() {
+  if (!free_.empty()) {
+    const uint32_t index = free_.back();
+    free_.pop_back();
+    return index;
+  }
+  if ((num_blocks_ >> lg_blocks_per_chunk_) == chunks_.size()) {
+    chunks_.push_back(allocator_.allocate(static_cast<size_t>(block_size_) << lg_blocks_per_chunk_));
+  }
+  return num_blocks_++;
+}
+
+template<typename A>
+template<typename T>
+void hll_sketch_pool_alloc<A>::slab<T>::deallocate(uint32_t index) {
+  free_.push_back(index);
+}
+
+template<typename A>
+template<typename T>
+T* hll_sketch_pool_alloc<A>::slab<T>::get(uint32_t index) const {
+  const uint32_t mask = (1 << lg_blocks_per_chunk_) - 1;
+  return chunks_[index >> lg_blocks_per_chunk_] + static_cast<size_t>(index & mask) * block_size_;
+}
+
+template<typename A>
+template<typename T>
+uint32_t hll_sketch_pool_alloc<A>::slab<T>::get_block_size() const {
+  return block_size_;
+}
+
+template<typename A>
+template<typename T>
+uint32_t hll_sketch_pool_alloc<A>::slab<T>::get_num_blocks() const {
+  return num_blocks_;
+}
+
+template<typename A>
+template<typename T>
+size_t hll_sketch_pool_alloc<A>::slab<T>::get_memory_usage() const {
+  return chunks_.size() * (static_cast<size_t>(block_size_) << lg_blocks_per_chunk_) * sizeof(T)
+      + chunks_.capacity() * sizeof(T*) + free_.capacity() * sizeof(uint32_t);
+}
+
+} // namespace datasketches
+
+#endif // _HLLSKETCHPOOL_INTERNAL_HPP_
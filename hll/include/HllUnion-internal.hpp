@@ -25,9 +25,14 @@
 #include "HllSketchImpl.hpp"
 #include "HllArray.hpp"
 #include "HllUtil.hpp"
+#include "run_parallel.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace datasketches {
 
@@ -59,6 +64,224 @@ void hll_union_alloc<A>::update(hll_sketch_alloc<A>&& sketch) {
   union_impl(sketch, lg_max_k_);
 }
 
+template<typename A>
+template<typename InputIt>
+void hll_union_alloc<A>::update_serialized(InputIt first, InputIt last) {
+  using AllocImage = typename std::allocator_traits<A>::template rebind_alloc<serialized_image>;
+  const A allocator = gadget_.sketch_impl->getAllocator();
+
+  // check all headers first, which also determines the lg_k of the result
+  uint8_t tgt_lg_k = lg_max_k_;
+  uint32_t num_hll = 0;
+  std::vector<serialized_image, AllocImage> images(allocator);
+  for (; first != last; ++first) {
+    const serialized_image image = check_serialized_image(first->data(), first->size());
+    if (image.empty) continue;
+    if (image.mode == HLL) {
+      tgt_lg_k = std::min(tgt_lg_k, image.lg_k);
+      ++num_hll;
+    }
+    images.push_back(image);
+  }
+
+  // up to the first HLL-mode sketch the gadget takes the coupons as usual,
+  // which may promote it to HLL mode before any registers are merged
+  auto first_hll = images.begin();
+  for (; first_hll != images.end() && first_hll->mode != HLL; ++first_hll) {
+    for_each_coupon(*first_hll, [this](uint32_t coupon) {
+      gadget_.sketch_impl = leak_free_coupon_update(gadget_.sketch_impl, coupon);
+    });
+  }
+  if (num_hll == 0) return;
+
+  if (gadget_.sketch_impl->getCurMode() == HLL) {
+    // a previous merge may have left cur_min stale, and isEmpty() depends on it
+    static_cast<HllArray<A>*>(gadget_.sketch_impl)->check_rebuild_kxq_cur_min();
+  }
+  const bool gadget_is_hll = gadget_.sketch_impl->getCurMode() == HLL && !is_empty();
+  if (gadget_is_hll) {
+    tgt_lg_k = std::min(tgt_lg_k, gadget_.get_lg_config_k());
+    ++num_hll;
+  }
+
+  Hll8Array<A>* dst;
+  if (gadget_is_hll) {
+    if (gadget_.get_lg_config_k() > tgt_lg_k) {
+      HllSketchImpl<A>* downsampled = copy_or_downsample(gadget_.sketch_impl, tgt_lg_k);
+      gadget_.sketch_impl->get_deleter()(gadget_.sketch_impl);
+      gadget_.sketch_impl = downsampled;
+    }
+    dst = static_cast<Hll8Array<A>*>(gadget_.sketch_impl);
+  } else {
+    using Hll8Alloc = typename std::allocator_traits<A>::template rebind_alloc<Hll8Array<A>>;
+    dst = new (Hll8Alloc(allocator).allocate(1)) Hll8Array<A>(tgt_lg_k, false, allocator);
+  }
+
+  for (auto it = first_hll; it != images.end(); ++it) {
+    const serialized_image& image = *it;
+    if (image.mode != HLL) continue;
+    dst->mergeHllImage(image.data);
+    if (num_hll == 1) { // the only HLL-mode sketch, as if copied into an empty union
+      const bool ooo_flag = image.data[hll_constants::FLAGS_BYTE] & hll_constants::OUT_OF_ORDER_FLAG_MASK;
+      double hip_accum = 0;
+      if (!ooo_flag) std::memcpy(&hip_accum, image.data + hll_constants::HIP_ACCUM_DOUBLE, sizeof(hip_accum));
+      dst->putHipAccum(hip_accum);
+      dst->putOutOfOrderFlag(ooo_flag);
+    }
+  }
+  // the coupons update the HIP estimator incrementally, so the registers must be consistent first
+  dst->check_rebuild_kxq_cur_min();
+
+  if (!gadget_is_hll) {
+    if (!gadget_.sketch_impl->isEmpty()) {
+      dst->mergeList(*static_cast<const CouponList<A>*>(gadget_.sketch_impl));
+    }
+    gadget_.sketch_impl->get_deleter()(gadget_.sketch_impl);
+    gadget_.sketch_impl = dst;
+  }
+  for (auto it = first_hll; it != images.end(); ++it) {
+    if (it->mode == HLL) continue;
+    for_each_coupon(*it, [dst](uint32_t coupon) { dst->couponUpdate(coupon); });
+  }
+
+  if (num_hll > 1) {
+    dst->putOutOfOrderFlag(true);
+    dst->putHipAccum(0);
+  }
+}
+
+template<typename A>
+auto hll_union_alloc<A>::check_serialized_image(const void* bytes, size_t len) -> serialized_image {
+  if (len < hll_constants::EMPTY_SKETCH_SIZE_BYTES) {
+    throw std::out_of_range("Input data length insufficient to hold HLL sketch");
+  }
+  const uint8_t* data = static_cast<const uint8_t*>(bytes);
+  if (data[hll_constants::SER_VER_BYTE] != hll_constants::SER_VER) {
+    throw std::invalid_argument("Wrong ser ver in input stream");
+  }
+  if (data[hll_constants::FAMILY_BYTE] != hll_constants::FAMILY_ID) {
+    throw std::invalid_argument("Input array is not an HLL sketch");
+  }
+  const uint8_t mode_byte = data[hll_constants::MODE_BYTE];
+  if ((mode_byte & 0x3) == 0x3) {
+    throw std::invalid_argument("Invalid current sketch mode");
+  }
+  if (((mode_byte >> 2) & 0x3) == 0x3) {
+    throw std::invalid_argument("Invalid target HLL type");
+  }
+  const hll_mode mode = static_cast<hll_mode>(mode_byte & 0x3);
+  const uint8_t expected_pre_ints = mode == LIST ? hll_constants::LIST_PREINTS
+      : (mode == SET ? hll_constants::HASH_SET_PREINTS : hll_constants::HLL_PREINTS);
+  if (data[hll_constants::PREAMBLE_INTS_BYTE] != expected_pre_ints) {
+    throw std::invalid_argument("Incorrect number of preInts in input stream");
+  }
+  const uint8_t lg_k = HllUtil<A>::checkLgK(data[hll_constants::LG_K_BYTE]);
+  const bool compact = data[hll_constants::FLAGS_BYTE] & hll_constants::COMPACT_FLAG_MASK;
+
+  serialized_image image {data, mode, lg_k, false, 0};
+  size_t expected_len;
+  if (mode == LIST) {
+    // the coupons of a list are always at the front, whether compact or not
+    const uint32_t count = data[hll_constants::LIST_COUNT_BYTE];
+    if (count > (1U << hll_constants::LG_INIT_LIST_SIZE)) {
+      throw std::invalid_argument("Invalid coupon count in list: " + std::to_string(count));
+    }
+    image.empty = (data[hll_constants::FLAGS_BYTE] & hll_constants::EMPTY_FLAG_MASK) || count == 0;
+    image.num_items = image.empty ? 0 : count;
+    expected_len = hll_constants::LIST_INT_ARR_START + image.num_items * sizeof(uint32_t);
+  } else if (mode == SET) {
+    if (lg_k <= 7) {
+      throw std::invalid_argument("Attempt to deserialize invalid CouponHashSet with lgConfigK <= 7. Found: "
+                                  + std::to_string(lg_k));
+    }
+    if (len < hll_constants::HASH_SET_INT_ARR_START) {
+      throw std::out_of_range("Input data length insufficient to hold CouponHashSet");
+    }
+    uint32_t count;
+    std::memcpy(&count, data + hll_constants::HASH_SET_COUNT_INT, sizeof(count));
+    uint8_t lg_arr_ints = data[hll_constants::LG_ARR_BYTE];
+    if (lg_arr_ints < hll_constants::LG_INIT_SET_SIZE) {
+      lg_arr_ints = HllUtil<A>::computeLgArrInts(SET, count, lg_k);
+    }
+    image.empty = count == 0;
+    image.num_items = compact ? count : 1 << lg_arr_ints;
+    expected_len = hll_constants::HASH_SET_INT_ARR_START + image.num_items * sizeof(uint32_t);
+  } else {
+    const target_hll_type tgt_type = static_cast<target_hll_type>((mode_byte >> 2) & 0x3);
+    const size_t offset = hll_constants::HLL_BYTE_ARR_START + HllArray<A>::hllArrBytes(tgt_type, lg_k);
+    if (len < offset) {
+      throw std::out_of_range("Input array too small to hold sketch image");
+    }
+    uint32_t num_at_cur_min, aux_count;
+    std::memcpy(&num_at_cur_min, data + hll_constants::CUR_MIN_COUNT_INT, sizeof(num_at_cur_min));
+    std::memcpy(&aux_count, data + hll_constants::AUX_COUNT_INT, sizeof(aux_count));
+    image.empty = data[hll_constants::HLL_CUR_MIN_BYTE] == 0 && num_at_cur_min == (1U << lg_k);
+    expected_len = offset;
+    if (aux_count > 0) {
+      if (tgt_type != HLL_4) {
+        throw std::invalid_argument("Aux entries in a sketch that is not HLL_4");
+      }
+      expected_len += (compact ? aux_count : 1 << data[hll_constants::LG_ARR_BYTE]) * sizeof(uint32_t);
+    }
+  }
+  if (len < expected_len) {
+    throw std::out_of_range("Byte array too short for sketch. Expected " + std::to_string(expected_len)
+                            + ", found: " + std::to_string(len));
+  }
+  return image;
+}
+
+template<typename A>
+template<typename F>
+void hll_union_alloc<A>::for_each_coupon(const serialized_image& image, F f) {
+  const uint8_t* ptr = image.data + (image.mode == LIST ? hll_constants::LIST_INT_ARR_START : hll_constants::HASH_SET_INT_ARR_START);
+  for (uint32_t i = 0; i < image.num_items; ++i, ptr += sizeof(uint32_t)) {
+    uint32_t coupon;
+    std::memcpy(&coupon, ptr, sizeof(coupon));
+    if (coupon != hll_constants::EMPTY) f(coupon);
+  }
+}
+
+template<typename A>
+template<typename ForwardIt>
+void hll_union_alloc<A>::update_parallel(ForwardIt first, ForwardIt last, unsigned num_threads) {
+  if (num_threads == 0) throw std::invalid_argument("num_threads must be positive");
+
+  // the HIP estimator is order-dependent until the union goes out of order
+  while (first != last && !(get_current_mode() == HLL && is_out_of_order_flag())) {
+    update(*first);
+    ++first;
+  }
+  const size_t num_sketches = std::distance(first, last);
+  if (num_sketches == 0) return;
+  if (num_threads > num_sketches) num_threads = static_cast<unsigned>(num_sketches);
+
+  using AllocUnion = typename std::allocator_traits<A>::template rebind_alloc<hll_union_alloc>;
+  using AllocIt = typename std::allocator_traits<A>::template rebind_alloc<ForwardIt>;
+  const A allocator = gadget_.sketch_impl->getAllocator();
+  // the range is split into one contiguous chunk per thread
+  std::vector<ForwardIt, AllocIt> chunk_bounds(allocator);
+  chunk_bounds.reserve(num_threads + 1);
+  chunk_bounds.push_back(first);
+  size_t remaining = num_sketches;
+  for (unsigned i = 0; i < num_threads; ++i) {
+    const size_t chunk_size = remaining / (num_threads - i);
+    chunk_bounds.push_back(std::next(chunk_bounds.back(), chunk_size));
+    remaining -= chunk_size;
+  }
+  std::vector<hll_union_alloc, AllocUnion> partials(allocator);
+  partials.reserve(num_threads);
+  for (unsigned i = 0; i < num_threads; ++i) partials.emplace_back(lg_max_k_, allocator);
+  run_parallel(num_threads, num_threads, [&partials, &chunk_bounds](size_t i) {
+    for (ForwardIt it = chunk_bounds[i]; it != chunk_bounds[i + 1]; ++it) partials[i].update(*it);
+  }, allocator);
+
+  // this union is out of order already, so merging the partial results in any order is exact
+  for (const auto& partial: partials) {
+    if (!partial.is_empty()) union_impl(partial.gadget_, lg_max_k_);
+  }
+}
+
 template<typename A>
 void hll_union_alloc<A>::update(const std::string& datum) {
   gadget_.update(datum);
@@ -169,6 +392,8 @@ void hll_union_alloc<A>::reset() {
 
 template<typename A>
 bool hll_union_alloc<A>::is_empty() const {
+  if (gadget_.sketch_impl->getCurMode() == hll_mode::HLL)
+    static_cast<HllArray<A>*>(gadget_.sketch_impl)->check_rebuild_kxq_cur_min();
   return gadget_.is_empty();
 }
 
@@ -230,6 +455,10 @@ template<typename A>
 void hll_union_alloc<A>::union_impl(const hll_sketch_alloc<A>& sketch, uint8_t lg_max_k) {
   const HllSketchImpl<A>* src_impl = sketch.sketch_impl; //default
   HllSketchImpl<A>* dst_impl = gadget_.sketch_impl; //default
+  if (dst_impl->getCurMode() == HLL) {
+    // a previous merge may have left cur_min stale, and isEmpty() depends on it
+    static_cast<HllArray<A>*>(dst_impl)->check_rebuild_kxq_cur_min();
+  }
   if (src_impl->getCurMode() == LIST || src_impl->getCurMode() == SET) {
     if (dst_impl->isEmpty() && src_impl->getLgConfigK() == dst_impl->getLgConfigK()) {
       dst_impl = src_impl->copyAs(HLL_8);
@@ -0,0 +1,288 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _DIRECT_HLL_SKETCH_HPP_
+#define _DIRECT_HLL_SKETCH_HPP_
+
+#include "hll.hpp"
+
+namespace datasketches {
+
+/**
+ * An HLL sketch that keeps all of its state in a caller-supplied region of memory.
+ *
+ * <p>The region is laid out exactly like the updatable serialization format produced by
+ * hll_sketch_alloc::serialize_updatable(). Updates, including all transitions between the
+ * LIST, SET and HLL modes, modify the region in place, so the region can be a memory-mapped
+ * file that is resumed after a restart, or shared memory visible to several processes.
+ * At any time the region can be read by hll_sketch_alloc::deserialize().
+ *
+ * <p>The sketch does not own the region and never reallocates it. The region must be aligned
+ * for uint32_t access and must be at least get_max_updatable_serialization_bytes() long.
+ * For HLL_4 the auxiliary exception table may, in extremely rare cases, need to grow beyond
+ * that size. If the region has no room for the larger table, the update throws
+ * std::out_of_range and leaves the region as it was before the update.
+ *
+ * <p>This class performs no synchronization. If several threads or processes update the same
+ * region, access must be serialized by the caller.
+ *
+ * <p>The allocator is only used for short-lived scratch space during mode transitions
+ * and for heap copies of the sketch.
+ */
+template<typename A = std::allocator<uint8_t> >
+class direct_hll_sketch_alloc final {
+  public:
+    /**
+     * Initializes the given region with an empty sketch and returns a sketch operating on it.
+     * @param bytes pointer to the region, aligned for uint32_t access
+     * @param capacity size of the region in bytes
+     * @param lg_config_k Sketch can hold 2^lg_config_k rows
+     * @param tgt_type The HLL mode to use, if/when the sketch reaches that state
+     * @param start_full_size Indicates whether to start in HLL mode
+     * @param allocator allocator for scratch space and heap copies
+     * @return sketch operating on the given region
+     */
+    static direct_hll_sketch_alloc initialize(void* bytes, size_t capacity, uint8_t lg_config_k,
+        target_hll_type tgt_type = HLL_4, bool start_full_size = false, const A& allocator = A());
+
+    /**
+     * Wraps a region holding an updatable serialized image of a sketch, such as one produced by
+     * hll_sketch_alloc::serialize_updatable() or left behind by another direct sketch.
+     * Compact images cannot be wrapped.
+     * @param bytes pointer to the region, aligned for uint32_t access
+     * @param capacity size of the region in bytes
+     * @param allocator allocator for scratch space and heap copies
+     * @return sketch operating on the given region
+     */
+    static direct_hll_sketch_alloc writable_wrap(void* bytes, size_t capacity, const A& allocator = A());
+
+    /**
+     * Resets the sketch to an empty state, in HLL mode if the sketch was
+     * initialized with start_full_size, otherwise in coupon collection mode.
+     */
+    void reset();
+
+    /**
+     * Creates an independent sketch on the heap with the same state as this one.
+     * @return heap copy of this sketch
+     */
+    hll_sketch_alloc<A> heapify() const;
+
+    /**
+     * Present the given std::string as a potential unique item.
+     * The string is converted to a byte array using UTF8 encoding.
+     * If the string is null or empty no update attempt is made and the method returns.
+     * @param datum The given string.
+     */
+    void update(const std::string& datum);
+
+    /**
+     * Present the given unsigned 64-bit integer as a potential unique item.
+     * @param datum The given integer.
+     */
+    void update(uint64_t datum);
+
+    /**
+     * Present the given unsigned 32-bit integer as a potential unique item.
+     * @param datum The given integer.
+     */
+    void update(uint32_t datum);
+
+    /**
+     * Present the given unsigned 16-bit integer as a potential unique item.
+     * @param datum The given integer.
+     */
+    void update(uint16_t datum);
+
+    /**
+     * Present the given unsigned 8-bit integer as a potential unique item.
+     * @param datum The given integer.
+     */
+    void update(uint8_t datum);
+
+    /**
+     * Present the given signed 64-bit integer as a potential unique item.
+     * @param datum The given integer.
+     */
+    void update(int64_t datum);
+
+    /**
+     * Present the given signed 32-bit integer as a potential unique item.
+     * @param datum The given integer.
+     */
+    void update(int32_t datum);
+
+    /**
+     * Present the given signed 16-bit integer as a potential unique item.
+     * @param datum The given integer.
+     */
+    void update(int16_t datum);
+
+    /**
+     * Present the given signed 8-bit integer as a potential unique item.
+     * @param datum The given integer.
+     */
+    void update(int8_t datum);
+
+    /**
+     * Present the given 64-bit floating point value as a potential unique item.
+     * @param datum The given double.
+     */
+    void update(double datum);
+
+    /**
+     * Present the given 32-bit floating point value as a potential unique item.
+     * @param datum The given float.
+     */
+    void update(float datum);
+
+    /**
+     * Present the given data array as a potential unique item.
+     * @param data The given array.
+     * @param length_bytes The array length in bytes.
+     */
+    void update(const void* data, size_t length_bytes);
+
+    /**
+     * Returns the current cardinality estimate
+     * @return the cardinality estimate
+     */
+    double get_estimate() const;
+
+    /**
+     * This is less accurate than the get_estimate() method
+     * and is automatically used when the sketch has gone through
+     * union operations where the more accurate HIP estimator cannot
+     * be used.
+     * @return the composite cardinality estimate
+     */
+    double get_composite_estimate() const;
+
+    /**
+     * Returns the approximate lower error bound given the specified
+     * number of standard deviations.
+     * @param num_std_dev Number of standard deviations, an integer from the set  {1, 2, 3}.
+     * @return The approximate lower bound.
+     */
+    double get_lower_bound(uint8_t num_std_dev) const;
+
+    /**
+     * Returns the approximate upper error bound given the specified
+     * number of standard deviations.
+     * @param num_std_dev Number of standard deviations, an integer from the set  {1, 2, 3}.
+     * @return The approximate upper bound.
+     */
+    double get_upper_bound(uint8_t num_std_dev) const;
+
+    /**
+     * Returns sketch's configured lg_k value.
+     * @return Configured lg_k value.
+     */
+    uint8_t get_lg_config_k() const;
+
+    /**
+     * Returns the sketch's target HLL mode (from #target_hll_type).
+     * @return The sketch's target HLL mode.
+     */
+    target_hll_type get_target_type() const;
+
+    /**
+     * Indicates if the sketch is currently empty.
+     * @return True if the sketch is empty.
+     */
+    bool is_empty() const;
+
+    /**
+     * Returns the number of bytes of the region currently occupied by the sketch image.
+     * @return Size of the updatable image in the region, in bytes.
+     */
+    uint32_t get_updatable_serialization_bytes() const;
+
+    /**
+     * Returns the minimum region size required to hold a sketch with the given parameters
+     * through all of its mode transitions.
+     * @param lg_config_k The Log2 of K for the target HLL sketch.
+     * @param tgt_type the desired Hll type
+     * @return required region size in bytes
+     */
+    static uint32_t get_max_updatable_serialization_bytes(uint8_t lg_config_k, target_hll_type tgt_type);
+
+  private:
+    // the pool keeps the HLL mode state of its sketches in direct images
+    template<typename> friend class hll_sketch_pool_alloc;
+
+    using vector_u32 = std::vector<uint32_t, typename std::allocator_traits<A>::template rebind_alloc<uint32_t>>;
+
+    direct_hll_sketch_alloc(uint8_t* bytes, size_t capacity, const A& allocator);
+
+    static void check_region(const void* bytes, size_t capacity, uint8_t lg_config_k, target_hll_type tgt_type);
+
+    void coupon_update(uint32_t coupon);
+    void list_update(uint32_t coupon);
+    void set_update(uint32_t coupon);
+    void hll_update(uint32_t coupon);
+    void hll4_update(uint32_t slot, uint8_t new_value);
+
+    void write_list_preamble(uint8_t lg_config_k, target_hll_type tgt_type);
+    void write_set_preamble(uint8_t lg_arr_ints);
+    void write_hll_preamble(bool start_full_size);
+    void promote_list_to_set();
+    void grow_set(uint8_t tgt_lg_arr_ints);
+    void promote_to_hll();
+    void promote_to_hll(const uint32_t* coupons, uint32_t num_coupons);
+    vector_u32 collect_coupons() const;
+
+    uint8_t get_hll4_slot(uint32_t slot) const;
+    void put_hll4_slot(uint32_t slot, uint8_t value);
+    uint8_t get_hll6_slot(uint32_t slot) const;
+    void put_hll6_slot(uint32_t slot, uint8_t value);
+    void hip_and_kxq_incremental_update(uint8_t old_value, uint8_t new_value);
+    void shift_to_bigger_cur_min();
+    uint32_t* aux_arr() const;
+    void aux_add(uint32_t slot, uint8_t value);
+    void aux_replace(uint32_t slot, uint8_t value);
+    uint8_t aux_find_value(uint32_t slot) const;
+    void aux_grow();
+
+    hll_mode get_current_mode() const;
+    uint32_t get_coupon_count() const;
+    uint32_t* coupons() const;
+    uint8_t get_lg_arr_ints() const;
+    uint32_t get_hll_arr_bytes() const;
+    bool is_out_of_order_flag() const;
+    void clear_empty_flag();
+
+    uint32_t get_u32(uint32_t offset) const;
+    void put_u32(uint32_t offset, uint32_t value);
+    double get_double(uint32_t offset) const;
+    void put_double(uint32_t offset, double value);
+
+    uint8_t* bytes_;
+    size_t capacity_;
+    A allocator_;
+};
+
+/// convenience alias for direct_hll_sketch with default allocator
+typedef direct_hll_sketch_alloc<> direct_hll_sketch;
+
+} // namespace datasketches
+
+#include "DirectHllSketch-internal.hpp"
+
+#endif // _DIRECT_HLL_SKETCH_HPP_
@@ -512,6 +512,53 @@ class hll_union_alloc {
      * @param sketch The given sketch.
      */
     void update(hll_sketch_alloc<A>&& sketch);
+
+    /**
+     * Update this union operator with a batch of serialized sketches, compact or updatable,
+     * reading their registers and coupons directly from the serialized images.
+     *
+     * <p>All images are checked before anything is merged. The coupons of the sketches before
+     * the first HLL-mode one go into the union as they would one sketch at a time. From there on
+     * the final lg_k is known from the headers, and all registers and coupons go into a single
+     * HLL_8 array of that size, without intermediate sketches, mode promotions or repeated
+     * downsampling.
+     *
+     * <p>The resulting registers are the same as after updating with each deserialized sketch
+     * in turn. The HIP estimator is kept as long as at most one HLL-mode sketch is involved,
+     * counting the union itself if it is in HLL mode, possibly promoted by the preceding coupons,
+     * when the first HLL-mode sketch arrives. Otherwise the union is out of order, as it would
+     * be after merging an HLL-mode sketch into an HLL-mode union.
+     *
+     * @param first iterator to the first serialized sketch
+     * @param last iterator past the last serialized sketch
+     * The elements must provide data() and size(), like vector_bytes or std::string.
+     */
+    template<typename InputIt>
+    void update_serialized(InputIt first, InputIt last);
+
+    /**
+     * Update this union operator with a range of sketches, spreading the work over
+     * the given number of threads.
+     *
+     * <p>The range is split into contiguous chunks, each of which goes into a separate
+     * union on its own thread, and the partial results are merged into this union at the end.
+     *
+     * <p>The HIP estimator depends on the order in which coupons arrive, so sketches are
+     * taken in order, on the calling thread, for as long as this union is not out of order.
+     * With HLL-mode inputs this is usually the first two sketches. Only the rest of the range
+     * is processed in parallel. The registers, mode, lg_k, out-of-order flag, estimates and
+     * bounds are therefore the same as after updating with each sketch in turn.
+     *
+     * <p>The sketches must not be modified while this method runs. If a worker throws,
+     * the exception is rethrown here once all threads have finished, and the state
+     * of this union is unspecified.
+     *
+     * @param first iterator to the first sketch
+     * @param last iterator past the last sketch, must be a forward iterator
+     * @param num_threads number of threads to use, including the calling thread
+     */
+    template<typename ForwardIt>
+    void update_parallel(ForwardIt first, ForwardIt last, unsigned num_threads);
   
     /**
      * Present the given std::string as a potential unique item.
@@ -614,6 +661,20 @@ class hll_union_alloc {
     */
     inline void union_impl(const hll_sketch_alloc<A>& sketch, uint8_t lg_max_k);
 
+    // header of a serialized sketch checked by update_serialized()
+    struct serialized_image {
+      const uint8_t* data;
+      hll_mode mode;
+      uint8_t lg_k;
+      bool empty;
+      uint32_t num_items; // coupon slots to read in LIST and SET modes
+    };
+
+    static serialized_image check_serialized_image(const void* bytes, size_t len);
+
+    template<typename F>
+    static void for_each_coupon(const serialized_image& image, F f);
+
     static HllSketchImpl<A>* copy_or_downsample(const HllSketchImpl<A>* src_impl, uint8_t tgt_lg_k);
 
     void coupon_update(uint32_t coupon);
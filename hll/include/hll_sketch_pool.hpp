@@ -0,0 +1,333 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _HLL_SKETCH_POOL_HPP_
+#define _HLL_SKETCH_POOL_HPP_
+
+#include <vector>
+
+#include "hll.hpp"
+#include "direct_hll_sketch.hpp"
+
+namespace datasketches {
+
+/**
+ * A pool of HLL sketches sharing one configuration, meant for applications that keep
+ * millions of sketches, most of which only ever see a few distinct items.
+ *
+ * <p>Sketches are identified by compact handles rather than being separate objects.
+ * Each sketch occupies a 32-byte entry holding up to six coupons inline, which covers
+ * the common case of a sketch in LIST mode without any further memory. Larger coupon sets
+ * and HLL arrays live in fixed-size blocks carved out of slabs, one slab per block size,
+ * and are recycled through free lists when sketches grow, are reset or destroyed.
+ * HLL arrays use the updatable serialization layout and are operated on in place
+ * (see direct_hll_sketch_alloc).
+ *
+ * <p>A pooled sketch promotes to HLL mode at the same number of distinct coupons
+ * as hll_sketch_alloc, so estimates and bounds are the same as those of a heap sketch fed
+ * the same input. In the coupon modes the pool does not keep the exact LIST and SET layout
+ * of the heap sketch, so get_sketch() returns an equivalent, but not necessarily
+ * byte-identical, heap sketch.
+ *
+ * <p>Use get_sketch() to serialize a pooled sketch or to feed it into an hll_union_alloc.
+ * Handles of destroyed sketches are reused by create(). The pool is not thread-safe.
+ */
+template<typename A = std::allocator<uint8_t> >
+class hll_sketch_pool_alloc final {
+  public:
+    /// Sketch handle
+    using handle = uint32_t;
+
+    /**
+     * Constructs a new pool
+     * @param lg_config_k Every sketch in the pool can hold 2^lg_config_k rows.
+     *        The value must be between 4 and 21, inclusive.
+     * @param tgt_type The HLL mode the sketches use once they reach that state
+     * @param allocator instance of an Allocator
+     */
+    explicit hll_sketch_pool_alloc(uint8_t lg_config_k, target_hll_type tgt_type = HLL_4, const A& allocator = A());
+
+    hll_sketch_pool_alloc(const hll_sketch_pool_alloc&) = delete;
+    hll_sketch_pool_alloc& operator=(const hll_sketch_pool_alloc&) = delete;
+    hll_sketch_pool_alloc(hll_sketch_pool_alloc&&) = default;
+    hll_sketch_pool_alloc& operator=(hll_sketch_pool_alloc&&) = default;
+
+    /**
+     * Creates a new empty sketch in the pool
+     * @return handle of the new sketch
+     */
+    handle create();
+
+    /**
+     * Destroys the given sketch, returning its memory to the pool.
+     * The handle may be returned again by subsequent calls to create().
+     * @param h handle of the sketch to destroy
+     */
+    void destroy(handle h);
+
+    /**
+     * Resets the given sketch to an empty state in coupon collection mode.
+     * @param h handle of the sketch
+     */
+    void reset(handle h);
+
+    /**
+     * Present the given std::string as a potential unique item.
+     * The string is converted to a byte array using UTF8 encoding.
+     * If the string is null or empty no update attempt is made and the method returns.
+     * @param h handle of the sketch
+     * @param datum The given string.
+     */
+    void update(handle h, const std::string& datum);
+
+    /**
+     * Present the given unsigned 64-bit integer as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given integer.
+     */
+    void update(handle h, uint64_t datum);
+
+    /**
+     * Present the given unsigned 32-bit integer as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given integer.
+     */
+    void update(handle h, uint32_t datum);
+
+    /**
+     * Present the given unsigned 16-bit integer as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given integer.
+     */
+    void update(handle h, uint16_t datum);
+
+    /**
+     * Present the given unsigned 8-bit integer as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given integer.
+     */
+    void update(handle h, uint8_t datum);
+
+    /**
+     * Present the given signed 64-bit integer as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given integer.
+     */
+    void update(handle h, int64_t datum);
+
+    /**
+     * Present the given signed 32-bit integer as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given integer.
+     */
+    void update(handle h, int32_t datum);
+
+    /**
+     * Present the given signed 16-bit integer as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given integer.
+     */
+    void update(handle h, int16_t datum);
+
+    /**
+     * Present the given signed 8-bit integer as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given integer.
+     */
+    void update(handle h, int8_t datum);
+
+    /**
+     * Present the given 64-bit floating point value as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given double.
+     */
+    void update(handle h, double datum);
+
+    /**
+     * Present the given 32-bit floating point value as a potential unique item.
+     * @param h handle of the sketch
+     * @param datum The given float.
+     */
+    void update(handle h, float datum);
+
+    /**
+     * Present the given data array as a potential unique item.
+     * @param h handle of the sketch
+     * @param data The given array.
+     * @param length_bytes The array length in bytes.
+     */
+    void update(handle h, const void* data, size_t length_bytes);
+
+    /**
+     * Returns the current cardinality estimate of the given sketch
+     * @param h handle of the sketch
+     * @return the cardinality estimate
+     */
+    double get_estimate(handle h) const;
+
+    /**
+     * Returns the composite cardinality estimate of the given sketch.
+     * See hll_sketch_alloc::get_composite_estimate().
+     * @param h handle of the sketch
+     * @return the composite cardinality estimate
+     */
+    double get_composite_estimate(handle h) const;
+
+    /**
+     * Returns the approximate lower error bound of the given sketch given the specified
+     * number of standard deviations.
+     * @param h handle of the sketch
+     * @param num_std_dev Number of standard deviations, an integer from the set  {1, 2, 3}.
+     * @return The approximate lower bound.
+     */
+    double get_lower_bound(handle h, uint8_t num_std_dev) const;
+
+    /**
+     * Returns the approximate upper error bound of the given sketch given the specified
+     * number of standard deviations.
+     * @param h handle of the sketch
+     * @param num_std_dev Number of standard deviations, an integer from the set  {1, 2, 3}.
+     * @return The approximate upper bound.
+     */
+    double get_upper_bound(handle h, uint8_t num_std_dev) const;
+
+    /**
+     * Indicates if the given sketch is currently empty.
+     * @param h handle of the sketch
+     * @return True if the sketch is empty.
+     */
+    bool is_empty(handle h) const;
+
+    /**
+     * Returns the current mode of the given sketch.
+     * @param h handle of the sketch
+     * @return LIST, SET or HLL
+     */
+    hll_mode get_current_mode(handle h) const;
+
+    /**
+     * Creates a heap copy of the given sketch, for instance to serialize it
+     * or to feed it into a union.
+     * @param h handle of the sketch
+     * @return heap copy of the sketch
+     */
+    hll_sketch_alloc<A> get_sketch(handle h) const;
+
+    /**
+     * Returns the lg_config_k shared by all sketches in the pool.
+     * @return Configured lg_k value.
+     */
+    uint8_t get_lg_config_k() const;
+
+    /**
+     * Returns the target HLL mode shared by all sketches in the pool.
+     * @return The target HLL mode.
+     */
+    target_hll_type get_target_type() const;
+
+    /**
+     * Returns the number of live sketches in the pool.
+     * @return number of sketches created and not yet destroyed
+     */
+    uint32_t get_num_sketches() const;
+
+    /**
+     * Returns the number of bytes of memory held by the pool, including free blocks.
+     * @return memory usage in bytes
+     */
+    size_t get_memory_usage() const;
+
+  private:
+    enum entry_state : uint8_t { FREE, LIST_STATE, SET_STATE, HLL_STATE };
+
+    static const uint8_t INLINE_COUPONS = 6;
+    static const uint8_t LG_MIN_SET_SIZE = 4;
+
+    struct entry {
+      entry_state state;
+      uint8_t lg_arr;  // SET: lg size of the coupon block, HLL: lg size of the aux region the block can hold
+      uint16_t reserved;
+      uint32_t count;  // number of coupons in LIST and SET states
+      union {
+        uint32_t coupons[INLINE_COUPONS];  // LIST
+        uint32_t block;                    // SET and HLL
+      };
+    };
+
+    // fixed-size blocks of T in chunks that are never moved, so indices stay valid
+    template<typename T>
+    class slab {
+      public:
+        slab(uint32_t block_size, const A& allocator);
+        slab(slab&& other) noexcept;
+        slab& operator=(slab&& other) noexcept;
+        ~slab();
+        uint32_t allocate();
+        void deallocate(uint32_t index);
+        T* get(uint32_t index) const;
+        uint32_t get_block_size() const;
+        uint32_t get_num_blocks() const;
+        size_t get_memory_usage() const;
+
+      private:
+        using AllocT = typename std::allocator_traits<A>::template rebind_alloc<T>;
+        using AllocPtr = typename std::allocator_traits<A>::template rebind_alloc<T*>;
+        using AllocU32 = typename std::allocator_traits<A>::template rebind_alloc<uint32_t>;
+        AllocT allocator_;
+        uint32_t block_size_;
+        uint8_t lg_blocks_per_chunk_;
+        uint32_t num_blocks_;
+        std::vector<T*, AllocPtr> chunks_;
+        std::vector<uint32_t, AllocU32> free_;
+        void release();
+    };
+
+    using AllocSlab = typename std::allocator_traits<A>::template rebind_alloc<slab<uint32_t>>;
+
+    uint8_t lg_config_k_;
+    target_hll_type tgt_type_;
+    uint8_t lg_base_aux_ints_;
+    uint32_t hll_threshold_;
+    uint32_t num_sketches_;
+    A allocator_;
+    slab<entry> entries_;
+    std::vector<slab<uint32_t>, AllocSlab> set_slabs_; // by lg_arr - LG_MIN_SET_SIZE
+    std::vector<slab<uint32_t>, AllocSlab> hll_slabs_; // by lg_arr - lg_base_aux_ints_
+
+    entry& get_entry(handle h) const;
+    void coupon_update(handle h, uint32_t coupon);
+    void list_update(entry& e, uint32_t coupon);
+    void set_update(entry& e, uint32_t coupon);
+    void hll_update(entry& e, uint32_t coupon);
+    void move_to_set(entry& e, uint8_t lg_arr);
+    void promote_to_hll(entry& e);
+    void release_block(entry& e);
+    slab<uint32_t>& get_set_slab(uint8_t lg_arr);
+    slab<uint32_t>& get_hll_slab(uint8_t lg_aux_arr_ints);
+    direct_hll_sketch_alloc<A> get_direct_sketch(const entry& e) const;
+};
+
+/// convenience alias for hll_sketch_pool with default allocator
+typedef hll_sketch_pool_alloc<> hll_sketch_pool;
+
+} // namespace datasketches
+
+#include "HllSketchPool-internal.hpp"
+
+#endif // _HLL_SKETCH_POOL_HPP_
@@ -0,0 +1,186 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "direct_hll_sketch.hpp"
+
+namespace datasketches {
+
+// uint32_t elements keep the region aligned as required
+using region = std::vector<uint32_t>;
+
+static region make_region(uint8_t lg_k, target_hll_type type) {
+  return region((direct_hll_sketch::get_max_updatable_serialization_bytes(lg_k, type) + 3) / 4, 0xffffffff);
+}
+
+static void check_image(const hll_sketch& heap, const direct_hll_sketch& direct, const region& mem) {
+  const auto bytes = heap.serialize_updatable();
+  REQUIRE(bytes.size() == direct.get_updatable_serialization_bytes());
+  REQUIRE(std::memcmp(bytes.data(), mem.data(), bytes.size()) == 0);
+  REQUIRE(heap.get_estimate() == direct.get_estimate());
+  REQUIRE(heap.get_composite_estimate() == direct.get_composite_estimate());
+  REQUIRE(heap.get_lower_bound(1) == direct.get_lower_bound(1));
+  REQUIRE(heap.get_upper_bound(2) == direct.get_upper_bound(2));
+  REQUIRE(heap.is_empty() == direct.is_empty());
+}
+
+static void check_same_as_heap(uint8_t lg_k, target_hll_type type, uint64_t n) {
+  hll_sketch heap(lg_k, type);
+  region mem = make_region(lg_k, type);
+  auto direct = direct_hll_sketch::initialize(mem.data(), mem.size() * 4, lg_k, type);
+  check_image(heap, direct, mem);
+
+  uint64_t checkpoint = 1;
+  for (uint64_t i = 0; i < n; ++i) {
+    heap.update(i);
+    direct.update(i);
+    if (i + 1 == checkpoint) {
+      check_image(heap, direct, mem);
+      checkpoint *= 2;
+    }
+  }
+  check_image(heap, direct, mem);
+}
+
+TEST_CASE("direct hll sketch: same image as heap sketch", "[direct_hll_sketch]") {
+  for (uint8_t lg_k: {4, 7, 8, 10, 12}) {
+    check_same_as_heap(lg_k, HLL_4, 200000);
+    check_same_as_heap(lg_k, HLL_6, 20000);
+    check_same_as_heap(lg_k, HLL_8, 20000);
+  }
+}
+
+TEST_CASE("direct hll sketch: start full size", "[direct_hll_sketch]") {
+  for (auto type: {HLL_4, HLL_6, HLL_8}) {
+    hll_sketch heap(10, type, true);
+    region mem = make_region(10, type);
+    auto direct = direct_hll_sketch::initialize(mem.data(), mem.size() * 4, 10, type, true);
+    check_image(heap, direct, mem);
+    for (int i = 0; i < 5000; ++i) {
+      heap.update(i);
+      direct.update(i);
+    }
+    check_image(heap, direct, mem);
+
+    heap.reset();
+    direct.reset();
+    check_image(heap, direct, mem);
+  }
+}
+
+TEST_CASE("direct hll sketch: resume after wrap", "[direct_hll_sketch]") {
+  const uint8_t lg_k = 11;
+  for (auto type: {HLL_4, HLL_6, HLL_8}) {
+    hll_sketch heap(lg_k, type);
+    region mem = make_region(lg_k, type);
+    direct_hll_sketch::initialize(mem.data(), mem.size() * 4, lg_k, type);
+    int value = 0;
+    for (int n: {5, 50, 500, 50000}) {
+      // a new instance each round, as if the process restarted
+      auto direct = direct_hll_sketch::writable_wrap(mem.data(), mem.size() * 4);
+      for (int i = 0; i < n; ++i, ++value) {
+        heap.update(value);
+        direct.update(value);
+      }
+      check_image(heap, direct, mem);
+      REQUIRE(direct.get_lg_config_k() == lg_k);
+      REQUIRE(direct.get_target_type() == type);
+    }
+  }
+}
+
+TEST_CASE("direct hll sketch: wrap heap image", "[direct_hll_sketch]") {
+  const uint8_t lg_k = 12;
+  for (auto type: {HLL_4, HLL_6, HLL_8}) {
+    for (int n: {0, 3, 100, 10000}) {
+      hll_sketch heap(lg_k, type);
+      for (int i = 0; i < n; ++i) heap.update(i);
+      const auto bytes = heap.serialize_updatable();
+      region mem = make_region(lg_k, type);
+      std::memcpy(mem.data(), bytes.data(), bytes.size());
+      auto direct = direct_hll_sketch::writable_wrap(mem.data(), mem.size() * 4);
+      check_image(heap, direct, mem);
+      for (int i = n; i < 2 * n + 10; ++i) {
+        heap.update(i);
+        direct.update(i);
+      }
+      check_image(heap, direct, mem);
+
+      // the region is a valid serialized image at all times
+      auto copy = direct.heapify();
+      REQUIRE(copy.get_estimate() == direct.get_estimate());
+    }
+  }
+}
+
+TEST_CASE("direct hll sketch: reset", "[direct_hll_sketch]") {
+  region mem = make_region(10, HLL_4);
+  auto direct = direct_hll_sketch::initialize(mem.data(), mem.size() * 4, 10, HLL_4);
+  for (int i = 0; i < 10000; ++i) direct.update(i);
+  REQUIRE_FALSE(direct.is_empty());
+  direct.reset();
+  REQUIRE(direct.is_empty());
+  REQUIRE(direct.get_estimate() == 0);
+  hll_sketch heap(10, HLL_4);
+  check_image(heap, direct, mem);
+}
+
+TEST_CASE("direct hll sketch: union of regions", "[direct_hll_sketch]") {
+  const uint8_t lg_k = 12;
+  region mem1 = make_region(lg_k, HLL_8);
+  region mem2 = make_region(lg_k, HLL_4);
+  auto sk1 = direct_hll_sketch::initialize(mem1.data(), mem1.size() * 4, lg_k, HLL_8);
+  auto sk2 = direct_hll_sketch::initialize(mem2.data(), mem2.size() * 4, lg_k, HLL_4);
+  for (int i = 0; i < 10000; ++i) sk1.update(i);
+  for (int i = 5000; i < 15000; ++i) sk2.update(i);
+  hll_union u(lg_k);
+  u.update(hll_sketch::deserialize(mem1.data(), mem1.size() * 4));
+  u.update(sk2.heapify());
+  REQUIRE(u.get_estimate() == Approx(15000).margin(15000 * 0.02));
+}
+
+TEST_CASE("direct hll sketch: invalid regions", "[direct_hll_sketch]") {
+  region mem = make_region(10, HLL_4);
+  // too small
+  REQUIRE_THROWS_AS(direct_hll_sketch::initialize(mem.data(), mem.size() * 4 - 4, 10, HLL_4), std::invalid_argument);
+  // misaligned
+  REQUIRE_THROWS_AS(direct_hll_sketch::initialize(reinterpret_cast<uint8_t*>(mem.data()) + 1, mem.size() * 4 - 4, 8, HLL_4), std::invalid_argument);
+  // invalid lg_k
+  REQUIRE_THROWS_AS(direct_hll_sketch::initialize(mem.data(), mem.size() * 4, 3, HLL_4), std::invalid_argument);
+
+  // compact image
+  hll_sketch heap(10, HLL_4);
+  for (int i = 0; i < 100; ++i) heap.update(i);
+  const auto compact = heap.serialize_compact();
+  std::memcpy(mem.data(), compact.data(), compact.size());
+  REQUIRE_THROWS_AS(direct_hll_sketch::writable_wrap(mem.data(), mem.size() * 4), std::invalid_argument);
+
+  // image from a sketch with larger lg_k than the region allows
+  hll_sketch big(12, HLL_4);
+  const auto big_bytes = big.serialize_updatable();
+  std::memcpy(mem.data(), big_bytes.data(), big_bytes.size());
+  REQUIRE_THROWS_AS(direct_hll_sketch::writable_wrap(mem.data(), mem.size() * 4), std::invalid_argument);
+}
+
+} /* namespace datasketches */
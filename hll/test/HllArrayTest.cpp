@@ -19,9 +19,14 @@
 
 #include "hll.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
+#include <iostream>
+#include <random>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 #include <catch2/catch.hpp>
 
 namespace datasketches {
@@ -189,4 +194,90 @@ TEST_CASE("hll array: check corrupt stream", "[hll_array]") {
   ss.put((char)tmp);
 }
 
+TEST_CASE("hll array: decrement hll 4 registers", "[hll_array]") {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(1, 15);
+  // 20 bytes: two full words and a tail
+  std::vector<uint8_t> arr(20);
+  for (auto& byte: arr) byte = static_cast<uint8_t>(dist(gen) | (dist(gen) << 4));
+  arr[3] = 0x1f;
+  arr[19] = 0xf1;
+  std::vector<uint8_t> expected(arr);
+  uint32_t expected_zeros = 0;
+  uint32_t expected_aux = 0;
+  for (auto& byte: expected) {
+    uint8_t lo = byte & 0xf;
+    uint8_t hi = byte >> 4;
+    if (lo == 15) ++expected_aux; else if (--lo == 0) ++expected_zeros;
+    if (hi == 15) ++expected_aux; else if (--hi == 0) ++expected_zeros;
+    byte = static_cast<uint8_t>(lo | (hi << 4));
+  }
+
+  uint32_t num_aux = 0;
+  const uint32_t num_zeros = Hll4Array<std::allocator<uint8_t>>::decrementRegisters(arr.data(),
+      static_cast<uint32_t>(arr.size()), num_aux);
+  REQUIRE(arr == expected);
+  REQUIRE(num_zeros == expected_zeros);
+  REQUIRE(num_aux == expected_aux);
+
+  arr[10] &= 0xf0;
+  REQUIRE_THROWS_AS(Hll4Array<std::allocator<uint8_t>>::decrementRegisters(arr.data(),
+      static_cast<uint32_t>(arr.size()), num_aux), std::runtime_error);
+}
+
+TEST_CASE("hll array: hll 4 matches hll 8 across cur_min shifts", "[hll_array]") {
+  for (uint8_t lg_k: {4, 5, 8}) {
+    hll_sketch sk4(lg_k, HLL_4);
+    hll_sketch sk8(lg_k, HLL_8);
+    uint64_t checkpoint = 16;
+    for (uint64_t i = 0; i < 2000000; ++i) {
+      sk4.update(i);
+      sk8.update(i);
+      if (i + 1 == checkpoint) {
+        REQUIRE(sk4.get_estimate() == sk8.get_estimate());
+        REQUIRE(hll_sketch(sk4, HLL_8).serialize_compact() == sk8.serialize_compact());
+        checkpoint *= 2;
+      }
+    }
+    REQUIRE(sk4.get_estimate() == sk8.get_estimate());
+    const auto bytes = sk4.serialize_updatable();
+    REQUIRE(bytes[hll_constants::HLL_CUR_MIN_BYTE] > (lg_k < 8 ? 10 : 5));
+    REQUIRE(hll_sketch(sk4, HLL_8).serialize_compact() == sk8.serialize_compact());
+  }
+}
+
+// not run by default, use the [benchmark] tag to run it
+TEST_CASE("hll array: hll 4 update latency", "[.][benchmark]") {
+  const uint8_t lg_k = 21;
+  const uint64_t n = 1ULL << 28;
+  hll_sketch sk(lg_k, HLL_4);
+  double max_latency_ns = 0;
+  // cur_min shifts and aux map rebuilds stand out from ordinary updates
+  const double slow_ns = 10000;
+  std::vector<std::pair<uint64_t, double>> slow_updates;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < n; ++i) {
+    const auto before = std::chrono::steady_clock::now();
+    sk.update(i);
+    const double latency_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count();
+    max_latency_ns = std::max(max_latency_ns, latency_ns);
+    if (latency_ns > slow_ns) slow_updates.push_back(std::make_pair(i, latency_ns));
+  }
+  const double total_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "HLL_4 lg_k=" << static_cast<int>(lg_k) << " n=" << n << ": "
+            << n / total_s / 1e6 << " M updates/s (including timing), max latency "
+            << max_latency_ns / 1000 << " us, cur_min "
+            << static_cast<int>(sk.serialize_updatable()[hll_constants::HLL_CUR_MIN_BYTE]) << std::endl;
+  std::cout << slow_updates.size() << " updates over " << slow_ns / 1000 << " us, the slowest after HLL promotion:" << std::endl;
+  std::sort(slow_updates.begin(), slow_updates.end(),
+      [](const std::pair<uint64_t, double>& a, const std::pair<uint64_t, double>& b) { return a.second > b.second; });
+  int num_printed = 0;
+  for (const auto& update: slow_updates) {
+    if (update.first < (1ULL << lg_k)) continue; // coupon modes and promotion
+    std::cout << "  update " << update.first << ": " << update.second / 1000 << " us" << std::endl;
+    if (++num_printed == 10) break;
+  }
+  REQUIRE(sk.get_estimate() == Approx(n).epsilon(0.01));
+}
+
 } /* namespace datasketches */
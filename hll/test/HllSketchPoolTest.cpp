@@ -0,0 +1,183 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include "hll_sketch_pool.hpp"
+#include <test_allocator.hpp>
+
+namespace datasketches {
+
+static hll_mode get_mode(const hll_sketch& sketch) {
+  return static_cast<hll_mode>(sketch.serialize_updatable()[hll_constants::MODE_BYTE] & 0x3);
+}
+
+static void check_same(const hll_sketch& heap, const hll_sketch_pool& pool, hll_sketch_pool::handle h) {
+  REQUIRE(pool.get_estimate(h) == heap.get_estimate());
+  REQUIRE(pool.get_composite_estimate(h) == heap.get_composite_estimate());
+  REQUIRE(pool.get_lower_bound(h, 1) == heap.get_lower_bound(1));
+  REQUIRE(pool.get_upper_bound(h, 2) == heap.get_upper_bound(2));
+  REQUIRE(pool.is_empty(h) == heap.is_empty());
+  REQUIRE(pool.get_current_mode(h) == get_mode(heap));
+
+  const hll_sketch copy = pool.get_sketch(h);
+  REQUIRE(get_mode(copy) == get_mode(heap));
+  REQUIRE(copy.get_estimate() == heap.get_estimate());
+  REQUIRE(copy.get_lower_bound(1) == heap.get_lower_bound(1));
+  if (get_mode(heap) == HLL) {
+    REQUIRE(copy.serialize_updatable() == heap.serialize_updatable());
+  }
+}
+
+TEST_CASE("hll sketch pool: same results as heap sketch", "[hll_sketch_pool]") {
+  for (uint8_t lg_k: {4, 7, 8, 11}) {
+    for (auto type: {HLL_4, HLL_6, HLL_8}) {
+      hll_sketch_pool pool(lg_k, type);
+      hll_sketch heap(lg_k, type);
+      const auto h = pool.create();
+      check_same(heap, pool, h);
+      uint64_t checkpoint = 64;
+      for (uint64_t i = 0; i < 50000; ++i) {
+        heap.update(i);
+        pool.update(h, i);
+        // every transition of the coupon modes, then sparser
+        if (i < 64 || i + 1 == checkpoint) {
+          check_same(heap, pool, h);
+          if (i + 1 == checkpoint) checkpoint *= 2;
+        }
+      }
+      check_same(heap, pool, h);
+    }
+  }
+}
+
+TEST_CASE("hll sketch pool: many interleaved sketches", "[hll_sketch_pool]") {
+  const uint8_t lg_k = 10;
+  hll_sketch_pool pool(lg_k, HLL_4);
+  std::vector<hll_sketch> heaps;
+  std::vector<hll_sketch_pool::handle> handles;
+  const int num_sketches = 100;
+  for (int i = 0; i < num_sketches; ++i) {
+    heaps.push_back(hll_sketch(lg_k, HLL_4));
+    handles.push_back(pool.create());
+  }
+  REQUIRE(pool.get_num_sketches() == num_sketches);
+  // sketch i gets about i * i distinct values
+  for (int n = 0; n < num_sketches * num_sketches; ++n) {
+    for (int i = 0; i < num_sketches; ++i) {
+      if (n < i * i) {
+        heaps[i].update(n);
+        pool.update(handles[i], n);
+      }
+    }
+  }
+  for (int i = 0; i < num_sketches; ++i) {
+    check_same(heaps[i], pool, handles[i]);
+  }
+}
+
+TEST_CASE("hll sketch pool: destroy and reuse", "[hll_sketch_pool]") {
+  hll_sketch_pool pool(12, HLL_8);
+  const auto h1 = pool.create();
+  const auto h2 = pool.create();
+  for (int i = 0; i < 10000; ++i) pool.update(h1, i);
+  for (int i = 0; i < 100; ++i) pool.update(h2, i);
+  REQUIRE(pool.get_current_mode(h1) == HLL);
+  REQUIRE(pool.get_current_mode(h2) == SET);
+
+  pool.destroy(h1);
+  pool.destroy(h2);
+  const size_t usage = pool.get_memory_usage();
+  REQUIRE(pool.get_num_sketches() == 0);
+  REQUIRE_THROWS_AS(pool.get_estimate(h1), std::invalid_argument);
+  REQUIRE_THROWS_AS(pool.update(h2, 1), std::invalid_argument);
+  REQUIRE_THROWS_AS(pool.is_empty(1000), std::invalid_argument);
+
+  // freed entries and blocks are reused
+  const auto h3 = pool.create();
+  const auto h4 = pool.create();
+  REQUIRE(pool.is_empty(h3));
+  REQUIRE(pool.is_empty(h4));
+  for (int i = 0; i < 10000; ++i) pool.update(h3, i);
+  for (int i = 0; i < 100; ++i) pool.update(h4, i);
+  REQUIRE(pool.get_memory_usage() == usage);
+  REQUIRE(pool.get_num_sketches() == 2);
+}
+
+TEST_CASE("hll sketch pool: reset", "[hll_sketch_pool]") {
+  hll_sketch_pool pool(8, HLL_6);
+  const auto h = pool.create();
+  for (int i = 0; i < 1000; ++i) pool.update(h, i);
+  REQUIRE(pool.get_current_mode(h) == HLL);
+  pool.reset(h);
+  REQUIRE(pool.is_empty(h));
+  REQUIRE(pool.get_current_mode(h) == LIST);
+  REQUIRE(pool.get_estimate(h) == 0);
+  hll_sketch heap(8, HLL_6);
+  for (int i = 0; i < 20; ++i) {
+    pool.update(h, i);
+    heap.update(i);
+  }
+  check_same(heap, pool, h);
+}
+
+TEST_CASE("hll sketch pool: union of pooled sketches", "[hll_sketch_pool]") {
+  hll_sketch_pool pool(12, HLL_4);
+  hll_union u(12);
+  for (int i = 0; i < 1000; ++i) {
+    const auto h = pool.create();
+    for (int j = 0; j < 10; ++j) pool.update(h, i * 10 + j);
+    u.update(pool.get_sketch(h));
+  }
+  REQUIRE(u.get_estimate() == Approx(10000).margin(10000 * 0.02));
+}
+
+TEST_CASE("hll sketch pool: small sketches are compact", "[hll_sketch_pool]") {
+  hll_sketch_pool pool(12, HLL_4);
+  const int num_sketches = 100000;
+  for (int i = 0; i < num_sketches; ++i) {
+    const auto h = pool.create();
+    for (int j = 0; j < 5; ++j) pool.update(h, i * 5 + j);
+  }
+  REQUIRE(pool.get_memory_usage() < num_sketches * 40);
+}
+
+TEST_CASE("hll sketch pool: allocation", "[hll_sketch_pool]") {
+  test_allocator_total_bytes = 0;
+  {
+    hll_sketch_pool_alloc<test_allocator<uint8_t>> pool(10, HLL_4, test_allocator<uint8_t>(0));
+    for (int i = 0; i < 100; ++i) {
+      const auto h = pool.create();
+      for (int j = 0; j < i * 100; ++j) pool.update(h, j);
+      if (i % 3 == 0) pool.destroy(h);
+    }
+    REQUIRE(test_allocator_total_bytes != 0);
+  }
+  REQUIRE(test_allocator_total_bytes == 0);
+}
+
+TEST_CASE("hll sketch pool: invalid lg_k", "[hll_sketch_pool]") {
+  REQUIRE_THROWS_AS(hll_sketch_pool(3), std::invalid_argument);
+  REQUIRE_THROWS_AS(hll_sketch_pool(22), std::invalid_argument);
+}
+
+} /* namespace datasketches */
@@ -18,8 +18,10 @@
  */
 
 #include <catch2/catch.hpp>
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
 
 #include "hll.hpp"
 
@@ -314,4 +316,216 @@ TEST_CASE("hll union: check hll to hll", "[hll_union]") {
   union_two_sketches_with_overlap(1000000, 11, HLL_4);
 }
 
+TEST_CASE("hll union: downsampled gadget is not empty", "[hll_union]") {
+  hll_sketch sketch1(14, HLL_4);
+  for (int key = 0; key < 100000; key++) sketch1.update(key);
+  hll_sketch sketch2(13, HLL_6);
+  for (int key = 100000; key < 200000; key++) sketch2.update(key);
+
+  // no query between the updates to refresh the state of the gadget
+  hll_union u(10);
+  u.update(sketch1);
+  u.update(sketch2);
+  REQUIRE(u.get_estimate() == Approx(200000).margin(200000 * 0.1));
+}
+
+static std::vector<hll_sketch::vector_bytes> make_serialized_sketches(const std::vector<uint8_t>& lg_ks,
+    const std::vector<uint64_t>& sizes) {
+  const target_hll_type types[] = {HLL_4, HLL_6, HLL_8};
+  std::vector<hll_sketch::vector_bytes> images;
+  uint64_t value = 0;
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    hll_sketch sk(lg_ks[i % lg_ks.size()], types[i % 3]);
+    // overlapping ranges
+    value -= value / 3;
+    for (uint64_t j = 0; j < sizes[i]; ++j) sk.update(value++);
+    images.push_back(i % 2 ? sk.serialize_compact() : sk.serialize_updatable());
+  }
+  return images;
+}
+
+static hll_sketch::vector_bytes get_registers(const hll_union& u) {
+  const auto bytes = u.get_result(HLL_8).serialize_updatable();
+  return hll_sketch::vector_bytes(bytes.begin() + hll_constants::HLL_BYTE_ARR_START, bytes.end());
+}
+
+static void check_bulk_union(uint8_t lg_max_k, const std::vector<hll_sketch::vector_bytes>& images) {
+  hll_union sequential(lg_max_k);
+  for (const auto& image: images) sequential.update(hll_sketch::deserialize(image.data(), image.size()));
+  hll_union bulk(lg_max_k);
+  bulk.update_serialized(images.begin(), images.end());
+
+  REQUIRE(bulk.get_lg_config_k() == sequential.get_lg_config_k());
+  REQUIRE(bulk.is_empty() == sequential.is_empty());
+  REQUIRE(bulk.get_composite_estimate() == Approx(sequential.get_composite_estimate()).epsilon(1e-12));
+  REQUIRE(bulk.get_estimate() == Approx(sequential.get_estimate()).epsilon(1e-12));
+  REQUIRE(bulk.get_lower_bound(2) == Approx(sequential.get_lower_bound(2)).epsilon(1e-12));
+  const hll_sketch bulk_result = bulk.get_result(HLL_8);
+  const hll_sketch sequential_result = sequential.get_result(HLL_8);
+  const auto bulk_bytes = bulk_result.serialize_updatable();
+  const auto sequential_bytes = sequential_result.serialize_updatable();
+  const uint8_t mode = bulk_bytes[hll_constants::MODE_BYTE] & 0x3;
+  REQUIRE(mode == (sequential_bytes[hll_constants::MODE_BYTE] & 0x3));
+  REQUIRE((bulk_bytes[hll_constants::FLAGS_BYTE] & hll_constants::OUT_OF_ORDER_FLAG_MASK) ==
+      (sequential_bytes[hll_constants::FLAGS_BYTE] & hll_constants::OUT_OF_ORDER_FLAG_MASK));
+  if (mode == HLL) {
+    REQUIRE(get_registers(bulk) == get_registers(sequential));
+  }
+}
+
+TEST_CASE("hll union: update serialized, hll mode inputs", "[hll_union]") {
+  check_bulk_union(12, make_serialized_sketches({12}, {10000, 20000, 5000}));
+  check_bulk_union(12, make_serialized_sketches({10, 14, 12, 11}, {10000, 100000, 5000, 50000}));
+  check_bulk_union(10, make_serialized_sketches({14, 13}, {100000, 100000}));
+  check_bulk_union(21, make_serialized_sketches({14, 8, 16}, {100000, 1000, 100000}));
+}
+
+TEST_CASE("hll union: update serialized, mixed inputs", "[hll_union]") {
+  // HLL-mode sketch first keeps the HIP estimator as in the sequential union
+  check_bulk_union(12, make_serialized_sketches({12, 12, 10, 14}, {100000, 3, 100, 7}));
+  check_bulk_union(11, make_serialized_sketches({13, 8, 12}, {100000, 5, 200}));
+  check_bulk_union(12, make_serialized_sketches({12, 10, 11, 9, 14}, {0, 1000, 3, 100000, 20}));
+  check_bulk_union(12, make_serialized_sketches({4, 12, 7}, {1000, 1000, 1000}));
+}
+
+TEST_CASE("hll union: update serialized, coupons promote the union before an hll mode input", "[hll_union]") {
+  // the coupons of the small sketches promote the union to HLL mode,
+  // so merging the large sketch afterwards makes it out of order
+  std::vector<hll_sketch::vector_bytes> images;
+  uint64_t value = 0;
+  for (int i = 0; i < 200; ++i) {
+    hll_sketch sk(10);
+    for (int j = 0; j < 5; ++j) sk.update(value++);
+    images.push_back(sk.serialize_compact());
+  }
+  hll_sketch large(10);
+  for (int j = 0; j < 5000; ++j) large.update(value++);
+  images.push_back(large.serialize_updatable());
+  check_bulk_union(10, images);
+
+  // the large sketch first keeps the HIP estimator
+  std::rotate(images.begin(), images.end() - 1, images.end());
+  check_bulk_union(10, images);
+}
+
+TEST_CASE("hll union: update serialized, coupon mode inputs", "[hll_union]") {
+  check_bulk_union(12, make_serialized_sketches({12}, {7}));
+  check_bulk_union(12, make_serialized_sketches({12, 10, 14}, {5, 100, 30}));
+  check_bulk_union(12, make_serialized_sketches({12, 12, 12, 12}, {100, 100, 100, 100}));
+  check_bulk_union(8, make_serialized_sketches({8, 12, 16}, {7, 20, 50}));
+}
+
+TEST_CASE("hll union: update serialized, current state is kept", "[hll_union]") {
+  for (uint64_t n: {0, 5, 100, 10000}) {
+    const auto images = make_serialized_sketches({12, 10, 14}, {5000, 50, 20000});
+    hll_sketch sk(11, HLL_6);
+    for (uint64_t i = 0; i < n; ++i) sk.update(i + 1000000);
+
+    hll_union sequential(12);
+    sequential.update(sk);
+    for (const auto& image: images) sequential.update(hll_sketch::deserialize(image.data(), image.size()));
+    hll_union bulk(12);
+    bulk.update(sk);
+    bulk.update_serialized(images.begin(), images.end());
+
+    REQUIRE(bulk.get_lg_config_k() == sequential.get_lg_config_k());
+    REQUIRE(bulk.get_estimate() == Approx(sequential.get_estimate()).epsilon(1e-12));
+    REQUIRE(get_registers(bulk) == get_registers(sequential));
+  }
+}
+
+TEST_CASE("hll union: update serialized, empty and invalid inputs", "[hll_union]") {
+  std::vector<hll_sketch::vector_bytes> images;
+  hll_sketch empty(12);
+  images.push_back(empty.serialize_compact());
+  images.push_back(empty.serialize_updatable());
+  hll_sketch empty_hll(12, HLL_4, true);
+  images.push_back(empty_hll.serialize_updatable());
+  hll_union u(12);
+  u.update_serialized(images.begin(), images.end());
+  REQUIRE(u.is_empty());
+
+  hll_sketch sk(12);
+  for (int i = 0; i < 1000; ++i) sk.update(i);
+  images.push_back(sk.serialize_compact());
+  auto truncated = sk.serialize_compact();
+  truncated.resize(truncated.size() - 1);
+  images.push_back(truncated);
+  REQUIRE_THROWS_AS(u.update_serialized(images.begin(), images.end()), std::out_of_range);
+  REQUIRE(u.is_empty()); // nothing merged
+
+  images.back() = sk.serialize_compact();
+  images.back()[hll_constants::FAMILY_BYTE] = 0;
+  REQUIRE_THROWS_AS(u.update_serialized(images.begin(), images.end()), std::invalid_argument);
+  REQUIRE(u.is_empty());
+
+  images.pop_back();
+  u.update_serialized(images.begin(), images.end());
+  REQUIRE(u.get_estimate() == sk.get_estimate());
+}
+
+static std::vector<hll_sketch> make_sketches(const std::vector<uint8_t>& lg_ks, const std::vector<uint64_t>& sizes) {
+  const target_hll_type types[] = {HLL_4, HLL_6, HLL_8};
+  std::vector<hll_sketch> sketches;
+  uint64_t value = 0;
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    hll_sketch sk(lg_ks[i % lg_ks.size()], types[i % 3]);
+    // overlapping ranges
+    value -= value / 3;
+    for (uint64_t j = 0; j < sizes[i]; ++j) sk.update(value++);
+    sketches.push_back(std::move(sk));
+  }
+  return sketches;
+}
+
+static void check_parallel_union(uint8_t lg_max_k, const std::vector<hll_sketch>& sketches) {
+  hll_union sequential(lg_max_k);
+  for (const auto& sk: sketches) sequential.update(sk);
+  const auto sequential_bytes = sequential.get_result(HLL_8).serialize_updatable();
+  for (unsigned num_threads: {1, 2, 3, 8}) {
+    hll_union parallel(lg_max_k);
+    parallel.update_parallel(sketches.begin(), sketches.end(), num_threads);
+
+    REQUIRE(parallel.get_lg_config_k() == sequential.get_lg_config_k());
+    REQUIRE(parallel.is_empty() == sequential.is_empty());
+    REQUIRE(parallel.get_estimate() == sequential.get_estimate());
+    REQUIRE(parallel.get_composite_estimate() == Approx(sequential.get_composite_estimate()).epsilon(1e-12));
+    REQUIRE(parallel.get_lower_bound(2) == sequential.get_lower_bound(2));
+    REQUIRE(parallel.get_upper_bound(1) == sequential.get_upper_bound(1));
+    const auto parallel_bytes = parallel.get_result(HLL_8).serialize_updatable();
+    // mode and flags, including out of order
+    REQUIRE(parallel_bytes[hll_constants::MODE_BYTE] == sequential_bytes[hll_constants::MODE_BYTE]);
+    REQUIRE(parallel_bytes[hll_constants::FLAGS_BYTE] == sequential_bytes[hll_constants::FLAGS_BYTE]);
+    if ((parallel_bytes[hll_constants::MODE_BYTE] & 0x3) == HLL) {
+      REQUIRE(get_registers(parallel) == get_registers(sequential));
+    }
+  }
+}
+
+TEST_CASE("hll union: update parallel, hll mode inputs", "[hll_union]") {
+  check_parallel_union(12, make_sketches({12}, std::vector<uint64_t>(50, 3000)));
+  check_parallel_union(12, make_sketches({10, 14, 12, 11}, std::vector<uint64_t>(21, 10000)));
+  check_parallel_union(10, make_sketches({14, 13}, {100000, 100000, 50000}));
+}
+
+TEST_CASE("hll union: update parallel, mixed inputs", "[hll_union]") {
+  check_parallel_union(12, make_sketches({12, 11}, {5, 100, 3000, 20, 700, 10000, 1, 300, 50000, 2, 40}));
+  // a single hll mode sketch keeps the HIP estimator
+  check_parallel_union(12, make_sketches({12}, {10, 200, 10, 5000, 7, 30, 100}));
+  check_parallel_union(12, make_sketches({12}, {5000, 10, 200, 10, 7, 30, 100}));
+}
+
+TEST_CASE("hll union: update parallel, coupon mode inputs", "[hll_union]") {
+  check_parallel_union(12, make_sketches({12}, {1, 5, 7, 30}));
+  check_parallel_union(12, make_sketches({12, 13, 14}, std::vector<uint64_t>(40, 100)));
+  check_parallel_union(12, {});
+}
+
+TEST_CASE("hll union: update parallel, invalid number of threads", "[hll_union]") {
+  const auto sketches = make_sketches({12}, {100, 10000});
+  hll_union u(12);
+  REQUIRE_THROWS_AS(u.update_parallel(sketches.begin(), sketches.end(), 0), std::invalid_argument);
+  REQUIRE(u.is_empty());
+}
+
 } /* namespace datasketches */
@@ -88,10 +88,11 @@ class kll_helper {
      * All levels except for level zero must be sorted before calling this, and will still be
      * sorted afterwards.
      * Level zero is not required to be sorted before, and may not be sorted afterwards.
+     * Sorting it uses tmp, the scratch space of get_sort_space() items for level zero.
      */
     template <typename T, typename C>
     static compress_result general_compress(uint16_t k, uint8_t m, uint8_t num_levels_in, T* items,
-            uint32_t* in_levels, uint32_t* out_levels, bool is_level_zero_sorted);
+            uint32_t* in_levels, uint32_t* out_levels, bool is_level_zero_sorted, T* tmp);
 
     template<typename T>
     static void copy_construct(const T* src, size_t src_first, size_t src_last, T* dst, size_t dst_first);
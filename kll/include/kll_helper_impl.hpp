@@ -24,6 +24,7 @@
 #include <stdexcept>
 
 #include "common_defs.hpp"
+#include "sorting.hpp"
 
 namespace datasketches {
 
@@ -124,35 +125,20 @@ void kll_helper::randomly_halve_up(T* buf, uint32_t start, uint32_t length) {
   }
 }
 
+// merge_items() takes the item from the second range if this is true, which is also the case for equivalent items
+template<typename C>
+struct take_equivalent_from_second {
+  template<typename T>
+  bool operator()(const T& item2, const T& item1) const { return !C()(item1, item2); }
+};
+
 // this version moves objects within the same buffer
 // assumes that destination has initialized objects
 // does not destroy the originals after the move
+// equivalent items are taken from the second array, the same as in the other version
 template <typename T, typename C>
 void kll_helper::merge_sorted_arrays(T* buf, uint32_t start_a, uint32_t len_a, uint32_t start_b, uint32_t len_b, uint32_t start_c) {
-  const uint32_t len_c = len_a + len_b;
-  const uint32_t lim_a = start_a + len_a;
-  const uint32_t lim_b = start_b + len_b;
-  const uint32_t lim_c = start_c + len_c;
-
-  uint32_t a = start_a;
-  uint32_t b = start_b;
-
-  for (uint32_t c = start_c; c < lim_c; c++) {
-    if (a == lim_a) {
-      if (b != c) buf[c] = std::move(buf[b]);
-      b++;
-    } else if (b == lim_b) {
-      if (a != c) buf[c] = std::move(buf[a]);
-      a++;
-    } else if (C()(buf[a], buf[b])) {
-      if (a != c) buf[c] = std::move(buf[a]);
-      a++;
-    } else {
-      if (b != c) buf[c] = std::move(buf[b]);
-      b++;
-    }
-  }
-  if (a != lim_a || b != lim_b) throw std::logic_error("inconsistent state");
+  merge_items(buf + start_a, buf + start_a + len_a, buf + start_b, buf + start_b + len_b, buf + start_c, take_equivalent_from_second<C>());
 }
 
 // this version is to merge from two different buffers into a third buffer
@@ -201,10 +187,11 @@ void kll_helper::merge_sorted_arrays(const T* buf_a, uint32_t start_a, uint32_t
  * All levels except for level zero must be sorted before calling this, and will still be
  * sorted afterwards.
  * Level zero is not required to be sorted before, and may not be sorted afterwards.
+ * Sorting it uses tmp, the scratch space of get_sort_space() items for level zero.
  */
 template <typename T, typename C>
 kll_helper::compress_result kll_helper::general_compress(uint16_t k, uint8_t m, uint8_t num_levels_in, T* items,
-        uint32_t* in_levels, uint32_t* out_levels, bool is_level_zero_sorted)
+        uint32_t* in_levels, uint32_t* out_levels, bool is_level_zero_sorted, T* tmp)
 {
   if (num_levels_in == 0) throw std::invalid_argument("num_levels_in == 0"); // things are too weird if zero levels are allowed
   const uint32_t starting_item_count = in_levels[num_levels_in] - in_levels[0];
@@ -230,7 +217,8 @@ kll_helper::compress_result kll_helper::general_compress(uint16_t k, uint8_t m,
       // move level over as is
       // make sure we are not moving data upwards
       if (raw_beg < out_levels[current_level]) throw std::logic_error("wrong move");
-      std::move(items + raw_beg, items + raw_lim, items + out_levels[current_level]);
+      // moving onto itself would leave some types like std::string empty
+      if (raw_beg != out_levels[current_level]) std::move(items + raw_beg, items + raw_lim, items + out_levels[current_level]);
       out_levels[current_level + 1] = out_levels[current_level] + raw_pop;
     } else {
       // The sketch is too full AND this level is too full, so we compact it
@@ -243,7 +231,7 @@ kll_helper::compress_result kll_helper::general_compress(uint16_t k, uint8_t m,
       const auto half_adj_pop = adj_pop / 2;
 
       if (odd_pop) { // move one guy over
-        items[out_levels[current_level]] = std::move(items[raw_beg]);
+        if (raw_beg != out_levels[current_level]) items[out_levels[current_level]] = std::move(items[raw_beg]);
         out_levels[current_level + 1] = out_levels[current_level] + 1;
       } else { // even number of items
         out_levels[current_level + 1] = out_levels[current_level];
@@ -251,7 +239,7 @@ kll_helper::compress_result kll_helper::general_compress(uint16_t k, uint8_t m,
 
       // level zero might not be sorted, so we must sort it if we wish to compact it
       if ((current_level == 0) && !is_level_zero_sorted) {
-        std::sort(items + adj_beg, items + adj_beg + adj_pop, C());
+        sort_items(items + adj_beg, items + adj_beg + adj_pop, C(), tmp);
       }
 
       if (pop_above == 0) { // Level above is empty, so halve up
@@ -20,7 +20,9 @@
 #ifndef KLL_SKETCH_HPP_
 #define KLL_SKETCH_HPP_
 
+#include <iterator>
 #include <memory>
+#include <type_traits>
 #include <vector>
 
 #include "common_defs.hpp"
@@ -188,13 +190,44 @@ class kll_sketch {
     template<typename FwdT>
     void update(FwdT&& item);
 
+    /**
+     * Updates this sketch with the given range of data items.
+     * The result is the same as updating with each item in order, but with less overhead per item.
+     * NaN items are skipped.
+     * @param first iterator to the first item
+     * @param last iterator past the last item
+     */
+    template<typename InputIt>
+    void update(InputIt first, InputIt last);
+
     /**
      * Merges another sketch into this one.
+     * This sketch keeps the work space of the merge for subsequent merges,
+     * so that merging many sketches into one does not allocate memory
+     * except when a level is added. Use shrink_work_space() to release it.
      * @param other sketch to merge into this one
      */
     template<typename FwdSk>
     void merge(FwdSk&& other);
 
+    /**
+     * Merges a range of sketches into this one.
+     * The result is statistically equivalent to merging the sketches one by one,
+     * but small sketches are gathered in batches with all their levels compacted in one pass,
+     * which is faster for many small sketches.
+     * Use std::move_iterator to move items out of the sketches.
+     * @param first iterator to the first sketch to merge into this one
+     * @param last iterator past the last sketch
+     */
+    template<typename ForwardIt>
+    void merge(ForwardIt first, ForwardIt last);
+
+    /**
+     * Releases the work space that merges and sorting keep for subsequent use.
+     * Call this after the last merge into a sketch that is kept for long.
+     */
+    void shrink_work_space();
+
     /**
      * Returns true if this sketch is empty.
      * @return empty flag
@@ -518,6 +551,8 @@ class kll_sketch {
     static const uint8_t PREAMBLE_INTS_SHORT = 2; // for empty and single item
     static const uint8_t PREAMBLE_INTS_FULL = 5;
 
+    static const uint8_t MAX_NUM_LEVELS = 64; // enough for any uint64_t N
+
     C comparator_;
     A allocator_;
     uint16_t k_;
@@ -529,6 +564,8 @@ class kll_sketch {
     vector_u32 levels_;
     T* items_;
     uint32_t items_size_;
+    T* work_items_; // uninitialized space reused by merges and sorting
+    uint32_t work_items_size_;
     T* min_item_;
     T* max_item_;
     mutable quantiles_sorted_view<T, C, A>* sorted_view_;
@@ -543,6 +580,14 @@ class kll_sketch {
     // common update code
     inline void update_min_max(const T& item);
     inline uint32_t internal_update();
+    template<typename InputIt>
+    void fill_level_zero(InputIt& first, InputIt last, T& min_item, T& max_item, std::input_iterator_tag);
+    template<typename RandomIt>
+    void fill_level_zero(RandomIt& first, RandomIt last, T& min_item, T& max_item, std::random_access_iterator_tag);
+    template<typename RandomIt, typename TT = T, typename std::enable_if<!std::is_arithmetic<TT>::value, int>::type = 0>
+    void update_min_max(RandomIt items, uint32_t num, T& min_item, T& max_item) const;
+    template<typename RandomIt, typename TT = T, typename std::enable_if<std::is_arithmetic<TT>::value, int>::type = 0>
+    void update_min_max(RandomIt items, uint32_t num, T& min_item, T& max_item) const;
 
     // The following code is only valid in the special case of exactly reaching capacity while updating.
     // It cannot be used while merging, while reducing k, or anything else.
@@ -551,8 +596,12 @@ class kll_sketch {
     uint8_t find_level_to_compact() const;
     void add_empty_top_level_to_completely_full_sketch();
     void sort_level_zero();
+    void sort_level(T* first, T* last);
 
     template<typename O> void merge_higher_levels(O&& other, uint64_t final_n);
+    template<typename ForwardIt> void merge_batch(ForwardIt first, ForwardIt last);
+    void compress_work_buffer(T* workbuf, uint32_t* worklevels, uint8_t provisional_num_levels, uint8_t ub, T* tmp);
+    T* get_work_items(uint32_t num);
 
     template<typename FwdSk>
     void populate_work_arrays(FwdSk&& other, T* workbuf, uint32_t* worklevels, uint8_t provisional_num_levels);
@@ -580,6 +629,8 @@ class kll_sketch {
 
     // for type converting constructor
     template<typename TT, typename CC, typename AA> friend class kll_sketch;
+    // to parse the serialized layout
+    template<typename TT, typename CC, typename AA> friend class wrapped_kll_sketch;
 
     void setup_sorted_view() const; // modifies mutable state
     void reset_sorted_view();
@@ -20,6 +20,8 @@
 #ifndef KLL_SKETCH_IMPL_HPP_
 #define KLL_SKETCH_IMPL_HPP_
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
@@ -45,6 +47,8 @@ n_(0),
 levels_(2, 0, allocator),
 items_(nullptr),
 items_size_(k_),
+work_items_(nullptr),
+work_items_size_(0),
 min_item_(nullptr),
 max_item_(nullptr),
 sorted_view_(nullptr)
@@ -69,6 +73,8 @@ n_(other.n_),
 levels_(other.levels_),
 items_(nullptr),
 items_size_(other.items_size_),
+work_items_(nullptr),
+work_items_size_(0),
 min_item_(nullptr),
 max_item_(nullptr),
 sorted_view_(nullptr)
@@ -92,11 +98,14 @@ n_(other.n_),
 levels_(std::move(other.levels_)),
 items_(other.items_),
 items_size_(other.items_size_),
+work_items_(other.work_items_),
+work_items_size_(other.work_items_size_),
 min_item_(other.min_item_),
 max_item_(other.max_item_),
 sorted_view_(nullptr)
 {
   other.items_ = nullptr;
+  other.work_items_ = nullptr;
   other.min_item_ = nullptr;
   other.max_item_ = nullptr;
 }
@@ -115,6 +124,8 @@ kll_sketch<T, C, A>& kll_sketch<T, C, A>::operator=(const kll_sketch& other) {
   std::swap(levels_, copy.levels_);
   std::swap(items_, copy.items_);
   std::swap(items_size_, copy.items_size_);
+  std::swap(work_items_, copy.work_items_);
+  std::swap(work_items_size_, copy.work_items_size_);
   std::swap(min_item_, copy.min_item_);
   std::swap(max_item_, copy.max_item_);
   reset_sorted_view();
@@ -134,6 +145,8 @@ kll_sketch<T, C, A>& kll_sketch<T, C, A>::operator=(kll_sketch&& other) {
   std::swap(levels_, other.levels_);
   std::swap(items_, other.items_);
   std::swap(items_size_, other.items_size_);
+  std::swap(work_items_, other.work_items_);
+  std::swap(work_items_size_, other.work_items_size_);
   std::swap(min_item_, other.min_item_);
   std::swap(max_item_, other.max_item_);
   reset_sorted_view();
@@ -148,6 +161,7 @@ kll_sketch<T, C, A>::~kll_sketch() {
     for (uint32_t i = begin; i < end; i++) items_[i].~T();
     allocator_.deallocate(items_, items_size_);
   }
+  shrink_work_space();
   if (min_item_ != nullptr) {
     min_item_->~T();
     allocator_.deallocate(min_item_, 1);
@@ -173,6 +187,8 @@ n_(other.n_),
 levels_(other.levels_, allocator_),
 items_(nullptr),
 items_size_(other.items_size_),
+work_items_(nullptr),
+work_items_size_(0),
 min_item_(nullptr),
 max_item_(nullptr),
 sorted_view_(nullptr)
@@ -198,6 +214,104 @@ void kll_sketch<T, C, A>::update(FwdT&& item) {
   reset_sorted_view();
 }
 
+template<typename T, typename C, typename A>
+template<typename InputIt>
+void kll_sketch<T, C, A>::update(InputIt first, InputIt last) {
+  // min and max are initialized by the first valid item
+  while (is_empty()) {
+    if (first == last) return;
+    update(*first++);
+  }
+  T min_item(*min_item_);
+  T max_item(*max_item_);
+  while (first != last) {
+    if (levels_[0] == 0) compress_while_updating();
+    fill_level_zero(first, last, min_item, max_item, typename std::iterator_traits<InputIt>::iterator_category());
+    is_level_zero_sorted_ = false;
+  }
+  *min_item_ = std::move(min_item);
+  *max_item_ = std::move(max_item);
+  reset_sorted_view();
+}
+
+// The free space at the beginning of level zero is filled from its end, the same as one item at a time.
+template<typename T, typename C, typename A>
+template<typename InputIt>
+void kll_sketch<T, C, A>::fill_level_zero(InputIt& first, InputIt last, T& min_item, T& max_item, std::input_iterator_tag) {
+  uint32_t index = levels_[0];
+  for (; first != last && index > 0; ++first) {
+    auto&& value = *first;
+    if (!check_update_item(value)) continue; // before the conversion to T
+    const T& item = value;
+    if (comparator_(item, min_item)) min_item = item;
+    if (comparator_(max_item, item)) max_item = item;
+    new (&items_[index - 1]) T(item);
+    --index;
+  }
+  n_ += levels_[0] - index;
+  levels_[0] = index;
+}
+
+// With the number of items known up front, the items are checked in a separate pass,
+// so that the common case of no invalid items is handled by simple loops that can be vectorized.
+template<typename T, typename C, typename A>
+template<typename RandomIt>
+void kll_sketch<T, C, A>::fill_level_zero(RandomIt& first, RandomIt last, T& min_item, T& max_item, std::random_access_iterator_tag) {
+  const uint32_t num = static_cast<uint32_t>(std::min<uint64_t>(levels_[0], last - first));
+  bool all_valid = true;
+  for (uint32_t i = 0; i < num; ++i) all_valid &= check_update_item(first[i]);
+  if (!all_valid) {
+    fill_level_zero(first, last, min_item, max_item, std::input_iterator_tag());
+    return;
+  }
+  update_min_max(first, num, min_item, max_item);
+  T* dst = items_ + levels_[0] - 1;
+  for (uint32_t i = 0; i < num; ++i) new (dst - i) T(first[i]);
+  first += num;
+  n_ += num;
+  levels_[0] -= num;
+}
+
+template<typename T, typename C, typename A>
+template<typename RandomIt, typename TT, typename std::enable_if<!std::is_arithmetic<TT>::value, int>::type>
+void kll_sketch<T, C, A>::update_min_max(RandomIt items, uint32_t num, T& min_item, T& max_item) const {
+  for (uint32_t i = 0; i < num; ++i) {
+    if (comparator_(items[i], min_item)) min_item = items[i];
+    if (comparator_(max_item, items[i])) max_item = items[i];
+  }
+}
+
+// Independent lanes break the dependency from one item to the next, so that this can be vectorized
+// without reordering the comparisons, which compilers would not do for floating point types.
+// The only difference from going item by item is which one of 0 and -0 can end up as min or max.
+template<typename T, typename C, typename A>
+template<typename RandomIt, typename TT, typename std::enable_if<std::is_arithmetic<TT>::value, int>::type>
+void kll_sketch<T, C, A>::update_min_max(RandomIt items, uint32_t num, T& min_item, T& max_item) const {
+  const unsigned NUM_LANES = 8;
+  T min_lanes[NUM_LANES];
+  T max_lanes[NUM_LANES];
+  for (unsigned j = 0; j < NUM_LANES; ++j) {
+    min_lanes[j] = min_item;
+    max_lanes[j] = max_item;
+  }
+  uint32_t i = 0;
+  for (; i + NUM_LANES <= num; i += NUM_LANES) {
+    for (unsigned j = 0; j < NUM_LANES; ++j) {
+      const T item = items[i + j];
+      min_lanes[j] = comparator_(item, min_lanes[j]) ? item : min_lanes[j];
+      max_lanes[j] = comparator_(max_lanes[j], item) ? item : max_lanes[j];
+    }
+  }
+  for (unsigned j = 0; j < NUM_LANES; ++j) {
+    if (comparator_(min_lanes[j], min_item)) min_item = min_lanes[j];
+    if (comparator_(max_item, max_lanes[j])) max_item = max_lanes[j];
+  }
+  for (; i < num; ++i) {
+    if (comparator_(items[i], min_item)) min_item = items[i];
+    if (comparator_(max_item, items[i])) max_item = items[i];
+  }
+}
+
 template<typename T, typename C, typename A>
 void kll_sketch<T, C, A>::update_min_max(const T& item) {
   if (is_empty()) {
@@ -243,6 +357,123 @@ void kll_sketch<T, C, A>::merge(FwdSk&& other) {
   reset_sorted_view();
 }
 
+template<typename T, typename C, typename A>
+template<typename ForwardIt>
+void kll_sketch<T, C, A>::merge(ForwardIt first, ForwardIt last) {
+  // Sketches are gathered into batches of about the capacity of this sketch.
+  // Compacting all of them at once would sort and merge many items that the compactions
+  // in between would have discarded, so it is only faster for many small sketches.
+  while (first != last) {
+    ForwardIt batch_last = first;
+    uint32_t num_items = (*batch_last).get_num_retained();
+    ++batch_last;
+    while (batch_last != last && num_items + (*batch_last).get_num_retained() <= items_size_) {
+      num_items += (*batch_last).get_num_retained();
+      ++batch_last;
+    }
+    if (std::next(first) == batch_last) {
+      merge(*first);
+    } else {
+      merge_batch(first, batch_last);
+    }
+    first = batch_last;
+  }
+}
+
+template<typename T, typename C, typename A>
+template<typename ForwardIt>
+void kll_sketch<T, C, A>::merge_batch(ForwardIt first, ForwardIt last) {
+  using FwdSk = decltype(*first);
+  uint64_t final_n = n_;
+  uint8_t provisional_num_levels = num_levels_;
+  for (ForwardIt it = first; it != last; ++it) {
+    const kll_sketch& other = *it;
+    if (other.is_empty()) continue;
+    if (m_ != other.m_) {
+      throw std::invalid_argument("incompatible M: " + std::to_string(m_) + " and " + std::to_string(other.m_));
+    }
+    final_n += other.n_;
+    provisional_num_levels = std::max(provisional_num_levels, other.num_levels_);
+  }
+  if (final_n == n_) return;
+
+  // all levels of this sketch and the batch are gathered in one work buffer
+  const uint8_t ub = kll_helper::ub_on_num_levels(final_n);
+  uint32_t worklevels[MAX_NUM_LEVELS + 2] = {};
+  for (uint8_t lvl = 0; lvl < provisional_num_levels; ++lvl) {
+    uint32_t level_size = safe_level_size(lvl);
+    for (ForwardIt it = first; it != last; ++it) level_size += (*it).safe_level_size(lvl);
+    worklevels[lvl + 1] = worklevels[lvl] + level_size;
+  }
+  const uint32_t num_work_items = worklevels[provisional_num_levels];
+
+  // the scratch space for sorting and merging follows the levels in the work space
+  uint32_t max_level_size = 0;
+  for (uint8_t lvl = 0; lvl < provisional_num_levels; ++lvl) max_level_size = std::max(max_level_size, worklevels[lvl + 1] - worklevels[lvl]);
+  T* workbuf = get_work_items(num_work_items + static_cast<uint32_t>(get_sort_space<T>(max_level_size)));
+  T* tmp = workbuf + num_work_items;
+
+  // level zero is not required to be sorted, higher levels are gathered as sorted runs and merged pairwise
+  vector_u32 run_bounds(allocator_);
+  for (uint8_t lvl = 0; lvl < provisional_num_levels; ++lvl) {
+    uint32_t end = worklevels[lvl];
+    run_bounds.assign(1, end);
+    const uint32_t self_pop = safe_level_size(lvl);
+    if (self_pop > 0) {
+      kll_helper::move_construct<T>(items_, levels_[lvl], levels_[lvl] + self_pop, workbuf, end, true);
+      end += self_pop;
+      run_bounds.push_back(end);
+    }
+    for (ForwardIt it = first; it != last; ++it) {
+      const uint32_t other_pop = (*it).safe_level_size(lvl);
+      if (other_pop == 0) continue;
+      const uint32_t other_beg = (*it).levels_[lvl];
+      for (uint32_t i = other_beg; i < other_beg + other_pop; ++i) {
+        new (&workbuf[end++]) T(conditional_forward<FwdSk>((*it).items_[i]));
+      }
+      run_bounds.push_back(end);
+    }
+    if (lvl == 0) continue;
+    while (run_bounds.size() > 2) {
+      T* base = workbuf;
+      size_t num_bounds = 1;
+      size_t i = 0;
+      for (; i + 2 < run_bounds.size(); i += 2) {
+        merge_items_in_place(base + run_bounds[i], base + run_bounds[i + 1], base + run_bounds[i + 2], comparator_, tmp);
+        run_bounds[num_bounds++] = run_bounds[i + 2];
+      }
+      if (i + 1 < run_bounds.size()) run_bounds[num_bounds++] = run_bounds[i + 1];
+      run_bounds.resize(num_bounds);
+    }
+  }
+
+  for (ForwardIt it = first; it != last; ++it) {
+    const kll_sketch& other = *it;
+    if (other.is_empty()) continue;
+    if (min_item_ == nullptr) {
+      min_item_ = new (allocator_.allocate(1)) T(conditional_forward<FwdSk>(*other.min_item_));
+      max_item_ = new (allocator_.allocate(1)) T(conditional_forward<FwdSk>(*other.max_item_));
+    } else {
+      if (comparator_(*other.min_item_, *min_item_)) *min_item_ = conditional_forward<FwdSk>(*other.min_item_);
+      if (comparator_(*max_item_, *other.max_item_)) *max_item_ = conditional_forward<FwdSk>(*other.max_item_);
+    }
+    if (other.is_estimation_mode()) min_k_ = std::min(min_k_, other.min_k_);
+  }
+
+  is_level_zero_sorted_ = false;
+  compress_work_buffer(workbuf, worklevels, provisional_num_levels, ub, tmp);
+  n_ = final_n;
+  assert_correct_total_weight();
+  reset_sorted_view();
+}
+
+template<typename T, typename C, typename A>
+void kll_sketch<T, C, A>::shrink_work_space() {
+  if (work_items_ != nullptr) allocator_.deallocate(work_items_, work_items_size_);
+  work_items_ = nullptr;
+  work_items_size_ = 0;
+}
+
 template<typename T, typename C, typename A>
 bool kll_sketch<T, C, A>::is_empty() const {
   return n_ == 0;
@@ -325,20 +556,15 @@ auto kll_sketch<T, C, A>::get_quantile(double rank, bool inclusive) const -> qua
 template<typename T, typename C, typename A>
 std::vector<T, A> kll_sketch<T, C, A>::get_quantiles(const double* ranks, uint32_t size, bool inclusive) const {
   if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
-  std::vector<T, A> quantiles(allocator_);
-  quantiles.reserve(size);
-
-  // may have a side effect of sorting level zero if needed
-  setup_sorted_view();
-
-  for (uint32_t i = 0; i < size; i++) {
+  for (uint32_t i = 0; i < size; ++i) {
     const double rank = ranks[i];
     if ((rank < 0.0) || (rank > 1.0)) {
       throw std::invalid_argument("normalized rank cannot be less than 0 or greater than 1");
     }
-    quantiles.push_back(sorted_view_->get_quantile(rank, inclusive));
   }
-  return quantiles;
+  // may have a side effect of sorting level zero if needed
+  setup_sorted_view();
+  return sorted_view_->get_quantiles(ranks, size, inclusive);
 }
 
 template<typename T, typename C, typename A>
@@ -683,6 +909,8 @@ n_(n),
 levels_(std::move(levels)),
 items_(items.release()),
 items_size_(items_size),
+work_items_(nullptr),
+work_items_size_(0),
 min_item_(min_item.release()),
 max_item_(max_item.release()),
 sorted_view_(nullptr)
@@ -715,7 +943,7 @@ void kll_sketch<T, C, A>::compress_while_updating(void) {
   // level zero might not be sorted, so we must sort it if we wish to compact it
   // sort_level_zero() is not used here because of the adjustment for odd number of items
   if ((level == 0) && !is_level_zero_sorted_) {
-    std::sort(items_ + adj_beg, items_ + adj_beg + adj_pop, comparator_);
+    sort_level(items_ + adj_beg, items_ + adj_beg + adj_pop);
   }
   if (pop_above == 0) {
     kll_helper::randomly_halve_up(items_, adj_beg, adj_pop);
@@ -796,11 +1024,17 @@ void kll_sketch<T, C, A>::add_empty_top_level_to_completely_full_sketch() {
 template<typename T, typename C, typename A>
 void kll_sketch<T, C, A>::sort_level_zero() {
   if (!is_level_zero_sorted_) {
-    std::sort(items_ + levels_[0], items_ + levels_[1], comparator_);
+    sort_level(items_ + levels_[0], items_ + levels_[1]);
     is_level_zero_sorted_ = true;
   }
 }
 
+// the work space is the scratch space of sorting, so that compactions do not allocate
+template<typename T, typename C, typename A>
+void kll_sketch<T, C, A>::sort_level(T* first, T* last) {
+  sort_items(first, last, comparator_, get_work_items(static_cast<uint32_t>(get_sort_space<T>(last - first))));
+}
+
 template<typename T, typename C, typename A>
 void kll_sketch<T, C, A>::check_sorting() const {
   // not checking level 0
@@ -830,20 +1064,36 @@ template<typename T, typename C, typename A>
 template<typename O>
 void kll_sketch<T, C, A>::merge_higher_levels(O&& other, uint64_t final_n) {
   const uint32_t tmp_num_items = get_num_retained() + other.get_num_retained_above_level_zero();
-  A alloc(allocator_);
-  auto tmp_items_deleter = [tmp_num_items, &alloc](T* ptr) { alloc.deallocate(ptr, tmp_num_items); }; // no destructor needed
-  const std::unique_ptr<T, decltype(tmp_items_deleter)> workbuf(allocator_.allocate(tmp_num_items), tmp_items_deleter);
+  // the scratch space for sorting level zero follows the levels in the work space
+  T* workbuf = get_work_items(tmp_num_items + static_cast<uint32_t>(get_sort_space<T>(safe_level_size(0))));
+  T* tmp = workbuf + tmp_num_items;
   const uint8_t ub = kll_helper::ub_on_num_levels(final_n);
-  const size_t work_levels_size = ub + 2; // ub+1 does not work
-  vector_u32 worklevels(work_levels_size, 0, allocator_);
-  vector_u32 outlevels(work_levels_size, 0, allocator_);
+  uint32_t worklevels[MAX_NUM_LEVELS + 2] = {}; // ub+1 does not work
 
   const uint8_t provisional_num_levels = std::max(num_levels_, other.num_levels_);
 
-  populate_work_arrays(std::forward<O>(other), workbuf.get(), worklevels.data(), provisional_num_levels);
+  populate_work_arrays(std::forward<O>(other), workbuf, worklevels, provisional_num_levels);
+  compress_work_buffer(workbuf, worklevels, provisional_num_levels, ub, tmp);
+}
 
-  const kll_helper::compress_result result = kll_helper::general_compress<T, C>(k_, m_, provisional_num_levels, workbuf.get(),
-      worklevels.data(), outlevels.data(), is_level_zero_sorted_);
+// merges and sorting reuse this space, which grows geometrically, so that they do not allocate in the steady state
+template<typename T, typename C, typename A>
+T* kll_sketch<T, C, A>::get_work_items(uint32_t num) {
+  if (work_items_size_ < num) {
+    const uint32_t size = std::max(num, work_items_size_ * 2);
+    shrink_work_space();
+    work_items_ = allocator_.allocate(size);
+    work_items_size_ = size;
+  }
+  return work_items_;
+}
+
+// compacts the levels gathered in the work buffer and moves the result into this sketch
+template<typename T, typename C, typename A>
+void kll_sketch<T, C, A>::compress_work_buffer(T* workbuf, uint32_t* worklevels, uint8_t provisional_num_levels, uint8_t ub, T* tmp) {
+  uint32_t outlevels[MAX_NUM_LEVELS + 2] = {};
+  const kll_helper::compress_result result = kll_helper::general_compress<T, C>(k_, m_, provisional_num_levels, workbuf,
+      worklevels, outlevels, is_level_zero_sorted_, tmp);
 
   // ub can sometimes be much bigger
   if (result.final_num_levels > ub) throw std::logic_error("merge error");
@@ -855,7 +1105,7 @@ void kll_sketch<T, C, A>::merge_higher_levels(O&& other, uint64_t final_n) {
     items_ = allocator_.allocate(items_size_);
   }
   const uint32_t free_space_at_bottom = result.final_capacity - result.final_num_items;
-  kll_helper::move_construct<T>(workbuf.get(), outlevels[0], outlevels[0] + result.final_num_items, items_, free_space_at_bottom, true);
+  kll_helper::move_construct<T>(workbuf, outlevels[0], outlevels[0] + result.final_num_items, items_, free_space_at_bottom, true);
 
   const size_t new_levels_size = result.final_num_levels + 1;
   if (levels_.size() < new_levels_size) {
@@ -1073,7 +1323,13 @@ void kll_sketch<T, C, A>::reset_sorted_view() {
 template<typename T, typename C, typename A>
 kll_sketch<T, C, A>::const_iterator::const_iterator(const T* items, const uint32_t* levels, const uint8_t num_levels):
 items(items), levels(levels), num_levels(num_levels), index(items == nullptr ? levels[num_levels] : levels[0]), level(items == nullptr ? num_levels : 0), weight(1)
-{}
+{
+  // level zero can be empty after a merge
+  while (level < num_levels && levels[level] == levels[level + 1]) {
+    ++level;
+    weight *= 2;
+  }
+}
 
 template<typename T, typename C, typename A>
 typename kll_sketch<T, C, A>::const_iterator& kll_sketch<T, C, A>::const_iterator::operator++() {
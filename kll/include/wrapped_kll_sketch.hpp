@@ -0,0 +1,155 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef WRAPPED_KLL_SKETCH_HPP_
+#define WRAPPED_KLL_SKETCH_HPP_
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "kll_sketch.hpp"
+#include "quantiles_sorted_view.hpp"
+
+namespace datasketches {
+
+/**
+ * Read-only KLL sketch of an arithmetic type over a buffer produced by kll_sketch::serialize()
+ * with the default serde, for instance a memory-mapped file.
+ * The retained items are used in place, so the buffer must outlive the wrapper.
+ * Items that are not aligned for the type T in the buffer are copied into the wrapper.
+ * A single rank is computed by searching each level without building a sorted view.
+ * Quantiles, CDF and PMF are computed from a sorted view built on the first such query and kept.
+ * The wrapper can be merged into a kll_sketch of the same type without deserializing it.
+ */
+template<
+  typename T,
+  typename C = std::less<T>, // strict weak ordering function (see C++ named requirements: Compare)
+  typename A = std::allocator<T>
+>
+class wrapped_kll_sketch {
+public:
+  static_assert(std::is_arithmetic<T>::value, "wrapped_kll_sketch requires an arithmetic type");
+
+  using value_type = T;
+  using comparator = C;
+  using vector_double = typename kll_sketch<T, C, A>::vector_double;
+
+  /**
+   * This method wraps a serialized sketch as an array of bytes.
+   * @param bytes pointer to the array of bytes
+   * @param size the size of the array
+   * @param comparator instance of a Comparator
+   * @param allocator instance of an Allocator
+   * @return an instance of the wrapped sketch
+   */
+  static wrapped_kll_sketch wrap(const void* bytes, size_t size, const C& comparator = C(), const A& allocator = A());
+
+  bool is_empty() const;
+  uint16_t get_k() const;
+  uint64_t get_n() const;
+  uint32_t get_num_retained() const;
+  bool is_estimation_mode() const;
+  T get_min_item() const;
+  T get_max_item() const;
+
+  /**
+   * Returns an approximation to the normalized rank of the given item from 0 to 1, inclusive.
+   * Computed by a binary search in each sorted level.
+   * @param item to be ranked
+   * @param inclusive if true the weight of the given item is included into the rank.
+   * @return an approximate rank of the given item
+   */
+  double get_rank(const T& item, bool inclusive = true) const;
+
+  /**
+   * Returns an item from the sketch that is the best approximation to an item
+   * from the original stream with the given rank.
+   * @param rank of an item in the hypothetical sorted stream
+   * @param inclusive if true, the given rank is considered inclusive (includes weight of an item)
+   * @return approximate quantile associated with the given rank
+   */
+  T get_quantile(double rank, bool inclusive = true) const;
+
+  /**
+   * Returns an approximation to the Cumulative Distribution Function (CDF).
+   * See kll_sketch::get_CDF() for details.
+   * @param split_points an array of <i>m</i> unique, monotonically increasing items
+   * @param size the number of split points in the array
+   * @param inclusive if true the rank of an item includes its own weight
+   * @return an array of m+1 doubles, which are a consecutive approximation to the CDF
+   */
+  vector_double get_CDF(const T* split_points, uint32_t size, bool inclusive = true) const;
+
+  /**
+   * Returns an approximation to the Probability Mass Function (PMF).
+   * See kll_sketch::get_PMF() for details.
+   * @param split_points an array of <i>m</i> unique, monotonically increasing items
+   * @param size the number of split points in the array
+   * @param inclusive if true the rank of an item includes its own weight
+   * @return an array of m+1 doubles each of which is an approximation to the fraction of the mass in a bucket
+   */
+  vector_double get_PMF(const T* split_points, uint32_t size, bool inclusive = true) const;
+
+  /**
+   * Gets the approximate rank error of this sketch normalized as a fraction between zero and one.
+   * @param pmf if true, returns the "double-sided" normalized rank error for the get_PMF() function.
+   * Otherwise, it is the "single-sided" normalized rank error for all the other queries.
+   * @return if pmf is true, returns the normalized rank error for the get_PMF() function.
+   * Otherwise, it is the "single-sided" normalized rank error for all the other queries.
+   */
+  double get_normalized_rank_error(bool pmf) const;
+
+  quantiles_sorted_view<T, C, A> get_sorted_view() const;
+
+private:
+  using sketch = kll_sketch<T, C, A>;
+
+  C comparator_;
+  A allocator_;
+  uint16_t k_;
+  uint8_t m_;
+  uint16_t min_k_;
+  uint8_t num_levels_;
+  bool is_level_zero_sorted_;
+  uint64_t n_;
+  uint32_t levels_[sketch::MAX_NUM_LEVELS + 1]; // level zero starts at index 0
+  std::shared_ptr<const std::vector<T, A>> copied_items_; // min, max and retained items if not aligned in the bytes
+  const T* items_;
+  const T* min_item_;
+  const T* max_item_;
+  mutable std::shared_ptr<const quantiles_sorted_view<T, C, A>> sorted_view_;
+
+  wrapped_kll_sketch(uint16_t k, const C& comparator, const A& allocator);
+
+  uint64_t get_weight(const T& item, bool inclusive) const;
+  uint32_t safe_level_size(uint8_t level) const;
+  uint32_t get_num_retained_above_level_zero() const;
+  const quantiles_sorted_view<T, C, A>& get_cached_sorted_view() const;
+
+  // to be merged into a sketch like another sketch
+  friend class kll_sketch<T, C, A>;
+};
+
+} /* namespace datasketches */
+
+#include "wrapped_kll_sketch_impl.hpp"
+
+#endif
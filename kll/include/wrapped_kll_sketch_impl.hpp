@@ -0,0 +1,252 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef WRAPPED_KLL_SKETCH_IMPL_HPP_
+#define WRAPPED_KLL_SKETCH_IMPL_HPP_
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "kll_helper.hpp"
+#include "memory_operations.hpp"
+
+namespace datasketches {
+
+template<typename T, typename C, typename A>
+wrapped_kll_sketch<T, C, A>::wrapped_kll_sketch(uint16_t k, const C& comparator, const A& allocator):
+comparator_(comparator),
+allocator_(allocator),
+k_(k),
+m_(sketch::DEFAULT_M),
+min_k_(k),
+num_levels_(1),
+is_level_zero_sorted_(false),
+n_(0),
+levels_(),
+copied_items_(),
+items_(nullptr),
+min_item_(nullptr),
+max_item_(nullptr),
+sorted_view_()
+{}
+
+template<typename T, typename C, typename A>
+wrapped_kll_sketch<T, C, A> wrapped_kll_sketch<T, C, A>::wrap(const void* bytes, size_t size, const C& comparator,
+    const A& allocator) {
+  ensure_minimum_memory(size, 8);
+  const char* ptr = static_cast<const char*>(bytes);
+  uint8_t preamble_ints;
+  ptr += copy_from_mem(ptr, preamble_ints);
+  uint8_t serial_version;
+  ptr += copy_from_mem(ptr, serial_version);
+  uint8_t family_id;
+  ptr += copy_from_mem(ptr, family_id);
+  uint8_t flags_byte;
+  ptr += copy_from_mem(ptr, flags_byte);
+  uint16_t k;
+  ptr += copy_from_mem(ptr, k);
+  uint8_t m;
+  ptr += copy_from_mem(ptr, m);
+  ptr += sizeof(uint8_t); // skip unused byte
+
+  sketch::check_m(m);
+  sketch::check_preamble_ints(preamble_ints, flags_byte);
+  sketch::check_serial_version(serial_version);
+  sketch::check_family_id(family_id);
+  ensure_minimum_memory(size, preamble_ints * sizeof(uint32_t));
+
+  wrapped_kll_sketch wrapped(k, comparator, allocator);
+  wrapped.m_ = m;
+  const bool is_empty(flags_byte & (1 << sketch::flags::IS_EMPTY));
+  if (is_empty) return wrapped;
+
+  const bool is_single_item(flags_byte & (1 << sketch::flags::IS_SINGLE_ITEM)); // used in serial version 2
+  if (is_single_item) {
+    wrapped.n_ = 1;
+    wrapped.levels_[0] = 0;
+    wrapped.levels_[1] = 1;
+  } else {
+    ptr += copy_from_mem(ptr, wrapped.n_);
+    ptr += copy_from_mem(ptr, wrapped.min_k_);
+    ptr += copy_from_mem(ptr, wrapped.num_levels_);
+    ptr += sizeof(uint8_t); // skip unused byte
+    if (wrapped.num_levels_ == 0 || wrapped.num_levels_ > sketch::MAX_NUM_LEVELS) {
+      throw std::invalid_argument("Possible corruption: number of levels " + std::to_string(wrapped.num_levels_));
+    }
+    // the last integer is not serialized because it can be derived
+    ensure_minimum_memory(size, sketch::DATA_START + wrapped.num_levels_ * sizeof(uint32_t));
+    ptr += copy_from_mem(ptr, wrapped.levels_, sizeof(uint32_t) * wrapped.num_levels_);
+    wrapped.levels_[wrapped.num_levels_] = kll_helper::compute_total_capacity(k, m, wrapped.num_levels_);
+    const uint32_t offset = wrapped.levels_[0];
+    for (uint8_t lvl = 0; lvl <= wrapped.num_levels_; ++lvl) {
+      if (wrapped.levels_[lvl] < offset || (lvl > 0 && wrapped.levels_[lvl] < wrapped.levels_[lvl - 1] + offset)) {
+        throw std::invalid_argument("Possible corruption: levels are not monotonic");
+      }
+      wrapped.levels_[lvl] -= offset;
+    }
+  }
+  wrapped.is_level_zero_sorted_ = (flags_byte & (1 << sketch::flags::IS_LEVEL_ZERO_SORTED)) > 0;
+
+  const uint32_t num_items = wrapped.levels_[wrapped.num_levels_];
+  const uint32_t num_min_max = is_single_item ? 0 : 2;
+  const size_t items_start = ptr - static_cast<const char*>(bytes);
+  ensure_minimum_memory(size, items_start + (num_min_max + num_items) * sizeof(T));
+  const T* items;
+  if (reinterpret_cast<uintptr_t>(ptr) % alignof(T) == 0) {
+    items = reinterpret_cast<const T*>(ptr);
+  } else {
+    auto copy = std::allocate_shared<std::vector<T, A>>(allocator, num_min_max + num_items, 0, allocator);
+    copy_from_mem(ptr, copy->data(), (num_min_max + num_items) * sizeof(T));
+    items = copy->data();
+    wrapped.copied_items_ = std::move(copy);
+  }
+  if (is_single_item) {
+    wrapped.min_item_ = wrapped.max_item_ = wrapped.items_ = items;
+  } else {
+    wrapped.min_item_ = items;
+    wrapped.max_item_ = items + 1;
+    wrapped.items_ = items + 2;
+  }
+  return wrapped;
+}
+
+template<typename T, typename C, typename A>
+bool wrapped_kll_sketch<T, C, A>::is_empty() const {
+  return n_ == 0;
+}
+
+template<typename T, typename C, typename A>
+uint16_t wrapped_kll_sketch<T, C, A>::get_k() const {
+  return k_;
+}
+
+template<typename T, typename C, typename A>
+uint64_t wrapped_kll_sketch<T, C, A>::get_n() const {
+  return n_;
+}
+
+template<typename T, typename C, typename A>
+uint32_t wrapped_kll_sketch<T, C, A>::get_num_retained() const {
+  return levels_[num_levels_] - levels_[0];
+}
+
+template<typename T, typename C, typename A>
+bool wrapped_kll_sketch<T, C, A>::is_estimation_mode() const {
+  return num_levels_ > 1;
+}
+
+template<typename T, typename C, typename A>
+T wrapped_kll_sketch<T, C, A>::get_min_item() const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  return *min_item_;
+}
+
+template<typename T, typename C, typename A>
+T wrapped_kll_sketch<T, C, A>::get_max_item() const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  return *max_item_;
+}
+
+template<typename T, typename C, typename A>
+double wrapped_kll_sketch<T, C, A>::get_rank(const T& item, bool inclusive) const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  return static_cast<double>(get_weight(item, inclusive)) / n_;
+}
+
+template<typename T, typename C, typename A>
+T wrapped_kll_sketch<T, C, A>::get_quantile(double rank, bool inclusive) const {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  return get_cached_sorted_view().get_quantile(rank, inclusive);
+}
+
+template<typename T, typename C, typename A>
+auto wrapped_kll_sketch<T, C, A>::get_CDF(const T* split_points, uint32_t size, bool inclusive) const -> vector_double {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  return get_cached_sorted_view().get_CDF(split_points, size, inclusive);
+}
+
+template<typename T, typename C, typename A>
+auto wrapped_kll_sketch<T, C, A>::get_PMF(const T* split_points, uint32_t size, bool inclusive) const -> vector_double {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  return get_cached_sorted_view().get_PMF(split_points, size, inclusive);
+}
+template<typename T, typename C, typename A>
+double wrapped_kll_sketch<T, C, A>::get_normalized_rank_error(bool pmf) const {
+  return sketch::get_normalized_rank_error(min_k_, pmf);
+}
+
+template<typename T, typename C, typename A>
+quantiles_sorted_view<T, C, A> wrapped_kll_sketch<T, C, A>::get_sorted_view() const {
+  quantiles_sorted_view<T, C, A> view(get_num_retained(), comparator_, allocator_);
+  for (uint8_t lvl = 0; lvl < num_levels_; ++lvl) {
+    const T* from = items_ + levels_[lvl];
+    const T* to = items_ + levels_[lvl + 1]; // exclusive
+    if (lvl == 0 && !is_level_zero_sorted_) {
+      // the wrapped bytes are read-only
+      std::vector<T, A> level_zero(from, to, allocator_);
+      std::sort(level_zero.begin(), level_zero.end(), comparator_);
+      view.add(level_zero.begin(), level_zero.end(), 1);
+    } else {
+      view.add(from, to, 1ULL << lvl);
+    }
+  }
+  view.convert_to_cummulative();
+  return view;
+}
+
+template<typename T, typename C, typename A>
+uint64_t wrapped_kll_sketch<T, C, A>::get_weight(const T& item, bool inclusive) const {
+  uint64_t weight = 0;
+  for (uint8_t lvl = 0; lvl < num_levels_; ++lvl) {
+    const T* from = items_ + levels_[lvl];
+    const T* to = items_ + levels_[lvl + 1];
+    uint64_t count;
+    if (lvl == 0 && !is_level_zero_sorted_) {
+      count = 0;
+      for (const T* it = from; it != to; ++it) count += inclusive ? !comparator_(item, *it) : comparator_(*it, item);
+    } else {
+      count = (inclusive ? std::upper_bound(from, to, item, comparator_) : std::lower_bound(from, to, item, comparator_)) - from;
+    }
+    weight += count << lvl;
+  }
+  return weight;
+}
+
+template<typename T, typename C, typename A>
+uint32_t wrapped_kll_sketch<T, C, A>::safe_level_size(uint8_t level) const {
+  if (level >= num_levels_) return 0;
+  return levels_[level + 1] - levels_[level];
+}
+
+template<typename T, typename C, typename A>
+uint32_t wrapped_kll_sketch<T, C, A>::get_num_retained_above_level_zero() const {
+  if (num_levels_ == 1) return 0;
+  return levels_[num_levels_] - levels_[1];
+}
+
+template<typename T, typename C, typename A>
+const quantiles_sorted_view<T, C, A>& wrapped_kll_sketch<T, C, A>::get_cached_sorted_view() const {
+  if (!sorted_view_) sorted_view_ = std::allocate_shared<quantiles_sorted_view<T, C, A>>(allocator_, get_sorted_view());
+  return *sorted_view_;
+}
+
+} /* namespace datasketches */
+
+#endif
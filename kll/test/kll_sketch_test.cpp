@@ -18,13 +18,21 @@
  */
 
 #include <catch2/catch.hpp>
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <sstream>
 #include <fstream>
+#include <iterator>
+#include <list>
+#include <random>
 #include <stdexcept>
 
+#include <bfloat16.hpp>
 #include <kll_sketch.hpp>
+#include <parallel_merge.hpp>
+#include <wrapped_kll_sketch.hpp>
+#include <wrapped_quantiles_sorted_view.hpp>
 #include <test_allocator.hpp>
 
 namespace datasketches {
@@ -129,6 +137,53 @@ TEST_CASE("kll sketch", "[kll_sketch]") {
     REQUIRE(sketch.get_n() == 1);
   }
 
+  SECTION("update from range same as one by one") {
+    std::vector<float> items;
+    for (int i = 0; i < 100000; i++) items.push_back(static_cast<float>((i * 7919) % 100003));
+    items[10] = std::numeric_limits<float>::quiet_NaN();
+    items[50000] = std::numeric_limits<float>::quiet_NaN();
+    // ranges that end at, cross and start at compactions
+    for (size_t step: {1, 7, 200, 1000, 100000}) {
+      random_bit.seed(1);
+      kll_float_sketch sketch1(200, std::less<float>(), 0);
+      for (float item: items) sketch1.update(item);
+      random_bit.seed(1);
+      kll_float_sketch sketch2(200, std::less<float>(), 0);
+      for (size_t i = 0; i < items.size(); i += step) {
+        sketch2.update(items.begin() + i, items.begin() + std::min(i + step, items.size()));
+      }
+      REQUIRE(sketch2.get_n() == items.size() - 2);
+      REQUIRE(sketch2.serialize() == sketch1.serialize());
+    }
+  }
+
+  SECTION("update from range of NaNs and empty range") {
+    kll_float_sketch sketch(200, std::less<float>(), 0);
+    std::vector<float> items(3, std::numeric_limits<float>::quiet_NaN());
+    sketch.update(items.begin(), items.end());
+    sketch.update(items.end(), items.end());
+    REQUIRE(sketch.is_empty());
+    items.push_back(1);
+    sketch.update(items.begin(), items.end());
+    REQUIRE(sketch.get_n() == 1);
+    REQUIRE(sketch.get_min_item() == 1);
+  }
+
+  SECTION("update from input iterators") {
+    random_bit.seed(1);
+    kll_string_sketch sketch1(200, std::less<std::string>(), 0);
+    for (int i = 0; i < 1000; i++) sketch1.update(std::to_string(i));
+    std::stringstream s;
+    for (int i = 0; i < 1000; i++) s << i << " ";
+    random_bit.seed(1);
+    kll_string_sketch sketch2(200, std::less<std::string>(), 0);
+    sketch2.update(std::istream_iterator<std::string>(s), std::istream_iterator<std::string>());
+    REQUIRE(sketch2.get_n() == 1000);
+    REQUIRE(sketch2.get_min_item() == "0");
+    REQUIRE(sketch2.get_max_item() == "999");
+    REQUIRE(sketch2.serialize() == sketch1.serialize());
+  }
+
   SECTION("many items, exact mode") {
     kll_float_sketch sketch(200, std::less<float>(), 0);
     const uint32_t n = 200;
@@ -601,6 +656,171 @@ TEST_CASE("kll sketch", "[kll_sketch]") {
     REQUIRE(sketch2.get_max_item() == 999999.0f);
   }
 
+  SECTION("merge range exact mode") {
+    std::vector<kll_float_sketch> sketches(5, kll_float_sketch(200, std::less<float>(), 0));
+    for (int i = 0; i < 100; i++) sketches[i % 3].update(static_cast<float>(i));
+    kll_float_sketch sketch(200, std::less<float>(), 0);
+    sketch.update(100);
+    sketch.merge(sketches.begin(), sketches.end());
+    REQUIRE_FALSE(sketch.is_estimation_mode());
+    REQUIRE(sketch.get_n() == 101);
+    REQUIRE(sketch.get_num_retained() == 101);
+    REQUIRE(sketch.get_min_item() == 0.0f);
+    REQUIRE(sketch.get_max_item() == 100.0f);
+    for (int i = 0; i <= 100; i++) {
+      REQUIRE(sketch.get_rank(static_cast<float>(i)) == (i + 1) / 101.0);
+    }
+  }
+
+  SECTION("merge range estimation mode") {
+    // sketches with a few levels are merged in batches
+    const int num_sketches = 300;
+    const int n = 300;
+    std::vector<kll_float_sketch> sketches;
+    std::vector<float> items;
+    for (int j = 0; j < num_sketches; j++) {
+      sketches.push_back(kll_float_sketch(200, std::less<float>(), 0));
+      // items of the sketches interleave, and some sketches are empty
+      if (j % 10 == 9) continue;
+      for (int i = 0; i < n; i++) {
+        items.push_back(static_cast<float>(i * num_sketches + j));
+        sketches.back().update(items.back());
+      }
+    }
+    std::sort(items.begin(), items.end());
+    kll_float_sketch sketch1(200, std::less<float>(), 0);
+    sketch1.merge(sketches.begin(), sketches.end());
+    kll_float_sketch sketch2(200, std::less<float>(), 0);
+    for (const auto& sketch: sketches) sketch2.merge(sketch);
+
+    REQUIRE(sketch1.get_n() == items.size());
+    REQUIRE(sketch1.get_n() == sketch2.get_n());
+    REQUIRE(sketch1.get_min_item() == sketch2.get_min_item());
+    REQUIRE(sketch1.get_max_item() == sketch2.get_max_item());
+
+    // the retained items are input items with the same total weight and number of levels as in the sequential merge,
+    // and within the capacity of these levels
+    uint64_t weights1[2] = {0, 0};
+    for (const auto pair: sketch1) {
+      REQUIRE(std::binary_search(items.begin(), items.end(), pair.first));
+      weights1[0] += pair.second;
+      weights1[1] = std::max(weights1[1], pair.second);
+    }
+    uint64_t weights2[2] = {0, 0};
+    for (const auto pair: sketch2) {
+      weights2[0] += pair.second;
+      weights2[1] = std::max(weights2[1], pair.second);
+    }
+    REQUIRE(weights1[0] == sketch1.get_n());
+    REQUIRE(weights2[0] == sketch2.get_n());
+    REQUIRE(weights1[1] == weights2[1]);
+    uint8_t num_levels = 1;
+    while ((1ULL << (num_levels - 1)) < weights1[1]) ++num_levels;
+    REQUIRE(sketch1.get_num_retained() <= kll_helper::compute_total_capacity(200, 8, num_levels));
+    REQUIRE(sketch2.get_num_retained() <= kll_helper::compute_total_capacity(200, 8, num_levels));
+
+    for (int i = 0; i <= 10; i++) {
+      const float item = items[(items.size() - 1) * i / 10];
+      const double true_rank = static_cast<double>(std::upper_bound(items.begin(), items.end(), item) - items.begin()) / items.size();
+      REQUIRE(sketch1.get_rank(item) == Approx(true_rank).margin(RANK_EPS_FOR_K_200));
+      REQUIRE(sketch2.get_rank(item) == Approx(true_rank).margin(RANK_EPS_FOR_K_200));
+      REQUIRE(sketch1.get_rank(item) == Approx(sketch2.get_rank(item)).margin(2 * RANK_EPS_FOR_K_200));
+    }
+    for (int i = 0; i < num_sketches; i++) sketch1.merge(sketches.begin() + i, sketches.begin() + i + 1);
+    REQUIRE(sketch1.get_n() == 2 * sketch2.get_n());
+  }
+
+  SECTION("merge strings") {
+    kll_string_sketch sketch1(200, std::less<std::string>(), 0);
+    for (int i = 0; i < 1000; i++) sketch1.update(std::to_string(i));
+    std::vector<std::pair<std::string, uint64_t>> items1(sketch1.begin(), sketch1.end());
+    std::sort(items1.begin(), items1.end());
+
+    // levels that are not compacted stay in place
+    kll_string_sketch sketch2(200, std::less<std::string>(), 0);
+    sketch2.merge(sketch1);
+    REQUIRE(sketch2.get_n() == 1000);
+    std::vector<std::pair<std::string, uint64_t>> items2(sketch2.begin(), sketch2.end());
+    std::sort(items2.begin(), items2.end());
+    REQUIRE(items2 == items1);
+
+    kll_string_sketch sketch3(200, std::less<std::string>(), 0);
+    for (int i = 1000; i < 2000; i++) sketch3.update(std::to_string(i));
+    sketch3.merge(sketch1);
+    REQUIRE(sketch3.get_n() == 2000);
+    REQUIRE(sketch3.get_min_item() == "0");
+    REQUIRE(sketch3.get_max_item() == "999");
+    uint64_t total_weight = 0;
+    for (const auto pair: sketch3) {
+      REQUIRE_FALSE(pair.first.empty());
+      REQUIRE(std::stoi(pair.first) < 2000);
+      total_weight += pair.second;
+    }
+    REQUIRE(total_weight == 2000);
+  }
+
+  SECTION("merge range of strings by moving") {
+    std::vector<kll_string_sketch> sketches(3, kll_string_sketch(200, std::less<std::string>(), 0));
+    for (int i = 0; i < 1000; i++) sketches[i % 3].update(std::to_string(i));
+    kll_string_sketch sketch(200, std::less<std::string>(), 0);
+    sketch.merge(std::make_move_iterator(sketches.begin()), std::make_move_iterator(sketches.end()));
+    REQUIRE(sketch.get_n() == 1000);
+    REQUIRE(sketch.get_min_item() == "0");
+    REQUIRE(sketch.get_max_item() == "999");
+    REQUIRE(sketch.get_rank("5") == Approx(0.446).margin(RANK_EPS_FOR_K_200));
+  }
+
+  SECTION("merge reuses work space") {
+    std::vector<kll_float_sketch> sketches;
+    for (int j = 0; j < 20; j++) {
+      sketches.push_back(kll_float_sketch(200, std::less<float>(), 0));
+      for (int i = 0; i < 1000; i++) sketches.back().update(static_cast<float>(i * 20 + j));
+    }
+    kll_float_sketch sketch(200, std::less<float>(), 0);
+    for (int i = 0; i < 1000000; i++) sketch.update(static_cast<float>(i));
+    for (const auto& other: sketches) sketch.merge(other); // allocates work space
+    const long long num_allocations = test_allocator_total_allocations;
+    for (const auto& other: sketches) sketch.merge(other);
+    // the number of levels does not grow, so there is nothing to allocate
+    REQUIRE(test_allocator_total_allocations == num_allocations);
+    REQUIRE(sketch.get_n() == 1040000);
+    const long long net_allocations = test_allocator_net_allocations;
+    sketch.shrink_work_space();
+    REQUIRE(test_allocator_net_allocations == net_allocations - 1);
+    sketch.shrink_work_space(); // nothing left to release
+    REQUIRE(test_allocator_net_allocations == net_allocations - 1);
+    sketch.merge(sketches[0]); // allocates work space again
+    REQUIRE(test_allocator_net_allocations == net_allocations);
+  }
+
+  SECTION("compaction without temporary buffers") {
+    // with this k level zero has enough items to be radix sorted in the work space
+    kll_float_sketch sketch(2000, std::less<float>(), 0);
+    for (uint64_t i = 0; i < 1000000; i++) {
+      const long long allocations = test_allocator_total_allocations;
+      const long long bytes = test_allocator_total_bytes;
+      sketch.update(static_cast<float>((i * 7919) % 1000000));
+      // only growing the items or the work space allocates
+      if (test_allocator_total_allocations != allocations) REQUIRE(test_allocator_total_bytes > bytes);
+    }
+  }
+
+  SECTION("merge reuses work space for sorting") {
+    // with this k level zero has enough items to be radix sorted, which needs scratch space
+    std::vector<kll_float_sketch> sketches;
+    for (int j = 0; j < 20; j++) {
+      sketches.push_back(kll_float_sketch(2000, std::less<float>(), 0));
+      for (int i = 0; i < 5000; i++) sketches.back().update(static_cast<float>(i * 20 + j));
+    }
+    kll_float_sketch sketch(2000, std::less<float>(), 0);
+    for (int i = 0; i < 1000000; i++) sketch.update(static_cast<float>(i));
+    for (const auto& other: sketches) sketch.merge(other); // allocates work space
+    const long long num_allocations = test_allocator_total_allocations;
+    for (const auto& other: sketches) sketch.merge(other);
+    REQUIRE(test_allocator_total_allocations == num_allocations);
+    REQUIRE(sketch.get_n() == 1200000);
+  }
+
   SECTION("sketch of ints") {
     kll_sketch<int> sketch;
     REQUIRE_THROWS_AS(sketch.get_quantile(0), std::runtime_error);
@@ -800,6 +1020,18 @@ TEST_CASE("kll sketch", "[kll_sketch]") {
     }
   }
 
+  SECTION("wrapped sorted view") {
+    kll_sketch<float> kll(200);
+    for (int i = 0; i < 10000; ++i) kll.update(static_cast<float>(i));
+    auto bytes = kll.get_sorted_view().serialize();
+    auto view = wrapped_quantiles_sorted_view<float>::wrap(bytes.data(), bytes.size());
+    REQUIRE(view.get_total_weight() == kll.get_n());
+    for (int i = 0; i < 10000; i += 100) {
+      REQUIRE(view.get_rank(static_cast<float>(i)) == kll.get_rank(static_cast<float>(i)));
+      REQUIRE(view.get_quantile(i / 10000.0, false) == kll.get_quantile(i / 10000.0, false));
+    }
+  }
+
   SECTION("type conversion: empty") {
     kll_sketch<double> kll_double;
     kll_sketch<float> kll_float(kll_double);
@@ -870,4 +1102,194 @@ TEST_CASE("kll sketch", "[kll_sketch]") {
   REQUIRE(test_allocator_total_bytes == 0);
 }
 
+TEST_CASE("kll sketch: merge parallel", "[kll_sketch]") {
+  std::vector<kll_sketch<float>> sketches;
+  for (int j = 0; j < 100; j++) {
+    sketches.push_back(kll_sketch<float>(200));
+    for (int i = 0; i < 1000; i++) sketches.back().update(static_cast<float>(i * 100 + j));
+  }
+
+  // the same seed gives the same result with any number of threads
+  kll_sketch<float> sketch1(200);
+  merge_parallel(sketch1, sketches.begin(), sketches.end(), 4, 42);
+  kll_sketch<float> sketch2(200);
+  merge_parallel(sketch2, sketches.begin(), sketches.end(), 1, 42);
+  REQUIRE(sketch1.serialize() == sketch2.serialize());
+  REQUIRE(sketch1.get_n() == 100000);
+  REQUIRE(sketch1.get_min_item() == 0.0f);
+  REQUIRE(sketch1.get_max_item() == 99999.0f);
+  REQUIRE(sketch1.get_rank(50000.0f) == Approx(0.5).margin(RANK_EPS_FOR_K_200));
+
+  kll_sketch<float> sketch3(200);
+  sketch3.update(-1);
+  merge_parallel(sketch3, sketches.begin(), sketches.end() - 1, 3);
+  REQUIRE(sketch3.get_n() == 99001);
+  REQUIRE(sketch3.get_min_item() == -1.0f);
+  REQUIRE(sketch3.get_rank(50000.0f) == Approx(0.5).margin(RANK_EPS_FOR_K_200));
+
+  merge_parallel(sketch3, sketches.end(), sketches.end(), 3);
+  REQUIRE(sketch3.get_n() == 99001);
+  REQUIRE_THROWS_AS(merge_parallel(sketch3, sketches.begin(), sketches.end(), 0), std::invalid_argument);
+}
+
+template<typename T>
+void check_wrapped(const kll_sketch<T>& sketch) {
+  auto bytes = sketch.serialize();
+  auto wrapped = wrapped_kll_sketch<T>::wrap(bytes.data(), bytes.size());
+  REQUIRE(wrapped.get_n() == sketch.get_n());
+  REQUIRE(wrapped.get_k() == sketch.get_k());
+  REQUIRE(wrapped.get_num_retained() == sketch.get_num_retained());
+  REQUIRE(wrapped.is_estimation_mode() == sketch.is_estimation_mode());
+  REQUIRE(wrapped.get_normalized_rank_error(false) == sketch.get_normalized_rank_error(false));
+  if (sketch.is_empty()) {
+    REQUIRE(wrapped.is_empty());
+    REQUIRE_THROWS_AS(wrapped.get_rank(0), std::runtime_error);
+    REQUIRE_THROWS_AS(wrapped.get_quantile(0.5), std::runtime_error);
+    return;
+  }
+  REQUIRE(wrapped.get_min_item() == sketch.get_min_item());
+  REQUIRE(wrapped.get_max_item() == sketch.get_max_item());
+  const T n = static_cast<T>(sketch.get_n());
+  std::vector<T> split_points;
+  for (T item = -1; item < n + 2; item += n / 20 + 1) split_points.push_back(item);
+  for (const T item: split_points) {
+    REQUIRE(wrapped.get_rank(item) == sketch.get_rank(item));
+    REQUIRE(wrapped.get_rank(item, false) == sketch.get_rank(item, false));
+  }
+  REQUIRE(wrapped.get_CDF(split_points.data(), split_points.size()) == sketch.get_CDF(split_points.data(), split_points.size()));
+  REQUIRE(wrapped.get_PMF(split_points.data(), split_points.size(), false) == sketch.get_PMF(split_points.data(), split_points.size(), false));
+  const auto view = wrapped.get_sorted_view();
+  for (int i = 0; i <= 100; ++i) {
+    const double rank = i / 100.0;
+    REQUIRE(wrapped.get_quantile(rank) == sketch.get_quantile(rank));
+    REQUIRE(wrapped.get_quantile(rank, false) == sketch.get_quantile(rank, false));
+    REQUIRE(view.get_quantile(rank) == sketch.get_quantile(rank));
+  }
+}
+
+TEST_CASE("kll sketch: wrapped", "[kll_sketch]") {
+  for (const int n: {0, 1, 10, 200, 201, 1000, 12345}) {
+    kll_sketch<float> sketch_float(200);
+    kll_sketch<double> sketch_double(100);
+    for (int i = 0; i < n; i++) {
+      sketch_float.update(static_cast<float>(i));
+      sketch_double.update(static_cast<double>((i * 7919) % (n + 1)));
+    }
+    check_wrapped(sketch_float);
+    check_wrapped(sketch_double);
+    // level zero sorted by queries before serializing
+    if (n > 0) sketch_double.get_quantile(0.5);
+    check_wrapped(sketch_double);
+  }
+
+  SECTION("merge into a sketch") {
+    kll_sketch<double> other(200);
+    for (int i = 0; i < 5000; i++) other.update(static_cast<double>(i));
+    auto bytes = other.serialize();
+    auto wrapped = wrapped_kll_sketch<double>::wrap(bytes.data(), bytes.size());
+    auto deserialized = kll_sketch<double>::deserialize(bytes.data(), bytes.size());
+
+    kll_sketch<double> sketch1(200);
+    for (int i = 0; i < 3000; i++) sketch1.update(static_cast<double>(-i));
+    kll_sketch<double> sketch2(sketch1);
+    random_bit.seed(1);
+    sketch1.merge(wrapped);
+    random_bit.seed(1);
+    sketch2.merge(deserialized);
+    REQUIRE(sketch1.serialize() == sketch2.serialize());
+    REQUIRE(sketch1.get_n() == 8000);
+    REQUIRE(sketch1.get_max_item() == 4999.0);
+  }
+
+  SECTION("corrupted") {
+    kll_sketch<float> sketch;
+    for (int i = 0; i < 1000; i++) sketch.update(static_cast<float>(i));
+    auto bytes = sketch.serialize();
+    REQUIRE_THROWS_AS(wrapped_kll_sketch<float>::wrap(bytes.data(), bytes.size() - 1), std::out_of_range);
+    bytes[0] = 3;
+    REQUIRE_THROWS_AS(wrapped_kll_sketch<float>::wrap(bytes.data(), bytes.size()), std::invalid_argument);
+  }
+
+  SECTION("m") {
+    kll_sketch<float> sketch;
+    for (int i = 0; i < 1000; i++) sketch.update(static_cast<float>(i));
+    auto bytes = sketch.serialize();
+    auto wrapped = wrapped_kll_sketch<float>::wrap(bytes.data(), bytes.size());
+    kll_sketch<float> target;
+    target.merge(wrapped); // the m of the image must match
+    REQUIRE(target.get_n() == 1000);
+    // only the default m is supported, the same as by deserialize()
+    bytes[6] = 4;
+    REQUIRE_THROWS_AS(kll_sketch<float>::deserialize(bytes.data(), bytes.size()), std::invalid_argument);
+    REQUIRE_THROWS_AS(wrapped_kll_sketch<float>::wrap(bytes.data(), bytes.size()), std::invalid_argument);
+  }
+}
+
+TEST_CASE("kll sketch: bfloat16", "[kll_sketch]") {
+  std::mt19937 gen(1);
+  std::exponential_distribution<float> distribution(0.01f);
+  const int n = 100000;
+  std::vector<float> values(n);
+  for (float& value: values) value = distribution(gen);
+  kll_sketch<bfloat16> sketch;
+  kll_sketch<float> sketch_float;
+  for (const float value: values) {
+    sketch.update(value);
+    sketch_float.update(value);
+  }
+  sketch.update(std::numeric_limits<float>::quiet_NaN()); // ignored
+  REQUIRE(sketch.get_n() == n);
+
+  std::vector<float> rounded;
+  for (const float value: values) rounded.push_back(bfloat16(value));
+  std::sort(values.begin(), values.end());
+  std::sort(rounded.begin(), rounded.end());
+  const float rel_error = std::ldexp(1.0f, -8);
+  for (int i = 1; i < 100; ++i) {
+    const float item = values[n / 100 * i];
+    // the sketch of the rounded stream has the usual error
+    const auto rounded_rank = std::upper_bound(rounded.begin(), rounded.end(), bfloat16(item)) - rounded.begin();
+    REQUIRE(sketch.get_rank(item) == Approx(static_cast<double>(rounded_rank) / n).margin(RANK_EPS_FOR_K_200));
+    // plus the fraction of the stream that the rounding can move across the item
+    const auto near_begin = std::lower_bound(values.begin(), values.end(), item * (1 - rel_error));
+    const auto near_end = std::upper_bound(values.begin(), values.end(), item * (1 + rel_error));
+    const double rank = static_cast<double>(std::upper_bound(values.begin(), values.end(), item) - values.begin()) / n;
+    REQUIRE(sketch.get_rank(item) == Approx(rank).margin(RANK_EPS_FOR_K_200 + static_cast<double>(near_end - near_begin) / n));
+    // quantiles are within the rounding error of the items at the ranks within the error of the sketch
+    const double rank_lo = std::max(0.0, i / 100.0 - RANK_EPS_FOR_K_200);
+    const double rank_hi = std::min(static_cast<double>(n - 1) / n, i / 100.0 + RANK_EPS_FOR_K_200);
+    const float quantile = sketch.get_quantile(i / 100.0);
+    REQUIRE(quantile >= values[static_cast<size_t>(rank_lo * n)] * (1 - rel_error));
+    REQUIRE(quantile <= values[static_cast<size_t>(rank_hi * n)] * (1 + rel_error));
+  }
+
+  // half the size of the sketch of floats
+  auto bytes = sketch.serialize();
+  REQUIRE(bytes.size() < sketch_float.serialize().size() * 0.6);
+  auto deserialized = kll_sketch<bfloat16>::deserialize(bytes.data(), bytes.size());
+  REQUIRE(deserialized.get_n() == n);
+  REQUIRE(static_cast<float>(deserialized.get_quantile(0.5)) == static_cast<float>(sketch.get_quantile(0.5)));
+  kll_sketch<float> converted(deserialized);
+  REQUIRE(converted.get_quantile(0.5) == static_cast<float>(sketch.get_quantile(0.5)));
+}
+
+TEST_CASE("kll sketch: bfloat16 range with NaN", "[kll_sketch]") {
+  // NaN must be skipped before the conversion to bfloat16, the same as one item at a time
+  std::list<float> values;
+  for (int i = 0; i < 1000; i++) values.push_back(i % 7 == 0 ? std::numeric_limits<float>::quiet_NaN() : static_cast<float>(i));
+  const std::vector<float> values_vector(values.begin(), values.end());
+  random_bit.seed(1);
+  kll_sketch<bfloat16> sketch1;
+  for (const float value: values) sketch1.update(value);
+  random_bit.seed(1);
+  kll_sketch<bfloat16> sketch2;
+  sketch2.update(values.begin(), values.end());
+  random_bit.seed(1);
+  kll_sketch<bfloat16> sketch3;
+  sketch3.update(values_vector.begin(), values_vector.end());
+  REQUIRE(sketch1.get_n() == 857);
+  REQUIRE(sketch2.serialize() == sketch1.serialize());
+  REQUIRE(sketch3.serialize() == sketch1.serialize());
+}
+
 } /* namespace datasketches */
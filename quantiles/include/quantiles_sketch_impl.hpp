@@ -28,6 +28,7 @@
 
 #include "count_zeros.hpp"
 #include "conditional_forward.hpp"
+#include "sorting.hpp"
 
 namespace datasketches {
 
@@ -299,7 +300,7 @@ void quantiles_sketch<T, C, A>::serialize(std::ostream& os, const SerDe& serde)
   write(os, family);
 
   // side-effect: sort base buffer since always compact
-  std::sort(const_cast<Level&>(base_buffer_).begin(), const_cast<Level&>(base_buffer_).end(), comparator_);
+  sort_items(const_cast<T*>(base_buffer_.data()), const_cast<T*>(base_buffer_.data()) + base_buffer_.size(), comparator_);
   const_cast<quantiles_sketch*>(this)->is_base_buffer_sorted_ = true;
 
   // empty, ordered, compact are valid flags
@@ -347,7 +348,7 @@ auto quantiles_sketch<T, C, A>::serialize(unsigned header_size_bytes, const SerD
   ptr += copy_to_mem(family, ptr);
 
   // side-effect: sort base buffer since always compact
-  std::sort(const_cast<Level&>(base_buffer_).begin(), const_cast<Level&>(base_buffer_).end(), comparator_);
+  sort_items(const_cast<T*>(base_buffer_.data()), const_cast<T*>(base_buffer_.data()) + base_buffer_.size(), comparator_);
   const_cast<quantiles_sketch*>(this)->is_base_buffer_sorted_ = true;
 
   // empty, ordered, compact are valid flags
@@ -741,7 +742,7 @@ template<typename T, typename C, typename A>
 quantiles_sorted_view<T, C, A> quantiles_sketch<T, C, A>::get_sorted_view() const {
   // allow side-effect of sorting the base buffer
   if (!is_base_buffer_sorted_) {
-    std::sort(const_cast<Level&>(base_buffer_).begin(), const_cast<Level&>(base_buffer_).end(), comparator_);
+    sort_items(const_cast<T*>(base_buffer_.data()), const_cast<T*>(base_buffer_.data()) + base_buffer_.size(), comparator_);
     const_cast<quantiles_sketch*>(this)->is_base_buffer_sorted_ = true;
   }
   quantiles_sorted_view<T, C, A> view(get_num_retained(), comparator_, allocator_);
@@ -772,20 +773,15 @@ auto quantiles_sketch<T, C, A>::get_quantile(double rank, bool inclusive) const
 template<typename T, typename C, typename A>
 std::vector<T, A> quantiles_sketch<T, C, A>::get_quantiles(const double* ranks, uint32_t size, bool inclusive) const {
   if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
-  std::vector<T, A> quantiles(allocator_);
-  quantiles.reserve(size);
-
-  // possible side-effect: sorting base buffer
-  setup_sorted_view();
-
   for (uint32_t i = 0; i < size; ++i) {
     const double rank = ranks[i];
     if ((rank < 0.0) || (rank > 1.0)) {
       throw std::invalid_argument("Normalized rank cannot be less than 0 or greater than 1");
     }
-    quantiles.push_back(sorted_view_->get_quantile(rank, inclusive));
   }
-  return quantiles;
+  // possible side-effect: sorting base buffer
+  setup_sorted_view();
+  return sorted_view_->get_quantiles(ranks, size, inclusive);
 }
 
 template<typename T, typename C, typename A>
@@ -937,7 +933,7 @@ void quantiles_sketch<T, C, A>::process_full_base_buffer() {
   // make sure there will be enough levels for the propagation
   grow_levels_if_needed(); // note: n_ was already incremented by update() before this
 
-  std::sort(base_buffer_.begin(), base_buffer_.end(), comparator_);
+  sort_items(base_buffer_.data(), base_buffer_.data() + base_buffer_.size(), comparator_);
   in_place_propagate_carry(0,
                            levels_[0], // unused here, but 0 is guaranteed to exist
                            base_buffer_,
@@ -1056,6 +1052,19 @@ void quantiles_sketch<T, C, A>::merge_two_size_k_buffers(Level& src_1, Level& sr
       throw std::logic_error("Input invariants violated in merge_two_size_k_buffers()");
   }
 
+  merge_two_size_k_buffers(src_1, src_2, dst, comparator, std::is_arithmetic<T>());
+}
+
+template<typename T, typename C, typename A>
+void quantiles_sketch<T, C, A>::merge_two_size_k_buffers(Level& src_1, Level& src_2,
+    Level& dst, const C& comparator, std::true_type) {
+  dst.resize(dst.capacity());
+  merge_items(src_1.data(), src_1.data() + src_1.size(), src_2.data(), src_2.data() + src_2.size(), dst.data(), comparator);
+}
+
+template<typename T, typename C, typename A>
+void quantiles_sketch<T, C, A>::merge_two_size_k_buffers(Level& src_1, Level& src_2,
+    Level& dst, const C& comparator, std::false_type) {
   auto end1 = src_1.end(), end2 = src_2.end();
   auto it1 = src_1.begin(), it2 = src_2.begin();
   
@@ -23,6 +23,8 @@
 #include <fstream>
 
 #include <quantiles_sketch.hpp>
+#include <parallel_merge.hpp>
+#include <wrapped_quantiles_sorted_view.hpp>
 #include <test_allocator.hpp>
 #include <common_defs.hpp>
 
@@ -867,6 +869,22 @@ TEST_CASE("quantiles sketch", "[quantiles_sketch]") {
     REQUIRE(bytes.size() == sketch2.get_serialized_size_bytes());
   }
 
+  SECTION("wrapped sorted view") {
+    quantiles_sketch<double> sketch(128);
+    for (int i = 0; i < 10000; ++i) sketch.update(i);
+    auto bytes = sketch.get_sorted_view().serialize();
+    auto view = wrapped_quantiles_sorted_view<double>::wrap(bytes.data(), bytes.size());
+    REQUIRE(view.get_total_weight() == sketch.get_n());
+    const double split_points[3] {100, 5000, 9000};
+    const auto pmf = view.get_PMF(split_points, 3);
+    const auto expected_pmf = sketch.get_PMF(split_points, 3);
+    for (size_t i = 0; i < 4; ++i) REQUIRE(pmf[i] == expected_pmf[i]);
+    for (int i = 0; i < 10000; i += 100) {
+      REQUIRE(view.get_rank(i, false) == sketch.get_rank(i, false));
+      REQUIRE(view.get_quantile(i / 10000.0) == sketch.get_quantile(i / 10000.0));
+    }
+  }
+
   SECTION("copy") {
     quantiles_sketch<int> sketch1;
     const int n(1000);
@@ -980,4 +998,21 @@ TEST_CASE("quantiles sketch", "[quantiles_sketch]") {
   }
 }
 
+TEST_CASE("quantiles sketch: merge parallel", "[quantiles_sketch]") {
+  std::vector<quantiles_sketch<double>> sketches;
+  for (int j = 0; j < 50; j++) {
+    sketches.push_back(quantiles_sketch<double>(128));
+    for (int i = 0; i < 1000; i++) sketches.back().update(i * 50 + j);
+  }
+  quantiles_sketch<double> sketch1(128);
+  merge_parallel(sketch1, sketches.begin(), sketches.end(), 4, 7);
+  quantiles_sketch<double> sketch2(128);
+  merge_parallel(sketch2, sketches.begin(), sketches.end(), 1, 7);
+  REQUIRE(sketch1.serialize() == sketch2.serialize());
+  REQUIRE(sketch1.get_n() == 50000);
+  REQUIRE(sketch1.get_min_item() == 0);
+  REQUIRE(sketch1.get_max_item() == 49999);
+  REQUIRE(sketch1.get_rank(25000) == Approx(0.5).margin(RANK_EPS_FOR_K_128));
+}
+
 } /* namespace datasketches */
@@ -53,6 +53,9 @@ public:
 
   uint64_t compute_weight(const T& item, bool inclusive) const;
 
+  // adds the weights of the given items visited in the given order of the items
+  void compute_weights(const T* items, const uint32_t* order, uint32_t size, bool inclusive, uint64_t* weights) const;
+
   template<typename FwdT>
   void append(FwdT&& item);
 
@@ -120,12 +123,10 @@ private:
   std::pair<uint32_t, uint32_t> compute_compaction_range(uint32_t secs_to_compact) const;
   void grow(uint32_t new_capacity);
   void ensure_space(uint32_t num);
+  void merge_promoted(T* items, uint32_t num);
 
   static uint32_t nearest_even(float value);
 
-  template<typename InIter, typename OutIter>
-  static void promote_evens_or_odds(InIter from, InIter to, bool flag, OutIter dst);
-
   // for deserialization
   class items_deleter;
   req_compactor(bool hra, uint8_t lg_weight, bool sorted, float section_size_raw, uint8_t num_sections, uint64_t state,
@@ -27,6 +27,7 @@
 #include "count_zeros.hpp"
 #include "conditional_forward.hpp"
 #include "common_defs.hpp"
+#include "sorting.hpp"
 
 namespace datasketches {
 
@@ -193,6 +194,30 @@ uint64_t req_compactor<T, C, A>::compute_weight(const T& item, bool inclusive) c
   return std::distance(begin(), it) << lg_weight_;
 }
 
+template<typename T, typename C, typename A>
+void req_compactor<T, C, A>::compute_weights(const T* items, const uint32_t* order, uint32_t size, bool inclusive,
+    uint64_t* weights) const {
+  if (!sorted_) const_cast<req_compactor*>(this)->sort(); // allow sorting as a side effect
+  // the items are sorted, so each search starts where the previous one ended,
+  // and a linear sweep is cheaper than a binary search per item if there are many of them
+  const uint32_t num_steps = 32 - count_leading_zeros_in_u32(num_items_);
+  const bool sweep = static_cast<uint64_t>(size) * num_steps >= num_items_;
+  const T* it = begin();
+  for (uint32_t i = 0; i < size; ++i) {
+    const T& item = items[order[i]];
+    if (sweep) {
+      if (inclusive) {
+        while (it != end() && !comparator_(item, *it)) ++it;
+      } else {
+        while (it != end() && comparator_(*it, item)) ++it;
+      }
+    } else {
+      it = inclusive ? std::upper_bound(it, end(), item, comparator_) : std::lower_bound(it, end(), item, comparator_);
+    }
+    weights[order[i]] += static_cast<uint64_t>(std::distance(begin(), it)) << lg_weight_;
+  }
+}
+
 template<typename T, typename C, typename A>
 template<typename FwdT>
 void req_compactor<T, C, A>::append(FwdT&& item) {
@@ -255,15 +280,15 @@ void req_compactor<T, C, A>::merge(FwdC&& other) {
   auto to = from + other.get_num_items();
   auto other_it = other.begin();
   for (auto it = from; it != to; ++it, ++other_it) new (it) T(conditional_forward<FwdC>(*other_it));
-  if (!other.sorted_) std::sort(from, to, comparator_);
-  if (num_items_ > 0) std::inplace_merge(hra_ ? from : begin(), items_ + offset, hra_ ? end() : to, C());
+  if (!other.sorted_) sort_items(from, to, comparator_);
+  if (num_items_ > 0) merge_items_in_place(hra_ ? from : begin(), items_ + offset, hra_ ? end() : to, comparator_);
   num_items_ += other.get_num_items();
 }
 
 template<typename T, typename C, typename A>
 void req_compactor<T, C, A>::sort() {
   if (!sorted_) {
-    std::sort(begin(), end(), comparator_);
+    sort_items(begin(), end(), comparator_);
     sorted_ = true;
   }
 }
@@ -281,11 +306,7 @@ std::pair<uint32_t, uint32_t> req_compactor<T, C, A>::compact(req_compactor& nex
 
   const auto num = (compaction_range.second - compaction_range.first) / 2;
   next.ensure_space(num);
-  auto next_middle = hra_ ? next.begin() : next.end();
-  auto next_empty = hra_ ? next.begin() - num : next.end();
-  promote_evens_or_odds(begin() + compaction_range.first, begin() + compaction_range.second, coin_, next_empty);
-  next.num_items_ += num;
-  std::inplace_merge(next.begin(), next_middle, next.end(), comparator_);
+  next.merge_promoted(begin() + compaction_range.first + (coin_ ? 1 : 0), num);
   for (size_t i = compaction_range.first; i < compaction_range.second; ++i) (*(begin() + i)).~T();
   num_items_ -= compaction_range.second - compaction_range.first;
 
@@ -297,6 +318,38 @@ std::pair<uint32_t, uint32_t> req_compactor<T, C, A>::compact(req_compactor& nex
   );
 }
 
+// The items at every other position starting from the given one are merged into the free space
+// after the items of this compactor from the end (LRA), or before them from the beginning (HRA),
+// so that neither a temporary buffer nor a separate pass to gather the promoted items is needed.
+// Equivalent items go in the same order as in merge_items_in_place() of the items
+// appended after (LRA) or before (HRA) the items of this compactor.
+template<typename T, typename C, typename A>
+void req_compactor<T, C, A>::merge_promoted(T* items, uint32_t num) {
+  if (hra_) {
+    T* const old_begin = begin();
+    T* const last = end();
+    T* it = old_begin;
+    T* dst = old_begin - num;
+    for (uint32_t i = 0; i < num; ++dst) {
+      T* src = (it != last && comparator_(*it, items[2 * i])) ? it++ : &items[2 * i++];
+      if (dst < old_begin) new (dst) T(std::move(*src));
+      else *dst = std::move(*src);
+    }
+  } else {
+    T* const first = begin();
+    T* const old_end = end();
+    T* it = old_end;
+    T* dst = old_end + num;
+    for (uint32_t i = num; i > 0;) {
+      T* src = (it != first && comparator_(items[2 * (i - 1)], *(it - 1))) ? --it : &items[2 * --i];
+      --dst;
+      if (dst >= old_end) new (dst) T(std::move(*src));
+      else *dst = std::move(*src);
+    }
+  }
+  num_items_ += num;
+}
+
 template<typename T, typename C, typename A>
 bool req_compactor<T, C, A>::ensure_enough_sections() {
   const float ssr = section_size_raw_ / sqrtf(2);
@@ -326,21 +379,6 @@ uint32_t req_compactor<T, C, A>::nearest_even(float value) {
   return static_cast<uint32_t>(round(value / 2)) << 1;
 }
 
-template<typename T, typename C, typename A>
-template<typename InIter, typename OutIter>
-void req_compactor<T, C, A>::promote_evens_or_odds(InIter from, InIter to, bool odds, OutIter dst) {
-  if (from == to) return;
-  InIter i = from;
-  if (odds) ++i;
-  while (i != to) {
-    new (dst) T(std::move(*i));
-    ++dst;
-    ++i;
-    if (i == to) break;
-    ++i;
-  }
-}
-
 // implementation for fixed-size arithmetic types (integral and floating point)
 template<typename T, typename C, typename A>
 template<typename S, typename TT, typename std::enable_if<std::is_arithmetic<TT>::value, int>::type>
@@ -111,6 +111,16 @@ public:
   template<typename FwdT>
   void update(FwdT&& item);
 
+  /**
+   * Updates this sketch with the given range of data items.
+   * The result is the same as updating with each item in order, but the capacity is checked
+   * once per block of items up to the next compaction. NaN items are skipped.
+   * @param first iterator to the first item
+   * @param last iterator past the last item
+   */
+  template<typename InputIt>
+  void update(InputIt first, InputIt last);
+
   /**
    * Merges another sketch into this one.
    * @param other sketch to merge into this one
@@ -144,6 +154,8 @@ public:
    */
   Allocator get_allocator() const;
 
+  using vector_double = typename quantiles_sorted_view<T, Comparator, Allocator>::vector_double;
+
   /**
    * Returns an approximation to the normalized rank of the given item from 0 to 1 inclusive.
    *
@@ -158,6 +170,20 @@ public:
    */
   double get_rank(const T& item, bool inclusive = true) const;
 
+  /**
+   * Returns approximations to the normalized ranks of the given items, the same as get_rank() for each item.
+   * The items are sorted once, unless they are sorted already, and then each level is swept
+   * instead of searched, which is faster for many items. NaN items are ranked one by one.
+   *
+   * <p>If the sketch is empty this throws std::runtime_error.
+   *
+   * @param items array of items to be ranked
+   * @param size the number of items in the array
+   * @param inclusive if true the weight of each item is included into its rank
+   * @return an array of approximate ranks of the given items in the same order
+   */
+  vector_double get_ranks(const T* items, uint32_t size, bool inclusive = true) const;
+
   /**
    * Returns an approximation to the Probability Mass Function (PMF) of the input stream
    * given a set of split points (items).
@@ -177,7 +203,6 @@ public:
    * @return an array of m+1 doubles each of which is an approximation
    * to the fraction of the input stream items (the mass) that fall into one of those intervals.
    */
-  using vector_double = typename quantiles_sorted_view<T, Comparator, Allocator>::vector_double;
   vector_double get_PMF(const T* split_points, uint32_t size, bool inclusive = true) const;
 
   /**
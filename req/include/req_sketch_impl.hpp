@@ -20,6 +20,7 @@
 #ifndef REQ_SKETCH_IMPL_HPP_
 #define REQ_SKETCH_IMPL_HPP_
 
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
 
@@ -201,6 +202,38 @@ void req_sketch<T, C, A>::update(FwdT&& item) {
   reset_sorted_view();
 }
 
+template<typename T, typename C, typename A>
+template<typename InputIt>
+void req_sketch<T, C, A>::update(InputIt first, InputIt last) {
+  // min and max are initialized by the first valid item
+  while (is_empty()) {
+    if (first == last) return;
+    update(*first++);
+  }
+  T min_item(*min_item_);
+  T max_item(*max_item_);
+  while (first != last) {
+    // the block of items up to the next compaction
+    uint32_t num = 0;
+    const uint32_t block_size = max_nom_size_ - num_retained_;
+    for (; first != last && num < block_size; ++first) {
+      auto&& value = *first;
+      if (!check_update_item(value)) continue; // before the conversion to T
+      const T& item = value;
+      if (comparator_(item, min_item)) min_item = item;
+      if (comparator_(max_item, item)) max_item = item;
+      compactors_[0].append(item);
+      ++num;
+    }
+    num_retained_ += num;
+    n_ += num;
+    if (num_retained_ == max_nom_size_) compress();
+  }
+  *min_item_ = std::move(min_item);
+  *max_item_ = std::move(max_item);
+  reset_sorted_view();
+}
+
 template<typename T, typename C, typename A>
 template<typename FwdSk>
 void req_sketch<T, C, A>::merge(FwdSk&& other) {
@@ -258,6 +291,33 @@ double req_sketch<T, C, A>::get_rank(const T& item, bool inclusive) const {
   return static_cast<double>(weight) / n_;
 }
 
+template<typename T, typename C, typename A>
+auto req_sketch<T, C, A>::get_ranks(const T* items, uint32_t size, bool inclusive) const -> vector_double {
+  if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
+  // NaN items are not ordered, so they are left out of the sorting and the sweeps, and ranked one by one
+  std::vector<uint32_t, typename std::allocator_traits<A>::template rebind_alloc<uint32_t>> order(size, 0, allocator_);
+  uint32_t num_ordered = 0;
+  bool sorted = true;
+  for (uint32_t i = 0; i < size; ++i) {
+    if (!check_update_item(items[i])) continue;
+    if (num_ordered > 0 && comparator_(items[i], items[order[num_ordered - 1]])) sorted = false;
+    order[num_ordered++] = i;
+  }
+  if (!sorted) {
+    const C& compare = comparator_;
+    std::sort(order.begin(), order.begin() + num_ordered, [items, &compare](uint32_t a, uint32_t b) { return compare(items[a], items[b]); });
+  }
+  std::vector<uint64_t, typename std::allocator_traits<A>::template rebind_alloc<uint64_t>> weights(size, 0, allocator_);
+  for (const auto& compactor: compactors_) {
+    compactor.compute_weights(items, order.data(), num_ordered, inclusive, weights.data());
+  }
+  vector_double ranks(size, 0, allocator_);
+  for (uint32_t i = 0; i < size; ++i) {
+    ranks[i] = check_update_item(items[i]) ? static_cast<double>(weights[i]) / n_ : get_rank(items[i], inclusive);
+  }
+  return ranks;
+}
+
 template<typename T, typename C, typename A>
 auto req_sketch<T, C, A>::get_PMF(const T* split_points, uint32_t size, bool inclusive) const -> vector_double {
   if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
@@ -286,20 +346,15 @@ auto req_sketch<T, C, A>::get_quantile(double rank, bool inclusive) const -> qua
 template<typename T, typename C, typename A>
 std::vector<T, A> req_sketch<T, C, A>::get_quantiles(const double* ranks, uint32_t size, bool inclusive) const {
   if (is_empty()) throw std::runtime_error("operation is undefined for an empty sketch");
-  std::vector<T, A> quantiles(allocator_);
-  quantiles.reserve(size);
-
-  // possible side-effect of sorting level zero
-  setup_sorted_view();
-
   for (uint32_t i = 0; i < size; ++i) {
     const double rank = ranks[i];
     if ((rank < 0.0) || (rank > 1.0)) {
       throw std::invalid_argument("Normalized rank cannot be less than 0 or greater than 1");
     }
-    quantiles.push_back(sorted_view_->get_quantile(rank, inclusive));
   }
-  return quantiles;
+  // possible side-effect of sorting level zero
+  setup_sorted_view();
+  return sorted_view_->get_quantiles(ranks, size, inclusive);
 }
 
 template<typename T, typename C, typename A>
@@ -19,9 +19,14 @@
 
 #include <catch2/catch.hpp>
 
+#include <bfloat16.hpp>
 #include <req_sketch.hpp>
+#include <parallel_merge.hpp>
+#include <wrapped_quantiles_sorted_view.hpp>
+#include <test_allocator.hpp>
 
 #include <fstream>
+#include <list>
 #include <sstream>
 #include <limits>
 #include <stdexcept>
@@ -564,6 +569,134 @@ TEST_CASE("get_rank equivalence") {
   }
 }
 
+TEST_CASE("req sketch: wrapped sorted view of strings", "[req_sketch]") {
+  req_sketch<std::string> sketch(12);
+  for (int i = 0; i < 1000; ++i) sketch.update(std::to_string(i));
+  auto bytes = sketch.get_sorted_view().serialize();
+  auto view = wrapped_quantiles_sorted_view<std::string>::wrap(bytes.data(), bytes.size());
+  REQUIRE(view.get_total_weight() == sketch.get_n());
+  for (int i = 0; i < 1000; i += 10) {
+    REQUIRE(view.get_rank(std::to_string(i)) == sketch.get_rank(std::to_string(i)));
+    REQUIRE(view.get_quantile(i / 1000.0) == sketch.get_quantile(i / 1000.0));
+  }
+}
+
+TEST_CASE("req sketch: update range", "[req_sketch]") {
+  std::vector<float> items;
+  for (int i = 0; i < 10000; ++i) items.push_back(static_cast<float>((i * 7919) % 10000));
+  items[100] = std::numeric_limits<float>::quiet_NaN();
+  for (const bool hra: {true, false}) {
+    random_bit.seed(1);
+    req_sketch<float> sketch1(12, hra);
+    sketch1.update(items.begin(), items.end());
+    random_bit.seed(1);
+    req_sketch<float> sketch2(12, hra);
+    for (const float item: items) sketch2.update(item);
+    REQUIRE(sketch1.get_n() == 9999);
+    REQUIRE(sketch1.serialize() == sketch2.serialize());
+
+    // into a sketch in estimation mode
+    sketch1.update(items.begin(), items.begin() + 5000);
+    for (auto it = items.begin(); it != items.begin() + 5000; ++it) sketch2.update(*it);
+    REQUIRE(sketch1.get_n() == 14998);
+    REQUIRE(sketch1.get_min_item() == 0);
+    REQUIRE(sketch1.get_max_item() == 9999);
+    REQUIRE(sketch1.get_num_retained() == sketch2.get_num_retained());
+  }
+
+  req_sketch<std::string> sketch(12);
+  const std::vector<std::string> strings = {"c", "a", "b"};
+  sketch.update(strings.begin(), strings.end());
+  REQUIRE(sketch.get_n() == 3);
+  REQUIRE(sketch.get_min_item() == "a");
+  REQUIRE(sketch.get_max_item() == "c");
+  sketch.update(strings.end(), strings.end());
+  REQUIRE(sketch.get_n() == 3);
+}
+
+TEST_CASE("req sketch: get_ranks", "[req_sketch]") {
+  req_sketch<float> empty(12);
+  const float item = 0;
+  REQUIRE_THROWS_AS(empty.get_ranks(&item, 1), std::runtime_error);
+
+  for (const bool hra: {true, false}) {
+    req_sketch<float> sketch(12, hra);
+    for (int i = 0; i < 10000; ++i) sketch.update(static_cast<float>((i * 7919) % 10000));
+    std::vector<float> sorted_items;
+    for (int i = -1; i <= 10000; i += 7) sorted_items.push_back(static_cast<float>(i));
+    std::vector<float> items;
+    for (int i = 0; i < 50; ++i) items.push_back(static_cast<float>((i * 6007) % 10001));
+    items.push_back(items[0]);
+    for (const bool inclusive: {true, false}) {
+      // level zero is not sorted before the first query
+      req_sketch<float> copy(sketch);
+      auto ranks = copy.get_ranks(items.data(), static_cast<uint32_t>(items.size()), inclusive);
+      REQUIRE(ranks.size() == items.size());
+      for (size_t i = 0; i < items.size(); ++i) REQUIRE(ranks[i] == sketch.get_rank(items[i], inclusive));
+      ranks = sketch.get_ranks(sorted_items.data(), static_cast<uint32_t>(sorted_items.size()), inclusive);
+      for (size_t i = 0; i < sorted_items.size(); ++i) REQUIRE(ranks[i] == sketch.get_rank(sorted_items[i], inclusive));
+
+      // NaN is not ordered, so it must not affect the ranks of the other items
+      for (std::vector<float> with_nan: {sorted_items, items}) {
+        with_nan.insert(with_nan.begin() + 10, std::numeric_limits<float>::quiet_NaN());
+        with_nan.push_back(std::numeric_limits<float>::quiet_NaN());
+        ranks = sketch.get_ranks(with_nan.data(), static_cast<uint32_t>(with_nan.size()), inclusive);
+        for (size_t i = 0; i < with_nan.size(); ++i) REQUIRE(ranks[i] == sketch.get_rank(with_nan[i], inclusive));
+      }
+    }
+  }
+
+  req_sketch<std::string> sketch(12);
+  for (int i = 0; i < 1000; ++i) sketch.update(std::to_string(i));
+  const std::vector<std::string> strings = {"5", "10", "1", "999", "a"};
+  auto ranks = sketch.get_ranks(strings.data(), static_cast<uint32_t>(strings.size()));
+  for (size_t i = 0; i < strings.size(); ++i) REQUIRE(ranks[i] == sketch.get_rank(strings[i]));
+}
+
+TEST_CASE("req sketch: compaction without temporary buffers", "[req_sketch]") {
+  for (const bool hra: {true, false}) {
+    random_bit.seed(1);
+    req_sketch<double, std::less<double>, test_allocator<double>> sketch1(4, hra, std::less<double>(), 0);
+    int i = 0;
+    for (; i < 200000; ++i) {
+      const long long allocations = test_allocator_total_allocations;
+      const long long bytes = test_allocator_total_bytes;
+      sketch1.update(i % 1000);
+      // sorting and merging the promoted items do not allocate,
+      // so only adding or growing a compactor allocates
+      if (test_allocator_total_allocations != allocations) REQUIRE(test_allocator_total_bytes > bytes);
+    }
+
+    // same items and ranks as with the default allocator
+    random_bit.seed(1);
+    req_sketch<double> sketch2(4, hra);
+    for (i = 0; i < 200000; ++i) sketch2.update(i % 1000);
+    REQUIRE(sketch1.get_num_retained() == sketch2.get_num_retained());
+    auto it1 = sketch1.begin();
+    for (auto it2 = sketch2.begin(); it2 != sketch2.end(); ++it1, ++it2) {
+      REQUIRE((*it1).first == (*it2).first);
+      REQUIRE((*it1).second == (*it2).second);
+    }
+    for (int j = 0; j < 1000; j += 100) REQUIRE(sketch1.get_rank(j) == sketch2.get_rank(j));
+  }
+}
+
+TEST_CASE("req sketch: bfloat16 range with NaN", "[req_sketch]") {
+  // NaN must be skipped before the conversion to bfloat16, the same as one item at a time
+  std::list<float> values;
+  for (int i = 0; i < 1000; i++) values.push_back(i % 7 == 0 ? std::numeric_limits<float>::quiet_NaN() : static_cast<float>(i));
+  for (const bool hra: {true, false}) {
+    random_bit.seed(1);
+    req_sketch<bfloat16> sketch1(12, hra);
+    for (const float value: values) sketch1.update(value);
+    random_bit.seed(1);
+    req_sketch<bfloat16> sketch2(12, hra);
+    sketch2.update(values.begin(), values.end());
+    REQUIRE(sketch1.get_n() == 857);
+    REQUIRE(sketch2.serialize() == sketch1.serialize());
+  }
+}
+
 //TEST_CASE("for manual comparison with Java") {
 //  req_sketch<float> sketch(12, false);
 //  for (size_t i = 0; i < 100000; ++i) sketch.update(i);
@@ -575,4 +708,21 @@ TEST_CASE("get_rank equivalence") {
 //  sketch.serialize(os);
 //}
 
+TEST_CASE("req sketch: merge parallel", "[req_sketch]") {
+  std::vector<req_sketch<float>> sketches;
+  for (int j = 0; j < 30; j++) {
+    sketches.push_back(req_sketch<float>(12));
+    for (int i = 0; i < 1000; i++) sketches.back().update(static_cast<float>(i * 30 + j));
+  }
+  req_sketch<float> sketch1(12);
+  merge_parallel(sketch1, sketches.begin(), sketches.end(), 3, 1);
+  req_sketch<float> sketch2(12);
+  merge_parallel(sketch2, sketches.begin(), sketches.end(), 2, 1);
+  REQUIRE(sketch1.serialize() == sketch2.serialize());
+  REQUIRE(sketch1.get_n() == 30000);
+  REQUIRE(sketch1.get_min_item() == 0);
+  REQUIRE(sketch1.get_max_item() == 29999);
+  REQUIRE(sketch1.get_rank(15000.0f) == Approx(0.5).margin(0.01));
+}
+
 } /* namespace datasketches */